@@ -51,6 +51,7 @@ namespace kvspp {
             int cmdClear(const std::vector<std::string>& args);
             int cmdSave(const std::vector<std::string>& args);
             int cmdLoad(const std::vector<std::string>& args);
+            int cmdImport(const std::vector<std::string>& args);
             int cmdStats(const std::vector<std::string>& args);
             int cmdInspect(const std::vector<std::string>& args);
             int cmdHelp(const std::vector<std::string>& args);
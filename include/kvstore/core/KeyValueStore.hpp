@@ -5,15 +5,44 @@
 #include <vector>
 #include <mutex>
 #include <memory>
+#include <functional>
+#include <optional>
 #include "ValueObject.hpp"
 #include "TypeRegistry.hpp"
+#include "kvstore/persistence/LogStructuredStorage.hpp"
+#include "kvstore/persistence/PackedStore.hpp"
+#include "kvstore/utils/MappedValueLog.hpp"
 
 namespace kvspp {
     namespace core {
 
+        /**
+        * Describes a single mutation applied to a KeyValueStore.
+        * The pointers are only valid for the duration of the listener call.
+        */
+        struct Mutation {
+            enum class Type { PUT, REMOVE, CLEAR, AUTOSAVE };
+
+            Type type;
+            const std::string* key = nullptr;      // PUT, REMOVE
+            const ValueObject* value = nullptr;    // PUT
+            bool autosave = false;                 // AUTOSAVE
+        };
+
+        /**
+        * Callback invoked for every mutation, while the store lock is held,
+        * so listeners observe mutations in exactly the order they were applied.
+        */
+        using MutationListener = std::function<void(const Mutation&)>;
+
         /**
         * Thread-safe in-memory key-value store.
         * Keys are strings, values are ValueObjects containing typed attributes.
+        * With openLogStructured() the values live on disk instead and only the
+        * keys are kept in memory (see LogStructuredStorage); with openPacked() it
+        * serves an immutable packed file read-only. With setTiering()
+        * values left unread for a while move to a memory-mapped cold file and
+        * come back on their next access.
         */
         class KeyValueStore {
         public:
@@ -32,16 +61,61 @@ namespace kvspp {
             */
             bool hasAutosave() const { return true; }
 
+            /**
+            * Hot/cold tiering counters (accesses are get() calls on the request path)
+            */
+            struct TierStats {
+                size_t hotKeys = 0;
+                size_t coldKeys = 0;
+                uint64_t coldBytes = 0;        // live bytes in the cold file
+                uint64_t coldFileBytes = 0;    // size of the cold file, including released records
+                uint64_t hotHits = 0;
+                uint64_t coldHits = 0;         // each one promoted the value back to memory
+                uint64_t misses = 0;
+                uint64_t demotions = 0;
+            };
+
         private:
+            // One key's value: in memory (hot) or a record in the cold file
+            struct Entry {
+                mutable std::unique_ptr<ValueObject> value;   // null while cold
+                mutable uint64_t coldOffset = 0;
+                mutable uint32_t coldLength = 0;
+                mutable uint32_t lastAccess = 0;              // seconds on the tiering clock
+            };
+
             // The main storage: key -> ValueObject
-            std::unordered_map<std::string, std::unique_ptr<ValueObject>> store_;
+            std::unordered_map<std::string, Entry> store_;
 
             // Per-store type registry for type consistency within this store
-            TypeRegistry typeRegistry_;
+            // (heap-allocated so ValueObjects keep a stable pointer across swapContents)
+            std::unique_ptr<TypeRegistry> typeRegistry_ = std::make_unique<TypeRegistry>();
 
             // Autosave flag for this store
             bool autosave_ = false;
 
+            // Approximate bytes held by store_ (see memoryUsage)
+            mutable size_t bytes_ = 0;
+
+            // Tiering: values idle for coldAfter_ seconds (0 = off) are demoted to
+            // coldLog_, a file created under coldPath_; the log travels with store_
+            uint32_t coldAfter_ = 0;
+            std::string coldPath_;
+            mutable std::unique_ptr<utils::MappedValueLog> coldLog_;
+            mutable size_t coldKeys_ = 0;
+            size_t sweepCursor_ = 0;
+            mutable TierStats tierCounters_;
+
+            // Set for log-structured stores: entries live here and store_ stays empty
+            std::unique_ptr<persistence::LogStructuredStorage> disk_;
+
+            // Set for packed stores: read-only entries served from the mapped file
+            std::unique_ptr<persistence::PackedStore> packed_;
+
+            // Registered mutation listeners (id -> callback)
+            std::vector<std::pair<size_t, MutationListener>> listeners_;
+            size_t nextListenerId_ = 1;
+
             // Mutex for thread safety
             mutable std::mutex mtx_;
             /**
@@ -75,10 +149,36 @@ namespace kvspp {
             /**
             * Get the value object for a given key
             * @param key The key to search for
-            * @return Pointer to ValueObject if found, nullptr if not found
+            * @return Pointer to ValueObject if found, nullptr if not found. For
+            *         log-structured stores it points to a per-thread copy read from
+            *         disk, valid until the next get() on the same thread. A cold
+            *         value (see setTiering) is promoted back to memory.
             */
             const ValueObject* get(const std::string& key) const;
 
+            /**
+            * Run visit on the value of key under the store lock, counting as an access
+            * like get(). For callers sharing the store with other threads: a write, or
+            * demotion of an idle value, may free the value once the lock is released.
+            * @return false if the key does not exist
+            */
+            bool get(const std::string& key, const std::function<void(const ValueObject&)>& visit) const;
+
+            /**
+            * Run visit on the value of key under the store lock, without counting as an
+            * access (cold values are not promoted). Used by snapshots running next to
+            * client writes, which may free a value as soon as the lock is released.
+            * @return false if the key does not exist
+            */
+            bool peek(const std::string& key, const std::function<void(const ValueObject&)>& visit) const;
+
+            /**
+            * Copy the value object for a given key under the store lock
+            * @param key The key to search for
+            * @return Copy of the ValueObject if found, std::nullopt if not found
+            */
+            std::optional<ValueObject> getCopy(const std::string& key) const;
+
             /**
             * Search for keys that have a specific attribute with a specific value
             * @param attributeKey The attribute name to search for
@@ -99,16 +199,31 @@ namespace kvspp {
             /**
             * Add or update a key-value pair in the store with a ValueObject
             * @param key The key to add/update
-            * @param valueObject The ValueObject to store
+            * @param valueObject The ValueObject to store, built against any TypeRegistry
+            * @throws TypeMismatchException if attribute types don't match existing registrations
             */
             void put(const std::string& key, const ValueObject& valueObject);
 
+            /**
+            * Insert many entries under a single lock acquisition (bulk loading)
+            * @param entries Keys and ValueObjects, built against this store's TypeRegistry
+            *        unless schema is given
+            * @param schema The registry the entries were built against; its types are
+            *        checked against (and registered with) this store's before any entry
+            *        is inserted
+            * @throws TypeMismatchException if schema conflicts with existing registrations
+            */
+            void putBatch(std::vector<std::pair<std::string, std::unique_ptr<ValueObject>>>&& entries,
+                const TypeRegistry* schema = nullptr);
+
             /**
             * Delete a key-value pair from the store
             * @param key The key to delete
+            * @param lazy Free the value on the background thread (UNLINK); otherwise it is
+            *             freed after the lock is released, in the background only if large
             * @return true if key was found and deleted, false if key not found
             */
-            bool deleteKey(const std::string& key);
+            bool deleteKey(const std::string& key, bool lazy = false);
 
             /**
             * Get all keys in the store
@@ -116,6 +231,13 @@ namespace kvspp {
             */
             std::vector<std::string> keys() const;
 
+            /**
+            * Check whether a key exists without decoding or promoting its value
+            * @param key The key to look up
+            * @return true if the key exists
+            */
+            bool contains(const std::string& key) const;
+
             /**
             * Get the number of entries in the store
             * @return Number of key-value pairs
@@ -127,9 +249,82 @@ namespace kvspp {
             * @return true if empty, false otherwise
             */
             bool empty() const;            /**
-            * Clear all entries from the store
+            * Clear all entries from the store. The entries are detached in O(1) under
+            * the lock and destroyed afterwards.
+            * @param lazy Destroy them on the background thread (FLUSH ASYNC) instead of
+            *             on the calling thread
+            */
+            void clear(bool lazy = true);
+
+            /**
+            * Approximate memory held by the entries, in bytes
             */
-            void clear();
+            size_t memoryUsage() const;
+
+            /**
+            * Atomically exchange all entries, the TypeRegistry and the autosave flag
+            * with another store, e.g. one loaded off to the side. Readers observe
+            * either the old or the new contents, never a mix.
+            * @param other Store that receives this store's previous contents. A
+            *              log-structured store keeps its storage: an in-memory
+            *              other is written into it and left empty.
+            * @param swapped Run under both store locks once the swap and its
+            *              mutation notifications are done, before any other write
+            */
+            void swapContents(KeyValueStore& other, const std::function<void()>& swapped = nullptr);
+
+            /**
+            * Keep the entries in a log-structured directory instead of in memory,
+            * opening (and recovering) the entries already stored there. Entries
+            * currently held in memory are discarded.
+            * @param directory Directory of the data and hint files
+            * @param options Data file size, merge thresholds and sync behaviour
+            * @throws PersistenceException if the directory cannot be opened
+            */
+            void openLogStructured(const std::string& directory,
+                const persistence::LogStructuredStorage::Options& options);
+
+            /**
+            * The log-structured storage of this store, or nullptr if it is held in memory
+            */
+            persistence::LogStructuredStorage* logStructured() const;
+
+            /**
+            * Serve the entries of a packed file (see PackedStore) instead of holding
+            * them in memory. The store becomes read-only: every mutation throws
+            * KVStoreException. Entries currently held in memory are discarded.
+            * @param path Packed file written by kvspp-pack
+            * @throws PersistenceException if the file is not a valid packed store
+            */
+            void openPacked(const std::string& path);
+
+            /**
+            * The packed file of this store, or nullptr if it is writable
+            */
+            persistence::PackedStore* packedStore() const;
+
+            /**
+            * Turn hot/cold tiering on or off
+            * @param coldAfterSeconds Demote values not accessed for this long; 0 turns
+            *                         tiering off and brings every cold value back
+            * @param coldPath Path prefix of the cold file (a unique suffix is added)
+            */
+            void setTiering(uint32_t coldAfterSeconds, const std::string& coldPath);
+
+            /**
+            * Idle time after which values are demoted, 0 if tiering is off
+            */
+            uint32_t tieringThreshold() const;
+
+            /**
+            * One incremental step of the demotion sweep: visits about maxEntries
+            * entries (continuing where the previous step stopped) and moves the idle
+            * ones to the cold file
+            * @return Number of values demoted
+            */
+            size_t demoteIdle(size_t maxEntries);
+
+            TierStats tierStats() const;
 
             /**
             * Save the store to a file using PersistenceManager
@@ -146,12 +341,70 @@ namespace kvspp {
             void load(const std::string& filePath);
 
             /**
-            * Get the TypeRegistry for this store
+            * Get the TypeRegistry for this store. Only for a store no other thread
+            * can reach yet (one being loaded): LOAD swaps the registry of a live store
             * @return Reference to the store's TypeRegistry
             */
             TypeRegistry& getTypeRegistry();
+            const TypeRegistry& getTypeRegistry() const;
+
+            /**
+            * Every registered attribute and its type, read under the store lock
+            */
+            std::vector<std::pair<std::string, AttributeType>> getSchema() const;
+
+            /**
+            * Register a listener that observes every subsequent mutation
+            * @param listener Callback invoked under the store lock
+            * @return Id used to remove the listener again
+            */
+            size_t addMutationListener(MutationListener listener);
+
+            /**
+            * Remove a previously registered mutation listener
+            * @param id Id returned by addMutationListener
+            */
+            void removeMutationListener(size_t id);
 
         private:
+            /**
+            * Insert or overwrite an entry, keeping bytes_ current, then announce the
+            * write to the mutation listeners (caller must hold mtx_)
+            * @return The value previously stored under key, to be freed outside the lock
+            */
+            std::unique_ptr<ValueObject> replace(std::string key, std::unique_ptr<ValueObject> valueObject);
+
+            /**
+            * The value of an entry (caller must hold mtx_). A cold value is promoted
+            * back to memory if recordAccess is set, otherwise decoded into a
+            * per-thread copy.
+            */
+            const ValueObject* valueOf(const Entry& entry, bool recordAccess) const;
+
+            // Forget an entry's cold record, if it has one (caller must hold mtx_)
+            void releaseCold(const Entry& entry) const;
+
+            // Bring every cold value back to memory (caller must hold mtx_)
+            void promoteAll();
+
+            // Rewrite the cold file without its released records (caller must hold mtx_)
+            void compactColdLog();
+
+            /**
+            * Check types against this store's registry and register the new ones;
+            * nothing is registered if any conflicts (caller must hold mtx_)
+            * @throws TypeMismatchException on the first conflict
+            */
+            void registerTypes(const std::vector<std::pair<std::string, AttributeType>>& types);
+
+            // Throw KVStoreException for packed stores (caller must hold mtx_)
+            void requireWritable() const;
+
+            /**
+            * Dispatch a mutation to all listeners (caller must hold mtx_)
+            */
+            void notify(const Mutation& mutation) const;
+
             /**
             * Helper function to convert AttributeValue to string for search comparison
             * @param value The AttributeValue to convert
@@ -1,8 +1,22 @@
 #pragma once
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <mutex>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <vector>
+#include <condition_variable>
+#include <functional>
 #include "KeyValueStore.hpp"
+#include "kvstore/persistence/BulkLoader.hpp"
+#include "kvstore/persistence/WriteAheadLog.hpp"
+#include "kvstore/persistence/PersistenceManager.hpp"
+#include "kvstore/persistence/ReplicationBacklog.hpp"
+#include "kvstore/utils/ThreadPool.hpp"
 
 namespace kvspp { namespace core { class KeyValueStore; } }
 
@@ -13,6 +27,77 @@ namespace kvstore {
     public:
         using storeToken = std::string;
 
+        // Availability of a store while snapshots are preloaded at startup
+        enum class LoadState {
+            READY,
+            LOADING,
+            FAILED
+        };
+
+        // What requests to a store that is still loading do
+        enum class LoadingPolicy {
+            BLOCK,   // wait until the load finishes
+            REJECT   // fail immediately
+        };
+
+        // Where a store keeps its entries
+        enum class StorageEngine {
+            MEMORY,  // in memory, persisted by snapshots and the write-ahead log
+            LOG      // on disk in store/<token>.logstore/, only keys in memory
+        };
+
+        // Snapshot an autosave store once `changes` mutations happened and `after` elapsed since its last save
+        struct SaveRule {
+            std::chrono::seconds after;
+            uint64_t changes;
+        };
+
+        // Background persistence settings for stores with autosave enabled
+        struct PersistenceOptions {
+            // Format of snapshots written to store/<token>.<ext> and of SAVE without an extension
+            kvspp::persistence::SnapshotFormat snapshotFormat = kvspp::persistence::SnapshotFormat::JSON;
+            // Codec for the blocks of binary snapshots (compressed on the load threads)
+            kvspp::utils::Codec snapshotCompression = kvspp::utils::Codec::NONE;
+            // Snapshots go to <file>.tmp and are renamed into place; this picks what is fsynced first
+            kvspp::persistence::SnapshotFsync snapshotFsync = kvspp::persistence::SnapshotFsync::FILE;
+            // Write snapshot files through io_uring where the kernel allows it
+            bool ioUring = false;
+            // Threads parsing large snapshots on LOAD (0 = one per core, 1 = single-threaded)
+            size_t loadThreads = 0;
+            // Log every mutation to a write-ahead log (otherwise rely on snapshots only)
+            bool appendOnly = true;
+            kvspp::persistence::FsyncPolicy fsyncPolicy = kvspp::persistence::FsyncPolicy::EVERYSEC;
+            std::chrono::milliseconds fsyncInterval{ 1000 };
+            // Rewrite the log into a fresh snapshot once it exceeds this multiple of the snapshot size
+            double rewriteRatio = 2.0;
+            // Logs smaller than this are never rewritten
+            uint64_t rewriteMinSize = 1 << 20;
+            // Snapshot a store's own file incrementally: only keys changed since the last
+            // snapshot are written, as a delta segment on top of the base snapshot
+            bool deltaSnapshots = false;
+            // Merge the deltas into a new base (in the background) once they exceed this
+            // fraction of the base size or number maxDeltas
+            double deltaMergeRatio = 0.5;
+            size_t maxDeltas = 16;
+            std::vector<SaveRule> saveRules = {
+                { std::chrono::seconds(3600), 1 },
+                { std::chrono::seconds(300), 100 },
+                { std::chrono::seconds(60), 10000 }
+            };
+            LoadingPolicy loadingPolicy = LoadingPolicy::BLOCK;
+            // Engine of newly created stores; LOG stores are their own persistence
+            // (no snapshots or write-ahead log) and are merged by the background thread
+            StorageEngine storageEngine = StorageEngine::MEMORY;
+            kvspp::persistence::LogStructuredStorage::Options logStorage;
+            // Hot/cold tiering of in-memory stores: values not read or written for this
+            // many seconds move to a memory-mapped file under store/cold/ (0 = off);
+            // TIERING overrides it per store
+            uint32_t coldAfterSeconds = 0;
+            // Bits per key of the Bloom filter written beside each snapshot (<snapshot>.bloom,
+            // 0 = none); answers lookups of absent keys while a store is still loading
+            double keyFilterBitsPerKey = 10.0;
+        };
+
         // Singleton accessor
         static StoreManager& instance();
 
@@ -28,22 +113,208 @@ namespace kvstore {
         // Thread-safe remove
         void remove(const storeToken& token, const std::string& key);
 
-        // Save a specific store to a file
-        void saveStore(const storeToken& token, const std::string& filename) const;
+        // Save a specific store to a file (synchronous)
+        void saveStore(const storeToken& token, const std::string& filename);
 
-        // Load a specific store from a file
+        // Load a specific store from a file, replaying its write-ahead log if present
         void loadStore(const storeToken& token, const std::string& filename);
 
+        /**
+         * Insert the records read from source (NDJSON or CSV, see BulkLoader) into a store,
+         * parsed in large batches on the load threads. With replace, they go into a fresh
+         * store that replaces the old contents atomically once all are in. An autosave
+         * store's write-ahead log is paused meanwhile and one snapshot is written at the end
+         * @param source Fills the buffer and returns the bytes read, 0 at the end of the input
+         * @return Records loaded
+         */
+        uint64_t bulkLoad(const storeToken& token, kvspp::persistence::BulkLoader::Format format, bool replace,
+            const std::function<size_t(char*, size_t)>& source);
+
+        // Turn autosave on/off: writes a snapshot and attaches/detaches the store's write-ahead log
+        void setAutosave(const storeToken& token, bool enabled);
+
+        // A complete snapshot file of a store, streamed to the client by DUMPSTORE
+        struct Dump {
+            std::string path;   // removed by the caller once sent
+            uint64_t size = 0;
+            uint32_t crc32 = 0;
+        };
+
+        /**
+         * Snapshot a store for DUMPSTORE. If nothing changed since its own snapshot was
+         * written (or loaded) and no deltas sit on top of it, that file is hard-linked
+         * rather than rewritten, so dumping an idle store costs no serialization
+         */
+        Dump dumpStore(const storeToken& token);
+
+        // File to receive a RESTORESTORE upload of the given format into (see restoreStore)
+        std::string restorePath(const storeToken& token, kvspp::persistence::SnapshotFormat format);
+
+        // Replace a store's contents with the snapshot at path (as LOAD does), then remove the file
+        void restoreStore(const storeToken& token, const std::string& path);
+
+        // Set a store's tiering threshold in seconds (0 = off, promoting every cold value)
+        void setTiering(const storeToken& token, uint32_t coldAfterSeconds);
+
+        // Make mutations applied so far durable for an autosave store (group commit on the log)
+        void commitAutosave(const storeToken& token);
+
+        // Ask the background thread to snapshot a store soon; bursts of requests coalesce into one save
+        void requestSave(const storeToken& token);
+
+        // Start a background snapshot now; returns false if one is already in progress
+        bool backgroundSave(const storeToken& token);
+
+        // Unix time of the last successful snapshot of a store (0 if never saved)
+        std::time_t lastSave(const storeToken& token) const;
+
+        // Synchronously snapshot every store with pending changes or save requests
+        void flushPendingSaves();
+
+        /**
+         * Load every snapshot found in store/ in the background, largest first, on
+         * up to `threads` threads (0 = one per core). Each discovered store is
+         * marked LOADING before this returns, so requests can be held back until
+         * its data is in place.
+         * @return Number of stores scheduled
+         */
+        size_t preloadStores(size_t threads);
+
+        // Apply the loading policy: true once the store may be used, false if it is loading and REJECT is set
+        bool awaitLoaded(const storeToken& token);
+
+        // True while awaitLoaded would wait for the store (it is loading and BLOCK is set)
+        bool loadWouldBlock(const storeToken& token) const;
+
+        // True if the store is still loading and its snapshot's key filter rules key out
+        bool definitelyAbsent(const storeToken& token, const std::string& key) const;
+
+        // Every known store with its load state, sorted by token
+        std::vector<std::pair<storeToken, LoadState>> storeStates() const;
+
+        /**
+         * Record the mutations of every store (existing and future) into a replication
+         * backlog of backlogBytes, created on the first call; later calls return it
+         */
+        std::shared_ptr<kvspp::persistence::ReplicationBacklog> enableReplication(size_t backlogBytes);
+
+        // The replication backlog, or null while no follower ever connected
+        std::shared_ptr<kvspp::persistence::ReplicationBacklog> replicationBacklog() const;
+
+        // Configure background persistence (call before enabling autosave)
+        void setPersistenceOptions(const PersistenceOptions& options);
+
         // Clear all stores (for testing/demo)
         void clearAllStores();
 
     private:
+        // Per-store persistence bookkeeping, shared with the store's mutation listeners
+        struct StoreState {
+            std::atomic<uint64_t> dirty{ 0 };          // mutations since the last snapshot
+            size_t dirtyListenerId = 0;
+            std::shared_ptr<kvspp::persistence::WriteAheadLog> log;
+            size_t logListenerId = 0;
+            size_t replicationListenerId = 0;
+            bool saveRequested = false;
+            bool saving = false;
+            std::chrono::steady_clock::time_point lastSaveTick = std::chrono::steady_clock::now();
+            std::time_t lastSave = 0;
+            LoadState loadState = LoadState::READY;
+            // Key filter of the snapshot being preloaded, trusted only while LOADING
+            std::shared_ptr<const kvspp::utils::BloomFilter> keyFilter;
+
+            // Delta snapshots: keys changed since the last snapshot, kept by the
+            // mutation listener (under keysMutex) while deltaSnapshots is on
+            std::mutex keysMutex;
+            std::unordered_set<std::string> dirtyKeys;
+            bool keysCleared = false;
+            // The on-disk base + deltas chain (guarded by snapshotMutex_)
+            bool hasBase = false;                  // base + deltas equal the store as of the last snapshot
+            std::string currentSnapshot;           // single file equal to the store as of the last snapshot or load
+            std::vector<std::string> deltas;       // delta file names, oldest first
+            uint64_t baseBytes = 0;
+            uint64_t deltaBytes = 0;
+            bool savedAutosave = false;            // autosave flag recorded by the last snapshot
+            std::atomic<bool> mergeRequested{ false };
+        };
+
         StoreManager() = default;
+        ~StoreManager();
         StoreManager(const StoreManager&) = delete;
         StoreManager& operator=(const StoreManager&) = delete;
 
+        // Normalize a user supplied filename to store/<name>.<ext> for writing
+        std::string resolveStorePath(const std::string& filename) const;
+        // Like resolveStorePath, but without an explicit extension picks the newest existing snapshot
+        std::string resolveLoadPath(const std::string& filename) const;
+        // Write-ahead log path belonging to a snapshot path
+        static std::string logPathFor(const std::string& snapshotPath);
+        // Data directory of a log-structured store
+        static std::string logStoragePathFor(const storeToken& token);
+        // Packed file that, if present, makes a store read-only and served from it
+        static std::string packedPathFor(const storeToken& token);
+        // Cold file prefix of a tiered store
+        static std::string coldPathFor(const storeToken& token);
+
+        // Apply a tiering threshold to a store (caller holds mutex_)
+        void applyTiering(const storeToken& token, kvspp::core::KeyValueStore& store, uint32_t coldAfterSeconds);
+
+        // Feed a store's mutations to the replication backlog (caller holds mutex_)
+        void attachReplication(const storeToken& token, kvspp::core::KeyValueStore& store, StoreState& state);
+
+        // Returns the store and its state, creating both if needed (caller holds mutex_)
+        std::shared_ptr<StoreState> stateFor(const storeToken& token);
+
+        void attachLog(const storeToken& token, kvspp::core::KeyValueStore& store);
+        void detachLog(const storeToken& token, kvspp::core::KeyValueStore& store);
+        void writeSnapshot(const kvspp::core::KeyValueStore& store, const std::string& path) const;
+
+        // Snapshot a store to store/<token>.json, rotating and dropping its log
+        void snapshotStore(const storeToken& token);
+
+        // Write the store's own snapshot: a delta segment when possible, otherwise a
+        // new base (merging any deltas) installed via a pending manifest entry
+        void writeStoreSnapshot(const storeToken& token, kvspp::core::KeyValueStore& store,
+            StoreState& state, const PersistenceOptions& options);
+
+        // Finish (or discard) a merge interrupted by a crash, before the base is loaded
+        static void recoverPendingMerge(const std::string& basePath);
+
+        // Background thread: fsync (EVERYSEC), save rules, requested saves and log rewrites
+        void persistenceLoop();
+
+        void finishPreload(const storeToken& token, LoadState state);
+
         std::unordered_map<storeToken, kvspp::core::KeyValueStore> stores_;
+        std::unordered_map<storeToken, std::shared_ptr<StoreState>> states_;
+        PersistenceOptions options_;
+        std::atomic<kvspp::persistence::SnapshotFormat> snapshotFormat_{ kvspp::persistence::SnapshotFormat::JSON };
         mutable std::mutex mutex_;
+        std::shared_ptr<kvspp::persistence::ReplicationBacklog> backlog_;
+        // Numbers the temporary files of DUMPSTORE and RESTORESTORE
+        std::atomic<uint64_t> transferSequence_{ 0 };
+        // CRC-32 of the last snapshot file dumped per token, reused while the file is unchanged
+        struct DumpChecksum {
+            uint64_t size;
+            int64_t mtime;
+            uint32_t crc32;
+        };
+        std::unordered_map<storeToken, DumpChecksum> dumpChecksums_;
+        // Cold files left behind by a previous process are removed before the first new one
+        bool coldDirCleaned_ = false;
+
+        // Serializes snapshot writes so concurrent saves never interleave in one file
+        mutable std::mutex saveMutex_;
+        // Serializes background snapshots (rotate + snapshot + drop rotated log)
+        std::mutex snapshotMutex_;
+
+        std::thread persistenceThread_;
+        std::condition_variable persistenceCv_;
+        bool stopPersistence_ = false;
+
+        // Startup preloading; loadCv_ is signalled (under mutex_) whenever a store finishes loading
+        std::unique_ptr<kvspp::utils::ThreadPool> preloadPool_;
+        std::condition_variable loadCv_;
     };
 
 } // namespace kvstore
@@ -3,6 +3,8 @@
 #include <string>
 #include <unordered_map>
 #include <variant>
+#include <vector>
+#include <utility>
 #include <mutex>
 
 namespace kvspp {
@@ -53,6 +55,9 @@ namespace kvspp {
             // check if an attribute is registered
             bool isRegistered(const std::string& attributeName) const;
 
+            // snapshot of every registered attribute and its type (e.g. for snapshot schemas)
+            std::vector<std::pair<std::string, AttributeType>> getAllTypes() const;
+
             // helper function to AttributeValue's type
             static AttributeType getTypeFromValue(const AttributeValue& value);
 
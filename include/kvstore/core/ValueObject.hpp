@@ -35,6 +35,10 @@ namespace kvspp {
             // Constructor with attribute pairs and TypeRegistry reference
             ValueObject(const std::vector<AttributePair>& attributePairs, TypeRegistry& typeRegistry);
 
+            // Constructor for attributes whose types were already validated against
+            // typeRegistry (bulk loading of a snapshot whose schema was registered up front)
+            ValueObject(std::unordered_map<std::string, AttributeValue>&& attributes, TypeRegistry& typeRegistry);
+
             // Default constructor (requires setTypeRegistry call before use)
             ValueObject() = default;
             // copy constructor and assignment operator
@@ -64,6 +68,9 @@ namespace kvspp {
             // Get all attributes
             const std::unordered_map<std::string, AttributeValue>& getAttributes() const;
 
+            // Approximate heap footprint in bytes (used for memory accounting)
+            size_t memoryUsage() const;
+
             // Override toString method to print as comma-separated key-value pairs
             std::string toString() const;
 
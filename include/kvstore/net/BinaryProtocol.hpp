@@ -0,0 +1,86 @@
+#ifndef KVSPP_BINARY_PROTOCOL_HPP
+#define KVSPP_BINARY_PROTOCOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace kvspp {
+    namespace net {
+
+        /**
+         * Length-prefixed binary framing for clients that want the least work per
+         * request: no text to split, upper-case or compare, and values sent as is.
+         *
+         * A client selects it by sending the 4-byte HELLO (0xB1 'K' 'V' <version>)
+         * as the first bytes of a connection; the server answers with the HELLO of
+         * the version it speaks. Every request and reply after that is a 16-byte
+         * little-endian header followed by keyLength bytes of key and valueLength
+         * bytes of value. A reply echoes the request's opcode and id and carries a
+         * status; its value is the result (or the error message). Replies may come
+         * back in a different order than the requests, so clients match them by id.
+         */
+        class BinaryProtocol {
+        public:
+            static constexpr char MAGIC = '\xB1';
+            static constexpr uint8_t VERSION = 1;
+            static constexpr size_t HELLO_SIZE = 4;
+            static constexpr size_t HEADER_SIZE = 16;
+            // Longest key and value a request may announce
+            static constexpr uint32_t MAX_KEY_LENGTH = 1 << 20;
+            static constexpr uint32_t MAX_VALUE_LENGTH = 512u << 20;
+
+            enum class Opcode : uint8_t {
+                PING = 0,
+                SELECT = 1,         // key: store token
+                GET = 2,            // reply: the "value" attribute as a string
+                SET = 3,            // value: stored as the "value" attribute
+                DEL = 4,
+                UNLINK = 5,
+                EXISTS = 6,
+                GET_RECORD = 7,     // reply: every attribute, typed (see BinaryWriter::putValueObject)
+                PUT_RECORD = 8,     // value: typed attributes replacing the record
+                COMMAND = 9         // value: a line protocol command; reply: its reply line
+            };
+
+            enum class Status : uint8_t {
+                OK = 0,
+                NOT_FOUND = 1,
+                FAILED = 2,
+                LOADING = 3,        // the store is loading (and the loading policy rejects)
+                READONLY = 4        // a write on a follower or a packed store
+            };
+
+            // Request flag: no reply unless the status is an error (FAILED, LOADING or READONLY)
+            static constexpr uint8_t FLAG_NOREPLY = 0x01;
+
+            struct Header {
+                Opcode opcode = Opcode::PING;
+                uint8_t flags = 0;
+                Status status = Status::OK;
+                uint32_t requestId = 0;
+                uint32_t keyLength = 0;
+                uint32_t valueLength = 0;
+            };
+
+            // The HELLO for version
+            static std::string hello(uint8_t version);
+            // Decode the HEADER_SIZE bytes at data
+            static Header decode(const char* data);
+            static void encode(std::string& out, const Header& header);
+
+            // Reply to request: its header with status and value, then value; empty if FLAG_NOREPLY leaves it out
+            static std::string reply(const Header& request, Status status, std::string_view value = {});
+            /**
+             * Reply to request with a line protocol reply: NOT_FOUND; ERROR as FAILED
+             * (LOADING and READONLY get statuses of their own) with the message as
+             * value; anything else as OK with the line as value (none for a plain OK).
+             */
+            static std::string replyFromLine(const Header& request, std::string_view line);
+        };
+
+    } // namespace net
+} // namespace kvspp
+
+#endif // KVSPP_BINARY_PROTOCOL_HPP
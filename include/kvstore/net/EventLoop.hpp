@@ -0,0 +1,98 @@
+#ifndef KVSPP_EVENT_LOOP_HPP
+#define KVSPP_EVENT_LOOP_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "kvstore/net/Reactor.hpp"
+#include "kvstore/utils/ThreadPool.hpp"
+
+namespace kvspp {
+    namespace net {
+
+#ifdef __linux__
+        /**
+         * Edge-triggered epoll reactor owning the client sockets it accepts. A server
+         * runs one per reactor thread, each with a listening socket of its own
+         * (SO_REUSEPORT) or all sharing one.
+         *
+         * The loop thread accepts, reads into each connection's input and writes its
+         * output without blocking. The handler runs the complete commands in input,
+         * appending replies to output, on the loop or, with command threads, on a
+         * pool (one batch per connection at a time, so replies stay in order). A
+         * command that streams over the socket or may wait (a BLOCKING result) is
+         * run on a thread of its own with the socket in blocking mode; the
+         * connection returns to the loop when it is done. Input is not read while
+         * replies are still waiting to be sent, so a client that does not read its
+         * replies is held back by TCP flow control instead of by memory.
+         */
+        class EventLoop : public Reactor {
+        public:
+            // Commands run on pool (shared between loops), or on the loop thread if it is null
+            EventLoop(Handler handler, utils::ThreadPool* pool);
+            ~EventLoop() override;
+
+            EventLoop(const EventLoop&) = delete;
+            EventLoop& operator=(const EventLoop&) = delete;
+
+            void run(int listenSock, bool shared) override;
+            void stop() override;
+            Stats stats() const override;
+
+        private:
+            void accept();
+            // Send output, read more input and run it, as far as the socket allows
+            void service(Connection& conn);
+            // false once the connection was closed or output is still pending
+            bool flush(Connection& conn);
+            // Read what has arrived; true if it stopped at the read limit with more to come
+            bool receive(Connection& conn);
+            void execute(Connection& conn);
+            // Handler result on the loop thread
+            void settle(Connection& conn, HandlerResult result);
+            // The handler, with its exceptions turned into CLOSE
+            HandlerResult call(Connection& conn, bool mayBlock);
+            // Run the connection on a thread of its own, socket in blocking mode
+            void block(Connection& conn);
+            // Hand a connection back to the loop (any thread)
+            void complete(Connection& conn, HandlerResult result);
+            void drainCompleted();
+            void close(Connection& conn);
+
+            Handler handler_;
+            utils::ThreadPool* pool_;
+            int epoll_ = -1;
+            int wake_ = -1;             // eventfd: completions and stop()
+            int listen_ = -1;
+            std::atomic<bool> stopping_{ false };
+            std::atomic<size_t> count_{ 0 };
+            std::atomic<uint64_t> accepted_{ 0 };
+            std::atomic<uint64_t> bytesIn_{ 0 };
+            std::atomic<uint64_t> bytesOut_{ 0 };
+            std::atomic<uint64_t> batches_{ 0 };
+            size_t busy_ = 0;
+            std::vector<char> readBuffer_;
+
+            std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+            std::deque<Connection*> ready_;                      // stopped at the read limit
+            std::vector<std::unique_ptr<Connection>> closed_;    // freed after each batch of events
+
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            std::vector<std::pair<Connection*, HandlerResult>> completed_;
+        };
+#endif
+
+    } // namespace net
+} // namespace kvspp
+
+#endif // KVSPP_EVENT_LOOP_HPP
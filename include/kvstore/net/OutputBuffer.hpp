@@ -0,0 +1,52 @@
+#ifndef KVSPP_OUTPUT_BUFFER_HPP
+#define KVSPP_OUTPUT_BUFFER_HPP
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+namespace kvspp {
+    namespace net {
+
+        /**
+         * Replies waiting to be sent, kept as a list of chunks so a batch of them goes
+         * out with one writev. Small replies are copied into the last chunk; large
+         * ones (a big GET value) are moved in as chunks of their own instead of being
+         * copied again. Sent bytes are dropped from the front without shifting the rest.
+         */
+        class OutputBuffer {
+        public:
+            void append(std::string&& data);
+            void append(std::string_view data);
+            OutputBuffer& operator+=(std::string&& data) { append(std::move(data)); return *this; }
+            OutputBuffer& operator+=(std::string_view data) { append(data); return *this; }
+
+            bool empty() const { return size_ == 0; }
+            // Bytes not yet sent
+            size_t size() const { return size_; }
+
+            // The unsent bytes of the first chunk
+            std::string_view front() const;
+#ifndef _WIN32
+            // Describe up to max chunks of unsent bytes, in order; returns the count
+            size_t gather(iovec* vec, size_t max) const;
+#endif
+            // Drop the first count unsent bytes
+            void consume(size_t count);
+            void clear();
+            void swap(OutputBuffer& other) noexcept;
+
+        private:
+            std::deque<std::string> chunks_;
+            size_t head_ = 0;       // bytes of the first chunk already sent
+            size_t size_ = 0;
+        };
+
+    } // namespace net
+} // namespace kvspp
+
+#endif // KVSPP_OUTPUT_BUFFER_HPP
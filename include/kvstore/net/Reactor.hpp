@@ -0,0 +1,77 @@
+#ifndef KVSPP_REACTOR_HPP
+#define KVSPP_REACTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "kvstore/net/OutputBuffer.hpp"
+
+namespace kvspp {
+    namespace net {
+
+        /**
+         * A client connection: its socket, the bytes received but not yet executed
+         * and the replies not yet sent. Exactly one thread works on it at a time.
+         */
+        struct Connection {
+            int sock = -1;
+            std::string input;
+            size_t scanned = 0;         // input before this offset holds no newline
+            OutputBuffer output;
+            std::string selectedToken;
+            // RESP version the client speaks (2 or 3), 0 for the line protocol; -1 until its first command
+            int resp = -1;
+            bool binary = false;        // speaks BinaryProtocol
+            std::string deferred;       // binary requests held back for a loading store (see TCPServer::serveBinary)
+            // Loop bookkeeping
+            bool busy = false;          // handed to a worker; the loop leaves it alone
+            bool peerClosed = false;    // no more input will arrive
+            bool closing = false;       // close once output is sent
+        };
+
+        // What a connection handler leaves to the loop
+        enum class HandlerResult {
+            DONE,       // every complete command ran
+            BLOCKING,   // the next command needs the socket or may wait; run again with mayBlock
+            CLOSE       // close the connection once its output is sent
+        };
+
+        /**
+         * An event loop serving the client connections accepted from a listening
+         * socket: EventLoop (epoll) or UringLoop (io_uring).
+         */
+        class Reactor {
+        public:
+            /**
+             * Runs the complete commands in conn.input, appending replies to conn.output.
+             * mayBlock is set on a connection's own thread, where the socket is in
+             * blocking mode and may be used directly once conn.output has been sent.
+             */
+            using Handler = std::function<HandlerResult(Connection& conn, bool mayBlock)>;
+
+            struct Stats {
+                size_t connections = 0;     // open now
+                uint64_t accepted = 0;
+                uint64_t bytesIn = 0;       // read by the loop (not by commands streaming on their own thread)
+                uint64_t bytesOut = 0;      // sent by the loop
+                uint64_t batches = 0;       // handler runs
+            };
+
+            virtual ~Reactor() = default;
+
+            /**
+             * Serve the clients of a listening socket until stop(); connections still
+             * with a worker are shut down and waited for before this returns.
+             * A socket shared with other loops wakes only one of them per connection
+             */
+            virtual void run(int listenSock, bool shared) = 0;
+            // Ends run(); callable from any thread
+            virtual void stop() = 0;
+            virtual Stats stats() const = 0;
+        };
+
+    } // namespace net
+} // namespace kvspp
+
+#endif // KVSPP_REACTOR_HPP
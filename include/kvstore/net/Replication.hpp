@@ -0,0 +1,87 @@
+#ifndef KVSPP_REPLICATION_HPP
+#define KVSPP_REPLICATION_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace kvspp {
+    namespace net {
+
+        /**
+         * Leader side of asynchronous replication.
+         *
+         * A follower opens an ordinary client connection and sends
+         * `SYNC <replication id>|? <offset>`. If the id is the leader's and the
+         * offset still lies in its backlog, the leader answers `CONTINUE <id>` and
+         * streams the backlog from that offset. Otherwise it answers
+         * `FULLSYNC <id> <offset>`, streams every store (a CLEAR, a PUT per key
+         * and the autosave flag, as FRAME_RECORD frames), sends a
+         * FRAME_SNAPSHOT_END frame and continues with the backlog from <offset>.
+         * The copy is taken without blocking writers, so it is not a point in
+         * time, but every change made while it is read is also in the stream
+         * that follows, which brings the follower to the same state. FRAME_PING
+         * frames keep an idle link alive. See ReplicationBacklog for the framing.
+         */
+        class ReplicationLeader {
+        public:
+            // Size of the backlog created when the first follower connects
+            static void setBacklogSize(size_t bytes);
+
+            // Serve the follower on sock that sent SYNC; returns once it disconnects
+            static void serve(int sock, const std::string& replicationId, uint64_t offset);
+
+            // Followers currently being served
+            static size_t followers();
+        };
+
+        /**
+         * Follower side: keeps a connection to the leader, applies its stream to the
+         * local stores and reconnects (resuming from the last applied offset when
+         * the leader still has it) whenever the link drops.
+         */
+        class ReplicationFollower {
+        public:
+            ReplicationFollower(const std::string& host, int port);
+            ~ReplicationFollower();
+
+            ReplicationFollower(const ReplicationFollower&) = delete;
+            ReplicationFollower& operator=(const ReplicationFollower&) = delete;
+
+            void start();
+            void stop();
+
+            struct Status {
+                bool linkUp = false;
+                bool synced = false;         // a full sync completed at least once
+                std::string replicationId;   // leader history the offset belongs to
+                uint64_t offset = 0;         // leader offset applied so far
+                uint64_t fullSyncs = 0;
+                uint64_t partialSyncs = 0;
+            };
+            Status status() const;
+
+            // "host:port" of the leader
+            std::string leader() const;
+
+        private:
+            void run();
+            // One connection: handshake, then apply frames until the link fails
+            void session(int sock);
+
+            std::string host_;
+            int port_;
+            std::thread thread_;
+            std::atomic<bool> running_{ false };
+            std::atomic<int> sock_{ -1 };
+
+            mutable std::mutex mtx_;
+            Status status_;
+        };
+
+    } // namespace net
+} // namespace kvspp
+
+#endif // KVSPP_REPLICATION_HPP
@@ -0,0 +1,53 @@
+#ifndef KVSPP_RESP_HPP
+#define KVSPP_RESP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "kvstore/core/ValueObject.hpp"
+
+namespace kvspp {
+    namespace net {
+
+        /**
+         * The Redis serialization protocol (RESP2 and RESP3) spoken next to the line
+         * protocol: requests are arrays of length-prefixed bulk strings, so keys and
+         * values may hold any bytes, and replies are typed. version is the RESP
+         * version a connection negotiated (2, or 3 after HELLO 3); it decides how
+         * nulls, maps and typed attribute values are written.
+         */
+        class Resp {
+        public:
+            /**
+             * Parse the request at the start of input, "*<n>\r\n" followed by n bulk
+             * strings, into args. Returns the bytes it took, or 0 while it has not all
+             * arrived (args is then left empty).
+             * @throws std::runtime_error if input does not hold a valid request
+             */
+            static size_t parseRequest(std::string_view input, std::vector<std::string>& args);
+
+            static std::string simple(std::string_view text);
+            static std::string error(std::string_view message);
+            static std::string integer(int64_t value);
+            static std::string bulk(std::string_view data);
+            static std::string null(int version);
+            static std::string arrayHeader(size_t count);
+            // A RESP3 map of count pairs; a flat array of 2 * count items in RESP2
+            static std::string mapHeader(size_t count, int version);
+            // An attribute as its RESP3 type (integer, double, boolean), or a bulk string
+            static std::string attribute(const core::AttributeValue& value, int version);
+
+            /**
+             * Rewrite a line protocol reply as RESP: OK as +OK, NOT_FOUND as null,
+             * VALUE as a bulk string of the value, ERROR as an error (LOADING and
+             * READONLY keep their codes) and anything else as a bulk string of the line.
+             */
+            static std::string fromLine(std::string&& reply, int version);
+        };
+
+    } // namespace net
+} // namespace kvspp
+
+#endif // KVSPP_RESP_HPP
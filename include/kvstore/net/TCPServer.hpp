@@ -4,8 +4,14 @@
 #include <thread>
 #include <atomic>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <vector>
 #include "kvstore/core/StoreManager.hpp"
+#include "kvstore/net/BinaryProtocol.hpp"
+#include "kvstore/net/EventLoop.hpp"
+#include "kvstore/net/Replication.hpp"
+#include "kvstore/net/UringLoop.hpp"
 
 namespace kvspp {
     namespace net {
@@ -19,16 +25,63 @@ namespace kvspp {
             void stop();
             bool isRunning() const;
 
+            // Serve as a read-only follower of the leader at host:port (call before start)
+            void replicateFrom(const std::string& host, int port);
+
+            // Pending connections the kernel queues for accept() (call before start)
+            void setListenBacklog(int backlog);
+            // Threads that run client commands; 0 runs them on the event loops (call before start)
+            void setCommandThreads(size_t threads);
+            // Event loops serving connections, each on a thread of its own (call before start)
+            void setReactors(size_t reactors);
+            // Pin reactor i to cpus[i % cpus.size()]; empty leaves them unpinned (call before start)
+            void setReactorCpus(const std::vector<int>& cpus);
+            // Serve connections from io_uring loops where the kernel allows, epoll otherwise (call before start)
+            void setIoUring(bool enabled);
+
         private:
             void run();
+#ifdef __linux__
+            // Runs reactor index on listeners[index], or on the shared listeners[0] past the end
+            void runReactor(size_t index, const std::vector<int>& listeners);
+#endif
+            // Thread-per-connection fallback where there is no event loop
             void handleClient(int clientSock);
-            std::string handleCommand(const std::string& line, std::string& selectedToken);
-            static std::vector<std::string> splitCommand(const std::string& line);
+            // Runs the complete requests in conn.input (see Reactor::Handler)
+            HandlerResult serveConnection(Connection& conn, bool mayBlock);
+            // serveConnection for a connection that negotiated BinaryProtocol
+            HandlerResult serveBinary(Connection& conn, bool mayBlock);
+            // Runs one command line, already split into tokens, and returns its reply
+            std::string handleCommand(const std::vector<std::string>& tokens, std::string& selectedToken, int clientSock);
+            // Runs one RESP request on conn (Redis command names included) and returns its RESP reply
+            std::string handleResp(const std::vector<std::string>& tokens, Connection& conn);
+            // Runs one BinaryProtocol request on conn and returns its reply (empty if it asked for none)
+            std::string handleBinary(const BinaryProtocol::Header& request, std::string_view key,
+                std::string_view value, Connection& conn);
+            // The refusal of a command to a store still loading, or of a write on a follower; empty if it may run
+            std::string checkAvailable(const std::string& cmd, const std::string& selectedToken);
+            // BULKLOAD: ingests the records that follow the line (starting with buffered)
+            std::string handleBulkLoad(const std::vector<std::string>& tokens, const std::string& selectedToken,
+                int clientSock, std::string& buffered);
+            // RESTORESTORE: receives the upload that follows the line (starting with buffered)
+            std::string handleRestore(const std::vector<std::string>& tokens, const std::string& selectedToken,
+                int clientSock, std::string& buffered);
+            static std::vector<std::string> splitCommand(std::string_view line);
 
             int port_;
             std::thread serverThread_;
             std::atomic<bool> running_;
             int serverSock_;
+            int listenBacklog_ = 511;
+            size_t commandThreads_ = 0;
+            size_t reactorCount_ = 1;
+            std::vector<int> reactorCpus_;
+            bool ioUring_ = false;
+#ifdef __linux__
+            std::unique_ptr<utils::ThreadPool> commandPool_;
+            std::vector<std::unique_ptr<Reactor>> loops_;
+#endif
+            std::unique_ptr<ReplicationFollower> follower_;
         };
 
     } // namespace net
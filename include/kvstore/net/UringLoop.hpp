@@ -0,0 +1,107 @@
+#ifndef KVSPP_URING_LOOP_HPP
+#define KVSPP_URING_LOOP_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "kvstore/net/Reactor.hpp"
+#include "kvstore/utils/IoUring.hpp"
+#include "kvstore/utils/ThreadPool.hpp"
+
+namespace kvspp {
+    namespace net {
+
+#ifdef KVSPP_HAVE_IO_URING
+        /**
+         * Reactor on one io_uring per loop thread, as an alternative to EventLoop.
+         *
+         * A multishot accept delivers new connections, and a multishot receive per
+         * connection fills buffers from a provided-buffer ring that the loop copies
+         * into the connection's input and hands straight back. A connection's replies
+         * go out as one sendmsg at a time. Everything queued in a round reaches the
+         * kernel in a single io_uring_enter, which also waits for the next
+         * completions. Commands run as in EventLoop (on the loop or the shared pool,
+         * BLOCKING ones on a thread of their own). Before such a thread takes the
+         * socket, the receive is cancelled and any send in flight finishes. Receiving
+         * pauses while a connection has a lot of unsent replies or unread input.
+         */
+        class UringLoop : public Reactor {
+        public:
+            /**
+             * Commands run on pool (shared between loops), or on the loop thread if it is null
+             * @throws std::system_error if the kernel lacks what the loop needs (6.0 or later)
+             */
+            UringLoop(Handler handler, utils::ThreadPool* pool);
+            ~UringLoop() override;
+
+            UringLoop(const UringLoop&) = delete;
+            UringLoop& operator=(const UringLoop&) = delete;
+
+            void run(int listenSock, bool shared) override;
+            void stop() override;
+            Stats stats() const override;
+
+        private:
+            struct Client;
+
+            void handle(const io_uring_cqe& cqe);
+            void armAccept();
+            void armWake();
+            void armReceive(Client& client);
+            void cancelReceive(Client& client);
+            void armSend(Client& client);
+            void onReceive(Client& client, const io_uring_cqe& cqe);
+            void onSent(Client& client, const io_uring_cqe& cqe);
+            // Should more input be read for the connection now?
+            bool wantsInput(const Client& client) const;
+            // Run the commands in input unless replies are backed up
+            void process(Client& client);
+            void execute(Client& client);
+            HandlerResult call(Client& client, bool mayBlock);
+            // Handler result on the loop thread: send replies, adjust receiving, close
+            void settle(Client& client, HandlerResult result);
+            // Give the connection a thread of its own once the ring has let go of the socket
+            void handOff(Client& client);
+            // Hand a connection back to the loop (any thread)
+            void complete(Client& client, HandlerResult result);
+            void drainCompleted();
+            void markDirty(Client& client);
+            void close(Client& client);
+            // Free a closed connection once no request refers to it
+            void release(Client& client);
+
+            Handler handler_;
+            utils::ThreadPool* pool_;
+            std::unique_ptr<utils::IoUring> ring_;
+            int wake_ = -1;             // eventfd: completions and stop()
+            uint64_t wakeValue_ = 0;
+            int listen_ = -1;
+            std::atomic<bool> stopping_{ false };
+            std::atomic<size_t> count_{ 0 };
+            std::atomic<uint64_t> accepted_{ 0 };
+            std::atomic<uint64_t> bytesIn_{ 0 };
+            std::atomic<uint64_t> bytesOut_{ 0 };
+            std::atomic<uint64_t> batches_{ 0 };
+            size_t busy_ = 0;
+
+            std::unordered_map<Client*, std::unique_ptr<Client>> clients_;
+            std::vector<Client*> dirty_;                         // input arrived this round
+            std::vector<std::unique_ptr<Client>> released_;      // freed after each round
+
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            std::vector<std::pair<Client*, HandlerResult>> completed_;
+        };
+#endif
+
+    } // namespace net
+} // namespace kvspp
+
+#endif // KVSPP_URING_LOOP_HPP
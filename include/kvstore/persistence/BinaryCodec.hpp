@@ -0,0 +1,59 @@
+#pragma once
+
+#include "kvstore/core/ValueObject.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace kvspp {
+    namespace persistence {
+
+        /**
+         * Little-endian primitives shared by the binary on-disk and wire formats.
+         * Attribute values are encoded as a one-byte AttributeType tag followed
+         * by a fixed-width payload (or a length-prefixed payload for strings).
+         */
+        class BinaryWriter {
+        public:
+            static void putU8(std::string& out, uint8_t value);
+            static void putU32(std::string& out, uint32_t value);
+            static void putU64(std::string& out, uint64_t value);
+            static void putString(std::string& out, std::string_view value);
+            static void putAttributeValue(std::string& out, const core::AttributeValue& value);
+            static void putValueObject(std::string& out, const core::ValueObject& obj);
+        };
+
+        /**
+         * Bounds-checked cursor over a binary buffer.
+         * Every accessor throws PersistenceException when the buffer is too short,
+         * so callers can treat a torn tail like any other corruption.
+         */
+        class BinaryReader {
+        public:
+            BinaryReader(const char* data, size_t size);
+
+            uint8_t u8();
+            uint32_t u32();
+            uint64_t u64();
+            std::string string();
+            std::string_view view(size_t length);
+            core::AttributeValue attributeValue();
+
+            // Decode attributes into obj, validating them against obj's TypeRegistry
+            void valueObject(core::ValueObject& obj);
+
+            bool atEnd() const { return pos_ == size_; }
+            size_t position() const { return pos_; }
+            size_t remaining() const { return size_ - pos_; }
+
+        private:
+            void require(size_t length) const;
+
+            const char* data_;
+            size_t size_;
+            size_t pos_ = 0;
+        };
+
+    }
+}
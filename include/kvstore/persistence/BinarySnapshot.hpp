@@ -0,0 +1,57 @@
+#pragma once
+
+#include "kvstore/core/KeyValueStore.hpp"
+#include "kvstore/persistence/JsonWriter.hpp"
+#include "kvstore/utils/Compression.hpp"
+#include "kvstore/utils/ThreadPool.hpp"
+#include <cstdint>
+#include <string>
+
+namespace kvspp {
+    namespace persistence {
+
+        /**
+         * Versioned binary snapshot format (*.kvs).
+         *
+         * Layout (all integers little-endian):
+         *   header   "KVSPSNAP", u32 version, u32 flags, u64 entry count,
+         *            schema (u32 count, then name + AttributeType tag per
+         *            attribute registered in the store's TypeRegistry), u32 crc32
+         *   blocks   u32 entry count, u32 stored length, u32 raw length, u8 codec,
+         *            stored payload, u32 crc32 of the stored payload; the raw
+         *            payload (the stored one decompressed with the block's codec)
+         *            holds per entry a length-prefixed key, a u32 attribute count
+         *            and per attribute a u32 schema index plus a typed value
+         *   footer   u32 block count, then u64 offset, u32 entries, u32 stored
+         *            length, u32 raw length, u8 codec per block; the schema
+         *            continued (u32 count, then name + tag per attribute first
+         *            written after the header, e.g. registered during a
+         *            background save), u32 crc32
+         *   trailer  u64 footer offset, "KVSPEND" + NUL
+         *
+         * Loading maps the file, registers the schema once and bulk-constructs
+         * entries straight from the mapping without re-validating each attribute.
+         * Blocks are self-contained, so with a pool they are compressed on save
+         * and verified, decompressed and decoded on load concurrently. Blocks that
+         * do not shrink are stored uncompressed. Version 2 files (no schema in the
+         * footer) and version 1 files (uncompressed blocks without the raw length
+         * and codec fields either) are still readable.
+         */
+        class BinarySnapshot {
+        public:
+            static constexpr uint32_t VERSION = 3;
+
+            // Write store to path in the binary format, compressing blocks with codec (on pool if given)
+            static void save(const core::KeyValueStore& store, const std::string& path,
+                utils::Codec codec = utils::Codec::NONE, utils::ThreadPool* pool = nullptr,
+                const JsonWriter::KeysCallback& onKeys = nullptr);
+
+            // Replace the contents of store with the snapshot at path
+            static void load(core::KeyValueStore& store, const std::string& path, utils::ThreadPool* pool = nullptr);
+
+            // True if path starts with the binary snapshot magic
+            static bool isBinarySnapshot(const std::string& path);
+        };
+
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "kvstore/core/KeyValueStore.hpp"
+#include "kvstore/utils/ThreadPool.hpp"
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kvspp {
+    namespace persistence {
+
+        /**
+         * High-throughput ingest of newline-delimited records into a store.
+         *
+         * Input is fed in arbitrary pieces and cut at line boundaries into batches
+         * of a few MiB. Each batch is parsed on the pool (attribute types are checked
+         * and registered once per batch, in a registry of the loader's own), and
+         * parsed batches are inserted in input order with one KeyValueStore::putBatch
+         * each, so a later record for a key wins over an earlier one.
+         *
+         * NDJSON records are objects with a string "key" member and scalar
+         * attributes: {"key": "user1", "name": "Ann", "age": 31}.
+         * CSV input starts with a header line. The first column holds the key and
+         * the other columns name the attributes. Fields may be quoted ("" escapes a
+         * quote) but not span lines. Empty fields are skipped. Unquoted fields that
+         * read as true/false, an integer or a decimal number get that type, like
+         * SET values. Quoted fields are always strings.
+         */
+        class BulkLoader {
+        public:
+            enum class Format {
+                NDJSON,
+                CSV
+            };
+
+            // Parse on pool (null or a single worker = the calling thread)
+            BulkLoader(core::KeyValueStore& store, Format format, utils::ThreadPool* pool);
+            // Waits for batches still being parsed
+            ~BulkLoader();
+
+            BulkLoader(const BulkLoader&) = delete;
+            BulkLoader& operator=(const BulkLoader&) = delete;
+
+            // Add input; complete batches are handed to the pool and inserted as they finish
+            void feed(const char* data, size_t length);
+
+            /**
+             * Parse the rest (a last line needs no newline) and insert every remaining batch
+             * @return Records inserted in total
+             * @throws KVStoreException naming the first line of the failing batch
+             */
+            uint64_t finish();
+
+            // "ndjson"/"json" or "csv" (case-insensitive); false for anything else
+            static bool parseFormat(const std::string& name, Format& format);
+
+        private:
+            using Entries = std::vector<std::pair<std::string, std::unique_ptr<core::ValueObject>>>;
+
+            struct Batch {
+                uint64_t firstLine;
+                std::future<Entries> entries;
+            };
+
+            // Hand the whole lines in data to a worker
+            void submit(std::string data);
+            // Insert finished batches in order until at most `keep` are in flight
+            void drain(size_t keep);
+            // Parse whole lines, the first of which is line firstLine of the input
+            Entries parse(const std::string& data, uint64_t firstLine) const;
+            Entries parseCsv(const std::string& data, uint64_t firstLine) const;
+
+            core::KeyValueStore& store_;
+            // Types of the records parsed so far; checked against the store's with each
+            // putBatch, so parsing never touches a registry LOAD may swap out
+            mutable core::TypeRegistry registry_;
+            Format format_;
+            utils::ThreadPool* pool_;
+            std::string pending_;                 // input not yet submitted
+            std::vector<std::string> columns_;    // CSV header (column 0 is the key)
+            bool headerRead_ = false;
+            uint64_t line_ = 1;                   // line number of the start of pending_
+            uint64_t records_ = 0;
+            std::deque<Batch> inFlight_;
+        };
+
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "kvstore/core/KeyValueStore.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace kvspp {
+    namespace persistence {
+
+        /**
+         * Incremental snapshot segment: the keys changed since the previous
+         * snapshot, as full values or tombstones.
+         *
+         * Layout (little-endian): "KVSPDLTA", u32 version, u32 flags (bit 0:
+         * autosave), u64 sequence number, u64 record count, records, u32 crc32 of
+         * everything before it. A record is a u8 op (1 = put, 2 = remove), the
+         * length-prefixed key and, for puts, the BinaryWriter value encoding.
+         */
+        class DeltaSnapshot {
+        public:
+            static constexpr uint32_t VERSION = 1;
+
+            struct Change {
+                std::string key;
+                std::optional<core::ValueObject> value; // nullopt = key removed
+            };
+
+            // Write a delta segment; returns its size in bytes
+            static uint64_t write(const std::string& path, uint64_t sequence, bool autosave,
+                const std::vector<Change>& changes);
+
+            // Apply a delta segment on top of store (after verifying its checksum)
+            static void apply(const std::string& path, core::KeyValueStore& store);
+        };
+
+        /**
+         * Lists the delta segments to apply on top of a base snapshot, oldest first.
+         *
+         * Stored next to the base as <name>.manifest, one "base <file>", "delta
+         * <file>" or "pending <file>" line each (file names relative to the
+         * manifest). "pending" marks a merge in progress: the named file is a new
+         * base that already contains every listed delta and only has to be renamed
+         * over the old one, so the deltas must not be applied again.
+         */
+        struct DeltaManifest {
+            std::string base;
+            std::string pending;
+            std::vector<std::string> deltas;
+
+            // Manifest path belonging to a base snapshot path
+            static std::string pathFor(const std::string& basePath);
+
+            // Read a manifest; std::nullopt if it does not exist
+            static std::optional<DeltaManifest> read(const std::string& path);
+
+            // Replace the manifest atomically (temporary file + rename)
+            void write(const std::string& path) const;
+        };
+
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "kvstore/core/KeyValueStore.hpp"
+#include "kvstore/utils/ThreadPool.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kvspp {
+    namespace persistence {
+
+        /**
+         * Stage 1 of the JSON loader: finds structural characters.
+         *
+         * The input is classified 64 bytes at a time with SIMD compares (AVX2 when
+         * the CPU supports it, SSE2 otherwise, scalar on other architectures) into
+         * quote, backslash and structural bitmasks. Escaped quotes are removed and a
+         * prefix XOR over the remaining quotes yields the in-string mask, so every
+         * '{', '}', '[', ']', ':', ',' outside strings and every opening quote is
+         * reported exactly once, in order. Positions are produced one window at a
+         * time, so memory use does not grow with the input size.
+         */
+        class JsonStructuralScanner {
+        public:
+            static constexpr size_t END = SIZE_MAX;
+
+            // Scan data[begin, end); begin must not lie inside a string
+            JsonStructuralScanner(const char* data, size_t end, size_t begin = 0);
+
+            // Position of the next structural character or opening quote, END when exhausted
+            size_t next();
+
+            // Like next() without consuming the position
+            size_t peek();
+
+            // Name of the block classifier selected for this CPU ("avx2", "sse2" or "scalar")
+            static const char* implementation();
+
+        private:
+            void refill();
+
+            const char* data_;
+            size_t end_;
+            size_t blockPos_;
+            uint64_t prevInString_ = 0;
+            uint64_t prevEscaped_ = 0;
+            std::vector<size_t> index_;
+            size_t cursor_ = 0;
+        };
+
+        /**
+         * Stage 2 of the JSON loader: a single pass over the structural positions
+         * that parses the {"store": {...}} snapshot format in place. Keys and values
+         * are taken directly from the input (unescaped only when they contain a
+         * backslash), attribute types are validated once per attribute name, and the
+         * parsed entries are built into a fresh store that replaces the target's
+         * contents atomically (KeyValueStore::swapContents).
+         *
+         * Given a pool, large snapshots are split at member boundaries of the store
+         * object and the ranges are parsed concurrently; the schema is merged and
+         * registered once before the batch insert.
+         */
+        class JsonReader {
+        public:
+            // Replace the contents of store with the snapshot in data[0, size)
+            static void loadStore(core::KeyValueStore& store, const char* data, size_t size,
+                utils::ThreadPool* pool = nullptr);
+
+            /**
+             * Parse newline-delimited JSON records, {"key": "<key>", "<attribute>": <scalar>, ...},
+             * for bulk loading. The attribute types are validated against (and registered
+             * with) registry; the entries are returned in input order, not yet inserted
+             * @throws PersistenceException on malformed input, TypeMismatchException on type conflicts
+             */
+            static std::vector<std::pair<std::string, std::unique_ptr<core::ValueObject>>> parseRecords(
+                const char* data, size_t size, core::TypeRegistry& registry);
+
+            /**
+             * Check the trailing "crc32" member of a snapshot written by JsonWriter.
+             * Documents without one (hand-written or older snapshots) are accepted.
+             * @throws PersistenceException if the checksum does not match
+             */
+            static void verifyChecksum(const char* data, size_t size);
+        };
+
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "kvstore/core/KeyValueStore.hpp"
+#include "kvstore/core/ValueObject.hpp"
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace kvspp {
+    namespace persistence {
+
+        /**
+         * Streaming JSON serializer with bounded memory.
+         *
+         * Output is accumulated in a fixed-size buffer that is handed to the sink
+         * (a file descriptor, a socket, ...) whenever it fills up, so serializing a
+         * store never needs more memory than the buffer, whatever the store size.
+         *
+         * Snapshots (Style::PRETTY) end with a "crc32" member holding the CRC-32 of
+         * every byte before the comma that precedes it (see JsonReader::verifyChecksum).
+         */
+        class JsonWriter {
+        public:
+            // Receives each full buffer; must consume all bytes or throw
+            using Sink = std::function<void(const char* data, size_t length)>;
+
+            // Layout of a serialized store
+            enum class Style {
+                PRETTY,   // indented snapshot file format, typed attributes
+                COMPACT   // single line, each value as {"value": "<string>"} (TCP JSON command)
+            };
+
+            explicit JsonWriter(Sink sink, size_t bufferSize = 64 * 1024);
+
+            JsonWriter(const JsonWriter&) = delete;
+            JsonWriter& operator=(const JsonWriter&) = delete;
+
+            // Append text verbatim
+            void raw(std::string_view text);
+
+            // Append a quoted, escaped JSON string
+            void string(std::string_view value);
+
+            // Append an attribute value (strings quoted, numbers and booleans bare)
+            void attributeValue(const core::AttributeValue& value);
+
+            // Keys a snapshot is written from (entries deleted meanwhile are skipped)
+            using KeysCallback = std::function<void(const std::vector<std::string>& keys)>;
+
+            // Serialize a whole store as {"store": {...,"autosave": bool}}, plus "crc32" when PRETTY
+            void store(const core::KeyValueStore& store, Style style, const KeysCallback& onKeys = nullptr);
+
+            // Hand any buffered output to the sink
+            void flush();
+
+        private:
+            void put(char c);
+            void valueObject(const core::ValueObject& obj);
+
+            Sink sink_;
+            std::vector<char> buffer_;
+            size_t used_ = 0;
+            bool checksumming_ = false;    // crc_ covers everything handed to the sink
+            uint32_t crc_ = 0;
+        };
+
+    }
+}
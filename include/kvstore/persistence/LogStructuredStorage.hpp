@@ -0,0 +1,167 @@
+#pragma once
+
+#include "kvstore/core/ValueObject.hpp"
+#include "kvstore/core/TypeRegistry.hpp"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kvspp {
+    namespace persistence {
+
+        /**
+         * Log-structured (Bitcask-style) storage for stores larger than memory.
+         *
+         * Only a key directory (key -> file id, offset, length, version) is kept in
+         * memory; values live in append-only data files <id>.data inside one
+         * directory and are read back with positional reads.
+         *
+         * Record layout (little-endian): u32 crc32 of the rest of the record,
+         * u64 version, u32 key length, u32 value length, key, value (BinaryWriter
+         * value encoding). A value length of TOMBSTONE marks a delete, CLEARED (with
+         * an empty key) drops every record of an older version.
+         *
+         * Writes go to the active file, which is sealed once it reaches
+         * maxFileSize. merge() rewrites the live records of all sealed files into
+         * new files and deletes the old ones; every merged or sealed file gets a
+         * <id>.hint file (the key directory entries of that file) so opening the
+         * directory does not have to read the values. Records carry a global
+         * version, so recovery does not depend on the order of the files.
+         */
+        class LogStructuredStorage {
+        public:
+            struct Options {
+                // Seal the active data file once it grows beyond this size
+                uint64_t maxFileSize = 64ull << 20;
+                // Merge once this fraction of the sealed files is stale records ...
+                double mergeRatio = 0.5;
+                // ... and they hold at least this many stale bytes
+                uint64_t mergeMinBytes = 16ull << 20;
+                // fdatasync after every write (otherwise sync() is called periodically)
+                bool syncEveryWrite = false;
+            };
+
+            struct Stats {
+                size_t keys = 0;
+                size_t files = 0;
+                uint64_t diskBytes = 0;
+                uint64_t staleBytes = 0;
+                uint64_t merges = 0;
+            };
+
+            /**
+             * Open (or create) the directory and rebuild the key directory from its
+             * hint and data files. Types recorded in the directory are registered in
+             * registry. Torn records at the end of a file are ignored.
+             */
+            LogStructuredStorage(const std::string& directory, core::TypeRegistry& registry, const Options& options);
+            ~LogStructuredStorage();
+
+            LogStructuredStorage(const LogStructuredStorage&) = delete;
+            LogStructuredStorage& operator=(const LogStructuredStorage&) = delete;
+
+            // Read a value from disk, decoded against registry; std::nullopt if the key is missing
+            std::optional<core::ValueObject> read(const std::string& key, core::TypeRegistry& registry) const;
+
+            bool contains(const std::string& key) const;
+
+            // Append a value; the record is written before this returns (fsynced with syncEveryWrite)
+            void put(const std::string& key, const core::ValueObject& value);
+
+            // Append many values with as few writes as possible
+            void putBatch(const std::vector<std::pair<const std::string*, const core::ValueObject*>>& entries);
+
+            // Append a tombstone; false if the key did not exist
+            bool remove(const std::string& key);
+
+            // Drop every key: writes a clear marker, then deletes the older files
+            void clear();
+
+            std::vector<std::string> keys() const;
+            size_t size() const;
+
+            // Approximate memory held by the key directory, in bytes
+            size_t memoryUsage() const;
+
+            // Persist the attribute types of registry if new ones were registered since the last call
+            void saveSchema(const core::TypeRegistry& registry);
+
+            // fdatasync the active data file
+            void sync();
+
+            // True once stale records in sealed files exceed the merge thresholds
+            bool mergeNeeded() const;
+
+            /**
+             * Rewrite the live records of all sealed files and delete them; writes
+             * and reads continue meanwhile (meant for a background thread)
+             */
+            void merge();
+
+            // Write hint files for sealed files that have none yet
+            void writeMissingHints();
+
+            Stats stats() const;
+
+            const std::string& directory() const { return directory_; }
+
+        private:
+            struct DataFile;
+
+            struct Location {
+                uint32_t fileId;
+                uint32_t valueLength;
+                uint64_t offset;      // start of the record
+                uint64_t version;
+            };
+
+            // One record as listed by a hint file or a scan of a data file
+            struct IndexEntry {
+                std::string key;
+                Location location;
+            };
+
+            std::string dataPath(uint32_t id) const;
+            std::string hintPath(uint32_t id) const;
+
+            std::shared_ptr<DataFile> openFile(uint32_t id, bool writable) const;
+            // Seal the active file and start a new one (caller holds mtx_)
+            void rotate();
+            // Append encoded records to the active file (caller holds mtx_)
+            uint64_t appendActive(const std::string& records);
+            // Record a superseded record as stale in its file (caller holds mtx_)
+            void markStale(const Location& location, size_t keyLength);
+
+            // Entries of one data file, from its hint file when valid, otherwise by scanning it
+            std::vector<IndexEntry> indexFile(const DataFile& file) const;
+            static std::vector<IndexEntry> scanFile(const DataFile& file);
+            static bool readHint(const std::string& path, uint32_t fileId, std::vector<IndexEntry>& entries);
+            static void writeHint(const std::string& path, const std::vector<IndexEntry>& entries);
+
+            void recover(core::TypeRegistry& registry);
+            void loadSchema(core::TypeRegistry& registry);
+
+            std::string directory_;
+            Options options_;
+
+            std::unordered_map<std::string, Location> keyDir_;
+            std::map<uint32_t, std::shared_ptr<DataFile>> files_;   // every data file, by id
+            std::shared_ptr<DataFile> active_;
+            uint32_t nextFileId_ = 1;
+            uint64_t nextVersion_ = 1;
+            size_t keyBytes_ = 0;
+            size_t schemaTypes_ = 0;
+            uint64_t merges_ = 0;
+            mutable std::mutex mtx_;
+
+            // Serializes merge() and writeMissingHints()
+            std::mutex mergeMutex_;
+        };
+
+    }
+}
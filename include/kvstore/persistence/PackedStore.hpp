@@ -0,0 +1,109 @@
+#pragma once
+
+#include "kvstore/core/ValueObject.hpp"
+#include "kvstore/core/TypeRegistry.hpp"
+#include "kvstore/utils/BloomFilter.hpp"
+#include "kvstore/utils/MappedFile.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace kvspp {
+    namespace core { class KeyValueStore; }
+
+    namespace persistence {
+
+        /**
+         * Immutable packed store file (*.kvpack), built offline by kvspp-pack and
+         * served read-only straight from a memory mapping.
+         *
+         * Layout (all integers little-endian):
+         *   header   "KVSPPACK", u32 version, u32 flags, u64 entry count, u64 hash
+         *            seed, u32 bucket count, u64 pilots offset, u64 slots offset,
+         *            u64 records offset, u64 file size, u32 crc32 of everything
+         *            from the pilots offset to the end, schema (u32 count, then
+         *            name + AttributeType tag per attribute), u32 crc32
+         *   pilots   u32 per bucket of the minimal perfect hash
+         *   records  length-prefixed key, u32 attribute count and per attribute
+         *            a u32 schema index plus a typed value
+         *   slots    u64 record offset per entry, indexed by the key's hash slot
+         *
+         * The index is a minimal perfect hash (hash and displace): a key's hash
+         * picks a bucket, and the bucket's pilot displaces it onto a slot no other
+         * key of the file uses. A lookup is two hashes, one pilot and one slot
+         * read and a key comparison against the record, whose bytes are only
+         * decoded when a value is actually returned. Opening validates just the
+         * header, so startup cost does not depend on the number of entries, and
+         * every process serving the file shares its page-cached copy. A key filter
+         * written next to the file (<file>.bloom) answers most misses without
+         * touching the mapping at all.
+         */
+        class PackedStore {
+        public:
+            static constexpr uint32_t VERSION = 1;
+
+            // Write the entries of store to path in the packed format
+            static void write(const core::KeyValueStore& store, const std::string& path);
+
+            // True if path starts with the packed store magic
+            static bool isPackedStore(const std::string& path);
+
+            /**
+             * Map a packed file and validate its header
+             * @throws PersistenceException if it is not a valid packed store
+             */
+            explicit PackedStore(const std::string& path);
+
+            PackedStore(const PackedStore&) = delete;
+            PackedStore& operator=(const PackedStore&) = delete;
+
+            size_t size() const { return count_; }
+            bool contains(std::string_view key) const;
+
+            // Decode the value of key, built against registry (which must hold the schema)
+            std::optional<core::ValueObject> read(std::string_view key, core::TypeRegistry& registry) const;
+
+            std::vector<std::string> keys() const;
+
+            // Keys whose attribute satisfies match; only that attribute is decoded
+            std::vector<std::string> search(const std::string& attribute,
+                const std::function<bool(const core::AttributeValue&)>& match) const;
+
+            // Register every attribute of the file's schema with registry
+            void registerSchema(core::TypeRegistry& registry) const;
+
+            /**
+             * Check the body checksum and that every record is reachable through the index
+             * @throws PersistenceException on any mismatch
+             */
+            void verify() const;
+
+            const std::string& path() const { return path_; }
+            uint64_t fileSize() const { return file_.size(); }
+
+        private:
+            // Record of key, or nullptr if the file does not contain it
+            const char* find(std::string_view key) const;
+            uint64_t slotOf(std::string_view key) const;
+            uint64_t recordOffset(uint64_t slot) const;
+
+            std::string path_;
+            utils::MappedFile file_;
+            uint64_t count_ = 0;
+            uint64_t seed_ = 0;
+            uint32_t buckets_ = 0;
+            uint64_t pilotsOffset_ = 0;
+            uint64_t slotsOffset_ = 0;
+            uint64_t recordsOffset_ = 0;
+            uint32_t bodyCrc_ = 0;
+            std::vector<std::pair<std::string, core::AttributeType>> schema_;
+            std::unique_ptr<utils::BloomFilter> filter_;
+        };
+
+    }
+}
@@ -3,6 +3,11 @@
 #include "kvstore/core/KeyValueStore.hpp"
 #include "kvstore/core/ValueObject.hpp"
 #include "kvstore/exceptions/Exceptions.hpp"
+#include "kvstore/persistence/JsonWriter.hpp"
+#include "kvstore/utils/BloomFilter.hpp"
+#include "kvstore/utils/Compression.hpp"
+#include "kvstore/utils/ThreadPool.hpp"
+#include <functional>
 #include <string>
 #include <memory>
 #include <mutex>
@@ -10,6 +15,28 @@
 namespace kvspp {
     namespace persistence {
 
+        /**
+         * On-disk snapshot formats. JSON stays the import/export format;
+         * BINARY (*.kvs, see BinarySnapshot) is the fast-loading one.
+         */
+        enum class SnapshotFormat {
+            JSON,
+            BINARY
+        };
+
+        /**
+         * How far a finished snapshot is made durable before it replaces the old one.
+         * Snapshots are always written to <path>.tmp and renamed into place, so a
+         * crash leaves either the old or the new file; fsyncing the file makes sure
+         * the renamed file has its contents, fsyncing the directory that the rename
+         * itself survives a power loss.
+         */
+        enum class SnapshotFsync {
+            NONE,       // leave flushing to the operating system
+            FILE,       // fsync the file before renaming it
+            DIRECTORY   // fsync the file, rename, then fsync its directory
+        };
+
         /**
          * PersistenceManager handles saving and loading key-value store data
          * to/from JSON files. It maintains type consistency across sessions
@@ -23,10 +50,10 @@ namespace kvspp {
         public:
             explicit PersistenceManager(const std::string& filePath);
 
-            // Save the entire store to JSON file
+            // Save the entire store in the format implied by the file extension
             void save(const core::KeyValueStore& store);
 
-            // Load store data from JSON file
+            // Load store data, detecting binary snapshots by their magic bytes
             void load(core::KeyValueStore& store);
 
             // Check if the persistence file exists
@@ -38,24 +65,55 @@ namespace kvspp {
             // Set a new file path
             void setFilePath(const std::string& newFilePath);
 
+            // Format written for a path, chosen by extension (*.kvs is binary, anything else JSON)
+            static SnapshotFormat formatForPath(const std::string& path);
+
+            // File extension (including the dot) used for a format
+            static const char* extensionFor(SnapshotFormat format);
+
+            // Worker threads used to parse large snapshots (0 = one per core, 1 = load on the calling thread)
+            static void setLoadThreads(size_t threads);
+
+            // Codec for the blocks of binary snapshots written from now on (unavailable codecs fall back to FAST)
+            static void setCompression(utils::Codec codec);
+            static utils::Codec compression();
+
+            // Durability of snapshot files written from now on
+            static void setSnapshotFsync(SnapshotFsync policy);
+            static SnapshotFsync snapshotFsync();
+
+            /**
+             * Replace path with the finished file temporary, fsyncing per snapshotFsync()
+             * @throws PersistenceException if the file cannot be synced or renamed
+             */
+            static void commitFile(const std::string& temporary, const std::string& path);
+
+            // Bits per key of the key filter written next to every snapshot (0 = none)
+            static void setKeyFilterBits(double bitsPerKey);
+            static double keyFilterBits();
+
+            // Key filter sidecar of a snapshot: <snapshot>.bloom
+            static std::string keyFilterPathFor(const std::string& snapshotPath);
+
+            /**
+             * Write the key filter of a snapshot that was just written, recording the
+             * snapshot's size and modification time
+             * @param keys Every key the snapshot holds (extra keys are harmless)
+             */
+            static void writeKeyFilter(const std::vector<std::string>& keys, const std::string& snapshotPath);
+
+            /**
+             * The key filter of a snapshot, or null if it is missing, corrupt or was
+             * not written for the snapshot's current contents
+             */
+            static std::unique_ptr<utils::BloomFilter> loadKeyFilter(const std::string& snapshotPath);
+
+            // Pool shared by all loads, compressed saves and bulk loads, created on first use; null when single-threaded
+            static utils::ThreadPool* sharedLoadPool();
+
         private:
-            // JSON serialization helpers
-            std::string valueObjectToJson(const core::ValueObject& obj) const;
-            std::string attributeValueToJson(const core::AttributeValue& value) const;
-            std::string escapeJsonString(const std::string& str) const;
-
-            // JSON deserialization helpers
-            core::ValueObject jsonToValueObject(const std::string& jsonStr, core::TypeRegistry& typeRegistry) const;
-            core::AttributeValue parseJsonValue(const std::string& jsonValue) const;
-            std::string unescapeJsonString(const std::string& str) const;
-
-            // File I/O helpers
-            std::string readFile(const std::string& path) const;
-            void writeFile(const std::string& path, const std::string& content) const;
-              // JSON parsing utilities
-            std::string extractJsonString(const std::string& json, const std::string& key) const;
-            std::string findJsonValue(const std::string& json, const std::string& key) const;
-            void parseStoreSection(const std::string& storeJson, core::KeyValueStore& store) const;
+            // Stream JSON produced by serialize straight to the file through a bounded buffer
+            void writeFile(const std::string& path, const std::function<void(JsonWriter&)>& serialize) const;
         };
 
     }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "kvstore/core/KeyValueStore.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace kvspp {
+    namespace persistence {
+
+        /**
+         * Leader side of replication: a bounded, in-memory stream of the mutations
+         * of every store, addressed by byte offset.
+         *
+         * Each mutation is framed like a write-ahead log record, [u32 length]
+         * [u32 crc32][payload], with a payload of u8 FRAME_RECORD, the store token
+         * (length-prefixed) and the WriteAheadLog record of the mutation. Offsets
+         * grow forever; the buffer keeps the last `capacity` bytes, so a follower
+         * that reconnects with an offset still inside it resumes from there, and
+         * one that fell further behind needs a full resync. The id changes with
+         * every backlog (every leader process), so offsets are never compared
+         * across histories.
+         */
+        class ReplicationBacklog {
+        public:
+            // Payload kinds of replication frames
+            static constexpr uint8_t FRAME_RECORD = 1;         // token + WAL record
+            static constexpr uint8_t FRAME_SNAPSHOT_END = 2;   // full sync complete
+            static constexpr uint8_t FRAME_PING = 3;           // keep-alive while idle
+
+            explicit ReplicationBacklog(size_t capacity);
+
+            // Frame a mutation of store token and append it (called from mutation listeners)
+            void append(const std::string& token, const core::Mutation& mutation);
+
+            /**
+             * Copy up to maxBytes of the stream starting at offset into out (replacing
+             * its contents), waiting up to timeout for data if the follower is caught up
+             * @return false if offset is no longer (or not yet) in the backlog
+             */
+            bool read(uint64_t offset, std::string& out, size_t maxBytes, std::chrono::milliseconds timeout) const;
+
+            // True if a follower may resume from offset
+            bool contains(uint64_t offset) const;
+
+            // Offset just past the last appended frame
+            uint64_t endOffset() const;
+
+            const std::string& id() const { return id_; }
+            size_t capacity() const { return ring_.size(); }
+
+            // Append a complete frame with the given payload to out (shared with the full sync stream)
+            static void appendFrame(std::string& out, const std::string& payload);
+
+            // Payload of a FRAME_RECORD for a mutation of store token
+            static std::string recordPayload(const std::string& token, const core::Mutation& mutation);
+
+        private:
+            std::string id_;
+            std::vector<char> ring_;
+            uint64_t end_ = 0;
+
+            mutable std::mutex mtx_;
+            mutable std::condition_variable cv_;
+        };
+
+    }
+}
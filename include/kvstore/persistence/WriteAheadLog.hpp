@@ -0,0 +1,101 @@
+#pragma once
+
+#include "kvstore/core/KeyValueStore.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace kvspp {
+    namespace persistence {
+
+        /**
+         * When appended log records are forced to stable storage
+         */
+        enum class FsyncPolicy {
+            ALWAYS,    // fsync before a commit returns
+            EVERYSEC,  // write on commit, fsync periodically in the background
+            NO         // write on commit, leave flushing to the OS
+        };
+
+        /**
+         * Append-only log of store mutations.
+         *
+         * Each record is framed as [u32 length][u32 crc32][payload], where the
+         * payload starts with a one-byte record type followed by the BinaryWriter
+         * encoding of the mutation. Appends only buffer the record in memory;
+         * commit() implements group commit: the first waiting writer becomes the
+         * leader, writes (and optionally fsyncs) everything buffered so far in one
+         * go, and wakes every writer whose record was part of that batch.
+         */
+        class WriteAheadLog {
+        public:
+            WriteAheadLog(const std::string& filePath, FsyncPolicy policy);
+            ~WriteAheadLog();
+
+            WriteAheadLog(const WriteAheadLog&) = delete;
+            WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+            // Buffer a mutation record; returns its sequence number
+            uint64_t append(const core::Mutation& mutation);
+
+            // Block until every record appended so far is written per the fsync policy
+            void commit();
+
+            // fsync data written since the last fsync (used by the EVERYSEC policy)
+            void fsyncIfNeeded();
+
+            // Discard the log contents (the caller has just taken a full snapshot)
+            void reset();
+
+            // Move the active log aside to <path>.old and start a new, empty one.
+            // Returns the path of the rotated log, which stays valid for replay
+            // until the caller has written a snapshot covering it.
+            std::string rotate();
+
+            // Total log size in bytes, including records not yet written
+            uint64_t size() const;
+
+            FsyncPolicy getPolicy() const { return policy_; }
+            const std::string& getFilePath() const { return filePath_; }
+
+            // Path of the rotated log belonging to a log path
+            static std::string rotatedPath(const std::string& filePath);
+
+            // Apply every record of a log file to store, streaming it. A torn last
+            // record left by a crash is truncated if newest (the file was still being
+            // appended to); any other bad record throws PersistenceException.
+            // Returns the number of records applied.
+            static size_t replay(const std::string& filePath, core::KeyValueStore& store, bool newest = true);
+
+            // Append the record payload of a mutation to out (also the replication wire format)
+            static void encodeRecord(const core::Mutation& mutation, std::string& out);
+
+            // Apply one record payload to store; throws PersistenceException if it is malformed
+            static void applyRecord(const char* payload, size_t length, core::KeyValueStore& store);
+
+        private:
+            void openFile();
+            void closeFile();
+            void writeAll(const std::string& data);
+            void syncFile(int fd);
+            void waitForLeader(std::unique_lock<std::mutex>& lock);
+
+            enum class RecordType : uint8_t { PUT = 1, REMOVE = 2, CLEAR = 3, AUTOSAVE = 4 };
+
+            std::string filePath_;
+            FsyncPolicy policy_;
+            int fd_ = -1;
+
+            mutable std::mutex mtx_;
+            std::condition_variable cv_;
+            std::string pending_;          // records not yet handed to the OS
+            uint64_t appendedSeq_ = 0;     // last sequence buffered
+            uint64_t writtenSeq_ = 0;      // last sequence written (and fsynced for ALWAYS)
+            uint64_t writtenBytes_ = 0;
+            bool flushing_ = false;        // a leader is writing outside the lock
+            bool unsynced_ = false;        // written data awaiting fsync
+        };
+
+    }
+}
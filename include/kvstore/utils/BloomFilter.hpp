@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kvspp {
+    namespace utils {
+
+        /**
+         * @brief Cache-blocked Bloom filter over keys
+         *
+         * Every key sets its bits within one 512-bit block, so a lookup touches a
+         * single cache line. mayContain() never returns false for an added key;
+         * at 10 bits per key about 1% of absent keys are reported as present.
+         * Uses Checksum::hash64, so a serialized filter is valid on any platform.
+         * Not thread-safe for add(); concurrent mayContain() calls are fine.
+         */
+        class BloomFilter {
+        public:
+            /**
+             * @brief Empty filter sized for a number of keys
+             * @param bitsPerKey Memory per key; more bits mean fewer false positives
+             */
+            BloomFilter(size_t expectedKeys, double bitsPerKey);
+
+            void add(std::string_view key);
+            bool mayContain(std::string_view key) const;
+
+            // Append the filter to out (little-endian, see deserialize)
+            void serialize(std::string& out) const;
+
+            /**
+             * @brief Rebuild a filter written by serialize()
+             * @throws std::runtime_error if the data is malformed
+             */
+            static BloomFilter deserialize(const char* data, size_t length);
+
+            size_t memoryUsage() const { return words_.size() * sizeof(uint64_t); }
+
+        private:
+            BloomFilter() = default;
+
+            std::vector<uint64_t> words_;
+            uint64_t blocks_ = 0;
+            uint32_t hashes_ = 0;
+        };
+
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace kvspp {
+    namespace utils {
+
+        /**
+         * @brief Checksums used to detect torn or corrupted on-disk records, and the
+         * stable key hash of on-disk indexes
+         */
+        class Checksum {
+        public:
+            /**
+             * @brief Compute (or continue) a CRC-32 (IEEE 802.3) over a byte range
+             * @param data Pointer to the bytes to checksum
+             * @param length Number of bytes
+             * @param crc Previous CRC when checksumming incrementally, 0 to start
+             * @return Updated CRC-32 value
+             */
+            static uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
+
+            /**
+             * @brief 64-bit hash of a key that is identical on every platform and build
+             * (unlike std::hash), so it can be persisted in index files
+             */
+            static uint64_t hash64(std::string_view data, uint64_t seed = 0);
+
+            // Finalizer of hash64, also used to derive further hashes from one value
+            static uint64_t mix64(uint64_t x);
+        };
+
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace kvspp {
+    namespace utils {
+
+        /**
+         * @brief Block codecs; the numeric value is stored on disk and must not change
+         */
+        enum class Codec : uint8_t {
+            NONE = 0,
+            FAST = 1,   // built-in LZ77 codec, always available
+            LZ4 = 2,    // only when built against liblz4
+            ZSTD = 3    // only when built against libzstd
+        };
+
+        /**
+         * @brief Compression of independent blocks (snapshot blocks are compressed one by one)
+         */
+        class Compression {
+        public:
+            /**
+             * @brief Whether this build can compress and decompress a codec
+             */
+            static bool available(Codec codec);
+
+            /**
+             * @brief The codec to actually use for a requested one: unavailable library codecs fall back to FAST
+             */
+            static Codec resolve(Codec codec);
+
+            // Lower-case codec name ("none", "fast", "lz4", "zstd")
+            static const char* name(Codec codec);
+
+            // Parse a codec name, std::nullopt if unknown
+            static std::optional<Codec> parse(const std::string& name);
+
+            /**
+             * @brief Compress a block
+             * @param codec Codec to use (must be available)
+             * @param data Bytes to compress
+             * @param length Number of bytes
+             * @param out Receives the compressed bytes (previous contents are replaced)
+             * @return false if the block does not shrink; it should then be stored uncompressed
+             */
+            static bool compress(Codec codec, const char* data, size_t length, std::string& out);
+
+            /**
+             * @brief Decompress a block into a buffer of exactly its original size
+             * @param codec Codec the block was compressed with
+             * @param data Compressed bytes
+             * @param length Number of compressed bytes
+             * @param out Destination buffer
+             * @param rawLength Original size; the block must decompress to exactly this many bytes
+             * @throws PersistenceException if the codec is unavailable or the block is corrupt
+             */
+            static void decompress(Codec codec, const char* data, size_t length, char* out, size_t rawLength);
+        };
+
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "kvstore/utils/IoUring.hpp"
+
+namespace kvspp {
+    namespace utils {
+
+        /**
+         * @brief Sequential writer for a new file (snapshots and the like)
+         *
+         * Data is gathered in 1 MiB buffers. With io_uring enabled (Linux) a full
+         * buffer is queued as an asynchronous write at its offset and the caller
+         * keeps filling the next one, so serialization overlaps the disk; up to four
+         * writes are in flight. Otherwise each full buffer is written with write().
+         * Nothing is synced: callers fsync per their own policy after close().
+         */
+        class FileWriter {
+        public:
+            /**
+             * @brief Create (or truncate) a file for writing
+             * @throws PersistenceException if it cannot be opened
+             */
+            explicit FileWriter(const std::string& path);
+            // Closes the file if close() was not reached (after an error); what was buffered is lost
+            ~FileWriter();
+
+            FileWriter(const FileWriter&) = delete;
+            FileWriter& operator=(const FileWriter&) = delete;
+
+            // @throws PersistenceException if an earlier write failed
+            void write(const char* data, size_t length);
+            void write(const std::string& data) { write(data.data(), data.size()); }
+
+            /**
+             * @brief Write out everything buffered, wait for it and close the file
+             * @throws PersistenceException if any write failed
+             */
+            void close();
+
+            // Use io_uring for files opened from now on, where the kernel allows it
+            static void setIoUring(bool enabled);
+            static bool ioUring();
+
+        private:
+            struct Slot {
+                std::string data;
+                size_t done = 0;            // bytes of data the kernel has written
+                uint64_t offset = 0;        // file offset of data
+                bool inFlight = false;
+            };
+
+            // Hand the current buffer to the kernel (or write it out) and move on to the next
+            void flushBuffer();
+            void queue(size_t slot);
+            // Reap completions; wait for at least one if wait is set
+            void reap(bool wait);
+            void fail(int error);
+            void closeFile();
+
+            std::string path_;
+            int fd_ = -1;
+            uint64_t offset_ = 0;           // file offset of the current buffer
+            std::vector<Slot> slots_;
+            size_t current_ = 0;
+            size_t inFlight_ = 0;
+            int error_ = 0;                 // first errno reported by the kernel
+#ifdef KVSPP_HAVE_IO_URING
+            std::unique_ptr<IoUring> ring_;
+#endif
+        };
+
+    }
+}
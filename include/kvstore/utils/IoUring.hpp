@@ -0,0 +1,110 @@
+#pragma once
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define KVSPP_HAVE_IO_URING 1
+
+#include <linux/io_uring.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kvspp {
+    namespace utils {
+
+        /**
+         * @brief io_uring instance driven through the raw system calls
+         *
+         * A submission queue, a completion queue and optionally one group of
+         * provided buffers that receives pick from (IOSQE_BUFFER_SELECT with
+         * BUFFER_GROUP). Entries queued with sqe() go to the kernel together on the
+         * next submit(). Not thread-safe: a ring belongs to one thread.
+         */
+        class IoUring {
+        public:
+            static constexpr uint16_t BUFFER_GROUP = 0;
+            // user_data of buffer returns; drain() skips their completions
+            static constexpr uint64_t BUFFER_TAG = ~uint64_t(0);
+
+            /**
+             * @brief Set up a ring
+             * @param entries Submission queue size (the completion queue gets twice as many)
+             * @throws std::system_error if the kernel refuses (too old, or io_uring disabled)
+             */
+            explicit IoUring(unsigned entries);
+            ~IoUring();
+
+            IoUring(const IoUring&) = delete;
+            IoUring& operator=(const IoUring&) = delete;
+
+            // A zeroed submission entry; when the queue is full the queued ones are submitted first
+            io_uring_sqe* sqe();
+
+            /**
+             * @brief Submit the queued entries and wait for at least waitFor completions
+             * @return Entries submitted, or -errno (-EINTR when a signal cut the wait short)
+             */
+            int submit(unsigned waitFor = 0);
+
+            /**
+             * @brief Call handle(const io_uring_cqe&) for each completion that is ready
+             * handle may queue new entries but must not call drain()
+             * @return Completions handled
+             */
+            template<typename F>
+            unsigned drain(F&& handle) {
+                unsigned head = *cqHead_;
+                const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+                unsigned handled = 0;
+                while(head != tail) {
+                    const io_uring_cqe& cqe = cqes_[head & cqMask_];
+                    if(cqe.user_data != BUFFER_TAG) handle(cqe);
+                    ++head;
+                    ++handled;
+                    // Release each entry at once; handle may submit and need the room
+                    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+                }
+                return handled;
+            }
+
+            // Whether the kernel implements an opcode
+            bool supports(uint8_t opcode) const;
+
+            /**
+             * @brief Provide count buffers of size bytes as BUFFER_GROUP
+             * Buffers are handed over with IORING_OP_PROVIDE_BUFFERS: provided-buffer
+             * rings (IORING_REGISTER_PBUF_RING) register but stay empty to receives on
+             * some kernels. Call before queueing anything else.
+             * @throws std::system_error if the kernel refuses
+             */
+            void setupBuffers(uint16_t count, uint32_t size);
+            char* buffer(uint16_t id) { return bufferData_.data() + static_cast<size_t>(id) * bufferSize_; }
+            // Give a buffer the kernel filled back to the group (queued with the next submit)
+            void recycleBuffer(uint16_t id);
+
+        private:
+            int fd_ = -1;
+            void* ring_ = nullptr;
+            size_t ringSize_ = 0;
+            io_uring_sqe* sqes_ = nullptr;
+            size_t sqesSize_ = 0;
+
+            unsigned* sqHead_ = nullptr;
+            unsigned* sqTail_ = nullptr;
+            unsigned sqMask_ = 0;
+            unsigned sqEntries_ = 0;
+            unsigned sqeTail_ = 0;          // entries handed out by sqe()
+
+            unsigned* cqHead_ = nullptr;
+            unsigned* cqTail_ = nullptr;
+            unsigned cqMask_ = 0;
+            io_uring_cqe* cqes_ = nullptr;
+
+            std::vector<bool> supported_;
+
+            uint32_t bufferSize_ = 0;
+            std::vector<char> bufferData_;
+        };
+
+    }
+}
+#endif
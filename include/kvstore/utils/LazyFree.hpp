@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace kvspp {
+    namespace utils {
+
+        /**
+         * @brief Background reclamation of detached data (lazy free)
+         *
+         * Owners detach large structures under their own lock in O(1) (swap or
+         * extract) and hand them over here once the lock is released; a single
+         * background thread runs the destructors. Small objects are destroyed
+         * inline, where the hand-off would cost more than the free itself.
+         */
+        class LazyFree {
+        public:
+            // Below this many allocations an object is freed on the calling thread
+            static constexpr size_t EFFORT_THRESHOLD = 64;
+
+            struct Stats {
+                uint64_t pendingBytes;
+                uint64_t pendingObjects;
+                uint64_t freedBytes;
+                uint64_t freedObjects;
+            };
+
+            static LazyFree& instance();
+
+            /**
+             * @brief Destroy an object, in the background if it is expensive to free
+             * @param object Object to destroy (moved in; must not be referenced elsewhere)
+             * @param bytes Approximate memory released, for the pending/freed metrics
+             * @param effort Approximate number of allocations to free
+             */
+            template<typename T>
+            void release(T object, size_t bytes, size_t effort) {
+                if(effort < EFFORT_THRESHOLD) return; // destroyed here on return
+                enqueue(std::make_shared<T>(std::move(object)), bytes);
+            }
+
+            /**
+             * @brief Destroy an object in the background regardless of its size
+             */
+            template<typename T>
+            void releaseAsync(T object, size_t bytes) {
+                enqueue(std::make_shared<T>(std::move(object)), bytes);
+            }
+
+            Stats stats() const;
+
+            // Block until everything handed over so far has been freed
+            void drain();
+
+        private:
+            LazyFree();
+            ~LazyFree() = delete; // lives for the whole process, see instance()
+
+            void enqueue(std::shared_ptr<void> object, size_t bytes);
+            void run();
+
+            struct Job {
+                std::shared_ptr<void> object;
+                size_t bytes;
+            };
+
+            std::deque<Job> jobs_;
+            mutable std::mutex mutex_;
+            std::condition_variable cv_;
+            std::condition_variable drained_;
+            bool busy_ = false;
+            std::atomic<uint64_t> pendingBytes_{ 0 };
+            std::atomic<uint64_t> pendingObjects_{ 0 };
+            std::atomic<uint64_t> freedBytes_{ 0 };
+            std::atomic<uint64_t> freedObjects_{ 0 };
+            std::thread thread_;
+        };
+
+    }
+}
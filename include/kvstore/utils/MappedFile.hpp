@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace kvspp {
+    namespace utils {
+
+        /**
+         * @brief Read-only memory mapping of a whole file (RAII)
+         *
+         * Uses mmap on POSIX systems and a file mapping object on Windows.
+         * Empty files map to a null pointer with size 0.
+         */
+        class MappedFile {
+        public:
+            /**
+             * @brief Map a file into memory
+             * @param path File to map
+             * @throws PersistenceException if the file cannot be opened or mapped
+             */
+            explicit MappedFile(const std::string& path);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            const char* data() const { return data_; }
+            size_t size() const { return size_; }
+
+            /**
+             * @brief Hint that the mapping will be read front to back
+             */
+            void adviseSequential() const;
+
+        private:
+            const char* data_ = nullptr;
+            size_t size_ = 0;
+#ifdef _WIN32
+            void* fileHandle_ = nullptr;
+            void* mappingHandle_ = nullptr;
+#endif
+        };
+
+    }
+}
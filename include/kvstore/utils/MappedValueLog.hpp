@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace kvspp {
+    namespace utils {
+
+        /**
+         * @brief Append-only scratch file accessed through a shared memory mapping
+         *
+         * Holds cold values outside the heap: the pages are file-backed, so the
+         * kernel can write them back and drop them under memory pressure instead
+         * of the process keeping them resident. The file is created empty and
+         * deleted again by the destructor; its contents never outlive the process.
+         * Not thread-safe; callers serialize access.
+         */
+        class MappedValueLog {
+        public:
+            /**
+             * @brief Create (or truncate) the backing file
+             * @throws PersistenceException if it cannot be created
+             */
+            explicit MappedValueLog(const std::string& path);
+            ~MappedValueLog();
+
+            MappedValueLog(const MappedValueLog&) = delete;
+            MappedValueLog& operator=(const MappedValueLog&) = delete;
+
+            /**
+             * @brief Append bytes, growing the file and remapping it when needed
+             * @return Offset of the appended bytes; pointers from data() are invalidated
+             */
+            uint64_t append(const char* bytes, size_t length);
+
+            // Bytes previously appended at offset
+            const char* data(uint64_t offset) const { return map_ + offset; }
+
+            // Mark length appended bytes as no longer referenced
+            void release(size_t length) { liveBytes_ -= length; }
+
+            // Forget every record (the space is reused by later appends)
+            void reset();
+
+            uint64_t size() const { return size_; }
+            uint64_t liveBytes() const { return liveBytes_; }
+            const std::string& path() const { return path_; }
+
+        private:
+            void remap(uint64_t capacity);
+
+            std::string path_;
+            char* map_ = nullptr;
+            uint64_t capacity_ = 0;
+            uint64_t size_ = 0;
+            uint64_t liveBytes_ = 0;
+#ifdef _WIN32
+            void* fileHandle_ = nullptr;
+            void* mappingHandle_ = nullptr;
+#else
+            int fd_ = -1;
+#endif
+        };
+
+    }
+}
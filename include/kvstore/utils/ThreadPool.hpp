@@ -0,0 +1,106 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace kvspp {
+    namespace utils {
+
+        /**
+         * @brief Fixed-size pool of worker threads draining a FIFO task queue
+         *
+         * Tasks must not block on other tasks submitted to the same pool.
+         */
+        class ThreadPool {
+        public:
+            /**
+             * @brief Start the workers
+             * @param threads Number of workers; 0 uses std::thread::hardware_concurrency()
+             */
+            explicit ThreadPool(size_t threads = 0);
+
+            // Finishes queued tasks, then joins the workers
+            ~ThreadPool();
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            /**
+             * @brief Queue a task
+             * @return Future holding the task's result or exception
+             */
+            template<typename F>
+            auto submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+                using Result = std::invoke_result_t<std::decay_t<F>>;
+                auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+                std::future<Result> result = packaged->get_future();
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    tasks_.emplace([packaged]() { (*packaged)(); });
+                }
+                cv_.notify_one();
+                return result;
+            }
+
+            size_t size() const { return workers_.size(); }
+
+            // Worker count used when none is requested (at least 1)
+            static size_t defaultThreadCount();
+
+        private:
+            void workerLoop();
+
+            std::vector<std::thread> workers_;
+            std::queue<std::function<void()>> tasks_;
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            bool stopping_ = false;
+        };
+
+        /**
+         * @brief Wait for every future, then rethrow the first failure
+         *
+         * Used where tasks borrow caller-owned data, so none may still be running
+         * when the caller unwinds.
+         */
+        template<typename T>
+        std::vector<T> waitAll(std::vector<std::future<T>>& futures) {
+            std::vector<T> results;
+            results.reserve(futures.size());
+            std::exception_ptr failure;
+            for(auto& future : futures) {
+                try {
+                    results.push_back(future.get());
+                }
+                catch(...) {
+                    if(!failure) failure = std::current_exception();
+                }
+            }
+            if(failure) std::rethrow_exception(failure);
+            return results;
+        }
+
+        // waitAll for tasks without a result
+        inline void waitAll(std::vector<std::future<void>>& futures) {
+            std::exception_ptr failure;
+            for(auto& future : futures) {
+                try {
+                    future.get();
+                }
+                catch(...) {
+                    if(!failure) failure = std::current_exception();
+                }
+            }
+            if(failure) std::rethrow_exception(failure);
+        }
+
+    }
+}
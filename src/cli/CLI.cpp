@@ -6,6 +6,7 @@
 #include <regex>
 #include <iomanip>
 #include <filesystem>
+#include <fstream>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -67,6 +68,7 @@ namespace kvspp {
                 }
             }
 
+            autoSaveIfEnabled();
             return 0;
         }
 
@@ -76,7 +78,9 @@ namespace kvspp {
                 return -1;
             }
 
-            return processCommand(args);
+            int result = processCommand(args);
+            autoSaveIfEnabled();
+            return result;
         }
 
         int CLI::processCommand(const std::vector<std::string>& tokens) {
@@ -111,6 +115,9 @@ namespace kvspp {
                 else if(command == "load") {
                     return cmdLoad(tokens);
                 }
+                else if(command == "import") {
+                    return cmdImport(tokens);
+                }
                 else if(command == "stats") {
                     return cmdStats(tokens);
                 }
@@ -187,17 +194,11 @@ namespace kvspp {
             try {
                 manager_.put(storeToken, key, value);
 
-                // Auto-save if enabled
+                // Auto-save if enabled: coalesced into a background save
                 if(autoSave_) {
-                    try {
-                        std::string fname = storeToken + ".json";
-                        manager_.saveStore(storeToken, fname);
-                        if(verboseMode_) {
-                            printInfo("Auto-saved store '" + storeToken + "' to: " + fname);
-                        }
-                    }
-                    catch(const std::exception& e) {
-                        printError("Auto-save failed: " + std::string(e.what()));
+                    manager_.requestSave(storeToken);
+                    if(verboseMode_) {
+                        printInfo("Scheduled background save of store '" + storeToken + "' to: " + storeToken + ".json");
                     }
                 }
 
@@ -227,17 +228,11 @@ namespace kvspp {
             try {
                 manager_.remove(storeToken, key);
 
-                // Auto-save if enabled
+                // Auto-save if enabled: coalesced into a background save
                 if(autoSave_) {
-                    try {
-                        std::string fname = storeToken + ".json";
-                        manager_.saveStore(storeToken, fname);
-                        if(verboseMode_) {
-                            printInfo("Auto-saved store '" + storeToken + "' to: " + fname);
-                        }
-                    }
-                    catch(const std::exception& e) {
-                        printError("Auto-save failed: " + std::string(e.what()));
+                    manager_.requestSave(storeToken);
+                    if(verboseMode_) {
+                        printInfo("Scheduled background save of store '" + storeToken + "' to: " + storeToken + ".json");
                     }
                 }
 
@@ -276,8 +271,25 @@ namespace kvspp {
                 return -1;
             }
 
-            printError("Clear command not yet implemented with StoreManager");
-            return -1;
+            const std::string& storeToken = args[1];
+            // Entries are detached at once and freed in the background
+            manager_.getStore(storeToken).clear();
+
+            // Auto-save if enabled: coalesced into a background save
+            if(autoSave_) {
+                manager_.requestSave(storeToken);
+                if(verboseMode_) {
+                    printInfo("Scheduled background save of store '" + storeToken + "' to: " + storeToken + ".json");
+                }
+            }
+
+            if(jsonMode_) {
+                std::cout << "{\"success\": true}" << std::endl;
+            }
+            else {
+                printSuccess("Cleared store '" + storeToken + "'");
+            }
+            return 0;
         }
 
         int CLI::cmdSave(const std::vector<std::string>& args) {
@@ -338,6 +350,59 @@ namespace kvspp {
             }
         }
 
+        int CLI::cmdImport(const std::vector<std::string>& args) {
+            const std::string usage = "Usage: import <storeToken> <file> [ndjson|csv] [replace]";
+            if(args.size() < 3 || args.size() > 5) {
+                printError(usage);
+                return -1;
+            }
+
+            const std::string& storeToken = args[1];
+            const std::string& filename = args[2];
+            // The format defaults to the file extension
+            auto format = std::filesystem::path(filename).extension() == ".csv"
+                ? kvspp::persistence::BulkLoader::Format::CSV : kvspp::persistence::BulkLoader::Format::NDJSON;
+            bool replace = false;
+            for(size_t i = 3; i < args.size(); ++i) {
+                if(args[i] == "replace") replace = true;
+                else if(!kvspp::persistence::BulkLoader::parseFormat(args[i], format)) {
+                    printError(usage);
+                    return -1;
+                }
+            }
+
+            std::ifstream in(filename, std::ios::binary);
+            if(!in) {
+                printError("Cannot open " + filename);
+                return -1;
+            }
+
+            try {
+                uint64_t records = manager_.bulkLoad(storeToken, format, replace, [&in](char* buffer, size_t capacity) {
+                    in.read(buffer, static_cast<std::streamsize>(capacity));
+                    return static_cast<size_t>(in.gcount());
+                });
+                if(in.bad()) throw std::runtime_error("read error in " + filename);
+
+                // Auto-save if enabled: one snapshot for the whole import
+                if(autoSave_) {
+                    manager_.requestSave(storeToken);
+                }
+
+                if(jsonMode_) {
+                    std::cout << "{\"success\": true, \"records\": " << records << "}" << std::endl;
+                }
+                else {
+                    printSuccess("Imported " + std::to_string(records) + " records into store '" + storeToken + "'");
+                }
+                return 0;
+            }
+            catch(const std::exception& e) {
+                printError("Failed to import: " + std::string(e.what()));
+                return -1;
+            }
+        }
+
         int CLI::cmdStats(const std::vector<std::string>& args) {
             if(args.size() != 2) {
                 printError("Usage: stats <storeToken>");
@@ -360,7 +425,7 @@ namespace kvspp {
 
         int CLI::cmdHelp(const std::vector<std::string>& args) {
             if(jsonMode_) {
-                std::cout << "{\"commands\": [\"get\", \"put\", \"delete\", \"save\", \"load\", \"help\"]}" << std::endl;
+                std::cout << "{\"commands\": [\"get\", \"put\", \"delete\", \"save\", \"load\", \"import\", \"help\"]}" << std::endl;
             }
             else {
                 std::cout << std::endl;
@@ -374,6 +439,8 @@ namespace kvspp {
                 std::cout << "File Operations:" << std::endl;
                 std::cout << "  save <storeToken> [filename]         - Save store to file" << std::endl;
                 std::cout << "  load <storeToken> [filename]         - Load store from file" << std::endl;
+                std::cout << "  import <storeToken> <file> [ndjson|csv] [replace]" << std::endl;
+                std::cout << "                                       - Bulk load records (NDJSON or CSV)" << std::endl;
                 std::cout << std::endl;
                 std::cout << "Utility:" << std::endl;
                 std::cout << "  help                                 - Show this help" << std::endl;
@@ -425,10 +492,17 @@ namespace kvspp {
         }
 
         void CLI::autoSaveIfEnabled() {
-            // In multi-store mode, auto-save happens after each put/delete operation
-            // rather than at exit, since we save each store individually.
-            if(autoSave_ && verboseMode_) {
-                printInfo("Auto-save was enabled - stores were saved after each modification");
+            // Saves requested by put/delete run on a background thread; make sure
+            // none are still pending when the CLI exits.
+            if(!autoSave_) return;
+            try {
+                manager_.flushPendingSaves();
+                if(verboseMode_) {
+                    printInfo("Auto-save complete - pending store saves were flushed");
+                }
+            }
+            catch(const std::exception& e) {
+                printError("Auto-save failed: " + std::string(e.what()));
             }
         }
 
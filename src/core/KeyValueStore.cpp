@@ -2,14 +2,56 @@
 #include "kvstore/exceptions/Exceptions.hpp"
 #include "kvstore/core/TypeRegistry.hpp"
 #include "kvstore/persistence/PersistenceManager.hpp"
+#include "kvstore/persistence/BinaryCodec.hpp"
+#include "kvstore/utils/LazyFree.hpp"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <variant>
 
 namespace kvspp {
     namespace core {
+
+        namespace {
+            // Replaced or deleted values at least this large are freed in the background
+            constexpr size_t LAZYFREE_VALUE_BYTES = 64 * 1024;
+
+            // The cold file is rewritten once it is this large and mostly released records
+            constexpr uint64_t COLD_COMPACT_MIN_BYTES = 64ull << 20;
+
+            // Approximate footprint of an entry: hash node, key and (if hot) value
+            template<typename Entry>
+            size_t entryBytes(const std::string& key, const Entry& entry) {
+                return 2 * sizeof(void*) + sizeof(std::pair<const std::string, Entry>) +
+                    key.capacity() + (entry.value ? entry.value->memoryUsage() : 0);
+            }
+
+            // Seconds since the first call; 32 bits keep the per-entry stamp small
+            uint32_t tierClock() {
+                static const auto start = std::chrono::steady_clock::now();
+                return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::steady_clock::now() - start).count());
+            }
+
+            // Distinguishes the cold files of stores sharing a path prefix (and of a
+            // store's previous contents that are still being freed)
+            std::atomic<uint64_t> coldFileSeq{ 0 };
+
+            // Dispose of a value taken out of the map (caller must not hold the store lock)
+            void releaseValue(std::unique_ptr<ValueObject> value, bool lazy) {
+                if(!value) return;
+                size_t bytes = value->memoryUsage();
+                if(lazy || bytes >= LAZYFREE_VALUE_BYTES) {
+                    utils::LazyFree::instance().releaseAsync(std::move(value), bytes);
+                }
+            }
+        }
         void KeyValueStore::setAutosave(bool enabled) {
             std::lock_guard<std::mutex> lock(mtx_);
             autosave_ = enabled;
+            Mutation mutation{ Mutation::Type::AUTOSAVE };
+            mutation.autosave = enabled;
+            notify(mutation);
         }
 
         bool KeyValueStore::getAutosave() const {
@@ -20,21 +62,126 @@ namespace kvspp {
         const ValueObject* KeyValueStore::get(const std::string& key) const {
             std::lock_guard<std::mutex> lock(mtx_);
 
+            if(disk_ || packed_) {
+                thread_local std::optional<ValueObject> current;
+                current = disk_ ? disk_->read(key, *typeRegistry_) : packed_->read(key, *typeRegistry_);
+                return current ? &*current : nullptr;
+            }
+
             auto it = store_.find(key);
             if(it != store_.end()) {
-                return it->second.get();
+                return valueOf(it->second, true);
             }
+            ++tierCounters_.misses;
             return nullptr;
         }
 
+        bool KeyValueStore::get(const std::string& key, const std::function<void(const ValueObject&)>& visit) const {
+            std::lock_guard<std::mutex> lock(mtx_);
+
+            if(disk_ || packed_) {
+                auto current = disk_ ? disk_->read(key, *typeRegistry_) : packed_->read(key, *typeRegistry_);
+                if(!current) return false;
+                visit(*current);
+                return true;
+            }
+
+            auto it = store_.find(key);
+            if(it == store_.end()) {
+                ++tierCounters_.misses;
+                return false;
+            }
+            visit(*valueOf(it->second, true));
+            return true;
+        }
+
+        bool KeyValueStore::peek(const std::string& key, const std::function<void(const ValueObject&)>& visit) const {
+            std::lock_guard<std::mutex> lock(mtx_);
+
+            if(disk_ || packed_) {
+                auto current = disk_ ? disk_->read(key, *typeRegistry_) : packed_->read(key, *typeRegistry_);
+                if(!current) return false;
+                visit(*current);
+                return true;
+            }
+
+            auto it = store_.find(key);
+            if(it == store_.end()) return false;
+            visit(*valueOf(it->second, false));
+            return true;
+        }
+
+        const ValueObject* KeyValueStore::valueOf(const Entry& entry, bool recordAccess) const {
+            if(entry.value) {
+                if(recordAccess) {
+                    entry.lastAccess = tierClock();
+                    ++tierCounters_.hotHits;
+                }
+                return entry.value.get();
+            }
+
+            auto value = std::make_unique<ValueObject>(*typeRegistry_);
+            persistence::BinaryReader reader(coldLog_->data(entry.coldOffset), entry.coldLength);
+            reader.valueObject(*value);
+            if(!recordAccess) {
+                thread_local std::optional<ValueObject> current;
+                current = std::move(*value);
+                return &*current;
+            }
+
+            // Promote: the value is back in memory until it goes idle again
+            releaseCold(entry);
+            bytes_ += value->memoryUsage();
+            entry.value = std::move(value);
+            entry.lastAccess = tierClock();
+            ++tierCounters_.coldHits;
+            return entry.value.get();
+        }
+
+        void KeyValueStore::releaseCold(const Entry& entry) const {
+            if(entry.value || !coldLog_) return;
+            coldLog_->release(entry.coldLength);
+            entry.coldLength = 0;
+            if(--coldKeys_ == 0) coldLog_->reset();
+        }
+
+        std::optional<ValueObject> KeyValueStore::getCopy(const std::string& key) const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if(disk_) return disk_->read(key, *typeRegistry_);
+            if(packed_) return packed_->read(key, *typeRegistry_);
+
+            auto it = store_.find(key);
+            if(it != store_.end()) {
+                return *valueOf(it->second, false);
+            }
+            return std::nullopt;
+        }
+
         std::vector<std::string> KeyValueStore::search(const std::string& attributeKey,
             const std::string& attributeValue) const {
             std::lock_guard<std::mutex> lock(mtx_);
             std::vector<std::string> result;
 
+            if(disk_) {
+                // Reads every value back from disk
+                for(const auto& key : disk_->keys()) {
+                    auto valueObject = disk_->read(key, *typeRegistry_);
+                    const auto* attr = valueObject ? valueObject->getAttribute(attributeKey) : nullptr;
+                    if(attr && attributeValueToString(*attr) == attributeValue) {
+                        result.push_back(key);
+                    }
+                }
+                return result;
+            }
+            if(packed_) {
+                return packed_->search(attributeKey, [this, &attributeValue](const AttributeValue& value) {
+                    return attributeValueToString(value) == attributeValue;
+                });
+            }
+
             for(const auto& pair : store_) {
                 const std::string& key = pair.first;
-                const auto& valueObject = pair.second;
+                const ValueObject* valueObject = valueOf(pair.second, false);
 
                 if(valueObject->hasAttribute(attributeKey)) {
                     const auto* attr = valueObject->getAttribute(attributeKey);
@@ -47,35 +194,130 @@ namespace kvspp {
             return result;
         }        void KeyValueStore::put(const std::string& key,
             const std::vector<std::pair<std::string, std::string>>& attributePairs) {
-            std::lock_guard<std::mutex> lock(mtx_);
+            std::unique_ptr<ValueObject> previous;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                requireWritable();
 
-            // Create new ValueObject with this store's TypeRegistry
-            auto valueObject = std::make_unique<ValueObject>(attributePairs, typeRegistry_);
+                // Create new ValueObject with this store's TypeRegistry
+                auto valueObject = std::make_unique<ValueObject>(attributePairs, *typeRegistry_);
+                if(disk_) {
+                    disk_->put(key, *valueObject);
+                    disk_->saveSchema(*typeRegistry_);
+                    notify({ Mutation::Type::PUT, &key, valueObject.get() });
+                    return;
+                }
 
-            // Store the object
-            store_[key] = std::move(valueObject);
+                // Store the object
+                previous = replace(key, std::move(valueObject));
+            }
+            releaseValue(std::move(previous), false);
         }
 
         void KeyValueStore::put(const std::string& key, const ValueObject& valueObject) {
-            std::lock_guard<std::mutex> lock(mtx_);
-            auto newValueObject = std::make_unique<ValueObject>(valueObject);
-            newValueObject->setTypeRegistry(typeRegistry_);
-            store_[key] = std::move(newValueObject);
+            std::unique_ptr<ValueObject> previous;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                requireWritable();
+                // The value may come from another registry (a record parsed off the
+                // lock, while LOAD can swap ours): check its types against ours
+                std::vector<std::pair<std::string, AttributeType>> types;
+                types.reserve(valueObject.getAttributes().size());
+                for(const auto& [name, value] : valueObject.getAttributes()) {
+                    types.emplace_back(name, TypeRegistry::getTypeFromValue(value));
+                }
+                registerTypes(types);
+                auto newValueObject = std::make_unique<ValueObject>(valueObject);
+                newValueObject->setTypeRegistry(*typeRegistry_);
+                if(disk_) {
+                    disk_->put(key, *newValueObject);
+                    disk_->saveSchema(*typeRegistry_);
+                    notify({ Mutation::Type::PUT, &key, newValueObject.get() });
+                    return;
+                }
+                previous = replace(key, std::move(newValueObject));
+            }
+            releaseValue(std::move(previous), false);
         }
 
-        bool KeyValueStore::deleteKey(const std::string& key) {
-            std::lock_guard<std::mutex> lock(mtx_);
+        std::unique_ptr<ValueObject> KeyValueStore::replace(std::string key, std::unique_ptr<ValueObject> valueObject) {
+            auto [it, inserted] = store_.try_emplace(std::move(key));
+            Entry& entry = it->second;
+            if(!inserted) {
+                bytes_ -= entryBytes(it->first, entry);
+                releaseCold(entry);
+            }
+            std::unique_ptr<ValueObject> previous = std::move(entry.value);
+            entry.value = std::move(valueObject);
+            entry.lastAccess = tierClock();
+            bytes_ += entryBytes(it->first, entry);
+            notify({ Mutation::Type::PUT, &it->first, entry.value.get() });
+            return previous;
+        }
 
-            auto it = store_.find(key);
-            if(it != store_.end()) {
+        void KeyValueStore::putBatch(std::vector<std::pair<std::string, std::unique_ptr<ValueObject>>>&& entries,
+            const TypeRegistry* schema) {
+            std::vector<std::unique_ptr<ValueObject>> replaced;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                requireWritable();
+                if(schema) registerTypes(schema->getAllTypes());
+                if(disk_) {
+                    std::vector<std::pair<const std::string*, const ValueObject*>> batch;
+                    batch.reserve(entries.size());
+                    for(auto& [key, valueObject] : entries) {
+                        valueObject->setTypeRegistry(*typeRegistry_);
+                        batch.emplace_back(&key, valueObject.get());
+                    }
+                    disk_->putBatch(batch);
+                    disk_->saveSchema(*typeRegistry_);
+                    for(const auto& [key, valueObject] : batch) notify({ Mutation::Type::PUT, key, valueObject });
+                    return;
+                }
+                // Grow geometrically: reserving just enough would rehash on every batch of a bulk load
+                const size_t needed = store_.size() + entries.size();
+                if(needed > store_.bucket_count() * store_.max_load_factor()) {
+                    store_.reserve(std::max(needed, store_.size() * 2));
+                }
+                for(auto& [key, valueObject] : entries) {
+                    valueObject->setTypeRegistry(*typeRegistry_);
+                    auto previous = replace(std::move(key), std::move(valueObject));
+                    if(previous) replaced.push_back(std::move(previous));
+                }
+            }
+            for(auto& previous : replaced) {
+                releaseValue(std::move(previous), false);
+            }
+        }
+
+        bool KeyValueStore::deleteKey(const std::string& key, bool lazy) {
+            std::unique_ptr<ValueObject> removed;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                requireWritable();
+
+                if(disk_) {
+                    if(!disk_->remove(key)) return false;
+                    notify({ Mutation::Type::REMOVE, &key });
+                    return true;
+                }
+
+                auto it = store_.find(key);
+                if(it == store_.end()) return false;
+                bytes_ -= entryBytes(it->first, it->second);
+                releaseCold(it->second);
+                removed = std::move(it->second.value);
                 store_.erase(it);
-                return true;
+                notify({ Mutation::Type::REMOVE, &key });
             }
-            return false;
+            releaseValue(std::move(removed), lazy);
+            return true;
         }
 
         std::vector<std::string> KeyValueStore::keys() const {
             std::lock_guard<std::mutex> lock(mtx_);
+            if(disk_) return disk_->keys();
+            if(packed_) return packed_->keys();
             std::vector<std::string> result;
             result.reserve(store_.size());
 
@@ -86,19 +328,107 @@ namespace kvspp {
             return result;
         }
 
+        bool KeyValueStore::contains(const std::string& key) const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if(disk_) return disk_->contains(key);
+            if(packed_) return packed_->contains(key);
+            return store_.find(key) != store_.end();
+        }
+
         size_t KeyValueStore::size() const {
             std::lock_guard<std::mutex> lock(mtx_);
-            return store_.size();
+            return disk_ ? disk_->size() : packed_ ? packed_->size() : store_.size();
         }
 
         bool KeyValueStore::empty() const {
             std::lock_guard<std::mutex> lock(mtx_);
-            return store_.empty();
+            return disk_ ? disk_->size() == 0 : packed_ ? packed_->size() == 0 : store_.empty();
         }
 
-        void KeyValueStore::clear() {
+        void KeyValueStore::clear(bool lazy) {
+            std::unordered_map<std::string, Entry> detached;
+            std::unique_ptr<utils::MappedValueLog> coldLog;
+            size_t bytes = 0;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                requireWritable();
+                if(disk_) disk_->clear();
+                detached.swap(store_);
+                coldLog.swap(coldLog_);
+                coldKeys_ = 0;
+                std::swap(bytes, bytes_);
+                notify({ Mutation::Type::CLEAR });
+            }
+            if(lazy) {
+                const size_t effort = detached.size();
+                utils::LazyFree::instance().release(std::move(detached), bytes, effort);
+            }
+            // Otherwise destroyed here, without holding the lock
+        }
+
+        size_t KeyValueStore::memoryUsage() const {
             std::lock_guard<std::mutex> lock(mtx_);
-            store_.clear();
+            return disk_ ? disk_->memoryUsage() : bytes_;
+        }
+
+        void KeyValueStore::swapContents(KeyValueStore& other, const std::function<void()>& swapped) {
+            if(&other == this) return;
+            std::scoped_lock lock(mtx_, other.mtx_);
+            requireWritable();
+            other.requireWritable();
+
+            if(disk_ && !other.disk_) {
+                // Write the new entries into this store's storage (its files stay in place)
+                disk_->clear();
+                other.promoteAll();
+                std::vector<std::pair<const std::string*, const ValueObject*>> batch;
+                batch.reserve(other.store_.size());
+                for(const auto& [key, entry] : other.store_) {
+                    batch.emplace_back(&key, entry.value.get());
+                }
+                disk_->putBatch(batch);
+                typeRegistry_.swap(other.typeRegistry_);
+                disk_->saveSchema(*typeRegistry_);
+                std::swap(autosave_, other.autosave_);
+
+                notify({ Mutation::Type::CLEAR });
+                for(const auto& [key, entry] : other.store_) {
+                    notify({ Mutation::Type::PUT, &key, entry.value.get() });
+                }
+                notify({ Mutation::Type::AUTOSAVE, nullptr, nullptr, autosave_ });
+
+                other.store_.clear();
+                other.bytes_ = 0;
+                other.notify({ Mutation::Type::CLEAR });
+                if(swapped) swapped();
+                return;
+            }
+
+            // The registries are swapped by pointer, so every ValueObject keeps
+            // pointing at the registry that travels with it
+            store_.swap(other.store_);
+            typeRegistry_.swap(other.typeRegistry_);
+            std::swap(autosave_, other.autosave_);
+            std::swap(bytes_, other.bytes_);
+            coldLog_.swap(other.coldLog_);
+            std::swap(coldKeys_, other.coldKeys_);
+            disk_.swap(other.disk_);
+
+            for(const KeyValueStore* target : { this, &other }) {
+                if(target->listeners_.empty()) continue;
+                target->notify({ Mutation::Type::CLEAR });
+                for(const auto& [key, entry] : target->store_) {
+                    target->notify({ Mutation::Type::PUT, &key, target->valueOf(entry, false) });
+                }
+                if(target->disk_) {
+                    for(const auto& key : target->disk_->keys()) {
+                        auto valueObject = target->disk_->read(key, *target->typeRegistry_);
+                        if(valueObject) target->notify({ Mutation::Type::PUT, &key, &*valueObject });
+                    }
+                }
+                target->notify({ Mutation::Type::AUTOSAVE, nullptr, nullptr, target->autosave_ });
+            }
+            if(swapped) swapped();
         }        std::string KeyValueStore::attributeValueToString(const AttributeValue& value) const {
             return std::visit([](const auto& v) -> std::string {
                 if constexpr(std::is_same_v<std::decay_t<decltype(v)>, std::string>) {
@@ -123,8 +453,190 @@ namespace kvspp {
             manager.load(*this);
         }
 
+        void KeyValueStore::openLogStructured(const std::string& directory,
+            const persistence::LogStructuredStorage::Options& options) {
+            std::unordered_map<std::string, Entry> detached;
+            std::unique_ptr<utils::MappedValueLog> coldLog;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                auto registry = std::make_unique<TypeRegistry>();
+                disk_ = std::make_unique<persistence::LogStructuredStorage>(directory, *registry, options);
+                typeRegistry_ = std::move(registry);
+                detached.swap(store_);
+                coldLog.swap(coldLog_);
+                coldKeys_ = 0;
+                bytes_ = 0;
+            }
+        }
+
+        persistence::LogStructuredStorage* KeyValueStore::logStructured() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return disk_.get();
+        }
+
+        void KeyValueStore::openPacked(const std::string& path) {
+            auto packed = std::make_unique<persistence::PackedStore>(path);
+            auto registry = std::make_unique<TypeRegistry>();
+            packed->registerSchema(*registry);
+
+            std::unordered_map<std::string, Entry> detached;
+            std::unique_ptr<utils::MappedValueLog> coldLog;
+            std::unique_ptr<persistence::LogStructuredStorage> disk;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                packed_ = std::move(packed);
+                typeRegistry_ = std::move(registry);
+                detached.swap(store_);
+                coldLog.swap(coldLog_);
+                disk.swap(disk_);
+                coldKeys_ = 0;
+                bytes_ = 0;
+            }
+        }
+
+        persistence::PackedStore* KeyValueStore::packedStore() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return packed_.get();
+        }
+
+        void KeyValueStore::requireWritable() const {
+            if(packed_) {
+                throw exceptions::KVStoreException("Store is read-only (served from " + packed_->path() + ")");
+            }
+        }
+
+        void KeyValueStore::setTiering(uint32_t coldAfterSeconds, const std::string& coldPath) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            coldAfter_ = coldAfterSeconds;
+            coldPath_ = coldPath;
+            if(coldAfterSeconds == 0) {
+                promoteAll();
+                coldLog_.reset();
+            }
+        }
+
+        uint32_t KeyValueStore::tieringThreshold() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return disk_ || packed_ ? 0 : coldAfter_;
+        }
+
+        size_t KeyValueStore::demoteIdle(size_t maxEntries) {
+            std::vector<std::unique_ptr<ValueObject>> demoted;
+            size_t demotedBytes = 0;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if(coldAfter_ == 0 || disk_ || store_.empty()) return 0;
+                if(!coldLog_) {
+                    coldLog_ = std::make_unique<utils::MappedValueLog>(coldPath_ + "." + std::to_string(coldFileSeq++));
+                }
+
+                // Walk whole buckets so the cursor stays valid between steps
+                // (a rehash only makes one sweep skip or revisit some entries)
+                const uint32_t now = tierClock();
+                const size_t buckets = store_.bucket_count();
+                if(sweepCursor_ >= buckets) sweepCursor_ = 0;
+                std::string encoded;
+                size_t visited = 0;
+                for(; visited < maxEntries && sweepCursor_ < buckets; ++sweepCursor_) {
+                    for(auto it = store_.begin(sweepCursor_); it != store_.end(sweepCursor_); ++it, ++visited) {
+                        Entry& entry = it->second;
+                        // Never a value touched this tick or the last: get() callers may still be using it
+                        if(!entry.value || now - entry.lastAccess < std::max<uint32_t>(coldAfter_, 2)) continue;
+
+                        encoded.clear();
+                        persistence::BinaryWriter::putValueObject(encoded, *entry.value);
+                        entry.coldOffset = coldLog_->append(encoded.data(), encoded.size());
+                        entry.coldLength = static_cast<uint32_t>(encoded.size());
+                        ++coldKeys_;
+                        const size_t valueBytes = entry.value->memoryUsage();
+                        bytes_ -= valueBytes;
+                        demotedBytes += valueBytes;
+                        demoted.push_back(std::move(entry.value));
+                    }
+                }
+                tierCounters_.demotions += demoted.size();
+
+                if(coldLog_->size() >= COLD_COMPACT_MIN_BYTES && coldLog_->liveBytes() * 2 < coldLog_->size()) {
+                    compactColdLog();
+                }
+            }
+            const size_t count = demoted.size();
+            if(count) utils::LazyFree::instance().release(std::move(demoted), demotedBytes, count);
+            return count;
+        }
+
+        void KeyValueStore::promoteAll() {
+            if(coldKeys_ == 0) return;
+            const TierStats counters = tierCounters_;
+            for(auto& [key, entry] : store_) {
+                if(!entry.value) valueOf(entry, true);
+            }
+            tierCounters_ = counters; // not accesses
+
+        }
+
+        void KeyValueStore::compactColdLog() {
+            auto compacted = std::make_unique<utils::MappedValueLog>(coldPath_ + "." + std::to_string(coldFileSeq++));
+            for(auto& [key, entry] : store_) {
+                if(entry.value) continue;
+                entry.coldOffset = compacted->append(coldLog_->data(entry.coldOffset), entry.coldLength);
+            }
+            coldLog_ = std::move(compacted);
+        }
+
+        KeyValueStore::TierStats KeyValueStore::tierStats() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            TierStats stats = tierCounters_;
+            stats.coldKeys = coldKeys_;
+            stats.hotKeys = (disk_ ? disk_->size() : store_.size()) - coldKeys_;
+            if(coldLog_) {
+                stats.coldBytes = coldLog_->liveBytes();
+                stats.coldFileBytes = coldLog_->size();
+            }
+            return stats;
+        }
+
         TypeRegistry& KeyValueStore::getTypeRegistry() {
-            return typeRegistry_;
+            return *typeRegistry_;
+        }
+
+        const TypeRegistry& KeyValueStore::getTypeRegistry() const {
+            return *typeRegistry_;
+        }
+
+        std::vector<std::pair<std::string, AttributeType>> KeyValueStore::getSchema() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return typeRegistry_->getAllTypes();
+        }
+
+        void KeyValueStore::registerTypes(const std::vector<std::pair<std::string, AttributeType>>& types) {
+            for(const auto& [name, type] : types) {
+                const AttributeType* registered = typeRegistry_->getRegisteredType(name);
+                if(registered && *registered != type) {
+                    throw exceptions::TypeMismatchException(name, TypeRegistry::getTypeName(*registered),
+                        TypeRegistry::getTypeName(type));
+                }
+            }
+            for(const auto& [name, type] : types) typeRegistry_->validateAndRegisterType(name, type);
+        }
+
+        size_t KeyValueStore::addMutationListener(MutationListener listener) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            size_t id = nextListenerId_++;
+            listeners_.emplace_back(id, std::move(listener));
+            return id;
+        }
+
+        void KeyValueStore::removeMutationListener(size_t id) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            listeners_.erase(std::remove_if(listeners_.begin(), listeners_.end(),
+                [id](const auto& entry) { return entry.first == id; }), listeners_.end());
+        }
+
+        void KeyValueStore::notify(const Mutation& mutation) const {
+            for(const auto& entry : listeners_) {
+                entry.second(mutation);
+            }
         }
 
     }
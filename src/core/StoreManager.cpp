@@ -1,23 +1,157 @@
-
 #include "kvstore/core/StoreManager.hpp"
+#include "kvstore/persistence/DeltaSnapshot.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include "kvstore/utils/FileWriter.hpp"
+#include "kvstore/utils/LazyFree.hpp"
+#include "kvstore/utils/MappedFile.hpp"
 #include <stdexcept>
 #include <mutex>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <vector>
 
 namespace kvstore {
 
+    namespace {
+        // Granularity of the background persistence thread
+        constexpr std::chrono::milliseconds PERSISTENCE_TICK{ 100 };
+        // Entries each tiered store's demotion sweep visits per tick
+        constexpr size_t TIERING_SWEEP_ENTRIES = 16384;
+        // Bytes bulk loads ask their source for at a time
+        constexpr size_t BULK_READ_BUFFER = 1 << 20;
+    }
+
     StoreManager& StoreManager::instance() {
         static StoreManager instance;
         return instance;
     }
 
+    StoreManager::~StoreManager() {
+        // Finish (or abandon queued) preloads before the stores go away
+        preloadPool_.reset();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopPersistence_ = true;
+        }
+        persistenceCv_.notify_all();
+        if(persistenceThread_.joinable()) persistenceThread_.join();
+    }
+
     void StoreManager::clearAllStores() {
+        // Detach everything under the lock; the stores are destroyed in the background
+        std::unordered_map<storeToken, kvspp::core::KeyValueStore> stores;
+        std::unordered_map<storeToken, std::shared_ptr<StoreState>> states;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for(auto& [token, state] : states_) {
+                auto it = stores_.find(token);
+                if(it == stores_.end()) continue;
+                it->second.removeMutationListener(state->dirtyListenerId);
+                if(state->log) it->second.removeMutationListener(state->logListenerId);
+                if(backlog_) it->second.removeMutationListener(state->replicationListenerId);
+            }
+            states.swap(states_);
+            stores.swap(stores_);
+        }
+
+        size_t bytes = 0;
+        size_t effort = 0;
+        for(const auto& [token, store] : stores) {
+            bytes += store.memoryUsage();
+            effort += store.size() + 1;
+        }
+        kvspp::utils::LazyFree::instance().release(std::make_pair(std::move(stores), std::move(states)), bytes, effort);
+    }
+
+    std::shared_ptr<StoreManager::StoreState> StoreManager::stateFor(const storeToken& token) {
+        auto [it, inserted] = stores_.try_emplace(token);
+        if(!inserted) return states_[token];
+
+        std::error_code ec;
+        if(std::filesystem::is_regular_file(packedPathFor(token), ec)) {
+            try {
+                it->second.openPacked(packedPathFor(token));
+            }
+            catch(...) {
+                stores_.erase(it);
+                throw;
+            }
+        }
+        else if(options_.storageEngine == StorageEngine::LOG) {
+            try {
+                auto storageOptions = options_.logStorage;
+                storageOptions.syncEveryWrite = options_.fsyncPolicy == kvspp::persistence::FsyncPolicy::ALWAYS;
+                it->second.openLogStructured(logStoragePathFor(token), storageOptions);
+            }
+            catch(...) {
+                stores_.erase(it);
+                throw;
+            }
+        }
+        else if(options_.coldAfterSeconds > 0) {
+            applyTiering(token, it->second, options_.coldAfterSeconds);
+        }
+
+        auto state = std::make_shared<StoreState>();
+        const bool trackKeys = options_.deltaSnapshots && options_.storageEngine == StorageEngine::MEMORY;
+        state->dirtyListenerId = it->second.addMutationListener([state, trackKeys](const kvspp::core::Mutation& mutation) {
+            state->dirty.fetch_add(1, std::memory_order_relaxed);
+            if(!trackKeys) return;
+            std::lock_guard<std::mutex> lock(state->keysMutex);
+            switch(mutation.type) {
+            case kvspp::core::Mutation::Type::PUT:
+            case kvspp::core::Mutation::Type::REMOVE:
+                state->dirtyKeys.insert(*mutation.key);
+                break;
+            case kvspp::core::Mutation::Type::CLEAR:
+                state->dirtyKeys.clear();
+                state->keysCleared = true;
+                break;
+            case kvspp::core::Mutation::Type::AUTOSAVE:
+                break; // every snapshot records the current flag
+            }
+        });
+        states_[token] = state;
+        if(backlog_) attachReplication(token, it->second, *state);
+
+        if(!persistenceThread_.joinable()) {
+            persistenceThread_ = std::thread(&StoreManager::persistenceLoop, this);
+        }
+        return state;
+    }
+
+    std::shared_ptr<kvspp::persistence::ReplicationBacklog> StoreManager::enableReplication(size_t backlogBytes) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!backlog_) {
+            backlog_ = std::make_shared<kvspp::persistence::ReplicationBacklog>(backlogBytes);
+            for(auto& [token, state] : states_) {
+                attachReplication(token, stores_.at(token), *state);
+            }
+        }
+        return backlog_;
+    }
+
+    std::shared_ptr<kvspp::persistence::ReplicationBacklog> StoreManager::replicationBacklog() const {
         std::lock_guard<std::mutex> lock(mutex_);
-        stores_.clear();
+        return backlog_;
+    }
+
+    void StoreManager::attachReplication(const storeToken& token, kvspp::core::KeyValueStore& store, StoreState& state) {
+        // Packed stores never change and are copied to followers out of band
+        if(store.packedStore()) return;
+        state.replicationListenerId = store.addMutationListener(
+            [backlog = backlog_, token](const kvspp::core::Mutation& mutation) {
+                backlog->append(token, mutation);
+            });
     }
 
     kvspp::core::KeyValueStore& StoreManager::getStore(const storeToken& token) {
         std::lock_guard<std::mutex> lock(mutex_);
-        return stores_[token]; // Creates if not exists
+        stateFor(token); // Creates if not exists
+        return stores_.at(token);
     }
 
 
@@ -28,10 +162,11 @@ namespace kvstore {
 
 
     std::string StoreManager::get(const storeToken& token, const std::string& key) {
-        const auto* vo = getStore(token).get(key);
-        if(!vo) throw std::runtime_error("Key not found");
-        // Assuming ValueObject has a toString() method
-        return vo->toString();
+        std::string value;
+        if(!getStore(token).get(key, [&value](const kvspp::core::ValueObject& vo) { value = vo.toString(); })) {
+            throw std::runtime_error("Key not found");
+        }
+        return value;
     }
 
 
@@ -40,35 +175,840 @@ namespace kvstore {
     }
 
 
+    namespace {
+        bool hasSnapshotExtension(const std::string& filename) {
+            auto ext = std::filesystem::path(filename).extension();
+            return ext == ".json" || ext == ".kvs";
+        }
 
+        std::string inStoreDirectory(const std::string& fname) {
+            // Always store in ./store/ relative to executable
+            if(fname.rfind("store/", 0) != 0 && fname.rfind("./store/", 0) != 0) {
+                return std::string("store/") + fname;
+            }
+            return fname;
+        }
+    }
 
-    void StoreManager::saveStore(const storeToken& token, const std::string& filename) const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = stores_.find(token);
-        if(it == stores_.end()) throw std::runtime_error("Store not found");
+    std::string StoreManager::resolveStorePath(const std::string& filename) const {
         std::string fname = filename;
-        // Ensure .json extension
-        if(fname.size() < 5 || fname.substr(fname.size() - 5) != ".json") {
-            fname += ".json";
+        // Ensure a snapshot extension, defaulting to the configured format
+        if(!hasSnapshotExtension(fname)) {
+            fname += kvspp::persistence::PersistenceManager::extensionFor(snapshotFormat_.load());
+        }
+        return inStoreDirectory(fname);
+    }
+
+    std::string StoreManager::resolveLoadPath(const std::string& filename) const {
+        if(hasSnapshotExtension(filename)) return inStoreDirectory(filename);
+
+        // Prefer whichever snapshot of this name was written last
+        std::string best = resolveStorePath(filename);
+        std::filesystem::file_time_type bestTime{};
+        bool found = false;
+        for(auto format : { kvspp::persistence::SnapshotFormat::BINARY, kvspp::persistence::SnapshotFormat::JSON }) {
+            std::string candidate = inStoreDirectory(filename + kvspp::persistence::PersistenceManager::extensionFor(format));
+            std::error_code ec;
+            auto time = std::filesystem::last_write_time(candidate, ec);
+            if(ec) continue;
+            if(!found || time > bestTime) {
+                best = candidate;
+                bestTime = time;
+                found = true;
+            }
+        }
+        return best;
+    }
+
+    std::string StoreManager::logPathFor(const std::string& snapshotPath) {
+        // store/<name>.json -> store/<name>.wal
+        return std::filesystem::path(snapshotPath).replace_extension(".wal").string();
+    }
+
+    std::string StoreManager::logStoragePathFor(const storeToken& token) {
+        return "store/" + token + ".logstore";
+    }
+
+    std::string StoreManager::packedPathFor(const storeToken& token) {
+        return "store/" + token + ".kvpack";
+    }
+
+    std::string StoreManager::coldPathFor(const storeToken& token) {
+        return "store/cold/" + token;
+    }
+
+    void StoreManager::setTiering(const storeToken& token, uint32_t coldAfterSeconds) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stateFor(token);
+        auto& store = stores_.at(token);
+        if(store.logStructured() || store.packedStore()) {
+            throw std::runtime_error("Tiering only applies to in-memory stores");
+        }
+        applyTiering(token, store, coldAfterSeconds);
+    }
+
+    void StoreManager::applyTiering(const storeToken& token, kvspp::core::KeyValueStore& store, uint32_t coldAfterSeconds) {
+        if(coldAfterSeconds > 0 && !coldDirCleaned_) {
+            std::error_code ec;
+            std::filesystem::remove_all(std::filesystem::path(coldPathFor(token)).parent_path(), ec);
+            coldDirCleaned_ = true;
         }
-        // Always store in ./store/ relative to executable
-        if(fname.rfind("store/", 0) != 0 && fname.rfind("./store/", 0) != 0) {
-            fname = std::string("store/") + fname;
+        store.setTiering(coldAfterSeconds, coldPathFor(token));
+    }
+
+    void StoreManager::writeSnapshot(const kvspp::core::KeyValueStore& store, const std::string& path) const {
+        std::lock_guard<std::mutex> lock(saveMutex_);
+        store.save(path);
+    }
+
+    void StoreManager::saveStore(const storeToken& token, const std::string& filename) {
+        std::string path = resolveStorePath(filename);
+        if(path == resolveStorePath(token)) {
+            // Saving a store to its own file is a full checkpoint
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if(stores_.find(token) == stores_.end()) throw std::runtime_error("Store not found");
+            }
+            snapshotStore(token);
+            return;
+        }
+
+        const kvspp::core::KeyValueStore* store = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = stores_.find(token);
+            if(it == stores_.end()) throw std::runtime_error("Store not found");
+            store = &it->second;
         }
-        it->second.save(fname);
+        writeSnapshot(*store, path);
     }
 
 
     void StoreManager::loadStore(const storeToken& token, const std::string& filename) {
+        std::string fname = resolveLoadPath(filename);
+        std::string logPath = logPathFor(fname);
+        recoverPendingMerge(fname);
+        if(!std::filesystem::exists(fname) && !std::filesystem::exists(logPath) &&
+            !std::filesystem::exists(kvspp::persistence::WriteAheadLog::rotatedPath(logPath))) {
+            throw kvspp::exceptions::PersistenceException("No snapshot found: " + fname);
+        }
+        auto& store = getStore(token);
+
+        // Stop logging while the contents are replaced (the log may be the one
+        // replayed below); it is re-attached, and rewritten against the new
+        // contents, below if autosave is on
+        detachLog(token, store);
+
+        // Build the new contents (snapshot plus log) off to the side, then publish
+        // them in one step so readers never see a partially loaded store
+        auto staged = std::make_unique<kvspp::core::KeyValueStore>();
+        std::vector<std::string> deltas;
+        uint64_t deltaBytes = 0;
+        size_t replayed = 0;
+        try {
+            staged->setAutosave(store.getAutosave());
+            staged->load(fname);
+
+            // Delta segments recorded on top of this base, oldest first
+            if(auto manifest = kvspp::persistence::DeltaManifest::read(kvspp::persistence::DeltaManifest::pathFor(fname))) {
+                if(manifest->base == std::filesystem::path(fname).filename().string()) {
+                    for(const auto& delta : manifest->deltas) {
+                        std::string deltaPath = (std::filesystem::path(fname).parent_path() / delta).string();
+                        kvspp::persistence::DeltaSnapshot::apply(deltaPath, *staged);
+                        deltaBytes += std::filesystem::file_size(deltaPath);
+                    }
+                    deltas = manifest->deltas;
+                }
+            }
+
+            // The rotated log was complete when set aside, unless no newer log was started
+            replayed = kvspp::persistence::WriteAheadLog::replay(kvspp::persistence::WriteAheadLog::rotatedPath(logPath), *staged,
+                !std::filesystem::exists(logPath));
+            replayed += kvspp::persistence::WriteAheadLog::replay(logPath, *staged);
+        }
+        catch(...) {
+            // The store keeps its contents, so it keeps logging them too
+            if(store.getAutosave()) attachLog(token, store);
+            throw;
+        }
+
+        std::shared_ptr<StoreState> state;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state = stateFor(token);
+        }
+        {
+            // No snapshot may run between the swap and resetting the delta bookkeeping
+            std::lock_guard<std::mutex> snapshotLock(snapshotMutex_);
+            // The store now matches the file it came from. Reset the change tracking
+            // under the store lock, so that writes after the swap stay counted
+            store.swapContents(*staged, [&state]() {
+                state->dirty = 0;
+                std::lock_guard<std::mutex> lock(state->keysMutex);
+                state->dirtyKeys.clear();
+                state->keysCleared = false;
+            });
+            // Further deltas can only extend the chain if it is this store's own and
+            // the store holds nothing beyond it (no replayed log records)
+            state->hasBase = fname == resolveStorePath(token) && replayed == 0;
+            state->currentSnapshot = deltas.empty() && replayed == 0 ? fname : "";
+            state->deltas = std::move(deltas);
+            state->deltaBytes = deltaBytes;
+            state->baseBytes = std::filesystem::exists(fname) ? std::filesystem::file_size(fname) : 0;
+            state->savedAutosave = store.getAutosave();
+            state->mergeRequested = false;
+        }
+
+        // The previous contents are freed off the request path
+        const size_t bytes = staged->memoryUsage();
+        const size_t effort = staged->size();
+        kvspp::utils::LazyFree::instance().release(std::move(staged), bytes, effort);
+
+        if(store.getAutosave()) {
+            attachLog(token, store);
+            snapshotStore(token);
+        }
+    }
+
+    uint64_t StoreManager::bulkLoad(const storeToken& token, kvspp::persistence::BulkLoader::Format format, bool replace,
+        const std::function<size_t(char*, size_t)>& source) {
+        auto& store = getStore(token);
+        if(store.packedStore()) {
+            throw std::runtime_error("store '" + token + "' is served read-only from a packed file");
+        }
+        if(replace && store.logStructured()) {
+            throw std::runtime_error("replacing contents only applies to in-memory stores");
+        }
+
+        // Logging every record would cost more than the load; the snapshot below covers them
+        detachLog(token, store);
+        auto checkpoint = [this, &token, &store]() {
+            if(!store.getAutosave()) return;
+            attachLog(token, store);
+            snapshotStore(token);
+        };
+
+        uint64_t records = 0;
+        try {
+            std::unique_ptr<kvspp::core::KeyValueStore> staged;
+            if(replace) {
+                staged = std::make_unique<kvspp::core::KeyValueStore>();
+                staged->setAutosave(store.getAutosave());
+            }
+            {
+                kvspp::persistence::BulkLoader loader(staged ? *staged : store, format,
+                    kvspp::persistence::PersistenceManager::sharedLoadPool());
+                std::vector<char> buffer(BULK_READ_BUFFER);
+                while(size_t length = source(buffer.data(), buffer.size())) {
+                    loader.feed(buffer.data(), length);
+                }
+                records = loader.finish();
+            }
+            if(staged) {
+                store.swapContents(*staged);
+                // The previous contents are freed off the request path
+                const size_t bytes = staged->memoryUsage();
+                const size_t effort = staged->size();
+                kvspp::utils::LazyFree::instance().release(std::move(staged), bytes, effort);
+            }
+        }
+        catch(...) {
+            // Records inserted before the failure are in the store but not in its log
+            try {
+                checkpoint();
+            }
+            catch(const std::exception& e) {
+                std::cerr << "Snapshot after failed bulk load of '" << token << "' failed: " << e.what() << std::endl;
+            }
+            throw;
+        }
+        checkpoint();
+        return records;
+    }
+
+    void StoreManager::setAutosave(const storeToken& token, bool enabled) {
+        auto& store = getStore(token);
+        if(store.packedStore()) {
+            throw std::runtime_error("store '" + token + "' is served read-only from a packed file");
+        }
+        if(enabled) {
+            attachLog(token, store);
+            store.setAutosave(true);
+            snapshotStore(token);
+        }
+        else {
+            detachLog(token, store);
+            store.setAutosave(false);
+            snapshotStore(token);
+            std::string logPath = logPathFor(resolveStorePath(token));
+            std::filesystem::remove(kvspp::persistence::WriteAheadLog::rotatedPath(logPath));
+            std::filesystem::remove(logPath);
+        }
+    }
+
+    void StoreManager::commitAutosave(const storeToken& token) {
+        std::shared_ptr<kvspp::persistence::WriteAheadLog> log;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            log = stateFor(token)->log;
+        }
+        // Without a log, autosave stores are covered by background snapshots only
+        if(log) log->commit();
+    }
+
+    void StoreManager::requestSave(const storeToken& token) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stateFor(token)->saveRequested = true;
+        }
+        persistenceCv_.notify_all();
+    }
+
+    bool StoreManager::backgroundSave(const storeToken& token) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto state = stateFor(token);
+            if(state->saving || state->saveRequested) return false;
+            state->saveRequested = true;
+        }
+        persistenceCv_.notify_all();
+        return true;
+    }
+
+    std::time_t StoreManager::lastSave(const storeToken& token) const {
         std::lock_guard<std::mutex> lock(mutex_);
-        std::string fname = filename;
-        if(fname.size() < 5 || fname.substr(fname.size() - 5) != ".json") {
-            fname += ".json";
+        auto it = states_.find(token);
+        return it == states_.end() ? 0 : it->second->lastSave;
+    }
+
+    void StoreManager::flushPendingSaves() {
+        std::vector<storeToken> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for(const auto& [token, state] : states_) {
+                bool autosave = state->log != nullptr || stores_.at(token).getAutosave();
+                if(state->saveRequested || (autosave && state->dirty > 0)) {
+                    pending.push_back(token);
+                }
+            }
+        }
+        for(const auto& token : pending) {
+            snapshotStore(token);
         }
-        if(fname.rfind("store/", 0) != 0 && fname.rfind("./store/", 0) != 0) {
-            fname = std::string("store/") + fname;
+    }
+
+    size_t StoreManager::preloadStores(size_t threads) {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        if(!fs::is_directory("store", ec)) return 0;
+
+        // One store per snapshot name; loadStore picks the newest of <name>.kvs / <name>.json
+        std::unordered_map<storeToken, uintmax_t> sizes;
+        for(const auto& entry : fs::directory_iterator("store", ec)) {
+            if(!entry.is_regular_file(ec) || !hasSnapshotExtension(entry.path().string())) continue;
+            // Skip a new base left behind by an interrupted delta merge
+            if(entry.path().stem().extension() == ".merge") continue;
+            // and drop dumps and uploads of transfers a crash cut short
+            if(entry.path().stem().extension() == ".dump" || entry.path().stem().extension() == ".restore") {
+                fs::remove(entry.path(), ec);
+                continue;
+            }
+            // Packed stores are opened on first use, without loading anything
+            if(fs::exists(packedPathFor(entry.path().stem().string()), ec)) continue;
+            uintmax_t& size = sizes[entry.path().stem().string()];
+            size = std::max(size, entry.file_size(ec));
+        }
+
+        // Largest first, so the longest load does not start last
+        std::vector<std::pair<uintmax_t, storeToken>> order;
+        for(auto& [token, size] : sizes) order.emplace_back(size, token);
+        std::sort(order.begin(), order.end(), std::greater<>());
+
+        // A snapshot's key filter knows every key the store will hold once loaded,
+        // unless deltas or a write-ahead log add keys on top of the snapshot
+        std::unordered_map<storeToken, std::shared_ptr<const kvspp::utils::BloomFilter>> filters;
+        for(const auto& [size, token] : order) {
+            std::string path = resolveLoadPath(token);
+            std::string logPath = logPathFor(path);
+            auto manifest = kvspp::persistence::DeltaManifest::read(kvspp::persistence::DeltaManifest::pathFor(path));
+            auto hasLog = [&ec](const std::string& log) {
+                uintmax_t size = fs::file_size(log, ec);
+                return !ec && size > 0;
+            };
+            if((manifest && (!manifest->deltas.empty() || !manifest->pending.empty())) ||
+                hasLog(logPath) || hasLog(kvspp::persistence::WriteAheadLog::rotatedPath(logPath))) {
+                continue;
+            }
+            filters[token] = kvspp::persistence::PersistenceManager::loadKeyFilter(path);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(preloadPool_) return 0;
+        for(const auto& [size, token] : order) {
+            auto state = stateFor(token);
+            state->loadState = LoadState::LOADING;
+            auto filter = filters.find(token);
+            if(filter != filters.end()) state->keyFilter = filter->second;
+        }
+        preloadPool_ = std::make_unique<kvspp::utils::ThreadPool>(std::min(
+            threads == 0 ? kvspp::utils::ThreadPool::defaultThreadCount() : threads, std::max<size_t>(order.size(), 1)));
+        for(const auto& [size, token] : order) {
+            preloadPool_->submit([this, token = token]() {
+                try {
+                    loadStore(token, token);
+                    finishPreload(token, LoadState::READY);
+                }
+                catch(const std::exception& e) {
+                    std::cerr << "Failed to preload store '" << token << "': " << e.what() << std::endl;
+                    finishPreload(token, LoadState::FAILED);
+                }
+            });
+        }
+        return order.size();
+    }
+
+    void StoreManager::finishPreload(const storeToken& token, LoadState state) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto storeState = stateFor(token);
+            storeState->loadState = state;
+            storeState->keyFilter.reset();
+        }
+        loadCv_.notify_all();
+    }
+
+    bool StoreManager::awaitLoaded(const storeToken& token) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = states_.find(token);
+        if(it == states_.end()) return true;
+        std::shared_ptr<StoreState> state = it->second;
+        if(options_.loadingPolicy == LoadingPolicy::REJECT) {
+            return state->loadState != LoadState::LOADING;
+        }
+        loadCv_.wait(lock, [&state]() { return state->loadState != LoadState::LOADING; });
+        return true;
+    }
+
+    bool StoreManager::loadWouldBlock(const storeToken& token) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(options_.loadingPolicy == LoadingPolicy::REJECT) return false;
+        auto it = states_.find(token);
+        return it != states_.end() && it->second->loadState == LoadState::LOADING;
+    }
+
+    bool StoreManager::definitelyAbsent(const storeToken& token, const std::string& key) const {
+        std::shared_ptr<const kvspp::utils::BloomFilter> filter;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = states_.find(token);
+            if(it == states_.end() || it->second->loadState != LoadState::LOADING) return false;
+            filter = it->second->keyFilter;
+        }
+        return filter && !filter->mayContain(key);
+    }
+
+    std::vector<std::pair<StoreManager::storeToken, StoreManager::LoadState>> StoreManager::storeStates() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::pair<storeToken, LoadState>> result;
+        result.reserve(states_.size());
+        for(const auto& [token, state] : states_) {
+            result.emplace_back(token, state->loadState);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    void StoreManager::setPersistenceOptions(const PersistenceOptions& options) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        options_ = options;
+        snapshotFormat_ = options.snapshotFormat;
+        kvspp::persistence::PersistenceManager::setLoadThreads(options.loadThreads);
+        kvspp::persistence::PersistenceManager::setCompression(options.snapshotCompression);
+        kvspp::persistence::PersistenceManager::setKeyFilterBits(options.keyFilterBitsPerKey);
+        kvspp::persistence::PersistenceManager::setSnapshotFsync(options.snapshotFsync);
+        kvspp::utils::FileWriter::setIoUring(options.ioUring);
+    }
+
+    void StoreManager::attachLog(const storeToken& token, kvspp::core::KeyValueStore& store) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto state = stateFor(token);
+        // Log-structured stores write every mutation to their data files already
+        if(state->log || !options_.appendOnly || store.logStructured()) return;
+
+        auto log = std::make_shared<kvspp::persistence::WriteAheadLog>(
+            logPathFor(resolveStorePath(token)), options_.fsyncPolicy);
+        state->logListenerId = store.addMutationListener([log](const kvspp::core::Mutation& mutation) {
+            log->append(mutation);
+        });
+        state->log = log;
+    }
+
+    void StoreManager::detachLog(const storeToken& token, kvspp::core::KeyValueStore& store) {
+        std::shared_ptr<kvspp::persistence::WriteAheadLog> log;
+        size_t listenerId = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto state = stateFor(token);
+            log.swap(state->log);
+            listenerId = state->logListenerId;
+        }
+        if(!log) return;
+        store.removeMutationListener(listenerId);
+        log->commit();
+    }
+
+    void StoreManager::snapshotStore(const storeToken& token) {
+        std::lock_guard<std::mutex> snapshotLock(snapshotMutex_);
+
+        std::shared_ptr<StoreState> state;
+        std::shared_ptr<kvspp::persistence::WriteAheadLog> log;
+        kvspp::core::KeyValueStore* store = nullptr;
+        PersistenceOptions options;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state = stateFor(token);
+            log = state->log;
+            store = &stores_.at(token);
+            options = options_;
+            state->saveRequested = false;
+            state->saving = true;
+        }
+
+        // Mutations racing with the snapshot stay counted as dirty
+        uint64_t dirtyBefore = state->dirty.load();
+        try {
+            // Records from here on go to a fresh log; the snapshot taken afterwards
+            // covers everything in the rotated one, which can then be dropped.
+            // Replaying the new log over that snapshot is idempotent.
+            if(auto* storage = store->logStructured()) {
+                // The data files are the store's persistence; a checkpoint makes them durable
+                storage->sync();
+            }
+            else {
+                std::string rotated;
+                if(log) rotated = log->rotate();
+                writeStoreSnapshot(token, *store, *state, options);
+                if(!rotated.empty()) std::filesystem::remove(rotated);
+            }
+        }
+        catch(...) {
+            // The on-disk chain is in an unknown state; the next snapshot is a full one
+            state->hasBase = false;
+            state->currentSnapshot.clear();
+            std::lock_guard<std::mutex> lock(mutex_);
+            state->saving = false;
+            state->lastSaveTick = std::chrono::steady_clock::now();
+            throw;
+        }
+
+        state->dirty -= dirtyBefore;
+        std::lock_guard<std::mutex> lock(mutex_);
+        state->saving = false;
+        state->lastSaveTick = std::chrono::steady_clock::now();
+        state->lastSave = std::time(nullptr);
+    }
+
+    namespace {
+        // store/<name>.json -> store/<name>.<suffix>
+        std::string siblingPath(const std::string& basePath, const std::string& suffix) {
+            return std::filesystem::path(basePath).replace_extension(suffix).string();
+        }
+
+        std::string inDirectoryOf(const std::string& basePath, const std::string& name) {
+            return (std::filesystem::path(basePath).parent_path() / name).string();
+        }
+
+        // Move a snapshot's key filter along with the snapshot (rename keeps the stamp valid)
+        void renameKeyFilter(const std::string& from, const std::string& to) {
+            using kvspp::persistence::PersistenceManager;
+            std::error_code ec;
+            std::filesystem::remove(PersistenceManager::keyFilterPathFor(to), ec);
+            std::filesystem::rename(PersistenceManager::keyFilterPathFor(from), PersistenceManager::keyFilterPathFor(to), ec);
+        }
+    }
+
+    void StoreManager::writeStoreSnapshot(const storeToken& token, kvspp::core::KeyValueStore& store,
+        StoreState& state, const PersistenceOptions& options) {
+        using kvspp::persistence::DeltaManifest;
+        using kvspp::persistence::DeltaSnapshot;
+
+        const std::string path = resolveStorePath(token);
+        const std::string manifestPath = DeltaManifest::pathFor(path);
+        const std::string baseName = std::filesystem::path(path).filename().string();
+
+        // Take the keys changed so far; later changes belong to the next snapshot
+        std::unordered_set<std::string> keys;
+        bool cleared = false;
+        {
+            std::lock_guard<std::mutex> lock(state.keysMutex);
+            keys.swap(state.dirtyKeys);
+            std::swap(cleared, state.keysCleared);
+        }
+
+        // A delta only pays off while it is small next to the store
+        if(options.deltaSnapshots && state.hasBase && !cleared && !state.mergeRequested &&
+            state.deltas.size() < options.maxDeltas && keys.size() * 2 <= store.size()) {
+            std::vector<DeltaSnapshot::Change> changes;
+            changes.reserve(keys.size());
+            for(const auto& key : keys) {
+                changes.push_back({ key, store.getCopy(key) });
+            }
+
+            if(keys.empty() && store.getAutosave() == state.savedAutosave) return; // nothing changed
+
+            const uint64_t sequence = state.deltas.size() + 1;
+            std::string name = std::filesystem::path(siblingPath(path, "." + std::to_string(sequence) + ".delta")).filename().string();
+            const bool autosave = store.getAutosave();
+            uint64_t bytes = DeltaSnapshot::write(inDirectoryOf(path, name), sequence, autosave, changes);
+
+            DeltaManifest manifest{ baseName, "", state.deltas };
+            manifest.deltas.push_back(name);
+            manifest.write(manifestPath);
+            state.deltas = std::move(manifest.deltas);
+            state.deltaBytes += bytes;
+            state.currentSnapshot.clear();
+            state.savedAutosave = autosave;
+
+            if(state.deltas.size() >= options.maxDeltas ||
+                static_cast<double>(state.deltaBytes) > options.deltaMergeRatio * static_cast<double>(state.baseBytes)) {
+                state.mergeRequested = true; // picked up by the background thread
+            }
+            return;
+        }
+
+        std::optional<DeltaManifest> existing = DeltaManifest::read(manifestPath);
+        if(!options.deltaSnapshots && !existing) {
+            writeSnapshot(store, path);
+            state.currentSnapshot = path;
+            return;
+        }
+
+        // Full snapshot, merging any deltas: write the new base beside the old one,
+        // mark it pending in the manifest, then rename it into place. A crash at any
+        // point leaves either the old base + deltas or the new base (see recoverPendingMerge)
+        const std::string merged = siblingPath(path, ".merge" + std::filesystem::path(path).extension().string());
+        const bool autosave = store.getAutosave();
+        writeSnapshot(store, merged);
+        DeltaManifest pending{ baseName, std::filesystem::path(merged).filename().string(),
+            existing ? existing->deltas : std::vector<std::string>{} };
+        pending.write(manifestPath);
+        kvspp::persistence::PersistenceManager::commitFile(merged, path);
+        renameKeyFilter(merged, path);
+        if(options.deltaSnapshots) DeltaManifest{ baseName, "", {} }.write(manifestPath);
+        else std::filesystem::remove(manifestPath);
+        for(const auto& delta : pending.deltas) {
+            std::filesystem::remove(inDirectoryOf(path, delta));
+        }
+
+        state.deltas.clear();
+        state.deltaBytes = 0;
+        state.baseBytes = std::filesystem::file_size(path);
+        state.hasBase = options.deltaSnapshots;
+        state.currentSnapshot = path;
+        state.savedAutosave = autosave;
+        state.mergeRequested = false;
+    }
+
+    void StoreManager::recoverPendingMerge(const std::string& basePath) {
+        using kvspp::persistence::DeltaManifest;
+        const std::string manifestPath = DeltaManifest::pathFor(basePath);
+        std::optional<DeltaManifest> manifest = DeltaManifest::read(manifestPath);
+        if(!manifest || manifest->pending.empty()) return;
+
+        // The pending base already contains every listed delta
+        std::string pendingPath = inDirectoryOf(basePath, manifest->pending);
+        if(std::filesystem::exists(pendingPath)) {
+            std::filesystem::rename(pendingPath, basePath);
+            renameKeyFilter(pendingPath, basePath);
+        }
+        for(const auto& delta : manifest->deltas) {
+            std::filesystem::remove(inDirectoryOf(basePath, delta));
+        }
+        DeltaManifest{ manifest->base, "", {} }.write(manifestPath);
+    }
+
+    StoreManager::Dump StoreManager::dumpStore(const storeToken& token) {
+        namespace fs = std::filesystem;
+        std::shared_ptr<StoreState> state;
+        const kvspp::core::KeyValueStore* store = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state = stateFor(token);
+            store = &stores_.at(token);
+        }
+        const std::string ownPath = resolveStorePath(token);
+        const std::string sequence = "." + std::to_string(++transferSequence_) + ".dump";
+
+        Dump dump;
+        bool linked = false;
+        {
+            // Snapshots are renamed into place, so the link pins the version checked here
+            std::lock_guard<std::mutex> snapshotLock(snapshotMutex_);
+            if(state->dirty == 0 && !state->currentSnapshot.empty()) {
+                dump.path = siblingPath(ownPath, sequence + fs::path(state->currentSnapshot).extension().string());
+                std::error_code ec;
+                fs::create_hard_link(state->currentSnapshot, dump.path, ec);
+                linked = !ec;
+            }
+        }
+        std::error_code ec;
+        if(!linked) {
+            dump.path = siblingPath(ownPath, sequence + fs::path(ownPath).extension().string());
+            try {
+                writeSnapshot(*store, dump.path);
+            }
+            catch(...) {
+                fs::remove(dump.path, ec);
+                throw;
+            }
+            fs::remove(kvspp::persistence::PersistenceManager::keyFilterPathFor(dump.path), ec);
+        }
+
+        try {
+            dump.size = fs::file_size(dump.path);
+            const int64_t mtime = static_cast<int64_t>(fs::last_write_time(dump.path).time_since_epoch().count());
+            if(linked) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = dumpChecksums_.find(token);
+                if(it != dumpChecksums_.end() && it->second.size == dump.size && it->second.mtime == mtime) {
+                    dump.crc32 = it->second.crc32;
+                    return dump;
+                }
+            }
+            {
+                kvspp::utils::MappedFile file(dump.path);
+                file.adviseSequential();
+                dump.crc32 = kvspp::utils::Checksum::crc32(file.data(), file.size());
+            }
+            if(linked) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                dumpChecksums_[token] = DumpChecksum{ dump.size, mtime, dump.crc32 };
+            }
+        }
+        catch(...) {
+            fs::remove(dump.path, ec);
+            throw;
+        }
+        return dump;
+    }
+
+    std::string StoreManager::restorePath(const storeToken& token, kvspp::persistence::SnapshotFormat format) {
+        return siblingPath(resolveStorePath(token), "." + std::to_string(++transferSequence_) + ".restore" +
+            kvspp::persistence::PersistenceManager::extensionFor(format));
+    }
+
+    void StoreManager::restoreStore(const storeToken& token, const std::string& path) {
+        std::error_code ec;
+        try {
+            loadStore(token, path);
+        }
+        catch(...) {
+            std::filesystem::remove(path, ec);
+            throw;
+        }
+        std::shared_ptr<StoreState> state;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state = stateFor(token);
+        }
+        {
+            // The upload is only scratch space; the store's own snapshot is what persists
+            std::lock_guard<std::mutex> snapshotLock(snapshotMutex_);
+            if(state->currentSnapshot == path) state->currentSnapshot.clear();
+        }
+        std::filesystem::remove(path, ec);
+    }
+
+    void StoreManager::persistenceLoop() {
+        auto lastFsync = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(!stopPersistence_) {
+            persistenceCv_.wait_for(lock, PERSISTENCE_TICK);
+            if(stopPersistence_) break;
+
+            const PersistenceOptions options = options_;
+            const auto now = std::chrono::steady_clock::now();
+            const bool fsyncDue = now - lastFsync >= options.fsyncInterval;
+            if(fsyncDue) lastFsync = now;
+
+            std::vector<storeToken> toSave;
+            std::vector<std::shared_ptr<kvspp::persistence::WriteAheadLog>> toFsync;
+            std::vector<kvspp::persistence::LogStructuredStorage*> toMaintain;
+            std::vector<kvspp::core::KeyValueStore*> toDemote;
+            for(const auto& [token, state] : states_) {
+                auto& store = stores_.at(token);
+                if(auto* storage = store.logStructured()) {
+                    toMaintain.push_back(storage);
+                    continue;
+                }
+                if(store.tieringThreshold() > 0) toDemote.push_back(&store);
+                if(state->saving) continue;
+                if(state->log && fsyncDue && state->log->getPolicy() == kvspp::persistence::FsyncPolicy::EVERYSEC) {
+                    toFsync.push_back(state->log);
+                }
+
+                // Merging deltas into a new base is always left to this thread
+                bool due = state->saveRequested || state->mergeRequested;
+                if(!due && state->log) {
+                    // Rewrite the log once it outgrows the snapshot
+                    std::string snapshotPath = resolveStorePath(token);
+                    std::error_code ec;
+                    uint64_t snapshotSize = std::filesystem::file_size(snapshotPath, ec);
+                    if(ec) snapshotSize = 0;
+                    uint64_t threshold = std::max<uint64_t>(options.rewriteMinSize,
+                        static_cast<uint64_t>(options.rewriteRatio * static_cast<double>(snapshotSize)));
+                    due = state->log->size() > threshold;
+                }
+                if(!due && state->dirty > 0 && (state->log || stores_.at(token).getAutosave())) {
+                    for(const auto& rule : options.saveRules) {
+                        if(state->dirty >= rule.changes && now - state->lastSaveTick >= rule.after) {
+                            due = true;
+                            break;
+                        }
+                    }
+                }
+                if(due) toSave.push_back(token);
+            }
+            lock.unlock();
+
+            for(const auto& log : toFsync) {
+                try {
+                    log->fsyncIfNeeded();
+                }
+                catch(const std::exception& e) {
+                    std::cerr << "Background fsync failed for " << log->getFilePath() << ": " << e.what() << "\n";
+                }
+            }
+            // Syncing, merging stale records and writing hint files of sealed data files
+            for(auto* storage : toMaintain) {
+                try {
+                    if(fsyncDue && options.fsyncPolicy == kvspp::persistence::FsyncPolicy::EVERYSEC) storage->sync();
+                    if(storage->mergeNeeded()) storage->merge();
+                    else storage->writeMissingHints();
+                }
+                catch(const std::exception& e) {
+                    std::cerr << "Background merge failed for " << storage->directory() << ": " << e.what() << "\n";
+                }
+            }
+            for(auto* store : toDemote) {
+                try {
+                    store->demoteIdle(TIERING_SWEEP_ENTRIES);
+                }
+                catch(const std::exception& e) {
+                    std::cerr << "Background tiering failed: " << e.what() << "\n";
+                }
+            }
+            for(const auto& token : toSave) {
+                try {
+                    snapshotStore(token);
+                }
+                catch(const std::exception& e) {
+                    std::cerr << "Background save failed for store '" << token << "': " << e.what() << "\n";
+                }
+            }
+
+            lock.lock();
         }
-        stores_[token].load(fname);
     }
 
 } // namespace kvstore
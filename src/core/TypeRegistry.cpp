@@ -37,6 +37,11 @@ namespace kvspp {
             return attributeTypes_.find(attributeName) != attributeTypes_.end();
         }
 
+        std::vector<std::pair<std::string, AttributeType>> TypeRegistry::getAllTypes() const {
+            std::lock_guard<std::mutex> lock(mtx);
+            return { attributeTypes_.begin(), attributeTypes_.end() };
+        }
+
         AttributeType TypeRegistry::getTypeFromValue(const AttributeValue& value) {
             if(std::holds_alternative<std::string>(value)) {
                 return AttributeType::STRING;
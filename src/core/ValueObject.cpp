@@ -27,6 +27,10 @@ namespace kvspp {
             }
         }
 
+        ValueObject::ValueObject(std::unordered_map<std::string, AttributeValue>&& attributes, TypeRegistry& typeRegistry)
+            : attributes_(std::move(attributes)), typeRegistry_(&typeRegistry) {
+        }
+
         void ValueObject::setTypeRegistry(TypeRegistry& typeRegistry) {
             typeRegistry_ = &typeRegistry;
         }        const AttributeValue* ValueObject::getAttribute(const std::string& attributeName) const {
@@ -128,6 +132,17 @@ namespace kvspp {
             // default is string
             return valueStr;
         }
+        size_t ValueObject::memoryUsage() const {
+            // Node = next pointer + cached hash + the pair itself
+            constexpr size_t NODE_BYTES = 2 * sizeof(void*) + sizeof(std::pair<const std::string, AttributeValue>);
+            size_t bytes = sizeof(ValueObject) + attributes_.bucket_count() * sizeof(void*);
+            for(const auto& [name, value] : attributes_) {
+                bytes += NODE_BYTES + name.capacity();
+                if(const auto* str = std::get_if<std::string>(&value)) bytes += str->capacity();
+            }
+            return bytes;
+        }
+
         std::string ValueObject::getValueString() const {
             auto it = attributes_.find("value");
             if(it == attributes_.end()) return "";
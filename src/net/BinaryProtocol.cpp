@@ -0,0 +1,68 @@
+#include "kvstore/net/BinaryProtocol.hpp"
+#include "kvstore/persistence/BinaryCodec.hpp"
+
+namespace kvspp {
+    namespace net {
+
+        using persistence::BinaryReader;
+        using persistence::BinaryWriter;
+
+        // Header layout: opcode, flags, status, a reserved byte, then the request id,
+        // key length and value length as 32-bit little-endian integers
+
+        std::string BinaryProtocol::hello(uint8_t version) {
+            return std::string{ MAGIC, 'K', 'V', static_cast<char>(version) };
+        }
+
+        BinaryProtocol::Header BinaryProtocol::decode(const char* data) {
+            BinaryReader reader(data, HEADER_SIZE);
+            Header header;
+            header.opcode = static_cast<Opcode>(reader.u8());
+            header.flags = reader.u8();
+            header.status = static_cast<Status>(reader.u8());
+            reader.u8();
+            header.requestId = reader.u32();
+            header.keyLength = reader.u32();
+            header.valueLength = reader.u32();
+            return header;
+        }
+
+        void BinaryProtocol::encode(std::string& out, const Header& header) {
+            BinaryWriter::putU8(out, static_cast<uint8_t>(header.opcode));
+            BinaryWriter::putU8(out, header.flags);
+            BinaryWriter::putU8(out, static_cast<uint8_t>(header.status));
+            BinaryWriter::putU8(out, 0);
+            BinaryWriter::putU32(out, header.requestId);
+            BinaryWriter::putU32(out, header.keyLength);
+            BinaryWriter::putU32(out, header.valueLength);
+        }
+
+        std::string BinaryProtocol::reply(const Header& request, Status status, std::string_view value) {
+            if((request.flags & FLAG_NOREPLY) && (status == Status::OK || status == Status::NOT_FOUND)) return {};
+            Header header;
+            header.opcode = request.opcode;
+            header.status = status;
+            header.requestId = request.requestId;
+            header.valueLength = static_cast<uint32_t>(value.size());
+            std::string out;
+            out.reserve(HEADER_SIZE + value.size());
+            encode(out, header);
+            out.append(value.data(), value.size());
+            return out;
+        }
+
+        std::string BinaryProtocol::replyFromLine(const Header& request, std::string_view line) {
+            if(!line.empty() && line.back() == '\n') line.remove_suffix(1);
+            if(line == "OK") return reply(request, Status::OK);
+            if(line == "NOT_FOUND") return reply(request, Status::NOT_FOUND);
+            if(line.compare(0, 6, "ERROR ") == 0) {
+                line.remove_prefix(6);
+                if(line.compare(0, 8, "LOADING ") == 0) return reply(request, Status::LOADING, line.substr(8));
+                if(line.compare(0, 9, "READONLY ") == 0) return reply(request, Status::READONLY, line.substr(9));
+                return reply(request, Status::FAILED, line);
+            }
+            return reply(request, Status::OK, line);
+        }
+
+    } // namespace net
+} // namespace kvspp
@@ -0,0 +1,313 @@
+#include "kvstore/net/EventLoop.hpp"
+
+#ifdef __linux__
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace kvspp {
+    namespace net {
+
+        namespace {
+            constexpr int MAX_EVENTS = 256;
+            // Bytes read from one connection before the loop turns to the others
+            constexpr size_t READ_LIMIT = 1 << 20;
+            constexpr size_t READ_CHUNK = 64 << 10;
+            // Reply chunks handed to one sendmsg
+            constexpr size_t IOV_BATCH = 64;
+            // Buffers of idle connections larger than this are given back
+            constexpr size_t IDLE_BUFFER_BYTES = 64 << 10;
+
+            bool setBlocking(int sock, bool blocking) {
+                int flags = fcntl(sock, F_GETFL, 0);
+                if(flags < 0) return false;
+                flags = blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK;
+                return fcntl(sock, F_SETFL, flags) == 0;
+            }
+
+            void release(std::string& buffer) {
+                if(buffer.empty() && buffer.capacity() > IDLE_BUFFER_BYTES) std::string().swap(buffer);
+            }
+        }
+
+        EventLoop::EventLoop(Handler handler, utils::ThreadPool* pool)
+            : handler_(std::move(handler)), pool_(pool), readBuffer_(READ_CHUNK) {
+            epoll_ = epoll_create1(EPOLL_CLOEXEC);
+            wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if(epoll_ < 0 || wake_ < 0) {
+                std::string error = std::strerror(errno);
+                if(epoll_ >= 0) ::close(epoll_);
+                if(wake_ >= 0) ::close(wake_);
+                throw std::runtime_error("cannot create event loop: " + error);
+            }
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.ptr = &wake_;
+            epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &event);
+        }
+
+        EventLoop::~EventLoop() {
+            ::close(wake_);
+            ::close(epoll_);
+        }
+
+        void EventLoop::stop() {
+            stopping_ = true;
+            uint64_t one = 1;
+            [[maybe_unused]] auto written = ::write(wake_, &one, sizeof(one));
+        }
+
+        EventLoop::Stats EventLoop::stats() const {
+            Stats stats;
+            stats.connections = count_;
+            stats.accepted = accepted_.load(std::memory_order_relaxed);
+            stats.bytesIn = bytesIn_.load(std::memory_order_relaxed);
+            stats.bytesOut = bytesOut_.load(std::memory_order_relaxed);
+            stats.batches = batches_.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+        void EventLoop::run(int listenSock, bool shared) {
+            listen_ = listenSock;
+            setBlocking(listen_, false);
+            // Level-triggered: connections left in the accept queue are picked up next round
+            epoll_event event{};
+            event.events = shared ? EPOLLIN | EPOLLEXCLUSIVE : EPOLLIN;
+            event.data.ptr = &listen_;
+            if(epoll_ctl(epoll_, EPOLL_CTL_ADD, listen_, &event) < 0) {
+                std::cerr << "Event loop: cannot watch the listening socket: " << std::strerror(errno) << std::endl;
+                return;
+            }
+
+            epoll_event events[MAX_EVENTS];
+            while(!stopping_) {
+                int ready = epoll_wait(epoll_, events, MAX_EVENTS, ready_.empty() ? -1 : 0);
+                if(ready < 0) {
+                    if(errno == EINTR) continue;
+                    std::cerr << "Event loop: epoll_wait failed: " << std::strerror(errno) << std::endl;
+                    break;
+                }
+                for(int i = 0; i < ready; ++i) {
+                    void* source = events[i].data.ptr;
+                    if(source == &listen_) {
+                        accept();
+                    }
+                    else if(source == &wake_) {
+                        uint64_t count;
+                        while(::read(wake_, &count, sizeof(count)) > 0) {}
+                        drainCompleted();
+                    }
+                    else {
+                        auto* conn = static_cast<Connection*>(source);
+                        if(conn->sock >= 0 && !conn->busy) service(*conn);
+                    }
+                }
+                // Connections that had more to read than one turn allows
+                for(size_t pending = ready_.size(); pending > 0 && !ready_.empty(); --pending) {
+                    Connection* conn = ready_.front();
+                    ready_.pop_front();
+                    if(conn->sock >= 0 && !conn->busy) service(*conn);
+                }
+                closed_.clear();
+            }
+
+            epoll_ctl(epoll_, EPOLL_CTL_DEL, listen_, nullptr);
+            // Wake workers blocked on their sockets and wait for every connection to come back
+            for(auto& [sock, conn] : connections_) {
+                if(conn->busy) ::shutdown(sock, SHUT_RDWR);
+            }
+            while(busy_ > 0) {
+                std::vector<std::pair<Connection*, HandlerResult>> completed;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this]() { return !completed_.empty(); });
+                    completed.swap(completed_);
+                }
+                busy_ -= completed.size();
+                for(auto& entry : completed) entry.first->busy = false;
+            }
+            while(!connections_.empty()) close(*connections_.begin()->second);
+            ready_.clear();
+            closed_.clear();
+        }
+
+        void EventLoop::accept() {
+            for(int accepted = 0; accepted < MAX_EVENTS; ++accepted) {
+                int sock = accept4(listen_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if(sock < 0) {
+                    if(errno == EINTR || errno == ECONNABORTED) continue;
+                    if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                        std::cerr << "Event loop: accept failed: " << std::strerror(errno) << std::endl;
+                    }
+                    return;
+                }
+                int optval = 1;
+                setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
+
+                auto conn = std::make_unique<Connection>();
+                conn->sock = sock;
+                epoll_event event{};
+                event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                event.data.ptr = conn.get();
+                if(epoll_ctl(epoll_, EPOLL_CTL_ADD, sock, &event) < 0) {
+                    ::close(sock);
+                    continue;
+                }
+                connections_.emplace(sock, std::move(conn));
+                ++count_;
+                accepted_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void EventLoop::service(Connection& conn) {
+            if(!flush(conn)) return;
+            if(conn.closing) {
+                close(conn);
+                return;
+            }
+            if(!conn.peerClosed && receive(conn)) ready_.push_back(&conn);
+            if(conn.input.empty() && !conn.peerClosed) return;
+            execute(conn);
+        }
+
+        bool EventLoop::flush(Connection& conn) {
+            iovec vec[IOV_BATCH];
+            while(!conn.output.empty()) {
+                msghdr message{};
+                message.msg_iov = vec;
+                message.msg_iovlen = conn.output.gather(vec, IOV_BATCH);
+                ssize_t written = ::sendmsg(conn.sock, &message, MSG_NOSIGNAL);
+                if(written > 0) {
+                    conn.output.consume(static_cast<size_t>(written));
+                    bytesOut_.fetch_add(static_cast<uint64_t>(written), std::memory_order_relaxed);
+                    continue;
+                }
+                if(written < 0 && errno == EINTR) continue;
+                // The rest goes out on the next EPOLLOUT edge
+                if(written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+                close(conn);
+                return false;
+            }
+            return true;
+        }
+
+        bool EventLoop::receive(Connection& conn) {
+            size_t total = 0;
+            while(total < READ_LIMIT) {
+                ssize_t received = ::recv(conn.sock, readBuffer_.data(), readBuffer_.size(), 0);
+                if(received > 0) {
+                    conn.input.append(readBuffer_.data(), static_cast<size_t>(received));
+                    total += static_cast<size_t>(received);
+                    continue;
+                }
+                if(received < 0 && errno == EINTR) continue;
+                if(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                conn.peerClosed = true;
+                break;
+            }
+            bytesIn_.fetch_add(total, std::memory_order_relaxed);
+            return total >= READ_LIMIT;
+        }
+
+        void EventLoop::execute(Connection& conn) {
+            conn.busy = true;
+            ++busy_;
+            if(pool_) {
+                pool_->submit([this, &conn]() {
+                    HandlerResult result = call(conn, false);
+                    if(result == HandlerResult::BLOCKING) block(conn);
+                    else complete(conn, result);
+                });
+                return;
+            }
+            HandlerResult result = call(conn, false);
+            if(result == HandlerResult::BLOCKING) {
+                block(conn);
+                return;
+            }
+            conn.busy = false;
+            --busy_;
+            settle(conn, result);
+        }
+
+        HandlerResult EventLoop::call(Connection& conn, bool mayBlock) {
+            batches_.fetch_add(1, std::memory_order_relaxed);
+            try {
+                return handler_(conn, mayBlock);
+            }
+            catch(const std::exception& e) {
+                std::cerr << "Event loop: closing a connection: " << e.what() << std::endl;
+                return HandlerResult::CLOSE;
+            }
+        }
+
+        void EventLoop::settle(Connection& conn, HandlerResult result) {
+            if(result == HandlerResult::CLOSE || conn.peerClosed) conn.closing = true;
+            if(!flush(conn)) return;
+            if(conn.closing) {
+                close(conn);
+                return;
+            }
+            release(conn.input);
+        }
+
+        void EventLoop::block(Connection& conn) {
+            std::thread([this, &conn]() {
+                HandlerResult result = HandlerResult::CLOSE;
+                if(setBlocking(conn.sock, true)) {
+                    result = call(conn, true);
+                    if(!setBlocking(conn.sock, false)) result = HandlerResult::CLOSE;
+                }
+                complete(conn, result);
+            }).detach();
+        }
+
+        void EventLoop::complete(Connection& conn, HandlerResult result) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            completed_.emplace_back(&conn, result);
+            uint64_t one = 1;
+            [[maybe_unused]] auto written = ::write(wake_, &one, sizeof(one));
+            cv_.notify_one();
+        }
+
+        void EventLoop::drainCompleted() {
+            std::vector<std::pair<Connection*, HandlerResult>> completed;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                completed.swap(completed_);
+            }
+            for(auto& [conn, result] : completed) {
+                conn->busy = false;
+                --busy_;
+                settle(*conn, result);
+                // Input that arrived meanwhile raised edges the loop ignored
+                if(conn->sock >= 0 && !conn->closing) service(*conn);
+            }
+        }
+
+        void EventLoop::close(Connection& conn) {
+            const int sock = conn.sock;
+            epoll_ctl(epoll_, EPOLL_CTL_DEL, sock, nullptr);
+            ::close(sock);
+            conn.sock = -1;
+            ready_.erase(std::remove(ready_.begin(), ready_.end(), &conn), ready_.end());
+            auto it = connections_.find(sock);
+            if(it != connections_.end()) {
+                closed_.push_back(std::move(it->second));
+                connections_.erase(it);
+            }
+            --count_;
+        }
+
+    } // namespace net
+} // namespace kvspp
+#endif
@@ -0,0 +1,89 @@
+#include "kvstore/net/OutputBuffer.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace kvspp {
+    namespace net {
+
+        namespace {
+            // Replies this large become chunks of their own
+            constexpr size_t LARGE_REPLY = 4 << 10;
+            // Small replies are packed into chunks of about this size
+            constexpr size_t CHUNK_SIZE = 16 << 10;
+            // A drained buffer keeps one chunk up to this capacity for the next replies
+            constexpr size_t KEEP_CAPACITY = 64 << 10;
+        }
+
+        void OutputBuffer::append(std::string&& data) {
+            if(data.size() < LARGE_REPLY) {
+                append(std::string_view(data));
+                return;
+            }
+            size_ += data.size();
+            // In place of the empty chunk a drained buffer keeps
+            if(!chunks_.empty() && chunks_.back().empty()) chunks_.back() = std::move(data);
+            else chunks_.push_back(std::move(data));
+        }
+
+        void OutputBuffer::append(std::string_view data) {
+            if(data.empty()) return;
+            if(data.size() >= LARGE_REPLY) {
+                append(std::string(data));
+                return;
+            }
+            if(chunks_.empty() || chunks_.back().size() >= CHUNK_SIZE) chunks_.emplace_back();
+            chunks_.back().append(data);
+            size_ += data.size();
+        }
+
+        std::string_view OutputBuffer::front() const {
+            if(chunks_.empty()) return {};
+            return std::string_view(chunks_.front()).substr(head_);
+        }
+
+#ifndef _WIN32
+        size_t OutputBuffer::gather(iovec* vec, size_t max) const {
+            size_t count = 0;
+            size_t skip = head_;
+            for(auto it = chunks_.begin(); it != chunks_.end() && count < max; ++it) {
+                vec[count].iov_base = const_cast<char*>(it->data() + skip);
+                vec[count].iov_len = it->size() - skip;
+                skip = 0;
+                ++count;
+            }
+            return count;
+        }
+#endif
+
+        void OutputBuffer::consume(size_t count) {
+            count = std::min(count, size_);
+            size_ -= count;
+            while(count > 0) {
+                const size_t left = chunks_.front().size() - head_;
+                if(count < left || chunks_.size() == 1) {
+                    head_ += count;
+                    break;
+                }
+                count -= left;
+                chunks_.pop_front();
+                head_ = 0;
+            }
+            if(size_ == 0) clear();
+        }
+
+        void OutputBuffer::clear() {
+            if(chunks_.size() == 1 && chunks_.front().capacity() <= KEEP_CAPACITY) chunks_.front().clear();
+            else std::deque<std::string>().swap(chunks_);
+            head_ = 0;
+            size_ = 0;
+        }
+
+        void OutputBuffer::swap(OutputBuffer& other) noexcept {
+            chunks_.swap(other.chunks_);
+            std::swap(head_, other.head_);
+            std::swap(size_, other.size_);
+        }
+
+    } // namespace net
+} // namespace kvspp
@@ -0,0 +1,385 @@
+#include "kvstore/net/Replication.hpp"
+#include "kvstore/core/StoreManager.hpp"
+#include "kvstore/persistence/BinaryCodec.hpp"
+#include "kvstore/persistence/ReplicationBacklog.hpp"
+#include "kvstore/persistence/WriteAheadLog.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace kvspp {
+    namespace net {
+
+        namespace {
+            using persistence::ReplicationBacklog;
+
+            std::atomic<size_t> backlogBytes{ 16 * 1024 * 1024 };
+            std::atomic<size_t> servedFollowers{ 0 };
+
+            // Bytes handed to send() at a time, both for the full sync and the backlog
+            constexpr size_t STREAM_CHUNK = 256 * 1024;
+            constexpr size_t FRAME_HEADER_SIZE = 8;
+            constexpr uint32_t MAX_FRAME_SIZE = 1u << 30;
+            // An idle leader pings this often; a follower hearing nothing for LINK_TIMEOUT reconnects
+            constexpr std::chrono::milliseconds PING_INTERVAL{ 1000 };
+            constexpr std::chrono::seconds LINK_TIMEOUT{ 5 };
+            constexpr std::chrono::milliseconds RETRY_INTERVAL{ 1000 };
+
+            void closeSocket(int sock) {
+#ifdef _WIN32
+                closesocket(sock);
+#else
+                ::close(sock);
+#endif
+            }
+
+            void setTimeout(int sock, int option, std::chrono::milliseconds timeout) {
+#ifdef _WIN32
+                DWORD value = static_cast<DWORD>(timeout.count());
+                setsockopt(sock, SOL_SOCKET, option, reinterpret_cast<const char*>(&value), sizeof(value));
+#else
+                timeval value{};
+                value.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+                value.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+                setsockopt(sock, SOL_SOCKET, option, &value, sizeof(value));
+#endif
+            }
+
+            // send() until every byte is out; throws if the peer went away
+            void sendAll(int sock, const char* data, size_t length) {
+#ifdef MSG_NOSIGNAL
+                const int flags = MSG_NOSIGNAL;
+#else
+                const int flags = 0;
+#endif
+                while(length > 0) {
+#ifdef _WIN32
+                    int sent = send(sock, data, static_cast<int>(length), flags);
+#else
+                    ssize_t sent = send(sock, data, length, flags);
+#endif
+                    if(sent <= 0) throw std::runtime_error("connection closed while sending");
+                    data += sent;
+                    length -= static_cast<size_t>(sent);
+                }
+            }
+
+            void sendAll(int sock, const std::string& data) {
+                sendAll(sock, data.data(), data.size());
+            }
+
+            std::string controlFrame(uint8_t kind) {
+                std::string payload;
+                persistence::BinaryWriter::putU8(payload, kind);
+                std::string frame;
+                ReplicationBacklog::appendFrame(frame, payload);
+                return frame;
+            }
+
+            // Stream every store as CLEAR, PUT per key, AUTOSAVE, then FRAME_SNAPSHOT_END
+            void sendStores(int sock) {
+                auto& manager = kvstore::StoreManager::instance();
+                std::string out;
+                for(const auto& [token, loadState] : manager.storeStates()) {
+                    auto& store = manager.getStore(token);
+                    if(store.packedStore()) continue;
+
+                    ReplicationBacklog::appendFrame(out, ReplicationBacklog::recordPayload(token, { core::Mutation::Type::CLEAR }));
+                    for(const auto& key : store.keys()) {
+                        auto value = store.getCopy(key);
+                        if(!value) continue; // deleted meanwhile; the REMOVE follows in the backlog
+                        ReplicationBacklog::appendFrame(out, ReplicationBacklog::recordPayload(token,
+                            { core::Mutation::Type::PUT, &key, &*value }));
+                        if(out.size() >= STREAM_CHUNK) {
+                            sendAll(sock, out);
+                            out.clear();
+                        }
+                    }
+                    ReplicationBacklog::appendFrame(out, ReplicationBacklog::recordPayload(token,
+                        { core::Mutation::Type::AUTOSAVE, nullptr, nullptr, store.getAutosave() }));
+                }
+                out += controlFrame(ReplicationBacklog::FRAME_SNAPSHOT_END);
+                sendAll(sock, out);
+            }
+
+            // Buffered reads of lines and frames from the leader connection
+            class LinkReader {
+            public:
+                explicit LinkReader(int sock) : sock_(sock) {}
+
+                std::string line() {
+                    size_t newline;
+                    while((newline = buffer_.find('\n', pos_)) == std::string::npos) fill();
+                    std::string result = buffer_.substr(pos_, newline - pos_);
+                    pos_ = newline + 1;
+                    if(!result.empty() && result.back() == '\r') result.pop_back();
+                    return result;
+                }
+
+                // Payload of the next frame, verified against its checksum; sets frameSize
+                std::string frame(size_t& frameSize) {
+                    require(FRAME_HEADER_SIZE);
+                    persistence::BinaryReader header(buffer_.data() + pos_, FRAME_HEADER_SIZE);
+                    const uint32_t length = header.u32();
+                    const uint32_t crc = header.u32();
+                    if(length > MAX_FRAME_SIZE) throw std::runtime_error("oversized frame in replication stream");
+                    require(FRAME_HEADER_SIZE + length);
+                    std::string payload = buffer_.substr(pos_ + FRAME_HEADER_SIZE, length);
+                    if(utils::Checksum::crc32(payload.data(), payload.size()) != crc) {
+                        throw std::runtime_error("checksum mismatch in replication stream");
+                    }
+                    pos_ += FRAME_HEADER_SIZE + length;
+                    frameSize = FRAME_HEADER_SIZE + length;
+                    return payload;
+                }
+
+            private:
+                void require(size_t length) {
+                    while(buffer_.size() - pos_ < length) fill();
+                }
+
+                void fill() {
+                    if(pos_ > 0 && pos_ * 2 >= buffer_.size()) {
+                        buffer_.erase(0, pos_);
+                        pos_ = 0;
+                    }
+                    char chunk[64 * 1024];
+#ifdef _WIN32
+                    int bytes = recv(sock_, chunk, static_cast<int>(sizeof(chunk)), 0);
+#else
+                    ssize_t bytes = recv(sock_, chunk, sizeof(chunk), 0);
+#endif
+                    if(bytes == 0) throw std::runtime_error("leader closed the connection");
+                    if(bytes < 0) {
+#ifdef _WIN32
+                        const bool timedOut = WSAGetLastError() == WSAETIMEDOUT;
+#else
+                        const bool timedOut = errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+                        throw std::runtime_error(timedOut ? "no data from the leader for too long" : std::strerror(errno));
+                    }
+                    buffer_.append(chunk, static_cast<size_t>(bytes));
+                }
+
+                int sock_;
+                std::string buffer_;
+                size_t pos_ = 0;
+            };
+
+            // Connect to host:port, returning -1 on failure
+            int connectTo(const std::string& host, int port) {
+                addrinfo hints{};
+                hints.ai_family = AF_UNSPEC;
+                hints.ai_socktype = SOCK_STREAM;
+                addrinfo* addresses = nullptr;
+                if(getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) return -1;
+                int sock = -1;
+                for(addrinfo* address = addresses; address; address = address->ai_next) {
+                    sock = static_cast<int>(socket(address->ai_family, address->ai_socktype, address->ai_protocol));
+                    if(sock < 0) continue;
+                    if(connect(sock, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0) break;
+                    closeSocket(sock);
+                    sock = -1;
+                }
+                freeaddrinfo(addresses);
+                return sock;
+            }
+        }
+
+        void ReplicationLeader::setBacklogSize(size_t bytes) {
+            backlogBytes = bytes;
+        }
+
+        size_t ReplicationLeader::followers() {
+            return servedFollowers;
+        }
+
+        void ReplicationLeader::serve(int sock, const std::string& replicationId, uint64_t offset) {
+            auto backlog = kvstore::StoreManager::instance().enableReplication(backlogBytes);
+            ++servedFollowers;
+            setTimeout(sock, SO_SNDTIMEO, std::chrono::duration_cast<std::chrono::milliseconds>(LINK_TIMEOUT));
+            try {
+                uint64_t position;
+                if(replicationId == backlog->id() && backlog->contains(offset)) {
+                    position = offset;
+                    sendAll(sock, "CONTINUE " + backlog->id() + "\n");
+                }
+                else {
+                    // Everything from here on reaches the follower through the backlog
+                    position = backlog->endOffset();
+                    sendAll(sock, "FULLSYNC " + backlog->id() + " " + std::to_string(position) + "\n");
+                    sendStores(sock);
+                }
+
+                const std::string ping = controlFrame(ReplicationBacklog::FRAME_PING);
+                std::string chunk;
+                while(true) {
+                    if(!backlog->read(position, chunk, STREAM_CHUNK, PING_INTERVAL)) {
+                        std::cerr << "Follower fell behind the replication backlog (--repl-backlog-size); dropping it\n";
+                        break;
+                    }
+                    if(chunk.empty()) {
+                        sendAll(sock, ping);
+                        continue;
+                    }
+                    sendAll(sock, chunk);
+                    position += chunk.size();
+                }
+            }
+            catch(const std::exception&) {
+                // The follower went away; it reconnects on its own
+            }
+            --servedFollowers;
+        }
+
+        ReplicationFollower::ReplicationFollower(const std::string& host, int port)
+            : host_(host), port_(port) {
+        }
+
+        ReplicationFollower::~ReplicationFollower() {
+            stop();
+        }
+
+        void ReplicationFollower::start() {
+            if(running_) return;
+            running_ = true;
+            thread_ = std::thread(&ReplicationFollower::run, this);
+        }
+
+        void ReplicationFollower::stop() {
+            running_ = false;
+            int sock = sock_.exchange(-1);
+            if(sock >= 0) {
+#ifdef _WIN32
+                shutdown(sock, SD_BOTH);
+#else
+                shutdown(sock, SHUT_RDWR);
+#endif
+            }
+            if(thread_.joinable()) thread_.join();
+        }
+
+        ReplicationFollower::Status ReplicationFollower::status() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return status_;
+        }
+
+        std::string ReplicationFollower::leader() const {
+            return host_ + ":" + std::to_string(port_);
+        }
+
+        void ReplicationFollower::run() {
+            std::string lastError;
+            while(running_) {
+                int sock = connectTo(host_, port_);
+                if(sock >= 0) {
+                    sock_ = sock;
+                    try {
+                        session(sock);
+                    }
+                    catch(const std::exception& e) {
+                        // Report each distinct failure once, not on every retry
+                        if(running_ && e.what() != lastError) {
+                            lastError = e.what();
+                            std::cerr << "Replication link to " << leader() << " down: " << lastError << "\n";
+                        }
+                    }
+                    sock_ = -1;
+                    closeSocket(sock);
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    status_.linkUp = false;
+                }
+                for(auto waited = std::chrono::milliseconds(0); running_ && waited < RETRY_INTERVAL; waited += std::chrono::milliseconds(100)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                }
+            }
+        }
+
+        void ReplicationFollower::session(int sock) {
+            auto& manager = kvstore::StoreManager::instance();
+            setTimeout(sock, SO_RCVTIMEO, std::chrono::duration_cast<std::chrono::milliseconds>(LINK_TIMEOUT));
+
+            Status resume = status();
+            sendAll(sock, "SYNC " + (resume.synced ? resume.replicationId : std::string("?")) + " " +
+                std::to_string(resume.offset) + "\n");
+
+            LinkReader reader(sock);
+            std::istringstream reply(reader.line());
+            std::string verb;
+            std::string replicationId;
+            uint64_t offset = resume.offset;
+            reply >> verb >> replicationId;
+            if(verb == "FULLSYNC") {
+                reply >> offset;
+            }
+            else if(verb != "CONTINUE" || replicationId != resume.replicationId) {
+                throw std::runtime_error("unexpected SYNC reply: " + reply.str());
+            }
+
+            size_t frameSize = 0;
+            if(verb == "FULLSYNC") {
+                // Build the copy off to the side and publish each store in one step
+                std::unordered_map<std::string, std::unique_ptr<core::KeyValueStore>> staged;
+                while(true) {
+                    std::string payload = reader.frame(frameSize);
+                    persistence::BinaryReader frame(payload.data(), payload.size());
+                    const uint8_t kind = frame.u8();
+                    if(kind == ReplicationBacklog::FRAME_SNAPSHOT_END) break;
+                    if(kind != ReplicationBacklog::FRAME_RECORD) continue;
+                    auto& store = staged[frame.string()];
+                    if(!store) store = std::make_unique<core::KeyValueStore>();
+                    persistence::WriteAheadLog::applyRecord(payload.data() + frame.position(), frame.remaining(), *store);
+                }
+
+                // Stores the leader does not have are emptied; packed stores are left alone
+                for(const auto& [token, loadState] : manager.storeStates()) {
+                    auto& store = manager.getStore(token);
+                    if(!store.packedStore() && staged.find(token) == staged.end()) store.clear();
+                }
+                for(auto& [token, copy] : staged) {
+                    auto& store = manager.getStore(token);
+                    if(!store.packedStore()) store.swapContents(*copy);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                status_.linkUp = true;
+                status_.synced = true;
+                status_.replicationId = replicationId;
+                status_.offset = offset;
+                ++(verb == "FULLSYNC" ? status_.fullSyncs : status_.partialSyncs);
+            }
+
+            while(running_) {
+                std::string payload = reader.frame(frameSize);
+                persistence::BinaryReader frame(payload.data(), payload.size());
+                if(frame.u8() != ReplicationBacklog::FRAME_RECORD) continue;
+                auto& store = manager.getStore(frame.string());
+                if(!store.packedStore()) {
+                    persistence::WriteAheadLog::applyRecord(payload.data() + frame.position(), frame.remaining(), store);
+                }
+                // Only whole applied frames count, so a reconnect resumes on a frame boundary
+                std::lock_guard<std::mutex> lock(mtx_);
+                status_.offset += frameSize;
+            }
+        }
+
+    } // namespace net
+} // namespace kvspp
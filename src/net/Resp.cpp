@@ -0,0 +1,161 @@
+#include "kvstore/net/Resp.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <stdexcept>
+#include <type_traits>
+#include <variant>
+
+namespace kvspp {
+    namespace net {
+
+        namespace {
+            // Limits on what a request may announce before its data arrives
+            constexpr int64_t MAX_ARGS = 1 << 20;
+            constexpr int64_t MAX_BULK = int64_t(512) << 20;
+            constexpr size_t MAX_HEADER = 64 << 10;
+
+            std::string formatDouble(double value) {
+                char buffer[32];
+                std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+                return buffer;
+            }
+        }
+
+        size_t Resp::parseRequest(std::string_view input, std::vector<std::string>& args) {
+            args.clear();
+            size_t pos = 0;
+            // Reads "<prefix><number>\r\n" at pos; false while the line is incomplete
+            auto header = [&input, &pos](char prefix, int64_t& value) {
+                const size_t end = input.find('\n', pos);
+                if(end == std::string_view::npos) {
+                    if(input.size() - pos > MAX_HEADER) throw std::runtime_error("Protocol error: too big header");
+                    return false;
+                }
+                if(input[pos] != prefix) {
+                    throw std::runtime_error(std::string("Protocol error: expected '") + prefix + "', got '" + input[pos] + "'");
+                }
+                const char* first = input.data() + pos + 1;
+                const char* last = input.data() + end - 1;
+                if(end < pos + 3 || *last != '\r') throw std::runtime_error("Protocol error: malformed length");
+                auto [ptr, ec] = std::from_chars(first, last, value);
+                if(ec != std::errc() || ptr != last) throw std::runtime_error("Protocol error: malformed length");
+                pos = end + 1;
+                return true;
+            };
+
+            int64_t count = 0;
+            if(!header('*', count)) return 0;
+            if(count > MAX_ARGS) throw std::runtime_error("Protocol error: invalid multibulk length");
+            // An empty (or null) array asks for nothing
+            if(count <= 0) return pos;
+            args.reserve(static_cast<size_t>(std::min<int64_t>(count, 1024)));
+            for(int64_t i = 0; i < count; ++i) {
+                int64_t length = 0;
+                if(!header('$', length)) {
+                    args.clear();
+                    return 0;
+                }
+                if(length < 0 || length > MAX_BULK) throw std::runtime_error("Protocol error: invalid bulk length");
+                const size_t size = static_cast<size_t>(length);
+                if(input.size() - pos < size + 2) {
+                    args.clear();
+                    return 0;
+                }
+                if(input[pos + size] != '\r' || input[pos + size + 1] != '\n') {
+                    throw std::runtime_error("Protocol error: bulk string not terminated by CRLF");
+                }
+                args.emplace_back(input.substr(pos, size));
+                pos += size + 2;
+            }
+            return pos;
+        }
+
+        std::string Resp::simple(std::string_view text) {
+            std::string reply;
+            reply.reserve(text.size() + 3);
+            reply += '+';
+            reply += text;
+            reply += "\r\n";
+            return reply;
+        }
+
+        std::string Resp::error(std::string_view message) {
+            std::string reply;
+            reply.reserve(message.size() + 3);
+            reply += '-';
+            reply += message;
+            // An error is a single line
+            std::replace(reply.begin(), reply.end(), '\r', ' ');
+            std::replace(reply.begin(), reply.end(), '\n', ' ');
+            reply += "\r\n";
+            return reply;
+        }
+
+        std::string Resp::integer(int64_t value) {
+            return ":" + std::to_string(value) + "\r\n";
+        }
+
+        std::string Resp::bulk(std::string_view data) {
+            std::string reply = "$" + std::to_string(data.size()) + "\r\n";
+            reply.reserve(reply.size() + data.size() + 2);
+            reply += data;
+            reply += "\r\n";
+            return reply;
+        }
+
+        std::string Resp::null(int version) {
+            return version >= 3 ? "_\r\n" : "$-1\r\n";
+        }
+
+        std::string Resp::arrayHeader(size_t count) {
+            return "*" + std::to_string(count) + "\r\n";
+        }
+
+        std::string Resp::mapHeader(size_t count, int version) {
+            return version >= 3 ? "%" + std::to_string(count) + "\r\n" : arrayHeader(count * 2);
+        }
+
+        std::string Resp::attribute(const core::AttributeValue& value, int version) {
+            return std::visit([version](const auto& v) -> std::string {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr(std::is_same_v<T, std::string>) {
+                    return bulk(v);
+                }
+                else if constexpr(std::is_same_v<T, bool>) {
+                    if(version >= 3) return v ? "#t\r\n" : "#f\r\n";
+                    return bulk(v ? "true" : "false");
+                }
+                else if constexpr(std::is_same_v<T, int>) {
+                    return version >= 3 ? integer(v) : bulk(std::to_string(v));
+                }
+                else {
+                    return version >= 3 ? "," + formatDouble(v) + "\r\n" : bulk(formatDouble(v));
+                }
+            }, value);
+        }
+
+        std::string Resp::fromLine(std::string&& reply, int version) {
+            if(reply == "OK\n") return simple("OK");
+            if(reply == "NOT_FOUND\n") return null(version);
+            std::string_view line(reply);
+            if(!line.empty() && line.back() == '\n') line.remove_suffix(1);
+            if(line.compare(0, 6, "VALUE ") == 0) {
+                // The value is already in place: swap the prefix for the length header
+                const size_t length = line.size() - 6;
+                reply.pop_back();
+                reply.replace(0, 6, "$" + std::to_string(length) + "\r\n");
+                reply += "\r\n";
+                return std::move(reply);
+            }
+            if(line.compare(0, 6, "ERROR ") == 0) {
+                line.remove_prefix(6);
+                if(line.compare(0, 8, "LOADING ") == 0 || line.compare(0, 9, "READONLY ") == 0) return error(line);
+                return error("ERR " + std::string(line));
+            }
+            return bulk(line);
+        }
+
+    } // namespace net
+} // namespace kvspp
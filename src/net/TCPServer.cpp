@@ -1,22 +1,332 @@
 #include "kvstore/net/TCPServer.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include "kvstore/net/Resp.hpp"
+#include "kvstore/persistence/BinaryCodec.hpp"
+#include "kvstore/persistence/JsonWriter.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include "kvstore/utils/LazyFree.hpp"
+#include "kvstore/utils/MappedFile.hpp"
+#include <algorithm>
 #include <iostream>
+#include <fstream>
 #include <sstream>
-#include <sstream>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
 #include <cstring>
+#include <filesystem>
 #ifdef _WIN32
 #include <winsock2.h>
 #pragma comment(lib, "ws2_32.lib")
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
+#include <fcntl.h>
 #include <unistd.h>
 #endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/sendfile.h>
+#endif
 
 #define BUFFER_SIZE 4096
 
 namespace kvspp {
     namespace net {
 
+        namespace {
+            // send() until every byte is out; throws if the peer went away
+            void sendAll(int sock, const char* data, size_t length) {
+#ifdef MSG_NOSIGNAL
+                const int flags = MSG_NOSIGNAL;
+#else
+                const int flags = 0;
+#endif
+                while(length > 0) {
+#ifdef _WIN32
+                    int sent = send(sock, data, static_cast<int>(length), flags);
+#else
+                    ssize_t sent = send(sock, data, length, flags);
+#endif
+                    if(sent <= 0) throw std::runtime_error("connection closed while sending");
+                    data += sent;
+                    length -= static_cast<size_t>(sent);
+                }
+            }
+
+            // Send every queued reply on a blocking socket, as many chunks per writev as fit
+            void sendOutput(int sock, OutputBuffer& output) {
+#ifdef _WIN32
+                while(!output.empty()) {
+                    std::string_view chunk = output.front();
+                    sendAll(sock, chunk.data(), chunk.size());
+                    output.consume(chunk.size());
+                }
+#else
+#ifdef MSG_NOSIGNAL
+                const int flags = MSG_NOSIGNAL;
+#else
+                const int flags = 0;
+#endif
+                iovec vec[64];
+                while(!output.empty()) {
+                    msghdr message{};
+                    message.msg_iov = vec;
+                    message.msg_iovlen = output.gather(vec, 64);
+                    ssize_t sent = sendmsg(sock, &message, flags);
+                    if(sent < 0 && errno == EINTR) continue;
+                    if(sent <= 0) throw std::runtime_error("connection closed while sending");
+                    output.consume(static_cast<size_t>(sent));
+                }
+#endif
+            }
+
+            // Chunk size of file transfers that go through user space
+            constexpr size_t TRANSFER_CHUNK = 1 << 20;
+
+            // Copy size bytes of path to the socket through a buffer (platforms without sendfile)
+            void sendFileBuffered(int sock, const std::string& path, uint64_t offset, uint64_t size) {
+                std::ifstream in(path, std::ios::binary);
+                if(!in || !in.seekg(static_cast<std::streamoff>(offset))) throw std::runtime_error("cannot read " + path);
+                std::vector<char> buffer(TRANSFER_CHUNK);
+                while(size > 0) {
+                    size_t chunk = static_cast<size_t>(std::min<uint64_t>(size, buffer.size()));
+                    if(!in.read(buffer.data(), static_cast<std::streamsize>(chunk))) throw std::runtime_error("file shrank while sending");
+                    sendAll(sock, buffer.data(), chunk);
+                    size -= chunk;
+                }
+            }
+
+            // Send size bytes of path to the socket, without copying them through user space where possible
+            void sendFile(int sock, const std::string& path, uint64_t size) {
+#ifdef __linux__
+                int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if(fd < 0) throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+                off_t offset = 0;
+                while(static_cast<uint64_t>(offset) < size) {
+                    ssize_t sent = ::sendfile(sock, fd, &offset, static_cast<size_t>(std::min<uint64_t>(size - offset, 1u << 30)));
+                    if(sent > 0) continue;
+                    const int error = sent < 0 ? errno : 0;
+                    if(error == EINTR) continue;
+                    if((error == EINVAL || error == ENOSYS) && offset == 0) {
+                        ::close(fd);
+                        sendFileBuffered(sock, path, 0, size);
+                        return;
+                    }
+                    ::close(fd);
+                    throw std::runtime_error(sent == 0 ? "file shrank while sending" : std::strerror(error));
+                }
+                ::close(fd);
+#else
+                sendFileBuffered(sock, path, 0, size);
+#endif
+            }
+
+            // Receive size bytes from the socket into out through a buffer
+            void receiveBuffered(int sock, std::ofstream* out, uint64_t size) {
+                std::vector<char> buffer(TRANSFER_CHUNK);
+                while(size > 0) {
+                    int chunk = static_cast<int>(std::min<uint64_t>(size, buffer.size()));
+                    auto received = recv(sock, buffer.data(), chunk, 0);
+                    if(received <= 0) throw std::runtime_error("connection closed during upload");
+                    if(out && !out->write(buffer.data(), received)) throw std::runtime_error("cannot write upload");
+                    size -= static_cast<uint64_t>(received);
+                }
+            }
+
+            /**
+             * Write the first size bytes of the upload that follows a request line to path.
+             * Bytes already read along with the line are taken from buffered first; on Linux
+             * the rest moves from the socket to the file with splice(), through a pipe
+             */
+            void receiveFile(int sock, const std::string& path, uint64_t size, std::string& buffered) {
+                const size_t early = static_cast<size_t>(std::min<uint64_t>(size, buffered.size()));
+                {
+                    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                    if(!out || !out.write(buffered.data(), static_cast<std::streamsize>(early))) {
+                        throw std::runtime_error("cannot write " + path);
+                    }
+                    buffered.erase(0, early);
+                    size -= early;
+#ifndef __linux__
+                    receiveBuffered(sock, &out, size);
+                    if(!out.flush()) throw std::runtime_error("cannot write " + path);
+                    return;
+#endif
+                }
+#ifdef __linux__
+                // splice() refuses O_APPEND files, so the file offset is passed explicitly
+                int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+                loff_t written = static_cast<loff_t>(early);
+                int pipes[2];
+                if(fd < 0 || ::pipe2(pipes, O_CLOEXEC) < 0) {
+                    if(fd >= 0) ::close(fd);
+                    throw std::runtime_error("cannot write " + path + ": " + std::strerror(errno));
+                }
+                std::string failure;
+                bool spliced = false;
+                while(size > 0 && failure.empty()) {
+                    ssize_t in = ::splice(sock, nullptr, pipes[1], nullptr,
+                        static_cast<size_t>(std::min<uint64_t>(size, TRANSFER_CHUNK)), SPLICE_F_MOVE | SPLICE_F_MORE);
+                    if(in < 0 && errno == EINTR) continue;
+                    if(in < 0 && (errno == EINVAL || errno == ENOSYS) && !spliced) break;
+                    if(in <= 0) {
+                        failure = in == 0 ? "connection closed during upload" : std::strerror(errno);
+                        break;
+                    }
+                    spliced = true;
+                    size -= static_cast<uint64_t>(in);
+                    while(in > 0) {
+                        ssize_t out = ::splice(pipes[0], nullptr, fd, &written, static_cast<size_t>(in), SPLICE_F_MOVE | SPLICE_F_MORE);
+                        if(out < 0 && errno == EINTR) continue;
+                        if(out <= 0) {
+                            failure = "cannot write " + path + ": " + std::strerror(errno);
+                            break;
+                        }
+                        in -= out;
+                    }
+                }
+                ::close(pipes[0]);
+                ::close(pipes[1]);
+                ::close(fd);
+                if(!failure.empty()) throw std::runtime_error(failure);
+                if(size > 0) {
+                    // splice() is not supported for this socket or file system
+                    std::ofstream out(path, std::ios::binary | std::ios::app);
+                    receiveBuffered(sock, &out, size);
+                    if(!out.flush()) throw std::runtime_error("cannot write " + path);
+                }
+#endif
+            }
+
+            /**
+             * The records that follow BULKLOAD, up to the line holding a single "."
+             * (which is consumed; anything after it stays in buffered for the
+             * commands that follow)
+             */
+            class BulkStream {
+            public:
+                BulkStream(int sock, std::string& buffered) : sock_(sock), buffered_(buffered) {}
+
+                // Copy up to capacity record bytes into out; 0 once the "." line was read
+                size_t read(char* out, size_t capacity) {
+                    while(!done_) {
+                        // Bytes before the first line that is (or may still become) "." are records
+                        const size_t size = buffered_.size();
+                        size_t limit = size;
+                        size_t terminator = 0;
+                        size_t at = lineStart_ && size > 0 && buffered_[0] == '.' ? 0 : nextLineWithDot(0);
+                        while(at != std::string::npos) {
+                            std::string_view rest(buffered_.data() + at, std::min<size_t>(3, size - at));
+                            if(rest.size() >= 2 && rest[1] == '\n') terminator = 2;
+                            else if(rest == ".\r\n") terminator = 3;
+                            if(terminator || rest == "." || rest == ".\r") {
+                                limit = at;
+                                break;
+                            }
+                            at = nextLineWithDot(at);
+                        }
+                        if(limit > 0) {
+                            size_t length = std::min(limit, capacity);
+                            std::memcpy(out, buffered_.data(), length);
+                            lineStart_ = out[length - 1] == '\n';
+                            buffered_.erase(0, length);
+                            return length;
+                        }
+                        if(terminator) {
+                            buffered_.erase(0, terminator);
+                            done_ = true;
+                            break;
+                        }
+                        char chunk[BUFFER_SIZE];
+                        auto received = recv(sock_, chunk, sizeof(chunk), 0);
+                        if(received <= 0) throw std::runtime_error("connection closed during bulk load");
+                        buffered_.append(chunk, static_cast<size_t>(received));
+                    }
+                    return 0;
+                }
+
+                // Discard the records up to the "." line (after a failure)
+                void skipRest() {
+                    std::vector<char> scratch(TRANSFER_CHUNK);
+                    while(read(scratch.data(), scratch.size()) > 0) {}
+                }
+
+            private:
+                // Start of the next line after from that begins with '.'
+                size_t nextLineWithDot(size_t from) const {
+                    size_t found = buffered_.find("\n.", from);
+                    return found == std::string::npos ? found : found + 1;
+                }
+
+                int sock_;
+                std::string& buffered_;
+                bool lineStart_ = true;
+                bool done_ = false;
+            };
+
+#ifdef __linux__
+            // A further listening socket on port beside ones bound with SO_REUSEPORT; -1 on failure
+            int openReusePortListener(int port, int backlog) {
+                int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if(sock < 0) return -1;
+                sockaddr_in addr{};
+                addr.sin_family = AF_INET;
+                addr.sin_addr.s_addr = INADDR_ANY;
+                addr.sin_port = htons(port);
+                int on = 1;
+                if(setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+                    setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0 ||
+                    bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(sock, backlog) < 0) {
+                    int error = errno;
+                    close(sock);
+                    errno = error;
+                    return -1;
+                }
+                return sock;
+            }
+#endif
+
+            uint32_t fileChecksum(const std::string& path) {
+                utils::MappedFile file(path);
+                file.adviseSequential();
+                return utils::Checksum::crc32(file.data(), file.size());
+            }
+
+            std::string hex32(uint32_t value) {
+                char text[9];
+                std::snprintf(text, sizeof(text), "%08x", value);
+                return text;
+            }
+
+            // Glob match for KEYS: '*' matches any run of bytes, '?' any one byte
+            bool globMatch(std::string_view pattern, std::string_view text) {
+                size_t p = 0, t = 0;
+                size_t starAt = std::string_view::npos, resumeAt = 0;
+                while(t < text.size()) {
+                    if(p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+                        ++p;
+                        ++t;
+                    }
+                    else if(p < pattern.size() && pattern[p] == '*') {
+                        starAt = p++;
+                        resumeAt = t;
+                    }
+                    else if(starAt != std::string_view::npos) {
+                        p = starAt + 1;
+                        t = ++resumeAt;
+                    }
+                    else {
+                        return false;
+                    }
+                }
+                while(p < pattern.size() && pattern[p] == '*') ++p;
+                return p == pattern.size();
+            }
+        }
+
 
         TCPServer::TCPServer(int port)
             : port_(port), running_(false), serverSock_(-1) {
@@ -29,17 +339,71 @@ namespace kvspp {
         void TCPServer::start() {
             if(running_) return;
             running_ = true;
+            if(follower_) follower_->start();
+#ifdef __linux__
+            if(commandThreads_ > 0) commandPool_ = std::make_unique<utils::ThreadPool>(commandThreads_);
+            auto handler = [this](Connection& conn, bool mayBlock) { return serveConnection(conn, mayBlock); };
+#ifdef KVSPP_HAVE_IO_URING
+            if(ioUring_) {
+                try {
+                    for(size_t i = 0; i < reactorCount_; ++i) {
+                        loops_.push_back(std::make_unique<UringLoop>(handler, commandPool_.get()));
+                    }
+                }
+                catch(const std::exception& e) {
+                    std::cerr << "io_uring unavailable (" << e.what() << "), using epoll" << std::endl;
+                    // All reactors share one backend (the one INFO reports)
+                    loops_.clear();
+                    ioUring_ = false;
+                }
+            }
+#endif
+            while(loops_.size() < reactorCount_) {
+                loops_.push_back(std::make_unique<EventLoop>(handler, commandPool_.get()));
+            }
+#endif
             serverThread_ = std::thread(&TCPServer::run, this);
         }
 
+        void TCPServer::replicateFrom(const std::string& host, int port) {
+            follower_ = std::make_unique<ReplicationFollower>(host, port);
+        }
+
+        void TCPServer::setListenBacklog(int backlog) {
+            listenBacklog_ = backlog;
+        }
+
+        void TCPServer::setCommandThreads(size_t threads) {
+            commandThreads_ = threads;
+        }
+
+        void TCPServer::setReactors(size_t reactors) {
+            reactorCount_ = reactors == 0 ? 1 : reactors;
+        }
+
+        void TCPServer::setReactorCpus(const std::vector<int>& cpus) {
+            reactorCpus_ = cpus;
+        }
+
+        void TCPServer::setIoUring(bool enabled) {
+            ioUring_ = enabled;
+        }
+
         void TCPServer::stop() {
             running_ = false;
-#ifdef _WIN32
+#ifdef __linux__
+            for(auto& loop : loops_) loop->stop();
+#elif defined(_WIN32)
             if(serverSock_ != INVALID_SOCKET) closesocket(serverSock_);
 #else
             if(serverSock_ != -1) close(serverSock_);
 #endif
             if(serverThread_.joinable()) serverThread_.join();
+#ifdef __linux__
+            loops_.clear();
+            commandPool_.reset();
+#endif
+            if(follower_) follower_->stop();
         }
 
         bool TCPServer::isRunning() const {
@@ -56,18 +420,53 @@ namespace kvspp {
                 std::cerr << "Failed to create socket\n";
                 return;
             }
+#ifndef _WIN32
+            // sendfile() and splice() cannot be told MSG_NOSIGNAL; a client that goes away
+            // mid-transfer must fail the write, not kill the process
+            std::signal(SIGPIPE, SIG_IGN);
+#endif
             sockaddr_in serverAddr{};
             serverAddr.sin_family = AF_INET;
             serverAddr.sin_addr.s_addr = INADDR_ANY;
             serverAddr.sin_port = htons(port_);
+#ifndef _WIN32
+            // A restarted leader must be able to rebind while its followers' old
+            // connections are still in TIME_WAIT
+            int reuse = 1;
+            setsockopt(serverSock_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+#ifdef __linux__
+            // With SO_REUSEPORT each reactor listens on a socket of its own and the kernel
+            // spreads new connections over them; otherwise they all accept from this one
+            const bool reusePort = loops_.size() > 1 &&
+                setsockopt(serverSock_, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == 0;
+#endif
             if(bind(serverSock_, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
                 std::cerr << "Bind failed\n";
                 return;
             }
-            if(listen(serverSock_, 5) < 0) {
+            if(listen(serverSock_, listenBacklog_) < 0) {
                 std::cerr << "Listen failed\n";
                 return;
             }
+#ifdef __linux__
+            std::vector<int> listeners{ serverSock_ };
+            for(size_t i = 1; reusePort && i < loops_.size(); ++i) {
+                int sock = openReusePortListener(port_, listenBacklog_);
+                if(sock < 0) {
+                    std::cerr << "Reactor " << i << " shares a listening socket: " << std::strerror(errno) << "\n";
+                    break;
+                }
+                listeners.push_back(sock);
+            }
+            std::vector<std::thread> reactors;
+            for(size_t i = 1; i < loops_.size(); ++i) {
+                reactors.emplace_back([this, i, &listeners]() { runReactor(i, listeners); });
+            }
+            runReactor(0, listeners);
+            for(auto& reactor : reactors) reactor.join();
+            for(size_t i = 1; i < listeners.size(); ++i) close(listeners[i]);
+#else
             while(running_) {
                 sockaddr_in clientAddr;
 #ifdef _WIN32
@@ -90,6 +489,7 @@ namespace kvspp {
                 if(clientSock < 0) continue;
                 std::thread(&TCPServer::handleClient, this, clientSock).detach();
             }
+#endif
 #ifdef _WIN32
             closesocket(serverSock_);
             WSACleanup();
@@ -98,29 +498,352 @@ namespace kvspp {
 #endif
         }
 
+#ifdef __linux__
+        void TCPServer::runReactor(size_t index, const std::vector<int>& listeners) {
+            if(!reactorCpus_.empty()) {
+                const int cpu = reactorCpus_[index % reactorCpus_.size()];
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET(cpu, &cpus);
+                int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+                if(error != 0) {
+                    std::cerr << "Reactor " << index << " not pinned to CPU " << cpu << ": " << std::strerror(error) << "\n";
+                }
+            }
+            const bool shared = index >= listeners.size() || (index == 0 && listeners.size() < loops_.size());
+            loops_[index]->run(shared ? listeners[0] : listeners[index], shared);
+        }
+#endif
+
+        std::string TCPServer::handleBulkLoad(const std::vector<std::string>& tokens, const std::string& selectedToken,
+            int clientSock, std::string& buffered) {
+            BulkStream records(clientSock, buffered);
+            // Refusals still consume the records, so the connection stays in step
+            auto refuse = [&records](const std::string& response) {
+                records.skipRest();
+                return response;
+            };
+            kvspp::persistence::BulkLoader::Format format;
+            std::string mode = tokens.size() == 3 ? tokens[2] : "";
+            for(auto& c : mode) c = toupper(c);
+            if(tokens.size() < 2 || tokens.size() > 3 || !kvspp::persistence::BulkLoader::parseFormat(tokens[1], format) ||
+                (tokens.size() == 3 && mode != "REPLACE")) {
+                return refuse("ERROR Usage: BULKLOAD ndjson|csv [REPLACE], then the records and a line with a single '.'\n");
+            }
+            auto& manager = kvstore::StoreManager::instance();
+            if(selectedToken.empty()) return refuse("ERROR No store selected. Use SELECT <storetoken> first.\n");
+            if(!manager.awaitLoaded(selectedToken)) {
+                return refuse("ERROR LOADING Store '" + selectedToken + "' is still loading\n");
+            }
+            if(follower_) return refuse("ERROR READONLY This server is a follower of " + follower_->leader() + "\n");
+            if(manager.getStore(selectedToken).packedStore()) {
+                return refuse("ERROR READONLY Store '" + selectedToken + "' is served read-only from a packed file\n");
+            }
+
+            try {
+                uint64_t loaded = manager.bulkLoad(selectedToken, format, mode == "REPLACE",
+                    [&records](char* out, size_t capacity) { return records.read(out, capacity); });
+                return "LOADED " + std::to_string(loaded) + "\n";
+            }
+            catch(const std::exception& e) {
+                // A dropped connection ends here too; skipRest then fails the same way
+                try {
+                    records.skipRest();
+                }
+                catch(const std::exception&) {
+                    throw std::runtime_error(e.what());
+                }
+                return std::string("ERROR ") + e.what() + "\n";
+            }
+        }
+
+        std::string TCPServer::handleRestore(const std::vector<std::string>& tokens, const std::string& selectedToken,
+            int clientSock, std::string& buffered) {
+            const std::string usage = "ERROR Usage: RESTORESTORE json|kvs <bytes> <crc32>\n";
+            if(tokens.size() != 4) return usage;
+            std::string format = tokens[1];
+            for(auto& c : format) c = tolower(c);
+            uint64_t size = 0;
+            uint32_t crc = 0;
+            try {
+                size_t used = 0;
+                size = std::stoull(tokens[2], &used);
+                if(used != tokens[2].size()) return usage;
+                unsigned long value = std::stoul(tokens[3], &used, 16);
+                if(used != tokens[3].size() || value > UINT32_MAX) return usage;
+                crc = static_cast<uint32_t>(value);
+            }
+            catch(const std::exception&) {
+                return usage;
+            }
+            if(format != "json" && format != "kvs") return usage;
+
+            // From here on the payload is framed, so refusals skip it and keep the connection
+            auto refuse = [&](const std::string& response) {
+                const size_t early = static_cast<size_t>(std::min<uint64_t>(size, buffered.size()));
+                buffered.erase(0, early);
+                receiveBuffered(clientSock, nullptr, size - early);
+                return response;
+            };
+            auto& manager = kvstore::StoreManager::instance();
+            if(selectedToken.empty()) return refuse("ERROR No store selected. Use SELECT <storetoken> first.\n");
+            if(!manager.awaitLoaded(selectedToken)) {
+                return refuse("ERROR LOADING Store '" + selectedToken + "' is still loading\n");
+            }
+            if(follower_) return refuse("ERROR READONLY This server is a follower of " + follower_->leader() + "\n");
+            if(manager.getStore(selectedToken).packedStore()) {
+                return refuse("ERROR READONLY Store '" + selectedToken + "' is served read-only from a packed file\n");
+            }
+
+            const std::string path = manager.restorePath(selectedToken, format == "kvs"
+                ? kvspp::persistence::SnapshotFormat::BINARY : kvspp::persistence::SnapshotFormat::JSON);
+            std::error_code ec;
+            try {
+                receiveFile(clientSock, path, size, buffered);
+            }
+            catch(const std::exception& e) {
+                std::filesystem::remove(path, ec);
+                throw std::runtime_error(std::string("upload failed: ") + e.what());
+            }
+            try {
+                if(fileChecksum(path) != crc) {
+                    std::filesystem::remove(path, ec);
+                    return "ERROR Restore failed: checksum mismatch\n";
+                }
+                manager.restoreStore(selectedToken, path);
+            }
+            catch(const std::exception& e) {
+                std::filesystem::remove(path, ec);
+                return std::string("ERROR Restore failed: ") + e.what() + "\n";
+            }
+            return "OK\n";
+        }
+
 #include <stdexcept>
+        HandlerResult TCPServer::serveConnection(Connection& conn, bool mayBlock) {
+            // Replies so far go out before a command that writes to the socket itself
+            auto flushOutput = [&conn]() {
+                sendOutput(conn.sock, conn.output);
+            };
+            if(conn.binary) return serveBinary(conn, mayBlock);
+            if(conn.resp < 0 && !conn.input.empty() && conn.input[0] == BinaryProtocol::MAGIC) {
+                // The binary protocol's HELLO (no line or RESP request starts with this byte)
+                if(conn.input.size() < BinaryProtocol::HELLO_SIZE) return HandlerResult::DONE;
+                const uint8_t version = static_cast<uint8_t>(conn.input[3]);
+                if(conn.input.compare(1, 2, "KV") != 0 || version == 0) {
+                    conn.input.clear();
+                    return HandlerResult::CLOSE;
+                }
+                conn.output += BinaryProtocol::hello(std::min(version, BinaryProtocol::VERSION));
+                conn.input.erase(0, BinaryProtocol::HELLO_SIZE);
+                conn.resp = 0;
+                conn.binary = true;
+                return serveBinary(conn, mayBlock);
+            }
+            // Every complete request runs back to back, parsed in place. Consumed input is
+            // dropped once per batch, and a partial line is scanned only once however
+            // many reads it takes to arrive.
+            size_t start = 0;
+            std::vector<std::string> tokens;
+            while(start < conn.input.size()) {
+                size_t next;
+                if(conn.input[start] == '*') {
+                    // A RESP request (no line protocol command starts with '*')
+                    size_t used;
+                    try {
+                        used = Resp::parseRequest(std::string_view(conn.input).substr(start), tokens);
+                    }
+                    catch(const std::exception& e) {
+                        // The stream cannot be resynchronized
+                        conn.output += Resp::error(std::string("ERR ") + e.what());
+                        conn.input.clear();
+                        conn.scanned = 0;
+                        return HandlerResult::CLOSE;
+                    }
+                    if(used == 0) break;
+                    next = start + used;
+                    conn.scanned = 0;
+                    if(conn.resp <= 0) conn.resp = 2;
+                    if(tokens.empty()) {
+                        start = next;
+                        continue;
+                    }
+                }
+                else {
+                    const size_t pos = conn.input.find('\n', std::max(start, conn.scanned));
+                    if(pos == std::string::npos) break;
+                    std::string_view line(conn.input.data() + start, pos - start);
+                    // Trim trailing \r if present
+                    if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                    tokens = splitCommand(line);
+                    next = pos + 1;
+                }
+                std::string cmd = tokens.empty() ? "" : tokens[0];
+                for(auto& c : cmd) c = toupper(c);
+                // A client opening with an inline PING or HELLO (as Redis tools do) speaks RESP
+                if(conn.resp < 0) conn.resp = cmd == "PING" || cmd == "HELLO" ? 2 : 0;
+                // Commands that stream over the socket, or wait for a store to load, get a thread of their own
+                const bool ownsSocket = conn.resp == 0 && (cmd == "RESTORESTORE" || cmd == "BULKLOAD" ||
+                    cmd == "SYNC" || cmd == "JSON" || cmd == "DUMPSTORE");
+                if(!mayBlock && (ownsSocket || (cmd != "QUIT" && !conn.selectedToken.empty() &&
+                    kvstore::StoreManager::instance().loadWouldBlock(conn.selectedToken)))) {
+                    conn.input.erase(0, start);
+                    conn.scanned = 0;
+                    return HandlerResult::BLOCKING;
+                }
+                start = next;
+                if(ownsSocket) {
+                    // The payload follows the line; what already arrived stays in input
+                    conn.input.erase(0, start);
+                    start = 0;
+                    conn.scanned = 0;
+                    flushOutput();
+                }
+
+                bool closing = false;
+                if(conn.resp > 0) {
+                    try {
+                        conn.output += handleResp(tokens, conn);
+                    }
+                    catch(const kvspp::exceptions::KVStoreException& e) {
+                        // A rejected value (say, of the wrong type) fails the command, not the connection
+                        conn.output += Resp::error(std::string("ERR ") + e.what());
+                    }
+                    closing = cmd == "QUIT";
+                }
+                else if(cmd == "RESTORESTORE") {
+                    try {
+                        std::string reply = handleRestore(tokens, conn.selectedToken, conn.sock, conn.input);
+                        // Without a valid header the payload cannot be told apart from commands
+                        closing = reply.compare(0, 12, "ERROR Usage:") == 0;
+                        conn.output += std::move(reply);
+                    }
+                    catch(const std::exception& e) {
+                        conn.output += std::string("ERROR Restore failed: ") + e.what() + "\n";
+                        closing = true;
+                    }
+                }
+                else if(cmd == "BULKLOAD") {
+                    // Records follow the line up to a "." line
+                    try {
+                        conn.output += handleBulkLoad(tokens, conn.selectedToken, conn.sock, conn.input);
+                    }
+                    catch(const std::exception&) {
+                        closing = true;
+                    }
+                }
+                else {
+                    try {
+                        conn.output += handleCommand(tokens, conn.selectedToken, conn.sock);
+                    }
+                    catch(const kvspp::exceptions::KVStoreException& e) {
+                        // As in RESP and binary: the command fails, the connection stays
+                        conn.output += std::string("ERROR ") + e.what() + "\n";
+                    }
+                    // QUIT ends the connection; a SYNC connection served a follower until it went away
+                    closing = cmd == "QUIT" || cmd == "SYNC";
+                }
+                if(closing) {
+                    conn.input.clear();
+                    conn.scanned = 0;
+                    return HandlerResult::CLOSE;
+                }
+            }
+            conn.input.erase(0, start);
+            conn.scanned = conn.input.size();
+            return HandlerResult::DONE;
+        }
+
+        HandlerResult TCPServer::serveBinary(Connection& conn, bool mayBlock) {
+            using Header = BinaryProtocol::Header;
+            using Opcode = BinaryProtocol::Opcode;
+            constexpr size_t HEADER_SIZE = BinaryProtocol::HEADER_SIZE;
+            auto& manager = kvstore::StoreManager::instance();
+            if(mayBlock && !conn.deferred.empty()) {
+                // The replies of the requests that went ahead are sent before waiting for the store
+                sendOutput(conn.sock, conn.output);
+                std::string deferred;
+                deferred.swap(conn.deferred);
+                const std::string selected = conn.selectedToken;
+                for(size_t at = 0; at < deferred.size();) {
+                    const Header header = BinaryProtocol::decode(deferred.data() + at);
+                    std::string_view key(deferred.data() + at + HEADER_SIZE, header.keyLength);
+                    std::string_view value(key.data() + key.size(), header.valueLength);
+                    conn.output += handleBinary(header, key, value, conn);
+                    at += HEADER_SIZE + header.keyLength + header.valueLength;
+                }
+                conn.selectedToken = selected;
+            }
+            // Requests to a store that is still loading are held back, together with every
+            // later request to that store, while the requests to other stores go ahead; the
+            // held ones run on the connection's own thread once the batch is done.
+            std::vector<std::string> holding;
+            size_t start = 0;
+            while(conn.input.size() - start >= HEADER_SIZE) {
+                const Header header = BinaryProtocol::decode(conn.input.data() + start);
+                if(header.keyLength > BinaryProtocol::MAX_KEY_LENGTH || header.valueLength > BinaryProtocol::MAX_VALUE_LENGTH) {
+                    conn.output += BinaryProtocol::reply(header, BinaryProtocol::Status::FAILED, "Request too large");
+                    conn.input.clear();
+                    return HandlerResult::CLOSE;
+                }
+                const size_t length = HEADER_SIZE + header.keyLength + header.valueLength;
+                if(conn.input.size() - start < length) break;
+                std::string_view key(conn.input.data() + start + HEADER_SIZE, header.keyLength);
+                std::string_view value(key.data() + key.size(), header.valueLength);
+                const std::string& store = conn.selectedToken;
+                bool held = false;
+                if(!mayBlock && header.opcode != Opcode::PING && header.opcode != Opcode::SELECT && !store.empty()) {
+                    if(std::find(holding.begin(), holding.end(), store) != holding.end()) {
+                        held = true;
+                    }
+                    else if(manager.loadWouldBlock(store)) {
+                        // Keys the loading snapshot's key filter rules out are answered at once
+                        const bool read = header.opcode == Opcode::GET || header.opcode == Opcode::EXISTS ||
+                            header.opcode == Opcode::GET_RECORD;
+                        held = !read || !manager.definitelyAbsent(store, std::string(key));
+                    }
+                }
+                if(held) {
+                    if(holding.empty() || holding.back() != store) {
+                        // Replayed with the store it was sent to
+                        Header select;
+                        select.opcode = Opcode::SELECT;
+                        select.flags = BinaryProtocol::FLAG_NOREPLY;
+                        select.keyLength = static_cast<uint32_t>(store.size());
+                        BinaryProtocol::encode(conn.deferred, select);
+                        conn.deferred += store;
+                        holding.push_back(store);
+                    }
+                    conn.deferred.append(conn.input, start, length);
+                }
+                else {
+                    conn.output += handleBinary(header, key, value, conn);
+                }
+                start += length;
+            }
+            conn.input.erase(0, start);
+            return conn.deferred.empty() ? HandlerResult::DONE : HandlerResult::BLOCKING;
+        }
+
         void TCPServer::handleClient(int clientSock) {
+            Connection conn;
+            conn.sock = clientSock;
             char buffer[BUFFER_SIZE];
-            std::string partial;
-            std::string selectedToken;
-            while(true) {
+            HandlerResult result = HandlerResult::DONE;
+            while(result == HandlerResult::DONE) {
 #ifdef _WIN32
-                int bytes = recv(clientSock, buffer, BUFFER_SIZE - 1, 0);
+                int bytes = recv(clientSock, buffer, BUFFER_SIZE, 0);
 #else
-                ssize_t bytes = recv(clientSock, buffer, BUFFER_SIZE - 1, 0);
+                ssize_t bytes = recv(clientSock, buffer, BUFFER_SIZE, 0);
 #endif
                 if(bytes <= 0) break;
-                buffer[bytes] = '\0';
-                partial += buffer;
-                size_t pos;
-                while((pos = partial.find('\n')) != std::string::npos) {
-                    std::string line = partial.substr(0, pos);
-                    partial.erase(0, pos + 1);
-                    // Trim trailing \r if present
-                    if(!line.empty() && line.back() == '\r') line.pop_back();
-                    std::string response = handleCommand(line, selectedToken);
-                    send(clientSock, response.c_str(), response.size(), 0);
-                    if(line == "QUIT") return;
+                conn.input.append(buffer, static_cast<size_t>(bytes));
+                try {
+                    result = serveConnection(conn, true);
+                    sendOutput(clientSock, conn.output);
+                }
+                catch(const std::exception&) {
+                    break;
                 }
             }
 #ifdef _WIN32
@@ -136,7 +859,7 @@ namespace kvspp {
 } // namespace kvspp
 
 // Definitions must be outside the namespace block
-std::vector<std::string> kvspp::net::TCPServer::splitCommand(const std::string& line) {
+std::vector<std::string> kvspp::net::TCPServer::splitCommand(std::string_view line) {
     std::vector<std::string> tokens;
     std::string token;
     bool inQuotes = false;
@@ -152,8 +875,18 @@ std::vector<std::string> kvspp::net::TCPServer::splitCommand(const std::string&
     return tokens;
 }
 
-std::string kvspp::net::TCPServer::handleCommand(const std::string& line, std::string& selectedToken) {
-    auto tokens = splitCommand(line);
+std::string kvspp::net::TCPServer::checkAvailable(const std::string& cmd, const std::string& selectedToken) {
+    // Hold back (or refuse) requests to a store that is still being preloaded
+    if(!selectedToken.empty() && cmd != "QUIT" && !kvstore::StoreManager::instance().awaitLoaded(selectedToken)) {
+        return "ERROR LOADING Store '" + selectedToken + "' is still loading\n";
+    }
+    if(follower_ && (cmd == "SET" || cmd == "DELETE" || cmd == "UNLINK" || cmd == "FLUSH" || cmd == "LOAD" || cmd == "AUTOSAVE")) {
+        return "ERROR READONLY This server is a follower of " + follower_->leader() + "\n";
+    }
+    return "";
+}
+
+std::string kvspp::net::TCPServer::handleCommand(const std::vector<std::string>& tokens, std::string& selectedToken, int clientSock) {
     if(tokens.empty()) return "ERROR Empty command\n";
     std::string cmd = tokens[0];
     for(auto& c : cmd) c = toupper(c);
@@ -162,49 +895,153 @@ std::string kvspp::net::TCPServer::handleCommand(const std::string& line, std::s
         selectedToken = tokens[1];
         return "OK\n";
     }
+    if(cmd == "SYNC") {
+        // A follower (see ReplicationLeader); the connection only streams to it from here on
+        if(tokens.size() != 3) return "ERROR Usage: SYNC <replicationid>|? <offset>\n";
+        uint64_t offset = 0;
+        try {
+            offset = std::stoull(tokens[2]);
+        }
+        catch(const std::exception&) {
+            return "ERROR Usage: SYNC <replicationid>|? <offset>\n";
+        }
+        ReplicationLeader::serve(clientSock, tokens[1], offset);
+        return "";
+    }
+    if(cmd == "STORES") {
+        if(tokens.size() != 1) return "ERROR Usage: STORES\n";
+        std::string response = "STORES";
+        for(const auto& [token, state] : kvstore::StoreManager::instance().storeStates()) {
+            const char* name = state == kvstore::StoreManager::LoadState::LOADING ? "loading"
+                : state == kvstore::StoreManager::LoadState::FAILED ? "failed" : "ready";
+            response += " " + token + ":" + name;
+        }
+        return response + "\n";
+    }
+    // Keys the loading snapshot's key filter rules out need not wait for the load
+    if((cmd == "GET" || cmd == "EXISTS") && tokens.size() == 2 && !selectedToken.empty() &&
+        kvstore::StoreManager::instance().definitelyAbsent(selectedToken, tokens[1])) {
+        return "NOT_FOUND\n";
+    }
+    std::string refusal = checkAvailable(cmd, selectedToken);
+    if(!refusal.empty()) return refusal;
+    if(cmd == "INFO") {
+        if(tokens.size() != 1) return "ERROR Usage: INFO\n";
+        std::string response = "INFO";
+        if(!selectedToken.empty()) {
+            auto& selected = kvstore::StoreManager::instance().getStore(selectedToken);
+            response += " keys:" + std::to_string(selected.size());
+            response += " memory_bytes:" + std::to_string(selected.memoryUsage());
+            if(auto* storage = selected.logStructured()) {
+                auto disk = storage->stats();
+                response += " disk_files:" + std::to_string(disk.files);
+                response += " disk_bytes:" + std::to_string(disk.diskBytes);
+                response += " disk_stale_bytes:" + std::to_string(disk.staleBytes);
+                response += " disk_merges:" + std::to_string(disk.merges);
+            }
+            else if(auto* packed = selected.packedStore()) {
+                response += " packed_file_bytes:" + std::to_string(packed->fileSize());
+            }
+            else if(uint32_t coldAfter = selected.tieringThreshold()) {
+                auto tier = selected.tierStats();
+                const uint64_t accesses = tier.hotHits + tier.coldHits + tier.misses;
+                auto ratio = [accesses](uint64_t hits) {
+                    char buffer[32];
+                    std::snprintf(buffer, sizeof(buffer), "%.4f", accesses ? static_cast<double>(hits) / accesses : 0.0);
+                    return std::string(buffer);
+                };
+                response += " tier_cold_after:" + std::to_string(coldAfter);
+                response += " tier_hot_keys:" + std::to_string(tier.hotKeys);
+                response += " tier_cold_keys:" + std::to_string(tier.coldKeys);
+                response += " tier_cold_bytes:" + std::to_string(tier.coldBytes);
+                response += " tier_cold_file_bytes:" + std::to_string(tier.coldFileBytes);
+                response += " tier_demotions:" + std::to_string(tier.demotions);
+                response += " tier_hot_hits:" + std::to_string(tier.hotHits);
+                response += " tier_cold_hits:" + std::to_string(tier.coldHits);
+                response += " tier_misses:" + std::to_string(tier.misses);
+                response += " tier_hot_hit_ratio:" + ratio(tier.hotHits);
+                response += " tier_cold_hit_ratio:" + ratio(tier.coldHits);
+            }
+        }
+        auto lazyFree = kvspp::utils::LazyFree::instance().stats();
+        response += " lazyfree_pending_bytes:" + std::to_string(lazyFree.pendingBytes);
+        response += " lazyfree_pending_objects:" + std::to_string(lazyFree.pendingObjects);
+        response += " lazyfree_freed_bytes:" + std::to_string(lazyFree.freedBytes);
+        response += " lazyfree_freed_objects:" + std::to_string(lazyFree.freedObjects);
+        if(follower_) {
+            auto replica = follower_->status();
+            response += " role:follower leader:" + follower_->leader();
+            response += std::string(" link:") + (replica.linkUp ? "up" : "down");
+            if(replica.synced) response += " repl_id:" + replica.replicationId;
+            response += " repl_offset:" + std::to_string(replica.offset);
+            response += " full_syncs:" + std::to_string(replica.fullSyncs);
+            response += " partial_syncs:" + std::to_string(replica.partialSyncs);
+        }
+        else {
+            response += " role:leader followers:" + std::to_string(ReplicationLeader::followers());
+            if(auto backlog = kvstore::StoreManager::instance().replicationBacklog()) {
+                response += " repl_id:" + backlog->id();
+                response += " repl_offset:" + std::to_string(backlog->endOffset());
+                response += " repl_backlog_bytes:" + std::to_string(backlog->capacity());
+            }
+        }
+#ifdef __linux__
+        response += " reactors:" + std::to_string(loops_.size());
+        response += std::string(" reactor_backend:") + (ioUring_ ? "io_uring" : "epoll");
+        for(size_t i = 0; i < loops_.size(); ++i) {
+            auto stats = loops_[i]->stats();
+            const std::string prefix = " reactor" + std::to_string(i) + "_";
+            if(!reactorCpus_.empty()) response += prefix + "cpu:" + std::to_string(reactorCpus_[i % reactorCpus_.size()]);
+            response += prefix + "connections:" + std::to_string(stats.connections);
+            response += prefix + "accepted:" + std::to_string(stats.accepted);
+            response += prefix + "batches:" + std::to_string(stats.batches);
+            response += prefix + "bytes_in:" + std::to_string(stats.bytesIn);
+            response += prefix + "bytes_out:" + std::to_string(stats.bytesOut);
+        }
+#endif
+        return response + "\n";
+    }
     if(cmd == "AUTOSAVE") {
         if(tokens.size() != 2) return "ERROR Usage: AUTOSAVE ON|OFF\n";
         std::string val = tokens[1];
         for(auto& c : val) c = toupper(c);
         if(selectedToken.empty()) return "ERROR No store selected. Use SELECT <storetoken> first.\n";
-        auto& store = kvstore::StoreManager::instance().getStore(selectedToken);
-        bool statusSaved = false;
-        if(val == "ON") {
-            store.setAutosave(true);
-            statusSaved = true;
-        }
-        else if(val == "OFF") {
-            store.setAutosave(false);
-            statusSaved = true;
+        if(val != "ON" && val != "OFF") return "ERROR Usage: AUTOSAVE ON|OFF\n";
+        try {
+            // Writes an initial snapshot and attaches (or drops) the store's write-ahead log
+            kvstore::StoreManager::instance().setAutosave(selectedToken, val == "ON");
         }
-        if(statusSaved) {
-            try {
-                kvstore::StoreManager::instance().saveStore(selectedToken, selectedToken + ".json");
-            }
-            catch(const std::exception& e) {
-                return std::string("ERROR Autosave (initial save) failed: ") + e.what() + "\n";
-            }
-            return "OK\n";
+        catch(const std::exception& e) {
+            return std::string("ERROR Autosave (initial save) failed: ") + e.what() + "\n";
         }
-        else return "ERROR Usage: AUTOSAVE ON|OFF\n";
+        return "OK\n";
     }
     if(selectedToken.empty()) {
         return "ERROR No store selected. Use SELECT <storetoken> first.\n";
     }
     auto& store = kvstore::StoreManager::instance().getStore(selectedToken);
+    if(store.packedStore() && (cmd == "SET" || cmd == "DELETE" || cmd == "UNLINK" || cmd == "FLUSH" || cmd == "LOAD")) {
+        return "ERROR READONLY Store '" + selectedToken + "' is served read-only from a packed file\n";
+    }
     if(cmd == "GET") {
         if(tokens.size() != 2) return "ERROR Usage: GET <key>\n";
-        const kvspp::core::ValueObject* val = store.get(tokens[1]);
-        if(!val) return "NOT_FOUND\n";
         // Return only the value string, not the 'value' key
-        return "VALUE " + val->getValueString() + "\n";
+        std::string reply = "VALUE ";
+        if(!store.get(tokens[1], [&reply](const kvspp::core::ValueObject& val) { reply += val.getValueString(); })) {
+            return "NOT_FOUND\n";
+        }
+        return reply + "\n";
+    }
+    else if(cmd == "EXISTS") {
+        if(tokens.size() != 2) return "ERROR Usage: EXISTS <key>\n";
+        return store.contains(tokens[1]) ? "OK\n" : "NOT_FOUND\n";
     }
     else if(cmd == "SET") {
         if(tokens.size() < 3) return "ERROR Usage: SET <key> <value>\n";
         store.put(tokens[1], { {"value", tokens[2]} });
         if(store.getAutosave()) {
             try {
-                kvstore::StoreManager::instance().saveStore(selectedToken, selectedToken + ".json");
+                kvstore::StoreManager::instance().commitAutosave(selectedToken);
             }
             catch(const std::exception& e) {
                 return std::string("ERROR Autosave failed: ") + e.what() + "\n";
@@ -217,7 +1054,21 @@ std::string kvspp::net::TCPServer::handleCommand(const std::string& line, std::s
         bool removed = store.deleteKey(tokens[1]);
         if(store.getAutosave()) {
             try {
-                kvstore::StoreManager::instance().saveStore(selectedToken, selectedToken + ".json");
+                kvstore::StoreManager::instance().commitAutosave(selectedToken);
+            }
+            catch(const std::exception& e) {
+                return std::string("ERROR Autosave failed: ") + e.what() + "\n";
+            }
+        }
+        return removed ? "OK\n" : "NOT_FOUND\n";
+    }
+    else if(cmd == "UNLINK") {
+        // Like DELETE, but the value is always freed by the background thread
+        if(tokens.size() != 2) return "ERROR Usage: UNLINK <key>\n";
+        bool removed = store.deleteKey(tokens[1], true);
+        if(store.getAutosave()) {
+            try {
+                kvstore::StoreManager::instance().commitAutosave(selectedToken);
             }
             catch(const std::exception& e) {
                 return std::string("ERROR Autosave failed: ") + e.what() + "\n";
@@ -225,6 +1076,46 @@ std::string kvspp::net::TCPServer::handleCommand(const std::string& line, std::s
         }
         return removed ? "OK\n" : "NOT_FOUND\n";
     }
+    else if(cmd == "FLUSH") {
+        if(tokens.size() > 2) return "ERROR Usage: FLUSH [ASYNC|SYNC]\n";
+        std::string mode = tokens.size() == 2 ? tokens[1] : "ASYNC";
+        for(auto& c : mode) c = toupper(c);
+        if(mode != "ASYNC" && mode != "SYNC") return "ERROR Usage: FLUSH [ASYNC|SYNC]\n";
+        store.clear(mode == "ASYNC");
+        if(store.getAutosave()) {
+            try {
+                kvstore::StoreManager::instance().commitAutosave(selectedToken);
+            }
+            catch(const std::exception& e) {
+                return std::string("ERROR Autosave failed: ") + e.what() + "\n";
+            }
+        }
+        return "OK\n";
+    }
+    else if(cmd == "TIERING") {
+        if(tokens.size() != 2) return "ERROR Usage: TIERING <seconds>|OFF\n";
+        std::string val = tokens[1];
+        for(auto& c : val) c = toupper(c);
+        uint32_t coldAfter = 0;
+        if(val != "OFF") {
+            try {
+                size_t used = 0;
+                unsigned long seconds = std::stoul(val, &used);
+                if(used != val.size() || seconds > UINT32_MAX) throw std::invalid_argument(val);
+                coldAfter = static_cast<uint32_t>(seconds);
+            }
+            catch(const std::exception&) {
+                return "ERROR Usage: TIERING <seconds>|OFF\n";
+            }
+        }
+        try {
+            kvstore::StoreManager::instance().setTiering(selectedToken, coldAfter);
+        }
+        catch(const std::exception& e) {
+            return std::string("ERROR ") + e.what() + "\n";
+        }
+        return "OK\n";
+    }
     else if(cmd == "SAVE") {
         if(tokens.size() != 2) return "ERROR Usage: SAVE <filename>\n";
         std::string filename = tokens[1];
@@ -236,6 +1127,17 @@ std::string kvspp::net::TCPServer::handleCommand(const std::string& line, std::s
             return std::string("ERROR Save failed: ") + e.what() + "\n";
         }
     }
+    else if(cmd == "BGSAVE") {
+        if(tokens.size() != 1) return "ERROR Usage: BGSAVE\n";
+        if(!kvstore::StoreManager::instance().backgroundSave(selectedToken)) {
+            return "ERROR Background save already in progress\n";
+        }
+        return "OK\n";
+    }
+    else if(cmd == "LASTSAVE") {
+        if(tokens.size() != 1) return "ERROR Usage: LASTSAVE\n";
+        return "LASTSAVE " + std::to_string(kvstore::StoreManager::instance().lastSave(selectedToken)) + "\n";
+    }
     else if(cmd == "LOAD") {
         if(tokens.size() != 2) return "ERROR Usage: LOAD <filename>\n";
         std::string filename = tokens[1];
@@ -257,31 +1159,51 @@ std::string kvspp::net::TCPServer::handleCommand(const std::string& line, std::s
         return response;
     }
     else if(cmd == "JSON") {
-     // Return the stringified JSON of the current selected store
+     // Stream the single-line JSON of the current selected store straight to the socket
+        bool started = false;
+        try {
+            kvspp::persistence::JsonWriter writer([clientSock, &started](const char* data, size_t length) {
+                started = true;
+                sendAll(clientSock, data, length);
+            });
+            writer.store(store, kvspp::persistence::JsonWriter::Style::COMPACT);
+            writer.raw("\n");
+            writer.flush();
+            return "";
+        }
+        catch(const std::exception& e) {
+            // Terminate a partially sent document before reporting the error
+            return std::string(started ? "\n" : "") + "ERROR JSON failed: " + e.what() + "\n";
+        }
+    }
+    else if(cmd == "DUMPSTORE") {
+        // The store's snapshot file, sent as is: DUMP <format> <bytes> <crc32>, then the bytes
+        if(tokens.size() != 1) return "ERROR Usage: DUMPSTORE\n";
+        kvstore::StoreManager::Dump dump;
         try {
-            std::ostringstream json;
-            json << "{";
-            json << "\"store\": {";
-            auto keys = store.keys();
-            size_t count = 0;
-            size_t total = keys.size();
-            for(size_t i = 0; i < total; ++i) {
-                const auto& key = keys[i];
-                const auto* valueObj = store.get(key);
-                if(valueObj) {
-                    if(count > 0) json << ",";
-                    json << "\"" << key << "\":{\"value\":\"" << valueObj->getValueString() << "\"}";
-                    ++count;
-                }
-            }
-            if(count > 0) json << ",";
-            json << "\"autosave\":" << (store.hasAutosave() ? (store.getAutosave() ? "true" : "false") : "false");
-            json << "}}";
-            return json.str() + "\n";
+            dump = kvstore::StoreManager::instance().dumpStore(selectedToken);
         }
         catch(const std::exception& e) {
-            return std::string("ERROR JSON failed: ") + e.what() + "\n";
+            return std::string("ERROR Dump failed: ") + e.what() + "\n";
+        }
+        const std::string format = kvspp::persistence::PersistenceManager::formatForPath(dump.path) ==
+            kvspp::persistence::SnapshotFormat::BINARY ? "kvs" : "json";
+        try {
+            std::string header = "DUMP " + format + " " + std::to_string(dump.size) + " " + hex32(dump.crc32) + "\n";
+            sendAll(clientSock, header.data(), header.size());
+            sendFile(clientSock, dump.path, dump.size);
         }
+        catch(const std::exception&) {
+            // The client cannot resynchronize with a short payload; drop the connection
+#ifdef _WIN32
+            shutdown(clientSock, SD_BOTH);
+#else
+            shutdown(clientSock, SHUT_RDWR);
+#endif
+        }
+        std::error_code ec;
+        std::filesystem::remove(dump.path, ec);
+        return "";
     }
     else if(cmd == "QUIT") {
         return "OK\n";
@@ -290,3 +1212,243 @@ std::string kvspp::net::TCPServer::handleCommand(const std::string& line, std::s
         return "ERROR Unknown command\n";
     }
 }
+
+std::string kvspp::net::TCPServer::handleResp(const std::vector<std::string>& tokens, Connection& conn) {
+    std::string cmd = tokens[0];
+    for(auto& c : cmd) c = toupper(c);
+    const int version = conn.resp;
+    auto wrongArguments = [&tokens]() {
+        return Resp::error("ERR wrong number of arguments for '" + tokens[0] + "' command");
+    };
+    if(cmd == "PING") {
+        if(tokens.size() > 2) return wrongArguments();
+        return tokens.size() == 2 ? Resp::bulk(tokens[1]) : Resp::simple("PONG");
+    }
+    if(cmd == "HELLO") {
+        // HELLO [protover [SETNAME name]]: switches the connection's RESP version
+        int requested = version;
+        if(tokens.size() >= 2) {
+            if(tokens[1] == "2" || tokens[1] == "3") requested = tokens[1][0] - '0';
+            else return Resp::error("NOPROTO unsupported protocol version");
+        }
+        for(size_t i = 2; i < tokens.size(); i += 2) {
+            std::string option = tokens[i];
+            for(auto& c : option) c = toupper(c);
+            if(option != "SETNAME" || i + 1 >= tokens.size()) return Resp::error("ERR Syntax error in HELLO option '" + tokens[i] + "'");
+        }
+        conn.resp = requested;
+        std::string reply = Resp::mapHeader(7, requested);
+        reply += Resp::bulk("server") + Resp::bulk("kvspp");
+        reply += Resp::bulk("version") + Resp::bulk("1.0");
+        reply += Resp::bulk("proto") + Resp::integer(requested);
+        reply += Resp::bulk("id") + Resp::integer(conn.sock);
+        reply += Resp::bulk("mode") + Resp::bulk("standalone");
+        reply += Resp::bulk("role") + Resp::bulk(follower_ ? "replica" : "master");
+        reply += Resp::bulk("modules") + Resp::arrayHeader(0);
+        return reply;
+    }
+    if(cmd == "QUIT") return Resp::simple("OK");
+    // What Redis clients and load tools ask a server on connecting; none of it applies here
+    if(cmd == "COMMAND") return Resp::arrayHeader(0);
+    if(cmd == "CONFIG") {
+        std::string sub = tokens.size() >= 2 ? tokens[1] : "";
+        for(auto& c : sub) c = toupper(c);
+        if(sub != "GET") return Resp::error("ERR only CONFIG GET is supported");
+        return Resp::mapHeader(0, version);
+    }
+    if(cmd == "CLIENT") {
+        std::string sub = tokens.size() >= 2 ? tokens[1] : "";
+        for(auto& c : sub) c = toupper(c);
+        if(sub != "SETNAME" && sub != "SETINFO") return Resp::error("ERR only CLIENT SETNAME and SETINFO are supported");
+        return Resp::simple("OK");
+    }
+    if(cmd == "RESTORESTORE" || cmd == "BULKLOAD" || cmd == "SYNC" || cmd == "JSON" || cmd == "DUMPSTORE") {
+        return Resp::error("ERR " + cmd + " streams over the socket and is only available on the line protocol");
+    }
+    if(cmd == "STORES") {
+        if(tokens.size() != 1) return wrongArguments();
+        auto states = kvstore::StoreManager::instance().storeStates();
+        std::string reply = Resp::mapHeader(states.size(), version);
+        for(const auto& [token, state] : states) {
+            const char* name = state == kvstore::StoreManager::LoadState::LOADING ? "loading"
+                : state == kvstore::StoreManager::LoadState::FAILED ? "failed" : "ready";
+            reply += Resp::bulk(token) + Resp::bulk(name);
+        }
+        return reply;
+    }
+    if(cmd == "DEL" || cmd == "UNLINK" || cmd == "EXISTS") {
+        // Any number of keys, one line protocol command each; replies with how many there were
+        if(tokens.size() < 2) return wrongArguments();
+        const std::string single = cmd == "DEL" ? "DELETE" : cmd;
+        int64_t count = 0;
+        for(size_t i = 1; i < tokens.size(); ++i) {
+            std::string reply = handleCommand({ single, tokens[i] }, conn.selectedToken, conn.sock);
+            if(reply == "OK\n") ++count;
+            else if(reply != "NOT_FOUND\n") return Resp::fromLine(std::move(reply), version);
+        }
+        return Resp::integer(count);
+    }
+    if(cmd == "FLUSHDB") {
+        std::vector<std::string> flush(tokens);
+        flush[0] = "FLUSH";
+        return Resp::fromLine(handleCommand(flush, conn.selectedToken, conn.sock), version);
+    }
+    if(cmd == "INFO") {
+        // The fields one per line; a section argument is accepted and ignored
+        if(tokens.size() > 2) return wrongArguments();
+        std::string reply = handleCommand({ "INFO" }, conn.selectedToken, conn.sock);
+        if(reply.compare(0, 5, "INFO ") != 0) return Resp::fromLine(std::move(reply), version);
+        std::string text = "# kvspp\r\n";
+        std::istringstream fields(reply.substr(5));
+        std::string field;
+        while(fields >> field) text += field + "\r\n";
+        return Resp::bulk(text);
+    }
+    if(cmd == "LASTSAVE") {
+        std::string reply = handleCommand(tokens, conn.selectedToken, conn.sock);
+        if(reply.compare(0, 9, "LASTSAVE ") != 0) return Resp::fromLine(std::move(reply), version);
+        return Resp::integer(std::stoll(reply.substr(9)));
+    }
+    if(cmd == "DBSIZE" || cmd == "KEYS" || cmd == "HGETALL" || cmd == "HGET") {
+        // Reads the line protocol has no counterpart for
+        std::string refusal = checkAvailable(cmd, conn.selectedToken);
+        if(!refusal.empty()) return Resp::fromLine(std::move(refusal), version);
+        if(conn.selectedToken.empty()) return Resp::error("ERR No store selected. Use SELECT <storetoken> first.");
+        auto& store = kvstore::StoreManager::instance().getStore(conn.selectedToken);
+        if(cmd == "DBSIZE") {
+            if(tokens.size() != 1) return wrongArguments();
+            return Resp::integer(static_cast<int64_t>(store.size()));
+        }
+        if(cmd == "KEYS") {
+            if(tokens.size() != 2) return wrongArguments();
+            std::vector<std::string> matched;
+            for(auto& key : store.keys()) {
+                if(globMatch(tokens[1], key)) matched.push_back(std::move(key));
+            }
+            std::string reply = Resp::arrayHeader(matched.size());
+            for(const auto& key : matched) reply += Resp::bulk(key);
+            return reply;
+        }
+        if(cmd == "HGETALL") {
+            // Every attribute of the record: a map in RESP3, with the values typed
+            if(tokens.size() != 2) return wrongArguments();
+            std::string reply;
+            store.get(tokens[1], [&reply, version](const kvspp::core::ValueObject& val) {
+                const auto& attributes = val.getAttributes();
+                reply = Resp::mapHeader(attributes.size(), version);
+                for(const auto& [name, value] : attributes) reply += Resp::bulk(name) + Resp::attribute(value, version);
+            });
+            return reply.empty() ? Resp::mapHeader(0, version) : reply;
+        }
+        if(tokens.size() != 3) return wrongArguments();
+        std::string reply = Resp::null(version);
+        store.get(tokens[1], [&reply, &tokens, version](const kvspp::core::ValueObject& val) {
+            if(const auto* attribute = val.getAttribute(tokens[2])) reply = Resp::attribute(*attribute, version);
+        });
+        return reply;
+    }
+    // GET, SET, SELECT and the rest of the line protocol, with their replies translated
+    return Resp::fromLine(handleCommand(tokens, conn.selectedToken, conn.sock), version);
+}
+
+std::string kvspp::net::TCPServer::handleBinary(const BinaryProtocol::Header& request, std::string_view key,
+    std::string_view value, Connection& conn) {
+    using Opcode = BinaryProtocol::Opcode;
+    using Status = BinaryProtocol::Status;
+    auto reply = [&request](Status status, std::string_view body = {}) {
+        return BinaryProtocol::reply(request, status, body);
+    };
+    const Opcode opcode = request.opcode;
+    if(opcode == Opcode::PING) return reply(Status::OK, value);
+    if(opcode == Opcode::SELECT) {
+        if(key.empty()) return reply(Status::FAILED, "Usage: SELECT with the store token as key");
+        conn.selectedToken = key;
+        return reply(Status::OK);
+    }
+    try {
+        if(opcode == Opcode::COMMAND) {
+            auto tokens = splitCommand(value);
+            if(tokens.empty()) return reply(Status::FAILED, "Empty command");
+            std::string cmd = tokens[0];
+            for(auto& c : cmd) c = toupper(c);
+            // SELECT has an opcode of its own; the rest need the socket or end the connection
+            if(cmd == "SELECT" || cmd == "QUIT" || cmd == "JSON" || cmd == "DUMPSTORE" || cmd == "RESTORESTORE" ||
+                cmd == "BULKLOAD" || cmd == "SYNC") {
+                return reply(Status::FAILED, cmd + " is not available through COMMAND");
+            }
+            return BinaryProtocol::replyFromLine(request, handleCommand(tokens, conn.selectedToken, conn.sock));
+        }
+        const bool write = opcode == Opcode::SET || opcode == Opcode::PUT_RECORD || opcode == Opcode::DEL ||
+            opcode == Opcode::UNLINK;
+        const char* name;
+        switch(opcode) {
+        case Opcode::GET: case Opcode::GET_RECORD: name = "GET"; break;
+        case Opcode::EXISTS: name = "EXISTS"; break;
+        case Opcode::SET: case Opcode::PUT_RECORD: name = "SET"; break;
+        case Opcode::DEL: name = "DELETE"; break;
+        case Opcode::UNLINK: name = "UNLINK"; break;
+        default: return reply(Status::FAILED, "Unknown opcode " + std::to_string(static_cast<int>(opcode)));
+        }
+        const std::string& token = conn.selectedToken;
+        if(token.empty()) return reply(Status::FAILED, "No store selected. SELECT a store first.");
+        const std::string k(key);
+        auto& manager = kvstore::StoreManager::instance();
+        if(!write && manager.definitelyAbsent(token, k)) return reply(Status::NOT_FOUND);
+        std::string refusal = checkAvailable(name, token);
+        if(!refusal.empty()) return BinaryProtocol::replyFromLine(request, refusal);
+        auto& store = manager.getStore(token);
+        if(write && store.packedStore()) {
+            return reply(Status::READONLY, "Store '" + token + "' is served read-only from a packed file");
+        }
+        Status status = Status::OK;
+        switch(opcode) {
+        case Opcode::GET: {
+            std::string value;
+            if(!store.get(k, [&value](const kvspp::core::ValueObject& val) { value = val.getValueString(); })) {
+                return reply(Status::NOT_FOUND);
+            }
+            return reply(Status::OK, value);
+        }
+        case Opcode::GET_RECORD: {
+            std::string record;
+            if(!store.get(k, [&record](const kvspp::core::ValueObject& val) {
+                kvspp::persistence::BinaryWriter::putValueObject(record, val);
+            })) {
+                return reply(Status::NOT_FOUND);
+            }
+            return reply(Status::OK, record);
+        }
+        case Opcode::EXISTS:
+            return reply(store.contains(k) ? Status::OK : Status::NOT_FOUND);
+        case Opcode::SET:
+            store.put(k, { {"value", std::string(value)} });
+            break;
+        case Opcode::PUT_RECORD: {
+            // Parsed against a scratch registry; put() checks the types against the store's
+            kvspp::core::TypeRegistry types;
+            kvspp::core::ValueObject record(types);
+            kvspp::persistence::BinaryReader reader(value.data(), value.size());
+            reader.valueObject(record);
+            if(!reader.atEnd()) return reply(Status::FAILED, "Trailing bytes after the record");
+            store.put(k, record);
+            break;
+        }
+        default:
+            if(!store.deleteKey(k, opcode == Opcode::UNLINK)) status = Status::NOT_FOUND;
+            break;
+        }
+        if(store.getAutosave()) {
+            try {
+                kvstore::StoreManager::instance().commitAutosave(token);
+            }
+            catch(const std::exception& e) {
+                return reply(Status::FAILED, std::string("Autosave failed: ") + e.what());
+            }
+        }
+        return reply(status);
+    }
+    catch(const kvspp::exceptions::KVStoreException& e) {
+        // A rejected value (say, of the wrong type) or a malformed record fails the request
+        return reply(Status::FAILED, e.what());
+    }
+}
@@ -0,0 +1,438 @@
+#include "kvstore/net/UringLoop.hpp"
+
+#ifdef KVSPP_HAVE_IO_URING
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace kvspp {
+    namespace net {
+
+        namespace {
+            constexpr unsigned RING_ENTRIES = 4096;
+            constexpr uint16_t RECEIVE_BUFFERS = 256;
+            constexpr uint32_t RECEIVE_BUFFER_SIZE = 16 << 10;
+            // Receiving pauses past this much unsent output, or input waiting for a worker
+            constexpr size_t BACKLOG_LIMIT = 1 << 20;
+            // Buffers of idle connections larger than this are given back
+            constexpr size_t IDLE_BUFFER_BYTES = 64 << 10;
+            // Reply chunks handed to one sendmsg
+            constexpr size_t IOV_BATCH = 64;
+
+            // user_data: the Client (8-byte aligned) with the operation in the low bits
+            enum Op : uint64_t {
+                ACCEPT = 1,
+                WAKE = 2,
+                CANCEL = 3,
+                RECEIVE = 4,
+                SEND = 5
+            };
+            constexpr uint64_t OP_MASK = 7;
+
+            void releaseBuffer(std::string& buffer) {
+                if(buffer.empty() && buffer.capacity() > IDLE_BUFFER_BYTES) std::string().swap(buffer);
+            }
+        }
+
+        struct UringLoop::Client : Connection {
+            std::string pending;        // received while a worker has the connection
+            OutputBuffer sending;       // replies the send in flight is working through
+            iovec vec[IOV_BATCH];
+            msghdr message{};
+            bool receiving = false;     // a multishot receive is armed
+            bool cancelling = false;    // ... and has been asked to stop
+            bool sendArmed = false;
+            bool handingOff = false;    // BLOCKING: waiting for the ring to let go of the socket
+            bool heldBack = false;      // commands wait for replies to drain
+            bool dirty = false;
+            bool closed = false;
+
+            uint64_t tag(Op op) const { return reinterpret_cast<uint64_t>(this) | op; }
+            size_t unsent() const { return sending.size() + (busy ? 0 : output.size()); }
+        };
+
+        UringLoop::UringLoop(Handler handler, utils::ThreadPool* pool)
+            : handler_(std::move(handler)), pool_(pool) {
+            ring_ = std::make_unique<utils::IoUring>(RING_ENTRIES);
+            // Multishot receive came in 6.0 together with IORING_OP_SEND_ZC; multishot
+            // accept and provided-buffer rings a release earlier
+            if(!ring_->supports(IORING_OP_SEND_ZC)) {
+                throw std::system_error(ENOSYS, std::generic_category(), "io_uring without multishot receive");
+            }
+            ring_->setupBuffers(RECEIVE_BUFFERS, RECEIVE_BUFFER_SIZE);
+            // Blocking: io_uring completes reads of a non-blocking eventfd with -EAGAIN at once
+            wake_ = eventfd(0, EFD_CLOEXEC);
+            if(wake_ < 0) throw std::system_error(errno, std::generic_category(), "eventfd");
+        }
+
+        UringLoop::~UringLoop() {
+            ring_.reset();
+            ::close(wake_);
+        }
+
+        void UringLoop::stop() {
+            stopping_ = true;
+            uint64_t one = 1;
+            [[maybe_unused]] auto written = ::write(wake_, &one, sizeof(one));
+        }
+
+        Reactor::Stats UringLoop::stats() const {
+            Stats stats;
+            stats.connections = count_;
+            stats.accepted = accepted_.load(std::memory_order_relaxed);
+            stats.bytesIn = bytesIn_.load(std::memory_order_relaxed);
+            stats.bytesOut = bytesOut_.load(std::memory_order_relaxed);
+            stats.batches = batches_.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+        void UringLoop::run(int listenSock, bool /* shared: each multishot accept takes a connection on its own */) {
+            listen_ = listenSock;
+            armAccept();
+            armWake();
+            while(!stopping_) {
+                int result = ring_->submit(1);
+                if(result < 0 && result != -EINTR && result != -EAGAIN && result != -EBUSY) {
+                    std::cerr << "io_uring loop: io_uring_enter failed: " << std::strerror(-result) << std::endl;
+                    break;
+                }
+                ring_->drain([this](const io_uring_cqe& cqe) { handle(cqe); });
+                std::vector<Client*> dirty;
+                dirty.swap(dirty_);
+                for(Client* client : dirty) {
+                    client->dirty = false;
+                    if(!client->closed && !client->busy) process(*client);
+                }
+                released_.clear();
+            }
+
+            io_uring_sqe* cancel = ring_->sqe();
+            cancel->opcode = IORING_OP_ASYNC_CANCEL;
+            cancel->addr = ACCEPT;
+            cancel->user_data = CANCEL;
+            // Wake workers blocked on their sockets and wait for every connection to come back
+            for(auto& [key, client] : clients_) {
+                if(client->busy) ::shutdown(client->sock, SHUT_RDWR);
+            }
+            while(busy_ > 0) {
+                std::vector<std::pair<Client*, HandlerResult>> completed;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this]() { return !completed_.empty(); });
+                    completed.swap(completed_);
+                }
+                busy_ -= completed.size();
+                for(auto& entry : completed) entry.first->busy = false;
+            }
+            std::vector<Client*> open;
+            for(auto& [key, client] : clients_) open.push_back(key);
+            for(Client* client : open) close(*client);
+            // Closed connections are freed as their last requests come back
+            while(!clients_.empty()) {
+                int result = ring_->submit(1);
+                if(result < 0 && result != -EINTR && result != -EAGAIN && result != -EBUSY) break;
+                ring_->drain([this](const io_uring_cqe& cqe) { handle(cqe); });
+            }
+            dirty_.clear();
+            released_.clear();
+        }
+
+        void UringLoop::handle(const io_uring_cqe& cqe) {
+            const uint64_t op = cqe.user_data & OP_MASK;
+            if(op == ACCEPT) {
+                if(cqe.res >= 0) {
+                    if(stopping_) {
+                        ::close(cqe.res);
+                    }
+                    else {
+                        int optval = 1;
+                        setsockopt(cqe.res, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
+                        auto client = std::make_unique<Client>();
+                        client->sock = cqe.res;
+                        Client* added = client.get();
+                        clients_.emplace(added, std::move(client));
+                        ++count_;
+                        accepted_.fetch_add(1, std::memory_order_relaxed);
+                        armReceive(*added);
+                    }
+                }
+                else if(cqe.res != -ECANCELED && cqe.res != -ECONNABORTED && cqe.res != -EINTR) {
+                    std::cerr << "io_uring loop: accept failed: " << std::strerror(-cqe.res) << std::endl;
+                }
+                if(!(cqe.flags & IORING_CQE_F_MORE) && !stopping_) armAccept();
+                return;
+            }
+            if(op == WAKE) {
+                if(!stopping_) armWake();
+                drainCompleted();
+                return;
+            }
+            if(op == CANCEL) return;
+            Client& client = *reinterpret_cast<Client*>(cqe.user_data & ~OP_MASK);
+            if(op == RECEIVE) onReceive(client, cqe);
+            else onSent(client, cqe);
+        }
+
+        void UringLoop::armAccept() {
+            io_uring_sqe* sqe = ring_->sqe();
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->fd = listen_;
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            sqe->accept_flags = SOCK_CLOEXEC;
+            sqe->user_data = ACCEPT;
+        }
+
+        void UringLoop::armWake() {
+            io_uring_sqe* sqe = ring_->sqe();
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = wake_;
+            sqe->addr = reinterpret_cast<uint64_t>(&wakeValue_);
+            sqe->len = sizeof(wakeValue_);
+            sqe->user_data = WAKE;
+        }
+
+        void UringLoop::armReceive(Client& client) {
+            io_uring_sqe* sqe = ring_->sqe();
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = client.sock;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = utils::IoUring::BUFFER_GROUP;
+            sqe->user_data = client.tag(RECEIVE);
+            client.receiving = true;
+            client.cancelling = false;
+        }
+
+        void UringLoop::cancelReceive(Client& client) {
+            if(!client.receiving || client.cancelling) return;
+            io_uring_sqe* sqe = ring_->sqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = client.tag(RECEIVE);
+            sqe->user_data = CANCEL;
+            client.cancelling = true;
+        }
+
+        void UringLoop::armSend(Client& client) {
+            if(client.sendArmed || client.closed) return;
+            if(client.sending.empty()) {
+                if(client.output.empty()) return;
+                client.sending.swap(client.output);
+            }
+            client.message.msg_iov = client.vec;
+            client.message.msg_iovlen = client.sending.gather(client.vec, IOV_BATCH);
+            io_uring_sqe* sqe = ring_->sqe();
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = client.sock;
+            sqe->addr = reinterpret_cast<uint64_t>(&client.message);
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->user_data = client.tag(SEND);
+            client.sendArmed = true;
+        }
+
+        void UringLoop::onReceive(Client& client, const io_uring_cqe& cqe) {
+            if(cqe.flags & IORING_CQE_F_BUFFER) {
+                const uint16_t id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                if(cqe.res > 0 && !client.closed) {
+                    (client.busy ? client.pending : client.input).append(ring_->buffer(id), static_cast<size_t>(cqe.res));
+                    bytesIn_.fetch_add(static_cast<uint64_t>(cqe.res), std::memory_order_relaxed);
+                    markDirty(client);
+                }
+                ring_->recycleBuffer(id);
+            }
+            // -ENOBUFS only means every buffer was taken at that moment; the receive is armed again
+            if(cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED)) {
+                client.peerClosed = true;
+                markDirty(client);
+            }
+            if(!(cqe.flags & IORING_CQE_F_MORE)) {
+                client.receiving = false;
+                client.cancelling = false;
+            }
+            if(client.closed) {
+                release(client);
+                return;
+            }
+            if(client.handingOff) {
+                handOff(client);
+                return;
+            }
+            if(!client.receiving && wantsInput(client)) armReceive(client);
+        }
+
+        void UringLoop::onSent(Client& client, const io_uring_cqe& cqe) {
+            client.sendArmed = false;
+            if(client.closed) {
+                release(client);
+                return;
+            }
+            if(cqe.res < 0) {
+                close(client);
+                return;
+            }
+            bytesOut_.fetch_add(static_cast<uint64_t>(cqe.res), std::memory_order_relaxed);
+            // A short send (or more chunks than one sendmsg takes) continues with the rest
+            client.sending.consume(static_cast<size_t>(cqe.res));
+            if(!client.sending.empty()) {
+                armSend(client);
+                return;
+            }
+            if(client.handingOff) {
+                handOff(client);
+                return;
+            }
+            if(!client.busy) {
+                // Replies that piled up meanwhile
+                armSend(client);
+                if(client.sendArmed) return;
+                if(client.closing) {
+                    close(client);
+                    return;
+                }
+                if(client.heldBack) markDirty(client);
+            }
+            if(!client.receiving && wantsInput(client)) armReceive(client);
+        }
+
+        bool UringLoop::wantsInput(const Client& client) const {
+            return !client.closed && !client.peerClosed && !client.closing && !client.handingOff &&
+                client.pending.size() < BACKLOG_LIMIT && client.unsent() < BACKLOG_LIMIT;
+        }
+
+        void UringLoop::process(Client& client) {
+            client.heldBack = client.unsent() >= BACKLOG_LIMIT;
+            if(client.heldBack) return;
+            if(client.input.empty() && !client.peerClosed) return;
+            execute(client);
+        }
+
+        void UringLoop::execute(Client& client) {
+            client.busy = true;
+            ++busy_;
+            if(pool_) {
+                pool_->submit([this, &client]() { complete(client, call(client, false)); });
+                return;
+            }
+            HandlerResult result = call(client, false);
+            if(result == HandlerResult::BLOCKING) {
+                client.handingOff = true;
+                cancelReceive(client);
+                handOff(client);
+                return;
+            }
+            client.busy = false;
+            --busy_;
+            settle(client, result);
+        }
+
+        HandlerResult UringLoop::call(Client& client, bool mayBlock) {
+            batches_.fetch_add(1, std::memory_order_relaxed);
+            try {
+                return handler_(client, mayBlock);
+            }
+            catch(const std::exception& e) {
+                std::cerr << "io_uring loop: closing a connection: " << e.what() << std::endl;
+                return HandlerResult::CLOSE;
+            }
+        }
+
+        void UringLoop::settle(Client& client, HandlerResult result) {
+            // Input that is still to be run keeps a half-closed connection open
+            if(result == HandlerResult::CLOSE || (client.peerClosed && !client.dirty)) client.closing = true;
+            armSend(client);
+            if(client.closing) {
+                if(!client.sendArmed) close(client);
+                return;
+            }
+            if(wantsInput(client)) {
+                if(!client.receiving) armReceive(client);
+            }
+            else {
+                cancelReceive(client);
+            }
+            releaseBuffer(client.input);
+        }
+
+        void UringLoop::handOff(Client& client) {
+            if(client.receiving || client.sendArmed) return;
+            client.handingOff = false;
+            client.input += client.pending;
+            client.pending.clear();
+            // Accepted sockets are blocking, so the thread can use this one as is
+            std::thread([this, &client]() { complete(client, call(client, true)); }).detach();
+        }
+
+        void UringLoop::complete(Client& client, HandlerResult result) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            completed_.emplace_back(&client, result);
+            uint64_t one = 1;
+            [[maybe_unused]] auto written = ::write(wake_, &one, sizeof(one));
+            cv_.notify_one();
+        }
+
+        void UringLoop::drainCompleted() {
+            std::vector<std::pair<Client*, HandlerResult>> completed;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                completed.swap(completed_);
+            }
+            for(auto& [client, result] : completed) {
+                if(result == HandlerResult::BLOCKING && !client->closed) {
+                    // A worker stopped at a command that needs a thread of its own
+                    client->handingOff = true;
+                    cancelReceive(*client);
+                    handOff(*client);
+                    continue;
+                }
+                client->busy = false;
+                --busy_;
+                if(client->closed) {
+                    release(*client);
+                    continue;
+                }
+                if(!client->pending.empty()) {
+                    client->input += client->pending;
+                    client->pending.clear();
+                    releaseBuffer(client->pending);
+                    markDirty(*client);
+                }
+                settle(*client, result == HandlerResult::BLOCKING ? HandlerResult::CLOSE : result);
+            }
+        }
+
+        void UringLoop::markDirty(Client& client) {
+            if(client.dirty) return;
+            client.dirty = true;
+            dirty_.push_back(&client);
+        }
+
+        void UringLoop::close(Client& client) {
+            if(client.closed) return;
+            client.closed = true;
+            // Ends the receive (and a send) still in flight; the socket is closed once they are back
+            ::shutdown(client.sock, SHUT_RDWR);
+            cancelReceive(client);
+            release(client);
+        }
+
+        void UringLoop::release(Client& client) {
+            if(!client.closed || client.receiving || client.sendArmed || client.busy) return;
+            ::close(client.sock);
+            client.sock = -1;
+            --count_;
+            auto it = clients_.find(&client);
+            if(it != clients_.end()) {
+                released_.push_back(std::move(it->second));
+                clients_.erase(it);
+            }
+        }
+
+    } // namespace net
+} // namespace kvspp
+#endif
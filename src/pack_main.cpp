@@ -0,0 +1,94 @@
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include "kvstore/core/KeyValueStore.hpp"
+#include "kvstore/persistence/PackedStore.hpp"
+#include "kvstore/persistence/PersistenceManager.hpp"
+
+/**
+ * Offline pack tool entry point
+ * Compiles a snapshot into an immutable packed store that kvspp-tcp serves
+ * read-only from a memory mapping
+ */
+int main(int argc, char* argv[]) {
+    std::string input;
+    std::string output;
+    bool verify = false;
+
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg == "--verify") {
+            verify = true;
+        }
+        else if(arg == "--key-filter-bits" && i + 1 < argc) {
+            try {
+                kvspp::persistence::PersistenceManager::setKeyFilterBits(std::stod(argv[++i]));
+            }
+            catch(const std::exception&) {
+                std::cerr << "Error: invalid --key-filter-bits value '" << argv[i] << "'" << std::endl;
+                return 1;
+            }
+        }
+        else if(arg == "--help" || arg == "-h") {
+            std::cout << "Usage: " << argv[0] << " <snapshot.json|snapshot.kvs> [output.kvpack] [--verify]" << std::endl;
+            std::cout << std::endl;
+            std::cout << "Writes store/<name>.kvpack by default. kvspp-tcp serves a store whose" << std::endl;
+            std::cout << "store/<storetoken>.kvpack exists read-only, straight from the file." << std::endl;
+            std::cout << std::endl;
+            std::cout << "Options:" << std::endl;
+            std::cout << "  --verify                 Re-open the packed file and check its checksum and index" << std::endl;
+            std::cout << "  --key-filter-bits <n>    Bits per key of the <output>.bloom miss filter (default 10, 0 = none)" << std::endl;
+            return 0;
+        }
+        else if(input.empty()) {
+            input = arg;
+        }
+        else if(output.empty()) {
+            output = arg;
+        }
+        else {
+            std::cerr << "Error: unexpected argument '" << arg << "'" << std::endl;
+            std::cerr << "Use --help for usage information" << std::endl;
+            return 1;
+        }
+    }
+    if(input.empty()) {
+        std::cerr << "Error: no input snapshot given" << std::endl;
+        std::cerr << "Use --help for usage information" << std::endl;
+        return 1;
+    }
+    if(output.empty()) {
+        output = "store/" + std::filesystem::path(input).stem().string() + ".kvpack";
+    }
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        kvspp::core::KeyValueStore store;
+        kvspp::persistence::PersistenceManager(input).load(store);
+        auto loaded = std::chrono::steady_clock::now();
+
+        kvspp::persistence::PackedStore::write(store, output);
+        if(kvspp::persistence::PersistenceManager::keyFilterBits() > 0) {
+            kvspp::persistence::PersistenceManager::writeKeyFilter(store.keys(), output);
+        }
+        auto packed = std::chrono::steady_clock::now();
+
+        auto ms = [](auto from, auto to) {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count();
+        };
+        std::cout << "Packed " << store.size() << " entries from " << input << " into " << output << " ("
+                  << std::filesystem::file_size(output) << " bytes; load " << ms(start, loaded) << " ms, pack "
+                  << ms(loaded, packed) << " ms)" << std::endl;
+
+        if(verify) {
+            kvspp::persistence::PackedStore(output).verify();
+            std::cout << "Verified " << output << std::endl;
+        }
+    }
+    catch(const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "kvstore/persistence/BinaryCodec.hpp"
+#include "kvstore/core/TypeRegistry.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include <cstring>
+
+namespace kvspp {
+    namespace persistence {
+
+        void BinaryWriter::putU8(std::string& out, uint8_t value) {
+            out.push_back(static_cast<char>(value));
+        }
+
+        void BinaryWriter::putU32(std::string& out, uint32_t value) {
+            char bytes[4];
+            for(int i = 0; i < 4; ++i) {
+                bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+            }
+            out.append(bytes, 4);
+        }
+
+        void BinaryWriter::putU64(std::string& out, uint64_t value) {
+            char bytes[8];
+            for(int i = 0; i < 8; ++i) {
+                bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+            }
+            out.append(bytes, 8);
+        }
+
+        void BinaryWriter::putString(std::string& out, std::string_view value) {
+            putU32(out, static_cast<uint32_t>(value.size()));
+            out.append(value.data(), value.size());
+        }
+
+        void BinaryWriter::putAttributeValue(std::string& out, const core::AttributeValue& value) {
+            core::AttributeType type = core::TypeRegistry::getTypeFromValue(value);
+            putU8(out, static_cast<uint8_t>(type));
+            switch(type) {
+            case core::AttributeType::STRING:
+                putString(out, std::get<std::string>(value));
+                break;
+            case core::AttributeType::INTEGER:
+                putU32(out, static_cast<uint32_t>(std::get<int>(value)));
+                break;
+            case core::AttributeType::DOUBLE: {
+                uint64_t bits;
+                double d = std::get<double>(value);
+                std::memcpy(&bits, &d, sizeof(bits));
+                putU64(out, bits);
+                break;
+            }
+            case core::AttributeType::BOOLEAN:
+                putU8(out, std::get<bool>(value) ? 1 : 0);
+                break;
+            }
+        }
+
+        void BinaryWriter::putValueObject(std::string& out, const core::ValueObject& obj) {
+            const auto& attributes = obj.getAttributes();
+            putU32(out, static_cast<uint32_t>(attributes.size()));
+            for(const auto& [name, value] : attributes) {
+                putString(out, name);
+                putAttributeValue(out, value);
+            }
+        }
+
+        BinaryReader::BinaryReader(const char* data, size_t size)
+            : data_(data), size_(size) {
+        }
+
+        void BinaryReader::require(size_t length) const {
+            if(length > size_ - pos_) {
+                throw exceptions::PersistenceException("Unexpected end of binary data");
+            }
+        }
+
+        uint8_t BinaryReader::u8() {
+            require(1);
+            return static_cast<uint8_t>(data_[pos_++]);
+        }
+
+        uint32_t BinaryReader::u32() {
+            require(4);
+            uint32_t value = 0;
+            for(int i = 0; i < 4; ++i) {
+                value |= static_cast<uint32_t>(static_cast<unsigned char>(data_[pos_ + i])) << (8 * i);
+            }
+            pos_ += 4;
+            return value;
+        }
+
+        uint64_t BinaryReader::u64() {
+            require(8);
+            uint64_t value = 0;
+            for(int i = 0; i < 8; ++i) {
+                value |= static_cast<uint64_t>(static_cast<unsigned char>(data_[pos_ + i])) << (8 * i);
+            }
+            pos_ += 8;
+            return value;
+        }
+
+        std::string_view BinaryReader::view(size_t length) {
+            require(length);
+            std::string_view result(data_ + pos_, length);
+            pos_ += length;
+            return result;
+        }
+
+        std::string BinaryReader::string() {
+            uint32_t length = u32();
+            return std::string(view(length));
+        }
+
+        core::AttributeValue BinaryReader::attributeValue() {
+            auto type = static_cast<core::AttributeType>(u8());
+            switch(type) {
+            case core::AttributeType::STRING:
+                return string();
+            case core::AttributeType::INTEGER:
+                return static_cast<int>(u32());
+            case core::AttributeType::DOUBLE: {
+                uint64_t bits = u64();
+                double d;
+                std::memcpy(&d, &bits, sizeof(d));
+                return d;
+            }
+            case core::AttributeType::BOOLEAN:
+                return u8() != 0;
+            }
+            throw exceptions::PersistenceException("Unknown attribute type tag in binary data");
+        }
+
+        void BinaryReader::valueObject(core::ValueObject& obj) {
+            uint32_t count = u32();
+            for(uint32_t i = 0; i < count; ++i) {
+                std::string name = string();
+                core::AttributeValue value = attributeValue();
+                std::visit([&obj, &name](auto&& v) { obj.setAttribute(name, v); }, value);
+            }
+        }
+
+    }
+}
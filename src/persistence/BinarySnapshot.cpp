@@ -0,0 +1,327 @@
+#include "kvstore/persistence/BinarySnapshot.hpp"
+#include "kvstore/persistence/BinaryCodec.hpp"
+#include "kvstore/core/TypeRegistry.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include "kvstore/utils/FileWriter.hpp"
+#include "kvstore/utils/MappedFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+namespace kvspp {
+    namespace persistence {
+
+        namespace {
+            constexpr char MAGIC[8] = { 'K', 'V', 'S', 'P', 'S', 'N', 'A', 'P' };
+            constexpr char END_MAGIC[8] = { 'K', 'V', 'S', 'P', 'E', 'N', 'D', '\0' };
+            constexpr size_t TRAILER_SIZE = 16;
+            constexpr size_t BLOCK_TARGET_SIZE = 64 * 1024;
+            constexpr uint32_t FLAG_AUTOSAVE = 1;
+
+            struct BlockInfo {
+                uint64_t offset;
+                uint32_t entries;
+                uint32_t length;       // stored payload bytes
+                uint32_t rawLength;    // payload bytes after decompression
+                utils::Codec codec;
+            };
+
+            void appendChecksum(std::string& out, size_t from) {
+                BinaryWriter::putU32(out, utils::Checksum::crc32(out.data() + from, out.size() - from));
+            }
+
+            void verifyChecksum(const char* data, size_t length, uint32_t expected, const std::string& what) {
+                if(utils::Checksum::crc32(data, length) != expected) {
+                    throw exceptions::PersistenceException("Checksum mismatch in snapshot " + what);
+                }
+            }
+        }
+
+        void BinarySnapshot::save(const core::KeyValueStore& store, const std::string& path,
+            utils::Codec codec, utils::ThreadPool* pool, const JsonWriter::KeysCallback& onKeys) {
+            std::filesystem::path filePath(path);
+            if(filePath.has_parent_path()) {
+                std::filesystem::create_directories(filePath.parent_path());
+            }
+            utils::FileWriter file(path);
+
+            // Schema: every attribute the store knows about, indexed by position.
+            // Attributes first seen while saving are appended and listed in the footer
+            auto schema = store.getSchema();
+            const size_t headerSchemaSize = schema.size();
+            std::unordered_map<std::string, uint32_t> schemaIndex;
+            for(uint32_t i = 0; i < schema.size(); ++i) {
+                schemaIndex.emplace(schema[i].first, i);
+            }
+
+            auto keys = store.keys();
+            if(onKeys) onKeys(keys);
+            std::string header(MAGIC, sizeof(MAGIC));
+            BinaryWriter::putU32(header, VERSION);
+            BinaryWriter::putU32(header, store.getAutosave() ? FLAG_AUTOSAVE : 0);
+            BinaryWriter::putU64(header, keys.size());
+            BinaryWriter::putU32(header, static_cast<uint32_t>(schema.size()));
+            for(const auto& [name, type] : schema) {
+                BinaryWriter::putString(header, name);
+                BinaryWriter::putU8(header, static_cast<uint8_t>(type));
+            }
+            appendChecksum(header, 0);
+            file.write(header);
+
+            uint64_t offset = header.size();
+            std::vector<BlockInfo> blocks;
+
+            // Blocks are serialized in order, compressed a batch at a time (concurrently
+            // with a pool) and then written in order, bounding the memory held at once
+            struct PendingBlock {
+                uint32_t entries = 0;
+                std::string raw;
+                std::string compressed;
+                utils::Codec codec = utils::Codec::NONE;
+            };
+            const bool parallel = pool && pool->size() > 1 && codec != utils::Codec::NONE;
+            const size_t batchSize = parallel ? pool->size() * 4 : 1;
+            std::vector<PendingBlock> batch(1);
+
+            auto compressBlock = [codec](PendingBlock& block) {
+                if(utils::Compression::compress(codec, block.raw.data(), block.raw.size(), block.compressed)) {
+                    block.codec = codec;
+                }
+            };
+
+            auto writeBatch = [&]() {
+                if(batch.back().entries == 0) batch.pop_back();
+                if(parallel && batch.size() > 1) {
+                    std::vector<std::future<void>> futures;
+                    for(auto& block : batch) {
+                        futures.push_back(pool->submit([&compressBlock, &block]() { compressBlock(block); }));
+                    }
+                    utils::waitAll(futures);
+                }
+                else {
+                    for(auto& block : batch) compressBlock(block);
+                }
+
+                for(const auto& block : batch) {
+                    const std::string& stored = block.codec == utils::Codec::NONE ? block.raw : block.compressed;
+                    std::string blockHeader;
+                    BinaryWriter::putU32(blockHeader, block.entries);
+                    BinaryWriter::putU32(blockHeader, static_cast<uint32_t>(stored.size()));
+                    BinaryWriter::putU32(blockHeader, static_cast<uint32_t>(block.raw.size()));
+                    BinaryWriter::putU8(blockHeader, static_cast<uint8_t>(block.codec));
+                    std::string crc;
+                    BinaryWriter::putU32(crc, utils::Checksum::crc32(stored.data(), stored.size()));
+                    file.write(blockHeader);
+                    file.write(stored);
+                    file.write(crc);
+
+                    blocks.push_back({ offset, block.entries, static_cast<uint32_t>(stored.size()),
+                        static_cast<uint32_t>(block.raw.size()), block.codec });
+                    offset += blockHeader.size() + stored.size() + crc.size();
+                }
+                batch.assign(1, PendingBlock{});
+            };
+
+            // Keys deleted while saving are skipped: the header entry count is only
+            // a sizing hint, the footer carries the exact per-block counts
+            for(const auto& key : keys) {
+                std::string& payload = batch.back().raw;
+                // Encoded under the store lock: a concurrent write may free the value
+                const bool found = store.peek(key, [&](const core::ValueObject& valueObj) {
+                    BinaryWriter::putString(payload, key);
+                    const auto& attributes = valueObj.getAttributes();
+                    BinaryWriter::putU32(payload, static_cast<uint32_t>(attributes.size()));
+                    for(const auto& [name, value] : attributes) {
+                        auto [it, added] = schemaIndex.try_emplace(name, static_cast<uint32_t>(schema.size()));
+                        if(added) schema.emplace_back(name, core::TypeRegistry::getTypeFromValue(value));
+                        BinaryWriter::putU32(payload, it->second);
+                        BinaryWriter::putAttributeValue(payload, value);
+                    }
+                });
+                if(!found) continue;
+                ++batch.back().entries;
+                if(payload.size() >= BLOCK_TARGET_SIZE) {
+                    if(batch.size() == batchSize) writeBatch();
+                    else batch.emplace_back();
+                }
+            }
+            writeBatch();
+
+            std::string footer;
+            BinaryWriter::putU32(footer, static_cast<uint32_t>(blocks.size()));
+            for(const auto& block : blocks) {
+                BinaryWriter::putU64(footer, block.offset);
+                BinaryWriter::putU32(footer, block.entries);
+                BinaryWriter::putU32(footer, block.length);
+                BinaryWriter::putU32(footer, block.rawLength);
+                BinaryWriter::putU8(footer, static_cast<uint8_t>(block.codec));
+            }
+            BinaryWriter::putU32(footer, static_cast<uint32_t>(schema.size() - headerSchemaSize));
+            for(size_t i = headerSchemaSize; i < schema.size(); ++i) {
+                BinaryWriter::putString(footer, schema[i].first);
+                BinaryWriter::putU8(footer, static_cast<uint8_t>(schema[i].second));
+            }
+            appendChecksum(footer, 0);
+            BinaryWriter::putU64(footer, offset);
+            footer.append(END_MAGIC, sizeof(END_MAGIC));
+            file.write(footer);
+            file.close();
+        }
+
+        void BinarySnapshot::load(core::KeyValueStore& store, const std::string& path, utils::ThreadPool* pool) {
+            utils::MappedFile file(path);
+            file.adviseSequential();
+            const char* data = file.data();
+            const size_t size = file.size();
+
+            if(size < sizeof(MAGIC) + TRAILER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+                throw exceptions::PersistenceException("Not a binary snapshot: " + path);
+            }
+            if(std::memcmp(data + size - sizeof(END_MAGIC), END_MAGIC, sizeof(END_MAGIC)) != 0) {
+                throw exceptions::PersistenceException("Truncated binary snapshot: " + path);
+            }
+
+            // Header and schema
+            BinaryReader header(data + sizeof(MAGIC), size - sizeof(MAGIC) - TRAILER_SIZE);
+            const uint32_t version = header.u32();
+            if(version > VERSION || version == 0) {
+                throw exceptions::PersistenceException("Unsupported snapshot version " + std::to_string(version));
+            }
+            const uint32_t flags = header.u32();
+            const uint64_t entryCount = header.u64();
+            const uint32_t schemaCount = header.u32();
+            std::vector<std::pair<std::string, core::AttributeType>> schema;
+            schema.reserve(schemaCount);
+            for(uint32_t i = 0; i < schemaCount; ++i) {
+                std::string name = header.string();
+                schema.emplace_back(std::move(name), static_cast<core::AttributeType>(header.u8()));
+            }
+            const size_t headerLength = sizeof(MAGIC) + header.position();
+            const uint32_t headerCrc = header.u32();
+            verifyChecksum(data, headerLength, headerCrc, "header");
+
+            // Footer index
+            BinaryReader trailer(data + size - TRAILER_SIZE, TRAILER_SIZE);
+            const uint64_t footerOffset = trailer.u64();
+            if(footerOffset < headerLength || footerOffset > size - TRAILER_SIZE) {
+                throw exceptions::PersistenceException("Corrupt snapshot footer offset: " + path);
+            }
+            BinaryReader footer(data + footerOffset, size - TRAILER_SIZE - footerOffset);
+            const uint32_t blockCount = footer.u32();
+            std::vector<BlockInfo> blocks(blockCount);
+            for(auto& block : blocks) {
+                block.offset = footer.u64();
+                block.entries = footer.u32();
+                block.length = footer.u32();
+                block.rawLength = block.length;
+                block.codec = utils::Codec::NONE;
+                if(version >= 2) {
+                    block.rawLength = footer.u32();
+                    block.codec = static_cast<utils::Codec>(footer.u8());
+                }
+            }
+            if(version >= 3) {
+                // Attributes the store registered while the snapshot was being written
+                const uint32_t lateCount = footer.u32();
+                for(uint32_t i = 0; i < lateCount; ++i) {
+                    std::string name = footer.string();
+                    schema.emplace_back(std::move(name), static_cast<core::AttributeType>(footer.u8()));
+                }
+            }
+            const size_t blockHeaderSize = version >= 2 ? 13 : 8;
+            const size_t footerLength = footer.position();
+            const uint32_t footerCrc = footer.u32();
+            verifyChecksum(data + footerOffset, footerLength, footerCrc, "footer");
+
+            // Register the schema once; entries then bypass per-attribute validation
+            // Decode into a fresh store (data and types) and publish it in one step
+            core::KeyValueStore staged;
+            core::TypeRegistry& registry = staged.getTypeRegistry();
+            for(const auto& [name, type] : schema) {
+                registry.validateAndRegisterType(name, type);
+            }
+
+            using Entries = std::vector<std::pair<std::string, std::unique_ptr<core::ValueObject>>>;
+            auto decodeBlocks = [&](size_t first, size_t last, Entries& entries) {
+                std::string scratch;
+                for(size_t b = first; b < last; ++b) {
+                    const BlockInfo& block = blocks[b];
+                    if(block.offset + blockHeaderSize + block.length + 4 > footerOffset) {
+                        throw exceptions::PersistenceException("Snapshot block out of bounds: " + path);
+                    }
+                    const char* payload = data + block.offset + blockHeaderSize;
+                    BinaryReader blockCrc(payload + block.length, 4);
+                    verifyChecksum(payload, block.length, blockCrc.u32(), "block");
+
+                    size_t payloadLength = block.length;
+                    if(block.codec != utils::Codec::NONE) {
+                        scratch.resize(block.rawLength);
+                        utils::Compression::decompress(block.codec, payload, block.length, scratch.data(), block.rawLength);
+                        payload = scratch.data();
+                        payloadLength = block.rawLength;
+                    }
+
+                    BinaryReader reader(payload, payloadLength);
+                    for(uint32_t e = 0; e < block.entries; ++e) {
+                        std::string_view key = reader.view(reader.u32());
+                        const uint32_t attributeCount = reader.u32();
+                        std::unordered_map<std::string, core::AttributeValue> attributes;
+                        attributes.reserve(attributeCount);
+                        for(uint32_t a = 0; a < attributeCount; ++a) {
+                            const uint32_t index = reader.u32();
+                            if(index >= schema.size()) {
+                                throw exceptions::PersistenceException("Snapshot attribute index out of range: " + path);
+                            }
+                            core::AttributeValue value = reader.attributeValue();
+                            if(core::TypeRegistry::getTypeFromValue(value) != schema[index].second) {
+                                throw exceptions::PersistenceException("Snapshot attribute '" + schema[index].first +
+                                    "' does not match its schema type");
+                            }
+                            attributes.emplace(schema[index].first, std::move(value));
+                        }
+                        entries.emplace_back(std::string(key),
+                            std::make_unique<core::ValueObject>(std::move(attributes), registry));
+                    }
+                }
+            };
+
+            Entries entries;
+            entries.reserve(static_cast<size_t>(entryCount));
+            if(!pool || pool->size() < 2 || blocks.size() < 2) {
+                decodeBlocks(0, blocks.size(), entries);
+            }
+            else {
+                // Contiguous runs of blocks per task keep the entries in file order
+                const size_t tasks = std::min(blocks.size(), pool->size() * 4);
+                std::vector<std::future<Entries>> futures;
+                for(size_t t = 0; t < tasks; ++t) {
+                    futures.push_back(pool->submit([&, t]() {
+                        Entries part;
+                        decodeBlocks(blocks.size() * t / tasks, blocks.size() * (t + 1) / tasks, part);
+                        return part;
+                    }));
+                }
+                for(auto& part : utils::waitAll(futures)) {
+                    std::move(part.begin(), part.end(), std::back_inserter(entries));
+                }
+            }
+
+            staged.putBatch(std::move(entries));
+            staged.setAutosave((flags & FLAG_AUTOSAVE) != 0);
+            store.swapContents(staged);
+        }
+
+        bool BinarySnapshot::isBinarySnapshot(const std::string& path) {
+            std::ifstream file(path, std::ios::binary);
+            char magic[sizeof(MAGIC)];
+            if(!file.read(magic, sizeof(magic))) return false;
+            return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+        }
+
+    }
+}
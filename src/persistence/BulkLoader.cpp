@@ -0,0 +1,239 @@
+#include "kvstore/persistence/BulkLoader.hpp"
+#include "kvstore/persistence/JsonReader.hpp"
+#include "kvstore/core/TypeRegistry.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+namespace kvspp {
+    namespace persistence {
+
+        namespace {
+            // Input is cut into batches of about this many bytes
+            constexpr size_t BATCH_BYTES = 4 << 20;
+            // Batches parsed ahead of insertion, per worker
+            constexpr size_t BATCHES_PER_WORKER = 2;
+
+            // Split one CSV line into fields, noting which were quoted
+            void splitCsv(std::string_view line, std::vector<std::string>& fields, std::vector<bool>& quoted) {
+                fields.clear();
+                quoted.clear();
+                size_t i = 0;
+                while(true) {
+                    std::string field;
+                    bool isQuoted = i < line.size() && line[i] == '"';
+                    if(isQuoted) {
+                        ++i;
+                        while(true) {
+                            if(i >= line.size()) throw std::runtime_error("unterminated quoted field");
+                            if(line[i] == '"') {
+                                if(i + 1 < line.size() && line[i + 1] == '"') {
+                                    field += '"';
+                                    i += 2;
+                                    continue;
+                                }
+                                ++i;
+                                break;
+                            }
+                            field += line[i++];
+                        }
+                        if(i < line.size() && line[i] != ',') throw std::runtime_error("text after closing quote");
+                    }
+                    else {
+                        size_t comma = line.find(',', i);
+                        size_t end = comma == std::string_view::npos ? line.size() : comma;
+                        field.assign(line.data() + i, end - i);
+                        i = end;
+                    }
+                    fields.push_back(std::move(field));
+                    quoted.push_back(isQuoted);
+                    if(i >= line.size()) return;
+                    ++i; // ','
+                }
+            }
+
+            // Type an unquoted CSV field the way SET values are typed
+            core::AttributeValue typedField(std::string&& text) {
+                if(text == "true") return true;
+                if(text == "false") return false;
+                const char* first = text.data();
+                const char* last = text.data() + text.size();
+                if(!text.empty() && (std::isdigit(static_cast<unsigned char>(text[0])) || text[0] == '-' || text[0] == '.')) {
+                    int intValue = 0;
+                    auto intResult = std::from_chars(first, last, intValue);
+                    if(intResult.ec == std::errc() && intResult.ptr == last) return intValue;
+                    double doubleValue = 0;
+                    auto doubleResult = std::from_chars(first, last, doubleValue);
+                    if(doubleResult.ec == std::errc() && doubleResult.ptr == last) return doubleValue;
+                }
+                return std::move(text);
+            }
+        }
+
+        BulkLoader::BulkLoader(core::KeyValueStore& store, Format format, utils::ThreadPool* pool)
+            : store_(store), format_(format), pool_(pool && pool->size() > 1 ? pool : nullptr) {
+            pending_.reserve(BATCH_BYTES);
+        }
+
+        BulkLoader::~BulkLoader() {
+            // Workers borrow this loader; none may outlive it
+            for(auto& batch : inFlight_) {
+                if(batch.entries.valid()) batch.entries.wait();
+            }
+        }
+
+        bool BulkLoader::parseFormat(const std::string& name, Format& format) {
+            std::string lower = name;
+            for(auto& c : lower) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            if(lower == "ndjson" || lower == "json") format = Format::NDJSON;
+            else if(lower == "csv") format = Format::CSV;
+            else return false;
+            return true;
+        }
+
+        void BulkLoader::feed(const char* data, size_t length) {
+            pending_.append(data, length);
+
+            if(format_ == Format::CSV && !headerRead_) {
+                size_t newline = pending_.find('\n');
+                if(newline == std::string::npos) return;
+                std::string header = pending_.substr(0, newline);
+                if(!header.empty() && header.back() == '\r') header.pop_back();
+                std::vector<bool> quoted;
+                try {
+                    splitCsv(header, columns_, quoted);
+                }
+                catch(const std::exception& e) {
+                    throw exceptions::PersistenceException("CSV header: " + std::string(e.what()));
+                }
+                if(header.empty()) throw exceptions::PersistenceException("CSV input must start with a header line");
+                pending_.erase(0, newline + 1);
+                headerRead_ = true;
+                ++line_;
+            }
+
+            if(pending_.size() < BATCH_BYTES) return;
+            size_t cut = pending_.rfind('\n');
+            if(cut == std::string::npos) return; // one very long line; wait for its end
+            std::string rest = pending_.substr(cut + 1);
+            pending_.resize(cut + 1);
+            submit(std::move(pending_));
+            pending_ = std::move(rest);
+            pending_.reserve(BATCH_BYTES);
+        }
+
+        uint64_t BulkLoader::finish() {
+            if(format_ == Format::CSV && !headerRead_ && !pending_.empty()) {
+                feed("\n", 1);
+            }
+            if(!pending_.empty()) submit(std::move(pending_));
+            pending_.clear();
+            drain(0);
+            return records_;
+        }
+
+        void BulkLoader::submit(std::string data) {
+            const uint64_t firstLine = line_;
+            line_ += static_cast<uint64_t>(std::count(data.begin(), data.end(), '\n'));
+            if(!pool_) {
+                std::promise<Entries> parsed;
+                try {
+                    parsed.set_value(parse(data, firstLine));
+                }
+                catch(...) {
+                    parsed.set_exception(std::current_exception());
+                }
+                inFlight_.push_back({ firstLine, parsed.get_future() });
+                drain(0);
+                return;
+            }
+            inFlight_.push_back({ firstLine, pool_->submit([this, data = std::move(data), firstLine]() {
+                return parse(data, firstLine);
+            }) });
+            drain(pool_->size() * BATCHES_PER_WORKER);
+        }
+
+        void BulkLoader::drain(size_t keep) {
+            while(inFlight_.size() > keep) {
+                Batch batch = std::move(inFlight_.front());
+                inFlight_.pop_front();
+                Entries entries;
+                try {
+                    entries = batch.entries.get();
+                }
+                catch(const std::exception& e) {
+                    throw exceptions::KVStoreException("Bulk load failed in the batch starting at line " +
+                        std::to_string(batch.firstLine) + ": " + e.what());
+                }
+                const size_t count = entries.size();
+                try {
+                    // The batch was parsed against registry_: its types meet the store's here
+                    store_.putBatch(std::move(entries), &registry_);
+                }
+                catch(const exceptions::TypeMismatchException& e) {
+                    throw exceptions::KVStoreException("Bulk load failed in the batch starting at line " +
+                        std::to_string(batch.firstLine) + ": " + e.what());
+                }
+                records_ += count;
+            }
+        }
+
+        BulkLoader::Entries BulkLoader::parse(const std::string& data, uint64_t firstLine) const {
+            if(format_ == Format::NDJSON) {
+                return JsonReader::parseRecords(data.data(), data.size(), registry_);
+            }
+            return parseCsv(data, firstLine);
+        }
+
+        BulkLoader::Entries BulkLoader::parseCsv(const std::string& data, uint64_t firstLine) const {
+            // Types seen in this batch per column; each is registered once per batch
+            std::vector<std::optional<core::AttributeType>> types(columns_.size());
+            std::vector<std::string> fields;
+            std::vector<bool> quoted;
+            Entries entries;
+
+            size_t begin = 0;
+            uint64_t line = firstLine;
+            while(begin < data.size()) {
+                size_t end = data.find('\n', begin);
+                if(end == std::string::npos) end = data.size();
+                std::string_view text(data.data() + begin, end - begin);
+                begin = end + 1;
+                const uint64_t number = line++;
+                if(!text.empty() && text.back() == '\r') text.remove_suffix(1);
+                if(text.empty()) continue;
+
+                try {
+                    splitCsv(text, fields, quoted);
+                    if(fields.size() > columns_.size()) throw std::runtime_error("more fields than header columns");
+                }
+                catch(const std::exception& e) {
+                    throw std::runtime_error("line " + std::to_string(number) + ": " + e.what());
+                }
+
+                std::unordered_map<std::string, core::AttributeValue> attributes;
+                for(size_t i = 1; i < fields.size(); ++i) {
+                    if(fields[i].empty() && !quoted[i]) continue;
+                    core::AttributeValue value = quoted[i] ? core::AttributeValue(std::move(fields[i])) : typedField(std::move(fields[i]));
+                    core::AttributeType type = core::TypeRegistry::getTypeFromValue(value);
+                    if(!types[i]) {
+                        registry_.validateAndRegisterType(columns_[i], type);
+                        types[i] = type;
+                    }
+                    else if(*types[i] != type) {
+                        throw exceptions::TypeMismatchException(columns_[i],
+                            core::TypeRegistry::getTypeName(*types[i]), core::TypeRegistry::getTypeName(type));
+                    }
+                    attributes.emplace(columns_[i], std::move(value));
+                }
+                entries.emplace_back(std::move(fields[0]), std::make_unique<core::ValueObject>(std::move(attributes), registry_));
+            }
+            return entries;
+        }
+
+    }
+}
@@ -0,0 +1,135 @@
+#include "kvstore/persistence/DeltaSnapshot.hpp"
+#include "kvstore/persistence/BinaryCodec.hpp"
+#include "kvstore/persistence/PersistenceManager.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include "kvstore/utils/MappedFile.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace kvspp {
+    namespace persistence {
+
+        namespace {
+            constexpr char MAGIC[8] = { 'K', 'V', 'S', 'P', 'D', 'L', 'T', 'A' };
+            constexpr uint32_t FLAG_AUTOSAVE = 1;
+
+            enum class Op : uint8_t {
+                PUT = 1,
+                REMOVE = 2
+            };
+
+            void writeFile(const std::string& path, const std::string& content) {
+                std::filesystem::path filePath(path);
+                if(filePath.has_parent_path()) {
+                    std::filesystem::create_directories(filePath.parent_path());
+                }
+                std::ofstream file(path, std::ios::binary | std::ios::trunc);
+                if(!file) {
+                    throw exceptions::PersistenceException("Cannot open file for writing: " + path);
+                }
+                file.write(content.data(), static_cast<std::streamsize>(content.size()));
+                file.flush();
+                if(!file) {
+                    throw exceptions::PersistenceException("Failed to write " + path);
+                }
+            }
+        }
+
+        uint64_t DeltaSnapshot::write(const std::string& path, uint64_t sequence, bool autosave,
+            const std::vector<Change>& changes) {
+            std::string out(MAGIC, sizeof(MAGIC));
+            BinaryWriter::putU32(out, VERSION);
+            BinaryWriter::putU32(out, autosave ? FLAG_AUTOSAVE : 0);
+            BinaryWriter::putU64(out, sequence);
+            BinaryWriter::putU64(out, changes.size());
+            for(const auto& change : changes) {
+                BinaryWriter::putU8(out, static_cast<uint8_t>(change.value ? Op::PUT : Op::REMOVE));
+                BinaryWriter::putString(out, change.key);
+                if(change.value) BinaryWriter::putValueObject(out, *change.value);
+            }
+            BinaryWriter::putU32(out, utils::Checksum::crc32(out.data(), out.size()));
+
+            // Written under a temporary name so a torn segment is never picked up
+            std::string temporary = path + ".tmp";
+            writeFile(temporary, out);
+            PersistenceManager::commitFile(temporary, path);
+            return out.size();
+        }
+
+        void DeltaSnapshot::apply(const std::string& path, core::KeyValueStore& store) {
+            utils::MappedFile file(path);
+            const char* data = file.data();
+            const size_t size = file.size();
+            if(size < sizeof(MAGIC) + 4 || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+                throw exceptions::PersistenceException("Not a delta snapshot: " + path);
+            }
+            BinaryReader trailer(data + size - 4, 4);
+            if(utils::Checksum::crc32(data, size - 4) != trailer.u32()) {
+                throw exceptions::PersistenceException("Checksum mismatch in delta snapshot: " + path);
+            }
+
+            BinaryReader reader(data + sizeof(MAGIC), size - sizeof(MAGIC) - 4);
+            const uint32_t version = reader.u32();
+            if(version != VERSION) {
+                throw exceptions::PersistenceException("Unsupported delta snapshot version " + std::to_string(version));
+            }
+            const uint32_t flags = reader.u32();
+            reader.u64(); // sequence number, informational
+            const uint64_t count = reader.u64();
+            for(uint64_t i = 0; i < count; ++i) {
+                const auto op = static_cast<Op>(reader.u8());
+                std::string key = reader.string();
+                if(op == Op::PUT) {
+                    core::TypeRegistry types;
+                    core::ValueObject obj(types);
+                    reader.valueObject(obj);
+                    store.put(key, obj);
+                }
+                else if(op == Op::REMOVE) {
+                    store.deleteKey(key);
+                }
+                else {
+                    throw exceptions::PersistenceException("Unknown record in delta snapshot: " + path);
+                }
+            }
+            store.setAutosave((flags & FLAG_AUTOSAVE) != 0);
+        }
+
+        std::string DeltaManifest::pathFor(const std::string& basePath) {
+            return std::filesystem::path(basePath).replace_extension(".manifest").string();
+        }
+
+        std::optional<DeltaManifest> DeltaManifest::read(const std::string& path) {
+            std::ifstream file(path);
+            if(!file) return std::nullopt;
+
+            DeltaManifest manifest;
+            std::string line;
+            while(std::getline(file, line)) {
+                size_t space = line.find(' ');
+                if(space == std::string::npos) continue;
+                std::string kind = line.substr(0, space);
+                std::string name = line.substr(space + 1);
+                if(kind == "base") manifest.base = name;
+                else if(kind == "pending") manifest.pending = name;
+                else if(kind == "delta") manifest.deltas.push_back(name);
+                else throw exceptions::PersistenceException("Malformed manifest line in " + path + ": " + line);
+            }
+            return manifest;
+        }
+
+        void DeltaManifest::write(const std::string& path) const {
+            std::string content = "base " + base + "\n";
+            if(!pending.empty()) content += "pending " + pending + "\n";
+            for(const auto& delta : deltas) {
+                content += "delta " + delta + "\n";
+            }
+            std::string temporary = path + ".tmp";
+            writeFile(temporary, content);
+            PersistenceManager::commitFile(temporary, path);
+        }
+
+    }
+}
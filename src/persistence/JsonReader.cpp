@@ -0,0 +1,695 @@
+#include "kvstore/persistence/JsonReader.hpp"
+#include "kvstore/core/TypeRegistry.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KVSPP_JSON_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define KVSPP_JSON_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace kvspp {
+    namespace persistence {
+
+        namespace {
+            constexpr size_t BLOCK = 64;
+            // Bytes classified per refill of the structural index
+            constexpr size_t WINDOW = 64 * 1024;
+
+            // Per-block classification: one bit per input byte
+            struct BlockMasks {
+                uint64_t quote;
+                uint64_t backslash;
+                uint64_t structural;
+            };
+
+            inline int trailingZeros(uint64_t bits) {
+#ifdef _MSC_VER
+                unsigned long index;
+                _BitScanForward64(&index, bits);
+                return static_cast<int>(index);
+#else
+                return __builtin_ctzll(bits);
+#endif
+            }
+
+            // Inclusive prefix XOR: bit i = xor of bits 0..i
+            inline uint64_t prefixXor(uint64_t bits) {
+                bits ^= bits << 1;
+                bits ^= bits << 2;
+                bits ^= bits << 4;
+                bits ^= bits << 8;
+                bits ^= bits << 16;
+                bits ^= bits << 32;
+                return bits;
+            }
+
+#ifndef KVSPP_JSON_SSE2
+            BlockMasks classifyScalar(const char* p) {
+                BlockMasks masks{ 0, 0, 0 };
+                for(size_t i = 0; i < BLOCK; ++i) {
+                    const char c = p[i];
+                    const uint64_t bit = uint64_t(1) << i;
+                    if(c == '"') masks.quote |= bit;
+                    else if(c == '\\') masks.backslash |= bit;
+                    else if(c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',') masks.structural |= bit;
+                }
+                return masks;
+            }
+#endif
+
+#ifdef KVSPP_JSON_SSE2
+            BlockMasks classifySse2(const char* p) {
+                const __m128i quote = _mm_set1_epi8('"');
+                const __m128i backslash = _mm_set1_epi8('\\');
+                const __m128i openBrace = _mm_set1_epi8('{');
+                const __m128i closeBrace = _mm_set1_epi8('}');
+                const __m128i colon = _mm_set1_epi8(':');
+                const __m128i comma = _mm_set1_epi8(',');
+                const __m128i caseBit = _mm_set1_epi8(0x20);
+
+                BlockMasks masks{ 0, 0, 0 };
+                for(int lane = 0; lane < 4; ++lane) {
+                    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * lane));
+                    // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+                    const __m128i folded = _mm_or_si128(v, caseBit);
+                    const __m128i structural = _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi8(folded, openBrace), _mm_cmpeq_epi8(folded, closeBrace)),
+                        _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+                    const int shift = 16 * lane;
+                    masks.quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << shift;
+                    masks.backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << shift;
+                    masks.structural |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(structural))) << shift;
+                }
+                return masks;
+            }
+#endif
+
+#ifdef KVSPP_JSON_AVX2
+            __attribute__((target("avx2")))
+            BlockMasks classifyAvx2(const char* p) {
+                const __m256i quote = _mm256_set1_epi8('"');
+                const __m256i backslash = _mm256_set1_epi8('\\');
+                const __m256i openBrace = _mm256_set1_epi8('{');
+                const __m256i closeBrace = _mm256_set1_epi8('}');
+                const __m256i colon = _mm256_set1_epi8(':');
+                const __m256i comma = _mm256_set1_epi8(',');
+                const __m256i caseBit = _mm256_set1_epi8(0x20);
+
+                BlockMasks masks{ 0, 0, 0 };
+                for(int lane = 0; lane < 2; ++lane) {
+                    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * lane));
+                    const __m256i folded = _mm256_or_si256(v, caseBit);
+                    const __m256i structural = _mm256_or_si256(
+                        _mm256_or_si256(_mm256_cmpeq_epi8(folded, openBrace), _mm256_cmpeq_epi8(folded, closeBrace)),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)));
+                    const int shift = 32 * lane;
+                    masks.quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << shift;
+                    masks.backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)))) << shift;
+                    masks.structural |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(structural))) << shift;
+                }
+                return masks;
+            }
+#endif
+
+            using Classifier = BlockMasks(*)(const char*);
+
+            struct ClassifierChoice {
+                Classifier classify;
+                const char* name;
+            };
+
+            ClassifierChoice chooseClassifier() {
+#ifdef KVSPP_JSON_AVX2
+                if(__builtin_cpu_supports("avx2")) return { classifyAvx2, "avx2" };
+#endif
+#ifdef KVSPP_JSON_SSE2
+                return { classifySse2, "sse2" };
+#else
+                return { classifyScalar, "scalar" };
+#endif
+            }
+
+            const ClassifierChoice& classifier() {
+                static const ClassifierChoice choice = chooseClassifier();
+                return choice;
+            }
+        }
+
+        JsonStructuralScanner::JsonStructuralScanner(const char* data, size_t end, size_t begin)
+            : data_(data), end_(end), blockPos_(begin) {
+            index_.reserve(WINDOW / 4);
+        }
+
+        const char* JsonStructuralScanner::implementation() {
+            return classifier().name;
+        }
+
+        void JsonStructuralScanner::refill() {
+            index_.clear();
+            cursor_ = 0;
+            const Classifier classify = classifier().classify;
+
+            while(index_.empty() && blockPos_ < end_) {
+                const size_t windowEnd = std::min(end_, blockPos_ + WINDOW);
+                for(; blockPos_ < windowEnd; blockPos_ += BLOCK) {
+                    BlockMasks masks;
+                    if(end_ - blockPos_ >= BLOCK) {
+                        masks = classify(data_ + blockPos_);
+                    }
+                    else {
+                        // Pad the tail so the classifier can always read a full block
+                        char tail[BLOCK];
+                        std::memset(tail, ' ', BLOCK);
+                        std::memcpy(tail, data_ + blockPos_, end_ - blockPos_);
+                        masks = classify(tail);
+                    }
+
+                    // Characters escaped by a backslash; backslash runs are rare, so
+                    // walk them bit by bit, carrying a trailing escape into the next block
+                    uint64_t escaped = prevEscaped_;
+                    uint64_t backslashes = masks.backslash & ~escaped;
+                    prevEscaped_ = 0;
+                    while(backslashes) {
+                        const int bit = trailingZeros(backslashes);
+                        if(bit == 63) {
+                            prevEscaped_ = 1;
+                            break;
+                        }
+                        const uint64_t escapedBit = uint64_t(1) << (bit + 1);
+                        escaped |= escapedBit;
+                        backslashes &= ~((uint64_t(1) << bit) | escapedBit);
+                    }
+
+                    const uint64_t quotes = masks.quote & ~escaped;
+                    const uint64_t inString = prefixXor(quotes) ^ prevInString_;
+                    prevInString_ = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+
+                    // Opening quotes are the quote bits that start an in-string run
+                    uint64_t bits = (masks.structural & ~inString) | (quotes & inString);
+                    while(bits) {
+                        index_.push_back(blockPos_ + trailingZeros(bits));
+                        bits &= bits - 1;
+                    }
+                }
+            }
+        }
+
+        size_t JsonStructuralScanner::peek() {
+            if(cursor_ == index_.size()) {
+                refill();
+                if(index_.empty()) return END;
+            }
+            return index_[cursor_];
+        }
+
+        size_t JsonStructuralScanner::next() {
+            size_t pos = peek();
+            if(pos != END) ++cursor_;
+            return pos;
+        }
+
+        namespace {
+            struct StringHash {
+                using is_transparent = void;
+                size_t operator()(std::string_view value) const { return std::hash<std::string_view>{}(value); }
+            };
+
+            inline bool isSpace(char c) {
+                return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+            }
+
+            void appendUtf8(std::string& out, uint32_t codePoint) {
+                if(codePoint < 0x80) {
+                    out += static_cast<char>(codePoint);
+                }
+                else if(codePoint < 0x800) {
+                    out += static_cast<char>(0xC0 | (codePoint >> 6));
+                    out += static_cast<char>(0x80 | (codePoint & 0x3F));
+                }
+                else if(codePoint < 0x10000) {
+                    out += static_cast<char>(0xE0 | (codePoint >> 12));
+                    out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (codePoint & 0x3F));
+                }
+                else {
+                    out += static_cast<char>(0xF0 | (codePoint >> 18));
+                    out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+                    out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (codePoint & 0x3F));
+                }
+            }
+
+            using TypeCache = std::unordered_map<std::string, core::AttributeType, StringHash, std::equal_to<>>;
+            using Entries = std::vector<std::pair<std::string, std::unique_ptr<core::ValueObject>>>;
+
+            // Inputs below this size are parsed on the calling thread
+            constexpr size_t PARALLEL_THRESHOLD = 1 << 20;
+            // Chunks per worker, so uneven entries still balance
+            constexpr size_t CHUNKS_PER_WORKER = 4;
+
+            /**
+             * Recursive-descent parser for the snapshot format driven by the
+             * structural positions from JsonStructuralScanner. Attribute types are
+             * only collected here; registering them with the store's TypeRegistry is
+             * left to the caller so chunks can be parsed concurrently.
+             */
+            class StoreParser {
+            public:
+                StoreParser(const char* data, size_t end, size_t begin, core::TypeRegistry& registry)
+                    : data_(data), end_(end), scanner_(data, end, begin), registry_(registry) {
+                }
+
+                Entries entries;
+                bool hasAutosave = false;
+                bool autosave = false;
+                TypeCache types;
+
+                /**
+                 * Parse the whole document. With a chunk size set, the members of
+                 * the store object are not parsed but split into ranges of roughly
+                 * that many bytes, each starting at a member's opening quote; the
+                 * returned vector then holds those starts followed by the position
+                 * of the store's closing brace.
+                 */
+                std::vector<size_t> parseDocument(size_t chunkBytes = 0) {
+                    std::vector<size_t> bounds;
+                    expect('{');
+                    if(peekChar() == '}') {
+                        scanner_.next();
+                        return bounds;
+                    }
+                    while(true) {
+                        std::string key = parseString(expect('"'));
+                        expect(':');
+                        if(key != "store") skipValue();
+                        else if(chunkBytes == 0) parseStore();
+                        else bounds = splitStore(chunkBytes);
+                        if(!separator()) break;
+                    }
+                    return bounds;
+                }
+
+                // Parse store members up to the end of a range produced by parseDocument
+                void parseChunk() {
+                    while(scanner_.peek() != JsonStructuralScanner::END) {
+                        parseMember();
+                        size_t pos = scanner_.next();
+                        if(pos == JsonStructuralScanner::END) break;
+                        if(data_[pos] != ',') fail("expected ','", pos);
+                    }
+                }
+
+                // Newline-delimited records, {"key": "...", <attribute>: <scalar>, ...} one after another
+                void parseRecords() {
+                    while(scanner_.peek() != JsonStructuralScanner::END) {
+                        size_t open = scanner_.peek();
+                        std::optional<std::string> key;
+                        auto value = parseValueObject(&key);
+                        if(!key) fail("record without a string \"key\" member", open);
+                        entries.emplace_back(std::move(*key), std::move(value));
+                    }
+                }
+
+            private:
+                [[noreturn]] void fail(const std::string& message, size_t pos) const {
+                    throw exceptions::PersistenceException("Malformed JSON at offset " +
+                        (pos == JsonStructuralScanner::END ? std::to_string(end_) : std::to_string(pos)) + ": " + message);
+                }
+
+                char peekChar() {
+                    size_t pos = scanner_.peek();
+                    return pos == JsonStructuralScanner::END ? '\0' : data_[pos];
+                }
+
+                size_t expect(char c) {
+                    size_t pos = scanner_.next();
+                    if(pos == JsonStructuralScanner::END || data_[pos] != c) {
+                        fail(std::string("expected '") + c + "'", pos);
+                    }
+                    return pos;
+                }
+
+                // Consume ',' (returns true) or the closing '}' (returns false)
+                bool separator() {
+                    size_t pos = scanner_.next();
+                    if(pos != JsonStructuralScanner::END && data_[pos] == ',') return true;
+                    if(pos != JsonStructuralScanner::END && data_[pos] == '}') return false;
+                    fail("expected ',' or '}'", pos);
+                }
+
+                // Raw contents of the string opened at quotePos (escapes untouched)
+                std::string_view rawString(size_t quotePos) {
+                    // Only whitespace may separate the closing quote from the next structural
+                    size_t bound = scanner_.peek();
+                    size_t close = bound == JsonStructuralScanner::END ? end_ : bound;
+                    while(close > quotePos + 1 && isSpace(data_[close - 1])) --close;
+                    if(close <= quotePos + 1 || data_[close - 1] != '"') fail("unterminated string", quotePos);
+                    return std::string_view(data_ + quotePos + 1, close - quotePos - 2);
+                }
+
+                std::string parseString(size_t quotePos) {
+                    std::string_view raw = rawString(quotePos);
+                    if(raw.find('\\') == std::string_view::npos) return std::string(raw);
+                    return unescape(raw, quotePos);
+                }
+
+                std::string unescape(std::string_view raw, size_t pos) const {
+                    std::string result;
+                    result.reserve(raw.size());
+                    for(size_t i = 0; i < raw.size(); ++i) {
+                        if(raw[i] != '\\') {
+                            result += raw[i];
+                            continue;
+                        }
+                        if(++i == raw.size()) fail("dangling escape", pos);
+                        switch(raw[i]) {
+                        case '"': result += '"'; break;
+                        case '\\': result += '\\'; break;
+                        case '/': result += '/'; break;
+                        case 'b': result += '\b'; break;
+                        case 'f': result += '\f'; break;
+                        case 'n': result += '\n'; break;
+                        case 'r': result += '\r'; break;
+                        case 't': result += '\t'; break;
+                        case 'u': {
+                            uint32_t codePoint = hex4(raw, i + 1, pos);
+                            i += 4;
+                            if(codePoint >= 0xD800 && codePoint < 0xDC00 && i + 6 < raw.size() &&
+                                raw.substr(i + 1, 2) == "\\u") {
+                                uint32_t low = hex4(raw, i + 3, pos);
+                                if(low >= 0xDC00 && low < 0xE000) {
+                                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                                    i += 6;
+                                }
+                            }
+                            appendUtf8(result, codePoint);
+                            break;
+                        }
+                        default:
+                            fail("invalid escape", pos);
+                        }
+                    }
+                    return result;
+                }
+
+                uint32_t hex4(std::string_view raw, size_t at, size_t pos) const {
+                    if(at + 4 > raw.size()) fail("truncated \\u escape", pos);
+                    uint32_t value = 0;
+                    auto result = std::from_chars(raw.data() + at, raw.data() + at + 4, value, 16);
+                    if(result.ec != std::errc() || result.ptr != raw.data() + at + 4) fail("invalid \\u escape", pos);
+                    return value;
+                }
+
+                // Bare literal between a ':' and the next structural character
+                std::string_view scalarAfter(size_t colonPos) {
+                    size_t begin = colonPos + 1;
+                    size_t bound = scanner_.peek();
+                    size_t end = bound == JsonStructuralScanner::END ? end_ : bound;
+                    while(begin < end && isSpace(data_[begin])) ++begin;
+                    while(end > begin && isSpace(data_[end - 1])) --end;
+                    if(begin == end) fail("missing value", colonPos);
+                    return std::string_view(data_ + begin, end - begin);
+                }
+
+                core::AttributeValue parseScalar(std::string_view text, size_t pos) const {
+                    if(text == "true") return true;
+                    if(text == "false") return false;
+                    if(text == "null") return std::string(text);
+
+                    const char* first = text.data();
+                    const char* last = text.data() + text.size();
+                    if(text.find_first_of(".eE") == std::string_view::npos) {
+                        int intValue = 0;
+                        auto result = std::from_chars(first, last, intValue);
+                        if(result.ec == std::errc() && result.ptr == last) return intValue;
+                        if(result.ec != std::errc::result_out_of_range) fail("invalid literal", pos);
+                    }
+                    double doubleValue = 0;
+                    auto result = std::from_chars(first, last, doubleValue);
+                    if(result.ec != std::errc() || result.ptr != last) fail("invalid literal", pos);
+                    return doubleValue;
+                }
+
+                void parseStore() {
+                    expect('{');
+                    if(peekChar() == '}') {
+                        scanner_.next();
+                        return;
+                    }
+                    do {
+                        parseMember();
+                    } while(separator());
+                }
+
+                // One "key": value member of the store object
+                void parseMember() {
+                    std::string key = parseString(expect('"'));
+                    size_t colon = expect(':');
+                    char c = peekChar();
+                    if(c == '{') {
+                        entries.emplace_back(std::move(key), parseValueObject());
+                    }
+                    else if(c == '"') {
+                        scanner_.next();
+                    }
+                    else if(c == '[') {
+                        skipValue();
+                    }
+                    else {
+                        std::string_view text = scalarAfter(colon);
+                        if(key == "autosave") {
+                            hasAutosave = true;
+                            autosave = text == "true";
+                        }
+                    }
+                }
+
+                std::vector<size_t> splitStore(size_t chunkBytes) {
+                    std::vector<size_t> bounds;
+                    expect('{');
+                    size_t lastStart = 0;
+                    bool memberStart = true;
+                    int depth = 1;
+                    while(true) {
+                        size_t pos = scanner_.next();
+                        if(pos == JsonStructuralScanner::END) fail("unterminated store object", pos);
+                        char c = data_[pos];
+                        if(c == '"') {
+                            if(memberStart && (bounds.empty() || pos - lastStart >= chunkBytes)) {
+                                bounds.push_back(pos);
+                                lastStart = pos;
+                            }
+                            memberStart = false;
+                        }
+                        else if(c == '{' || c == '[') {
+                            ++depth;
+                        }
+                        else if(c == '}' || c == ']') {
+                            if(--depth == 0) {
+                                if(!bounds.empty()) bounds.push_back(pos);
+                                return bounds;
+                            }
+                        }
+                        else if(c == ',' && depth == 1) {
+                            memberStart = true;
+                        }
+                    }
+                }
+
+                // With recordKey set, a "key" member is taken out of the attributes into it
+                std::unique_ptr<core::ValueObject> parseValueObject(std::optional<std::string>* recordKey = nullptr) {
+                    expect('{');
+                    std::unordered_map<std::string, core::AttributeValue> attributes;
+                    if(peekChar() == '}') {
+                        scanner_.next();
+                        return std::make_unique<core::ValueObject>(std::move(attributes), registry_);
+                    }
+                    while(true) {
+                        size_t namePos = expect('"');
+                        std::string name = parseString(namePos);
+                        size_t colon = expect(':');
+                        core::AttributeValue value;
+                        char c = peekChar();
+                        if(recordKey && name == "key") {
+                            if(c != '"') fail("record key must be a string", colon);
+                            *recordKey = parseString(scanner_.next());
+                            if(!separator()) break;
+                            continue;
+                        }
+                        if(c == '"') {
+                            value = parseString(scanner_.next());
+                        }
+                        else if(c == '{' || c == '[') {
+                            fail("nested values are not supported", scanner_.peek());
+                        }
+                        else {
+                            value = parseScalar(scalarAfter(colon), colon);
+                        }
+                        checkType(name, core::TypeRegistry::getTypeFromValue(value));
+                        attributes[std::move(name)] = std::move(value);
+                        if(!separator()) break;
+                    }
+                    return std::make_unique<core::ValueObject>(std::move(attributes), registry_);
+                }
+
+                void checkType(const std::string& name, core::AttributeType type) {
+                    auto it = types.find(std::string_view(name));
+                    if(it == types.end()) {
+                        types.emplace(name, type);
+                    }
+                    else if(it->second != type) {
+                        throw exceptions::TypeMismatchException(name,
+                            core::TypeRegistry::getTypeName(it->second), core::TypeRegistry::getTypeName(type));
+                    }
+                }
+
+                void skipValue() {
+                    char c = peekChar();
+                    if(c == '"') {
+                        scanner_.next();
+                        return;
+                    }
+                    if(c != '{' && c != '[') return; // scalar: nothing to consume
+                    int depth = 0;
+                    do {
+                        size_t pos = scanner_.next();
+                        if(pos == JsonStructuralScanner::END) fail("unterminated value", pos);
+                        char s = data_[pos];
+                        if(s == '{' || s == '[') ++depth;
+                        else if(s == '}' || s == ']') --depth;
+                    } while(depth > 0);
+                }
+
+                const char* data_;
+                size_t end_;
+                JsonStructuralScanner scanner_;
+                core::TypeRegistry& registry_;
+            };
+
+            // Merge a chunk's attribute types into the combined schema
+            void mergeTypes(TypeCache& schema, const TypeCache& types) {
+                for(const auto& [name, type] : types) {
+                    auto [it, inserted] = schema.emplace(name, type);
+                    if(!inserted && it->second != type) {
+                        throw exceptions::TypeMismatchException(name,
+                            core::TypeRegistry::getTypeName(it->second), core::TypeRegistry::getTypeName(type));
+                    }
+                }
+            }
+        }
+
+        void JsonReader::verifyChecksum(const char* data, size_t size) {
+            // Walk back over ,"crc32":"xxxxxxxx"} from the end of the document
+            size_t pos = size;
+            auto skipSpace = [data, &pos]() {
+                while(pos > 0 && isSpace(data[pos - 1])) --pos;
+            };
+            auto expectBack = [data, &pos, &skipSpace](std::string_view text) {
+                skipSpace();
+                if(pos < text.size() || std::string_view(data + pos - text.size(), text.size()) != text) return false;
+                pos -= text.size();
+                return true;
+            };
+            if(!expectBack("}") || !expectBack("\"") || pos < 9) return;
+            pos -= 8;
+            uint32_t expected = 0;
+            auto [end, ec] = std::from_chars(data + pos, data + pos + 8, expected, 16);
+            if(ec != std::errc() || end != data + pos + 8 || !expectBack("\"") || !expectBack(":") ||
+                !expectBack("\"crc32\"") || !expectBack(",")) {
+                return;
+            }
+            if(utils::Checksum::crc32(data, pos) != expected) {
+                throw exceptions::PersistenceException("Checksum mismatch in JSON snapshot (torn or corrupted file)");
+            }
+        }
+
+        std::vector<std::pair<std::string, std::unique_ptr<core::ValueObject>>> JsonReader::parseRecords(
+            const char* data, size_t size, core::TypeRegistry& registry) {
+            StoreParser parser(data, size, 0, registry);
+            parser.parseRecords();
+            for(const auto& [name, type] : parser.types) {
+                registry.validateAndRegisterType(name, type);
+            }
+            return std::move(parser.entries);
+        }
+
+        void JsonReader::loadStore(core::KeyValueStore& store, const char* data, size_t size, utils::ThreadPool* pool) {
+            // Skip leading whitespace; an empty document leaves the store empty
+            size_t begin = 0;
+            while(begin < size && isSpace(data[begin])) ++begin;
+
+            // Parse into a fresh store (data and types) and publish it in one step
+            core::KeyValueStore staged;
+            core::TypeRegistry& registry = staged.getTypeRegistry();
+            TypeCache schema;
+            Entries entries;
+            bool hasAutosave = false;
+            bool autosave = false;
+
+            if(begin < size && (!pool || pool->size() < 2 || size < PARALLEL_THRESHOLD)) {
+                StoreParser parser(data, size, 0, registry);
+                parser.parseDocument();
+                schema = std::move(parser.types);
+                entries = std::move(parser.entries);
+                hasAutosave = parser.hasAutosave;
+                autosave = parser.autosave;
+            }
+            else if(begin < size) {
+                // Find member boundaries on this thread (stage 1 plus depth tracking
+                // only), then parse the ranges of the store object concurrently
+                StoreParser outline(data, size, 0, registry);
+                std::vector<size_t> bounds = outline.parseDocument(size / (pool->size() * CHUNKS_PER_WORKER) + 1);
+
+                std::vector<std::future<std::unique_ptr<StoreParser>>> chunks;
+                for(size_t i = 0; i + 1 < bounds.size(); ++i) {
+                    chunks.push_back(pool->submit([data, &registry, from = bounds[i], to = bounds[i + 1]]() {
+                        auto parser = std::make_unique<StoreParser>(data, to, from, registry);
+                        parser->parseChunk();
+                        return parser;
+                    }));
+                }
+
+                size_t total = 0;
+                auto parsed = utils::waitAll(chunks);
+                for(const auto& parser : parsed) {
+                    mergeTypes(schema, parser->types);
+                    total += parser->entries.size();
+                    if(parser->hasAutosave) {
+                        hasAutosave = true;
+                        autosave = parser->autosave;
+                    }
+                }
+                entries.reserve(total);
+                for(auto& parser : parsed) {
+                    std::move(parser->entries.begin(), parser->entries.end(), std::back_inserter(entries));
+                }
+            }
+
+            // Register the schema once for the whole snapshot
+            for(const auto& [name, type] : schema) {
+                registry.validateAndRegisterType(name, type);
+            }
+
+            staged.putBatch(std::move(entries));
+            staged.setAutosave(hasAutosave ? autosave : store.getAutosave());
+            store.swapContents(staged);
+        }
+
+    }
+}
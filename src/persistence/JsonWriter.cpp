@@ -0,0 +1,160 @@
+#include "kvstore/persistence/JsonWriter.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace kvspp {
+    namespace persistence {
+
+        JsonWriter::JsonWriter(Sink sink, size_t bufferSize)
+            : sink_(std::move(sink)), buffer_(bufferSize) {
+        }
+
+        void JsonWriter::flush() {
+            if(used_ == 0) return;
+            if(checksumming_) crc_ = utils::Checksum::crc32(buffer_.data(), used_, crc_);
+            sink_(buffer_.data(), used_);
+            used_ = 0;
+        }
+
+        void JsonWriter::put(char c) {
+            if(used_ == buffer_.size()) flush();
+            buffer_[used_++] = c;
+        }
+
+        void JsonWriter::raw(std::string_view text) {
+            while(!text.empty()) {
+                if(used_ == buffer_.size()) flush();
+                size_t chunk = std::min(text.size(), buffer_.size() - used_);
+                std::memcpy(buffer_.data() + used_, text.data(), chunk);
+                used_ += chunk;
+                text.remove_prefix(chunk);
+            }
+        }
+
+        void JsonWriter::string(std::string_view value) {
+            static const char HEX[] = "0123456789abcdef";
+            put('"');
+            size_t runStart = 0;
+            for(size_t i = 0; i < value.size(); ++i) {
+                unsigned char c = static_cast<unsigned char>(value[i]);
+                if(c >= 0x20 && c != '"' && c != '\\') continue;
+
+                // Copy the run of plain characters before the one needing escaping
+                raw(value.substr(runStart, i - runStart));
+                runStart = i + 1;
+                switch(c) {
+                case '"': raw("\\\""); break;
+                case '\\': raw("\\\\"); break;
+                case '\b': raw("\\b"); break;
+                case '\f': raw("\\f"); break;
+                case '\n': raw("\\n"); break;
+                case '\r': raw("\\r"); break;
+                case '\t': raw("\\t"); break;
+                default: {
+                    char escaped[6] = { '\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF] };
+                    raw(std::string_view(escaped, sizeof(escaped)));
+                    break;
+                }
+                }
+            }
+            raw(value.substr(runStart));
+            put('"');
+        }
+
+        void JsonWriter::attributeValue(const core::AttributeValue& value) {
+            if(std::holds_alternative<std::string>(value)) {
+                string(std::get<std::string>(value));
+            }
+            else if(std::holds_alternative<int>(value)) {
+                raw(std::to_string(std::get<int>(value)));
+            }
+            else if(std::holds_alternative<double>(value)) {
+                raw(std::to_string(std::get<double>(value)));
+            }
+            else if(std::holds_alternative<bool>(value)) {
+                raw(std::get<bool>(value) ? "true" : "false");
+            }
+            else {
+                raw("null");
+            }
+        }
+
+        void JsonWriter::valueObject(const core::ValueObject& obj) {
+            raw("{\n");
+            const auto& attributes = obj.getAttributes();
+            size_t count = 0;
+            for(const auto& [key, value] : attributes) {
+                raw("      ");
+                string(key);
+                raw(": ");
+                attributeValue(value);
+                if(++count < attributes.size()) {
+                    put(',');
+                }
+                put('\n');
+            }
+            raw("    }");
+        }
+
+        void JsonWriter::store(const core::KeyValueStore& store, Style style, const KeysCallback& onKeys) {
+            const bool pretty = style == Style::PRETTY;
+            // A snapshot starts with the store object, so the checksum covers the whole document
+            if(pretty) {
+                checksumming_ = true;
+                crc_ = 0;
+            }
+            raw(pretty ? "{\n  \"store\": {\n" : "{\"store\": {");
+
+            // Only the key list is materialized; each entry is serialized straight
+            // into the buffer, which is flushed to the sink as it fills
+            auto keys = store.keys();
+            if(onKeys) onKeys(keys);
+            size_t count = 0;
+            // Values are copied out under the store lock (a concurrent write may free
+            // them), not serialized under it: a flush may block on a slow sink
+            for(const auto& key : keys) {
+                if(pretty) {
+                    auto valueObj = store.getCopy(key);
+                    if(!valueObj) continue;
+                    raw("    ");
+                    string(key);
+                    raw(": ");
+                    valueObject(*valueObj);
+                    raw(",\n");
+                }
+                else {
+                    std::string value;
+                    if(!store.peek(key, [&value](const core::ValueObject& obj) { value = obj.getValueString(); })) continue;
+                    if(count > 0) put(',');
+                    string(key);
+                    raw(":{\"value\":");
+                    string(value);
+                    put('}');
+                }
+                ++count;
+            }
+
+            bool autosave = store.hasAutosave() ? store.getAutosave() : false;
+            if(pretty) {
+                raw("    \"autosave\": ");
+                raw(autosave ? "true" : "false");
+                raw("\n  }");
+                flush();
+                checksumming_ = false;
+                char trailer[40];
+                std::snprintf(trailer, sizeof(trailer), ",\n  \"crc32\": \"%08x\"\n}", static_cast<unsigned>(crc_));
+                raw(trailer);
+            }
+            else {
+                if(count > 0) put(',');
+                raw("\"autosave\":");
+                raw(autosave ? "true" : "false");
+                raw("}}");
+            }
+        }
+
+    }
+}
@@ -0,0 +1,716 @@
+#include "kvstore/persistence/LogStructuredStorage.hpp"
+#include "kvstore/persistence/BinaryCodec.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unordered_set>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace kvspp {
+    namespace persistence {
+
+        namespace {
+            constexpr size_t HEADER_SIZE = 20;
+            constexpr uint32_t TOMBSTONE = 0xFFFFFFFF;
+            constexpr uint32_t CLEARED = 0xFFFFFFFE;
+            constexpr char HINT_MAGIC[8] = { 'K', 'V', 'S', 'P', 'H', 'I', 'N', 'T' };
+            constexpr const char* SCHEMA_FILE = "schema";
+            // Writes and scans are done in chunks of about this size
+            constexpr size_t IO_CHUNK = 1 << 20;
+
+            std::string errnoMessage(const std::string& what, const std::string& path) {
+                return what + " '" + path + "': " + std::strerror(errno);
+            }
+
+            uint64_t recordSize(size_t keyLength, uint32_t valueLength) {
+                return HEADER_SIZE + keyLength + (valueLength >= CLEARED ? 0 : valueLength);
+            }
+
+            void appendRecord(std::string& out, uint64_t version, std::string_view key, uint32_t valueLength,
+                std::string_view value) {
+                const size_t start = out.size();
+                BinaryWriter::putU32(out, 0);
+                BinaryWriter::putU64(out, version);
+                BinaryWriter::putU32(out, static_cast<uint32_t>(key.size()));
+                BinaryWriter::putU32(out, valueLength);
+                out.append(key);
+                out.append(value);
+                const uint32_t crc = utils::Checksum::crc32(out.data() + start + 4, out.size() - start - 4);
+                std::string encoded;
+                BinaryWriter::putU32(encoded, crc);
+                out.replace(start, 4, encoded);
+            }
+
+            // Parsed header of a record; false if the bytes cannot be a record
+            bool parseHeader(const char* data, uint32_t& crc, uint64_t& version, uint32_t& keyLength, uint32_t& valueLength) {
+                BinaryReader reader(data, HEADER_SIZE);
+                crc = reader.u32();
+                version = reader.u64();
+                keyLength = reader.u32();
+                valueLength = reader.u32();
+                return version != 0;
+            }
+
+            bool verifyRecord(const char* record, size_t length, uint32_t crc) {
+                return utils::Checksum::crc32(record + 4, length - 4) == crc;
+            }
+
+            void writeAll(int fd, const char* data, size_t length, const std::string& path) {
+                while(length > 0) {
+#ifdef _WIN32
+                    int written = _write(fd, data, static_cast<unsigned int>(length));
+#else
+                    ssize_t written = ::write(fd, data, length);
+#endif
+                    if(written < 0) {
+                        if(errno == EINTR) continue;
+                        throw exceptions::PersistenceException(errnoMessage("Cannot write data file", path));
+                    }
+                    data += written;
+                    length -= static_cast<size_t>(written);
+                }
+            }
+
+            void syncDirectory(const std::string& path) {
+#ifndef _WIN32
+                int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if(fd < 0) return;
+                ::fsync(fd);
+                ::close(fd);
+#else
+                (void)path;
+#endif
+            }
+        }
+
+        // An open data file. Sealed files are immutable; files dropped by merge()
+        // are deleted (with their hint) once the last reader lets go of them.
+        struct LogStructuredStorage::DataFile {
+            uint32_t id = 0;
+            std::string path;
+            std::string hint;
+            int fd = -1;
+            uint64_t size = 0;          // guarded by LogStructuredStorage::mtx_
+            uint64_t staleBytes = 0;    // guarded by LogStructuredStorage::mtx_
+            bool hasHint = false;       // guarded by LogStructuredStorage::mtx_
+            std::atomic<bool> obsolete{ false };
+#ifdef _WIN32
+            mutable std::mutex ioMutex; // _lseeki64 + _read are not atomic
+#endif
+
+            ~DataFile() {
+                if(fd >= 0) {
+#ifdef _WIN32
+                    _close(fd);
+#else
+                    ::close(fd);
+#endif
+                }
+                if(obsolete) {
+                    std::error_code ec;
+                    std::filesystem::remove(hint, ec);
+                    std::filesystem::remove(path, ec);
+                }
+            }
+
+            void readAt(uint64_t offset, char* out, size_t length) const {
+#ifdef _WIN32
+                std::lock_guard<std::mutex> lock(ioMutex);
+                if(_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+                    throw exceptions::PersistenceException(errnoMessage("Cannot seek data file", path));
+                }
+#endif
+                while(length > 0) {
+#ifdef _WIN32
+                    int got = _read(fd, out, static_cast<unsigned int>(length));
+#else
+                    ssize_t got = ::pread(fd, out, length, static_cast<off_t>(offset));
+#endif
+                    if(got < 0) {
+                        if(errno == EINTR) continue;
+                        throw exceptions::PersistenceException(errnoMessage("Cannot read data file", path));
+                    }
+                    if(got == 0) {
+                        throw exceptions::PersistenceException("Unexpected end of data file: " + path);
+                    }
+                    out += got;
+                    offset += static_cast<uint64_t>(got);
+                    length -= static_cast<size_t>(got);
+                }
+            }
+
+            void sync() const {
+#ifdef _WIN32
+                int rc = _commit(fd);
+#elif defined(__linux__)
+                int rc = ::fdatasync(fd);
+#else
+                int rc = ::fsync(fd);
+#endif
+                if(rc != 0) {
+                    throw exceptions::PersistenceException(errnoMessage("Cannot fsync data file", path));
+                }
+            }
+        };
+
+        LogStructuredStorage::LogStructuredStorage(const std::string& directory, core::TypeRegistry& registry,
+            const Options& options)
+            : directory_(directory), options_(options) {
+            std::filesystem::create_directories(directory_);
+            recover(registry);
+        }
+
+        LogStructuredStorage::~LogStructuredStorage() {
+            try {
+                if(active_) active_->sync();
+            }
+            catch(const std::exception&) {
+                // Nothing sensible to do while shutting down
+            }
+        }
+
+        std::string LogStructuredStorage::dataPath(uint32_t id) const {
+            char name[16];
+            std::snprintf(name, sizeof(name), "%08u.data", id);
+            return (std::filesystem::path(directory_) / name).string();
+        }
+
+        std::string LogStructuredStorage::hintPath(uint32_t id) const {
+            return std::filesystem::path(dataPath(id)).replace_extension(".hint").string();
+        }
+
+        std::shared_ptr<LogStructuredStorage::DataFile> LogStructuredStorage::openFile(uint32_t id, bool writable) const {
+            auto file = std::make_shared<DataFile>();
+            file->id = id;
+            file->path = dataPath(id);
+            file->hint = hintPath(id);
+#ifdef _WIN32
+            file->fd = writable
+                ? _open(file->path.c_str(), _O_RDWR | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE)
+                : _open(file->path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+            file->fd = writable
+                ? ::open(file->path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644)
+                : ::open(file->path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+            if(file->fd < 0) {
+                throw exceptions::PersistenceException(errnoMessage("Cannot open data file", file->path));
+            }
+            file->size = std::filesystem::file_size(file->path);
+            return file;
+        }
+
+        void LogStructuredStorage::rotate() {
+            const uint32_t id = nextFileId_++;
+            active_ = openFile(id, true);
+            files_[id] = active_;
+        }
+
+        uint64_t LogStructuredStorage::appendActive(const std::string& records) {
+            const uint64_t offset = active_->size;
+            writeAll(active_->fd, records.data(), records.size(), active_->path);
+            active_->size += records.size();
+            if(options_.syncEveryWrite) active_->sync();
+            return offset;
+        }
+
+        void LogStructuredStorage::markStale(const Location& location, size_t keyLength) {
+            auto it = files_.find(location.fileId);
+            if(it != files_.end()) it->second->staleBytes += recordSize(keyLength, location.valueLength);
+        }
+
+        std::optional<core::ValueObject> LogStructuredStorage::read(const std::string& key, core::TypeRegistry& registry) const {
+            Location location;
+            std::shared_ptr<DataFile> file;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                auto it = keyDir_.find(key);
+                if(it == keyDir_.end()) return std::nullopt;
+                location = it->second;
+                file = files_.at(location.fileId);
+            }
+
+            // The file stays open (even if a merge drops it meanwhile) while we hold it
+            std::string record(recordSize(key.size(), location.valueLength), '\0');
+            file->readAt(location.offset, record.data(), record.size());
+            uint32_t crc, keyLength, valueLength;
+            uint64_t version;
+            parseHeader(record.data(), crc, version, keyLength, valueLength);
+            if(version != location.version || keyLength != key.size() || !verifyRecord(record.data(), record.size(), crc) ||
+                record.compare(HEADER_SIZE, key.size(), key) != 0) {
+                throw exceptions::PersistenceException("Corrupt record for key '" + key + "' in " + file->path);
+            }
+
+            core::ValueObject value(registry);
+            BinaryReader reader(record.data() + HEADER_SIZE + keyLength, valueLength);
+            reader.valueObject(value);
+            return value;
+        }
+
+        bool LogStructuredStorage::contains(const std::string& key) const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return keyDir_.count(key) != 0;
+        }
+
+        void LogStructuredStorage::put(const std::string& key, const core::ValueObject& value) {
+            putBatch({ { &key, &value } });
+        }
+
+        void LogStructuredStorage::putBatch(const std::vector<std::pair<const std::string*, const core::ValueObject*>>& entries) {
+            std::lock_guard<std::mutex> lock(mtx_);
+
+            // Records are buffered and written in chunks; key directory entries are
+            // updated once their chunk is in the file
+            std::string buffer;
+            std::vector<std::pair<const std::string*, Location>> pending;
+            auto flush = [&]() {
+                if(buffer.empty()) return;
+                const uint64_t base = appendActive(buffer);
+                for(auto& [key, location] : pending) {
+                    location.offset += base;
+                    auto [it, inserted] = keyDir_.try_emplace(*key, location);
+                    if(inserted) {
+                        keyBytes_ += key->size();
+                    }
+                    else {
+                        markStale(it->second, key->size());
+                        it->second = location;
+                    }
+                }
+                buffer.clear();
+                pending.clear();
+            };
+
+            std::string encoded;
+            for(const auto& [key, value] : entries) {
+                encoded.clear();
+                BinaryWriter::putValueObject(encoded, *value);
+                if(encoded.size() >= CLEARED) {
+                    throw exceptions::PersistenceException("Value too large for key '" + *key + "'");
+                }
+                const uint64_t size = recordSize(key->size(), static_cast<uint32_t>(encoded.size()));
+                if(active_->size + buffer.size() + size > options_.maxFileSize && active_->size + buffer.size() > 0) {
+                    flush();
+                    rotate();
+                }
+                const uint64_t version = nextVersion_++;
+                pending.push_back({ key, { active_->id, static_cast<uint32_t>(encoded.size()), buffer.size(), version } });
+                appendRecord(buffer, version, *key, static_cast<uint32_t>(encoded.size()), encoded);
+                if(buffer.size() >= IO_CHUNK) flush();
+            }
+            flush();
+        }
+
+        bool LogStructuredStorage::remove(const std::string& key) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = keyDir_.find(key);
+            if(it == keyDir_.end()) return false;
+
+            std::string record;
+            appendRecord(record, nextVersion_++, key, TOMBSTONE, {});
+            if(active_->size + record.size() > options_.maxFileSize && active_->size > 0) rotate();
+            appendActive(record);
+            // The tombstone only matters until the records it shadows are merged away
+            active_->staleBytes += record.size();
+            markStale(it->second, key.size());
+            keyBytes_ -= key.size();
+            keyDir_.erase(it);
+            return true;
+        }
+
+        void LogStructuredStorage::clear() {
+            std::lock_guard<std::mutex> lock(mtx_);
+
+            // The marker goes to a fresh file and is made durable before the older
+            // files (whose records it supersedes) are deleted
+            rotate();
+            std::string record;
+            appendRecord(record, nextVersion_++, {}, CLEARED, {});
+            appendActive(record);
+            active_->staleBytes += record.size();
+            active_->sync();
+            syncDirectory(directory_);
+
+            for(auto it = files_.begin(); it != files_.end();) {
+                if(it->second == active_) {
+                    ++it;
+                    continue;
+                }
+                it->second->obsolete = true;
+                it = files_.erase(it);
+            }
+            keyDir_.clear();
+            keyBytes_ = 0;
+        }
+
+        std::vector<std::string> LogStructuredStorage::keys() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            std::vector<std::string> result;
+            result.reserve(keyDir_.size());
+            for(const auto& entry : keyDir_) {
+                result.push_back(entry.first);
+            }
+            return result;
+        }
+
+        size_t LogStructuredStorage::size() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return keyDir_.size();
+        }
+
+        size_t LogStructuredStorage::memoryUsage() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return keyDir_.size() * (2 * sizeof(void*) + sizeof(std::pair<const std::string, Location>)) + keyBytes_;
+        }
+
+        void LogStructuredStorage::saveSchema(const core::TypeRegistry& registry) {
+            auto types = registry.getAllTypes();
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if(types.size() <= schemaTypes_) return;
+                schemaTypes_ = types.size();
+            }
+
+            std::string out;
+            BinaryWriter::putU32(out, static_cast<uint32_t>(types.size()));
+            for(const auto& [name, type] : types) {
+                BinaryWriter::putString(out, name);
+                BinaryWriter::putU8(out, static_cast<uint8_t>(type));
+            }
+            BinaryWriter::putU32(out, utils::Checksum::crc32(out.data(), out.size()));
+
+            const std::string path = (std::filesystem::path(directory_) / SCHEMA_FILE).string();
+            {
+                std::ofstream file(path + ".tmp", std::ios::binary | std::ios::trunc);
+                file.write(out.data(), static_cast<std::streamsize>(out.size()));
+                if(!file) throw exceptions::PersistenceException("Cannot write schema: " + path);
+            }
+            std::filesystem::rename(path + ".tmp", path);
+        }
+
+        void LogStructuredStorage::loadSchema(core::TypeRegistry& registry) {
+            const std::string path = (std::filesystem::path(directory_) / SCHEMA_FILE).string();
+            std::ifstream file(path, std::ios::binary);
+            if(!file) return;
+            std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            if(data.size() < 8) return;
+
+            BinaryReader crcReader(data.data() + data.size() - 4, 4);
+            if(utils::Checksum::crc32(data.data(), data.size() - 4) != crcReader.u32()) {
+                throw exceptions::PersistenceException("Checksum mismatch in schema: " + path);
+            }
+            BinaryReader reader(data.data(), data.size() - 4);
+            const uint32_t count = reader.u32();
+            for(uint32_t i = 0; i < count; ++i) {
+                std::string name = reader.string();
+                registry.validateAndRegisterType(name, static_cast<core::AttributeType>(reader.u8()));
+            }
+            schemaTypes_ = count;
+        }
+
+        void LogStructuredStorage::sync() {
+            std::shared_ptr<DataFile> active;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                active = active_;
+            }
+            active->sync();
+        }
+
+        bool LogStructuredStorage::mergeNeeded() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            uint64_t total = 0;
+            uint64_t stale = 0;
+            for(const auto& [id, file] : files_) {
+                if(file == active_) continue;
+                total += file->size;
+                stale += file->staleBytes;
+            }
+            return stale > 0 && stale >= options_.mergeMinBytes &&
+                static_cast<double>(stale) >= options_.mergeRatio * static_cast<double>(total);
+        }
+
+        void LogStructuredStorage::merge() {
+            std::lock_guard<std::mutex> mergeLock(mergeMutex_);
+
+            // Seal the active file and take every sealed file with the live records in it
+            std::vector<std::shared_ptr<DataFile>> inputs;
+            std::vector<IndexEntry> live;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if(active_->size > 0) rotate();
+                std::unordered_set<uint32_t> ids;
+                for(const auto& [id, file] : files_) {
+                    if(file == active_) continue;
+                    inputs.push_back(file);
+                    ids.insert(id);
+                }
+                if(inputs.empty()) return;
+                for(const auto& [key, location] : keyDir_) {
+                    if(ids.count(location.fileId)) live.push_back({ key, location });
+                }
+            }
+            std::sort(live.begin(), live.end(), [](const IndexEntry& a, const IndexEntry& b) {
+                return a.location.fileId != b.location.fileId ? a.location.fileId < b.location.fileId
+                    : a.location.offset < b.location.offset;
+            });
+            std::unordered_map<uint32_t, std::shared_ptr<DataFile>> inputById;
+            for(const auto& file : inputs) inputById[file->id] = file;
+
+            // Copy the live records (unchanged, versions included) into new files
+            std::vector<std::pair<std::shared_ptr<DataFile>, std::vector<IndexEntry>>> outputs;
+            std::string buffer;
+            auto flush = [&]() {
+                if(buffer.empty()) return;
+                auto& output = outputs.back().first;
+                writeAll(output->fd, buffer.data(), buffer.size(), output->path);
+                output->size += buffer.size();
+                buffer.clear();
+            };
+            auto finish = [&]() {
+                if(outputs.empty()) return;
+                flush();
+                outputs.back().first->sync();
+                writeHint(outputs.back().first->hint, outputs.back().second);
+                outputs.back().first->hasHint = true;
+            };
+
+            std::string record;
+            for(const auto& entry : live) {
+                const uint64_t size = recordSize(entry.key.size(), entry.location.valueLength);
+                record.resize(size);
+                inputById.at(entry.location.fileId)->readAt(entry.location.offset, record.data(), size);
+                uint32_t crc, keyLength, valueLength;
+                uint64_t version;
+                parseHeader(record.data(), crc, version, keyLength, valueLength);
+                if(version != entry.location.version || !verifyRecord(record.data(), size, crc)) {
+                    throw exceptions::PersistenceException("Corrupt record for key '" + entry.key + "' during merge");
+                }
+
+                if(outputs.empty() || outputs.back().first->size + buffer.size() + size > options_.maxFileSize) {
+                    finish();
+                    uint32_t id;
+                    {
+                        std::lock_guard<std::mutex> lock(mtx_);
+                        id = nextFileId_++;
+                    }
+                    outputs.push_back({ openFile(id, true), {} });
+                }
+                auto& [output, entries] = outputs.back();
+                entries.push_back({ entry.key, { output->id, entry.location.valueLength, output->size + buffer.size(), version } });
+                buffer += record;
+                if(buffer.size() >= IO_CHUNK) flush();
+            }
+            finish();
+            syncDirectory(directory_);
+
+            // Publish: point keys that were not written meanwhile at their new records
+            std::lock_guard<std::mutex> lock(mtx_);
+            for(auto& [output, entries] : outputs) {
+                for(const auto& entry : entries) {
+                    auto it = keyDir_.find(entry.key);
+                    if(it != keyDir_.end() && it->second.version == entry.location.version) {
+                        it->second = entry.location;
+                    }
+                    else {
+                        output->staleBytes += recordSize(entry.key.size(), entry.location.valueLength);
+                    }
+                }
+                files_[output->id] = output;
+            }
+            for(const auto& file : inputs) {
+                file->obsolete = true;
+                files_.erase(file->id);
+            }
+            ++merges_;
+        }
+
+        void LogStructuredStorage::writeMissingHints() {
+            std::lock_guard<std::mutex> mergeLock(mergeMutex_);
+            std::vector<std::shared_ptr<DataFile>> sealed;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                for(const auto& [id, file] : files_) {
+                    if(file != active_ && !file->hasHint) sealed.push_back(file);
+                }
+            }
+            for(const auto& file : sealed) {
+                writeHint(file->hint, scanFile(*file));
+                std::lock_guard<std::mutex> lock(mtx_);
+                file->hasHint = true;
+            }
+        }
+
+        LogStructuredStorage::Stats LogStructuredStorage::stats() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            Stats stats;
+            stats.keys = keyDir_.size();
+            stats.files = files_.size();
+            for(const auto& [id, file] : files_) {
+                stats.diskBytes += file->size;
+                stats.staleBytes += file->staleBytes;
+            }
+            stats.merges = merges_;
+            return stats;
+        }
+
+        std::vector<LogStructuredStorage::IndexEntry> LogStructuredStorage::indexFile(const DataFile& file) const {
+            std::vector<IndexEntry> entries;
+            if(readHint(file.hint, file.id, entries)) return entries;
+            return scanFile(file);
+        }
+
+        std::vector<LogStructuredStorage::IndexEntry> LogStructuredStorage::scanFile(const DataFile& file) {
+            std::vector<IndexEntry> entries;
+            std::string window;
+            uint64_t windowStart = 0;
+            // Make [offset, offset + length) available in window; false past the end of the file
+            auto ensure = [&](uint64_t offset, uint64_t length) {
+                if(offset + length > file.size) return false;
+                if(offset >= windowStart && offset + length <= windowStart + window.size()) return true;
+                windowStart = offset;
+                window.resize(static_cast<size_t>(std::min<uint64_t>(std::max<uint64_t>(length, IO_CHUNK), file.size - offset)));
+                file.readAt(offset, window.data(), window.size());
+                return true;
+            };
+
+            uint64_t offset = 0;
+            while(ensure(offset, HEADER_SIZE)) {
+                uint32_t crc, keyLength, valueLength;
+                uint64_t version;
+                if(!parseHeader(window.data() + (offset - windowStart), crc, version, keyLength, valueLength)) break;
+                const uint64_t size = recordSize(keyLength, valueLength);
+                if(!ensure(offset, size)) break;   // torn tail
+                const char* record = window.data() + (offset - windowStart);
+                if(!verifyRecord(record, size, crc)) break;
+                entries.push_back({ std::string(record + HEADER_SIZE, keyLength), { file.id, valueLength, offset, version } });
+                offset += size;
+            }
+            return entries;
+        }
+
+        bool LogStructuredStorage::readHint(const std::string& path, uint32_t fileId, std::vector<IndexEntry>& entries) {
+            std::ifstream file(path, std::ios::binary);
+            if(!file) return false;
+            std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            if(data.size() < sizeof(HINT_MAGIC) + 8 || std::memcmp(data.data(), HINT_MAGIC, sizeof(HINT_MAGIC)) != 0) {
+                return false;
+            }
+            BinaryReader crcReader(data.data() + data.size() - 4, 4);
+            if(utils::Checksum::crc32(data.data(), data.size() - 4) != crcReader.u32()) return false;
+
+            try {
+                BinaryReader reader(data.data() + sizeof(HINT_MAGIC), data.size() - sizeof(HINT_MAGIC) - 4);
+                const uint32_t count = reader.u32();
+                entries.reserve(count);
+                for(uint32_t i = 0; i < count; ++i) {
+                    Location location;
+                    location.fileId = fileId;
+                    location.version = reader.u64();
+                    location.offset = reader.u64();
+                    location.valueLength = reader.u32();
+                    entries.push_back({ reader.string(), location });
+                }
+            }
+            catch(const exceptions::PersistenceException&) {
+                entries.clear();
+                return false;
+            }
+            return true;
+        }
+
+        void LogStructuredStorage::writeHint(const std::string& path, const std::vector<IndexEntry>& entries) {
+            std::string out(HINT_MAGIC, sizeof(HINT_MAGIC));
+            BinaryWriter::putU32(out, static_cast<uint32_t>(entries.size()));
+            for(const auto& entry : entries) {
+                BinaryWriter::putU64(out, entry.location.version);
+                BinaryWriter::putU64(out, entry.location.offset);
+                BinaryWriter::putU32(out, entry.location.valueLength);
+                BinaryWriter::putString(out, entry.key);
+            }
+            BinaryWriter::putU32(out, utils::Checksum::crc32(out.data(), out.size()));
+
+            {
+                std::ofstream file(path + ".tmp", std::ios::binary | std::ios::trunc);
+                file.write(out.data(), static_cast<std::streamsize>(out.size()));
+                if(!file) throw exceptions::PersistenceException("Cannot write hint file: " + path);
+            }
+            std::filesystem::rename(path + ".tmp", path);
+        }
+
+        void LogStructuredStorage::recover(core::TypeRegistry& registry) {
+            loadSchema(registry);
+
+            std::vector<uint32_t> ids;
+            for(const auto& entry : std::filesystem::directory_iterator(directory_)) {
+                const auto& path = entry.path();
+                if(path.extension() == ".tmp") {
+                    std::filesystem::remove(path);
+                    continue;
+                }
+                if(path.extension() != ".data") continue;
+                try {
+                    ids.push_back(static_cast<uint32_t>(std::stoul(path.stem().string())));
+                }
+                catch(const std::exception&) {
+                    // Not one of ours
+                }
+            }
+            std::sort(ids.begin(), ids.end());
+
+            // Newest version of every key wins, whatever file it is in; tombstones
+            // stay in the directory until all files are read
+            uint64_t clearedBefore = 0;
+            uint64_t maxVersion = 0;
+            for(uint32_t id : ids) {
+                auto file = openFile(id, false);
+                auto entries = indexFile(*file);
+                file->hasHint = std::filesystem::exists(file->hint);
+                for(auto& entry : entries) {
+                    maxVersion = std::max(maxVersion, entry.location.version);
+                    if(entry.location.valueLength == CLEARED) {
+                        clearedBefore = std::max(clearedBefore, entry.location.version);
+                        continue;
+                    }
+                    auto [it, inserted] = keyDir_.try_emplace(std::move(entry.key), entry.location);
+                    if(!inserted && entry.location.version > it->second.version) it->second = entry.location;
+                }
+                files_[id] = file;
+                nextFileId_ = std::max(nextFileId_, id + 1);
+            }
+
+            std::unordered_map<uint32_t, uint64_t> liveBytes;
+            for(auto it = keyDir_.begin(); it != keyDir_.end();) {
+                if(it->second.valueLength == TOMBSTONE || it->second.version < clearedBefore) {
+                    it = keyDir_.erase(it);
+                    continue;
+                }
+                liveBytes[it->second.fileId] += recordSize(it->first.size(), it->second.valueLength);
+                keyBytes_ += it->first.size();
+                ++it;
+            }
+            for(auto& [id, file] : files_) {
+                file->staleBytes = file->size - liveBytes[id];
+            }
+            nextVersion_ = maxVersion + 1;
+
+            // Appends always go to a new file, so a torn tail is never extended
+            rotate();
+        }
+
+    }
+}
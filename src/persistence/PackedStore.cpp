@@ -0,0 +1,412 @@
+#include "kvstore/persistence/PackedStore.hpp"
+#include "kvstore/persistence/BinaryCodec.hpp"
+#include "kvstore/persistence/PersistenceManager.hpp"
+#include "kvstore/core/KeyValueStore.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+namespace kvspp {
+    namespace persistence {
+
+        namespace {
+            constexpr char MAGIC[8] = { 'K', 'V', 'S', 'P', 'P', 'A', 'C', 'K' };
+            constexpr uint64_t INITIAL_SEED = 0x6b7673707061636bull;
+            // Average keys per bucket: fewer buckets mean a smaller index but longer pilot searches
+            constexpr uint64_t KEYS_PER_BUCKET = 4;
+            constexpr int MAX_SEEDS = 16;
+            constexpr size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+            uint32_t loadU32(const char* p) {
+                uint32_t value = 0;
+                for(int i = 0; i < 4; ++i) {
+                    value |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+                }
+                return value;
+            }
+
+            uint64_t loadU64(const char* p) {
+                uint64_t value = 0;
+                for(int i = 0; i < 8; ++i) {
+                    value |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+                }
+                return value;
+            }
+
+            // Both maps are shared by the builder and lookups and define the file format
+            uint64_t bucketOf(uint64_t hash, uint32_t buckets) {
+                return ((hash >> 32) * buckets) >> 32;
+            }
+
+            uint64_t slotOfHash(uint64_t hash, uint32_t pilot, uint64_t seed, uint64_t count) {
+                return (hash ^ utils::Checksum::mix64(pilot ^ seed)) % count;
+            }
+
+            /**
+             * Find a pilot per bucket such that every key lands on its own slot.
+             * Buckets are placed largest first, while most slots are still free.
+             * @return false if some bucket found no pilot (the caller retries with another seed)
+             */
+            bool buildIndex(const std::vector<uint64_t>& hashes, uint64_t seed, uint32_t buckets,
+                std::vector<uint32_t>& pilots, std::vector<uint64_t>& slotOfKey) {
+                const uint64_t count = hashes.size();
+                std::vector<std::vector<uint64_t>> members(buckets);
+                for(uint64_t i = 0; i < count; ++i) {
+                    members[bucketOf(hashes[i], buckets)].push_back(i);
+                }
+                std::vector<uint32_t> order(buckets);
+                for(uint32_t b = 0; b < buckets; ++b) order[b] = b;
+                std::stable_sort(order.begin(), order.end(), [&members](uint32_t a, uint32_t b) {
+                    return members[a].size() > members[b].size();
+                });
+
+                const uint64_t maxPilot = std::min<uint64_t>(UINT32_MAX, std::max<uint64_t>(1 << 20, 64 * count));
+                std::vector<bool> taken(count, false);
+                std::vector<uint64_t> slots;
+                for(uint32_t bucket : order) {
+                    const auto& keys = members[bucket];
+                    if(keys.empty()) break;
+                    bool placed = false;
+                    for(uint64_t pilot = 0; pilot <= maxPilot && !placed; ++pilot) {
+                        slots.clear();
+                        placed = true;
+                        for(uint64_t key : keys) {
+                            uint64_t slot = slotOfHash(hashes[key], static_cast<uint32_t>(pilot), seed, count);
+                            if(taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+                                placed = false;
+                                break;
+                            }
+                            slots.push_back(slot);
+                        }
+                        if(placed) {
+                            pilots[bucket] = static_cast<uint32_t>(pilot);
+                            for(size_t k = 0; k < keys.size(); ++k) {
+                                taken[slots[k]] = true;
+                                slotOfKey[keys[k]] = slots[k];
+                            }
+                        }
+                    }
+                    if(!placed) return false;
+                }
+                return true;
+            }
+
+            // Skip one typed attribute value (see BinaryWriter::putAttributeValue)
+            void skipAttributeValue(BinaryReader& reader) {
+                switch(static_cast<core::AttributeType>(reader.u8())) {
+                case core::AttributeType::STRING:
+                    reader.view(reader.u32());
+                    return;
+                case core::AttributeType::INTEGER:
+                    reader.u32();
+                    return;
+                case core::AttributeType::DOUBLE:
+                    reader.u64();
+                    return;
+                case core::AttributeType::BOOLEAN:
+                    reader.u8();
+                    return;
+                }
+                throw exceptions::PersistenceException("Unknown attribute type tag in packed store");
+            }
+        }
+
+        void PackedStore::write(const core::KeyValueStore& store, const std::string& path) {
+            std::filesystem::path filePath(path);
+            if(filePath.has_parent_path()) {
+                std::filesystem::create_directories(filePath.parent_path());
+            }
+
+            auto schema = store.getSchema();
+            std::unordered_map<std::string, uint32_t> schemaIndex;
+            for(uint32_t i = 0; i < schema.size(); ++i) {
+                schemaIndex.emplace(schema[i].first, i);
+            }
+
+            // Index
+            const auto keys = store.keys();
+            const uint64_t count = keys.size();
+            const uint32_t buckets = static_cast<uint32_t>((count + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET);
+            std::vector<uint64_t> hashes(count);
+            std::vector<uint32_t> pilots(buckets, 0);
+            std::vector<uint64_t> slotOfKey(count, 0);
+            uint64_t seed = INITIAL_SEED;
+            for(int attempt = 0;; ++attempt) {
+                if(attempt == MAX_SEEDS) {
+                    throw exceptions::PersistenceException("Cannot build a perfect hash index for " + path);
+                }
+                for(uint64_t i = 0; i < count; ++i) {
+                    hashes[i] = utils::Checksum::hash64(keys[i], seed);
+                }
+                // Keys with identical hashes can never be separated; try another seed
+                std::vector<uint64_t> sorted(hashes);
+                std::sort(sorted.begin(), sorted.end());
+                if(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end() &&
+                    buildIndex(hashes, seed, buckets, pilots, slotOfKey)) {
+                    break;
+                }
+                seed = utils::Checksum::mix64(seed + 1);
+            }
+
+            auto makeHeader = [&](uint64_t slotsOffset, uint64_t recordsOffset, uint64_t fileSize, uint32_t bodyCrc) {
+                std::string header(MAGIC, sizeof(MAGIC));
+                BinaryWriter::putU32(header, VERSION);
+                BinaryWriter::putU32(header, 0);
+                BinaryWriter::putU64(header, count);
+                BinaryWriter::putU64(header, seed);
+                BinaryWriter::putU32(header, buckets);
+                BinaryWriter::putU64(header, 0); // pilots offset, patched below
+                BinaryWriter::putU64(header, slotsOffset);
+                BinaryWriter::putU64(header, recordsOffset);
+                BinaryWriter::putU64(header, fileSize);
+                BinaryWriter::putU32(header, bodyCrc);
+                BinaryWriter::putU32(header, static_cast<uint32_t>(schema.size()));
+                for(const auto& [name, type] : schema) {
+                    BinaryWriter::putString(header, name);
+                    BinaryWriter::putU8(header, static_cast<uint8_t>(type));
+                }
+                std::string pilotsOffset;
+                BinaryWriter::putU64(pilotsOffset, header.size() + 4);
+                header.replace(36, 8, pilotsOffset);
+                BinaryWriter::putU32(header, utils::Checksum::crc32(header.data(), header.size()));
+                return header;
+            };
+
+            // Servers may have the old file mapped: never rewrite it in place
+            const std::string temporary = path + ".tmp";
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if(!file) {
+                throw exceptions::PersistenceException("Cannot open file for writing: " + temporary);
+            }
+            // The header is rewritten once the offsets and checksum are known
+            const std::string placeholder = makeHeader(0, 0, 0, 0);
+            file.write(placeholder.data(), static_cast<std::streamsize>(placeholder.size()));
+
+            // Pilots, then the records (streamed), then the slot table, so the body
+            // checksum is computed in file order
+            std::string buffer;
+            for(uint32_t pilot : pilots) BinaryWriter::putU32(buffer, pilot);
+            uint32_t crc = utils::Checksum::crc32(buffer.data(), buffer.size());
+            file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            const uint64_t recordsOffset = placeholder.size() + buffer.size();
+
+            std::vector<uint64_t> slotOffsets(count, 0);
+            uint64_t offset = recordsOffset;
+            buffer.clear();
+            auto flush = [&]() {
+                crc = utils::Checksum::crc32(buffer.data(), buffer.size(), crc);
+                file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                offset += buffer.size();
+                buffer.clear();
+            };
+            for(uint64_t i = 0; i < count; ++i) {
+                slotOffsets[slotOfKey[i]] = offset + buffer.size();
+                // Encoded under the store lock: a concurrent write may free the value
+                const bool found = store.peek(keys[i], [&](const core::ValueObject& valueObj) {
+                    BinaryWriter::putString(buffer, keys[i]);
+                    const auto& attributes = valueObj.getAttributes();
+                    BinaryWriter::putU32(buffer, static_cast<uint32_t>(attributes.size()));
+                    for(const auto& [name, value] : attributes) {
+                        auto it = schemaIndex.find(name);
+                        if(it == schemaIndex.end()) {
+                            throw exceptions::PersistenceException("Attribute '" + name + "' is missing from the type registry");
+                        }
+                        BinaryWriter::putU32(buffer, it->second);
+                        BinaryWriter::putAttributeValue(buffer, value);
+                    }
+                });
+                if(!found) {
+                    throw exceptions::PersistenceException("Key '" + keys[i] + "' disappeared while packing");
+                }
+                if(buffer.size() >= WRITE_BUFFER_SIZE) flush();
+            }
+            flush();
+
+            const uint64_t slotsOffset = offset;
+            for(uint64_t slotOffset : slotOffsets) {
+                BinaryWriter::putU64(buffer, slotOffset);
+                if(buffer.size() >= WRITE_BUFFER_SIZE) flush();
+            }
+            flush();
+
+            const std::string header = makeHeader(slotsOffset, recordsOffset, offset, crc);
+            file.seekp(0);
+            file.write(header.data(), static_cast<std::streamsize>(header.size()));
+            file.close();
+            if(!file) {
+                throw exceptions::PersistenceException("Failed writing packed store: " + temporary);
+            }
+            PersistenceManager::commitFile(temporary, path);
+        }
+
+        bool PackedStore::isPackedStore(const std::string& path) {
+            std::ifstream file(path, std::ios::binary);
+            char magic[sizeof(MAGIC)];
+            return file.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+        }
+
+        PackedStore::PackedStore(const std::string& path) : path_(path), file_(path) {
+            const char* data = file_.data();
+            const size_t size = file_.size();
+            if(size < sizeof(MAGIC) || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+                throw exceptions::PersistenceException("Not a packed store: " + path);
+            }
+
+            BinaryReader header(data + sizeof(MAGIC), size - sizeof(MAGIC));
+            const uint32_t version = header.u32();
+            if(version != VERSION) {
+                throw exceptions::PersistenceException("Unsupported packed store version " + std::to_string(version));
+            }
+            header.u32(); // flags
+            count_ = header.u64();
+            seed_ = header.u64();
+            buckets_ = header.u32();
+            pilotsOffset_ = header.u64();
+            slotsOffset_ = header.u64();
+            recordsOffset_ = header.u64();
+            const uint64_t fileSize = header.u64();
+            bodyCrc_ = header.u32();
+            const uint32_t schemaCount = header.u32();
+            schema_.reserve(schemaCount);
+            for(uint32_t i = 0; i < schemaCount; ++i) {
+                std::string name = header.string();
+                auto type = static_cast<core::AttributeType>(header.u8());
+                schema_.emplace_back(std::move(name), type);
+            }
+            const size_t headerSize = sizeof(MAGIC) + header.position();
+            if(header.u32() != utils::Checksum::crc32(data, headerSize)) {
+                throw exceptions::PersistenceException("Checksum mismatch in packed store header: " + path);
+            }
+            if(fileSize != size || pilotsOffset_ != headerSize + 4 ||
+                recordsOffset_ != pilotsOffset_ + 4ull * buckets_ || slotsOffset_ < recordsOffset_ ||
+                slotsOffset_ + 8 * count_ != size || (count_ > 0) != (buckets_ > 0)) {
+                throw exceptions::PersistenceException("Corrupt or truncated packed store: " + path);
+            }
+            filter_ = PersistenceManager::loadKeyFilter(path);
+        }
+
+        uint64_t PackedStore::slotOf(std::string_view key) const {
+            const uint64_t hash = utils::Checksum::hash64(key, seed_);
+            const uint32_t pilot = loadU32(file_.data() + pilotsOffset_ + 4 * bucketOf(hash, buckets_));
+            return slotOfHash(hash, pilot, seed_, count_);
+        }
+
+        uint64_t PackedStore::recordOffset(uint64_t slot) const {
+            return loadU64(file_.data() + slotsOffset_ + 8 * slot);
+        }
+
+        const char* PackedStore::find(std::string_view key) const {
+            if(count_ == 0 || (filter_ && !filter_->mayContain(key))) return nullptr;
+            const uint64_t offset = recordOffset(slotOf(key));
+            if(offset < recordsOffset_ || offset + 4 > slotsOffset_) {
+                throw exceptions::PersistenceException("Corrupt slot table in packed store: " + path_);
+            }
+            const char* record = file_.data() + offset;
+            const uint32_t length = loadU32(record);
+            if(length != key.size() || offset + 4 + length > slotsOffset_ ||
+                std::memcmp(record + 4, key.data(), length) != 0) {
+                return nullptr;
+            }
+            return record;
+        }
+
+        bool PackedStore::contains(std::string_view key) const {
+            return find(key) != nullptr;
+        }
+
+        std::optional<core::ValueObject> PackedStore::read(std::string_view key, core::TypeRegistry& registry) const {
+            const char* record = find(key);
+            if(!record) return std::nullopt;
+
+            BinaryReader reader(record, static_cast<size_t>(file_.data() + slotsOffset_ - record));
+            reader.view(reader.u32());
+            const uint32_t attributeCount = reader.u32();
+            std::unordered_map<std::string, core::AttributeValue> attributes;
+            attributes.reserve(attributeCount);
+            for(uint32_t i = 0; i < attributeCount; ++i) {
+                const uint32_t index = reader.u32();
+                if(index >= schema_.size()) {
+                    throw exceptions::PersistenceException("Attribute index out of range in packed store: " + path_);
+                }
+                attributes.emplace(schema_[index].first, reader.attributeValue());
+            }
+            return core::ValueObject(std::move(attributes), registry);
+        }
+
+        std::vector<std::string> PackedStore::keys() const {
+            std::vector<std::string> result;
+            result.reserve(count_);
+            BinaryReader reader(file_.data() + recordsOffset_, slotsOffset_ - recordsOffset_);
+            while(!reader.atEnd()) {
+                result.emplace_back(reader.view(reader.u32()));
+                const uint32_t attributeCount = reader.u32();
+                for(uint32_t i = 0; i < attributeCount; ++i) {
+                    reader.u32();
+                    skipAttributeValue(reader);
+                }
+            }
+            return result;
+        }
+
+        std::vector<std::string> PackedStore::search(const std::string& attribute,
+            const std::function<bool(const core::AttributeValue&)>& match) const {
+            std::vector<std::string> result;
+            auto it = std::find_if(schema_.begin(), schema_.end(),
+                [&attribute](const auto& entry) { return entry.first == attribute; });
+            if(it == schema_.end()) return result;
+            const uint32_t target = static_cast<uint32_t>(it - schema_.begin());
+
+            BinaryReader reader(file_.data() + recordsOffset_, slotsOffset_ - recordsOffset_);
+            while(!reader.atEnd()) {
+                std::string_view key = reader.view(reader.u32());
+                const uint32_t attributeCount = reader.u32();
+                for(uint32_t i = 0; i < attributeCount; ++i) {
+                    if(reader.u32() != target) {
+                        skipAttributeValue(reader);
+                    }
+                    else if(match(reader.attributeValue())) {
+                        result.emplace_back(key);
+                    }
+                }
+            }
+            return result;
+        }
+
+        void PackedStore::registerSchema(core::TypeRegistry& registry) const {
+            for(const auto& [name, type] : schema_) {
+                registry.validateAndRegisterType(name, type);
+            }
+        }
+
+        void PackedStore::verify() const {
+            if(utils::Checksum::crc32(file_.data() + pilotsOffset_, file_.size() - pilotsOffset_) != bodyCrc_) {
+                throw exceptions::PersistenceException("Checksum mismatch in packed store: " + path_);
+            }
+            uint64_t records = 0;
+            BinaryReader reader(file_.data() + recordsOffset_, slotsOffset_ - recordsOffset_);
+            while(!reader.atEnd()) {
+                const char* record = file_.data() + recordsOffset_ + reader.position();
+                std::string_view key = reader.view(reader.u32());
+                if(find(key) != record) {
+                    throw exceptions::PersistenceException("Key '" + std::string(key) + "' is not reachable in packed store: " + path_);
+                }
+                const uint32_t attributeCount = reader.u32();
+                for(uint32_t i = 0; i < attributeCount; ++i) {
+                    if(reader.u32() >= schema_.size()) {
+                        throw exceptions::PersistenceException("Attribute index out of range in packed store: " + path_);
+                    }
+                    skipAttributeValue(reader);
+                }
+                ++records;
+            }
+            if(records != count_) {
+                throw exceptions::PersistenceException("Entry count mismatch in packed store: " + path_);
+            }
+        }
+
+    }
+}
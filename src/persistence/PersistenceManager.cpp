@@ -1,15 +1,77 @@
 #include "kvstore/persistence/PersistenceManager.hpp"
+#include "kvstore/persistence/BinarySnapshot.hpp"
+#include "kvstore/persistence/JsonReader.hpp"
+#include "kvstore/persistence/BinaryCodec.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include "kvstore/utils/FileWriter.hpp"
+#include "kvstore/utils/MappedFile.hpp"
 #include "kvstore/core/TypeRegistry.hpp"
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
 #include <stdexcept>
-#include <algorithm>
-#include <cctype>
+#include <cerrno>
+#include <cstring>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace kvspp {
     namespace persistence {
 
+        namespace {
+            std::mutex loadPoolMutex;
+            std::unique_ptr<utils::ThreadPool> loadPool;
+            size_t loadThreads = 0;
+            std::atomic<utils::Codec> snapshotCompression{ utils::Codec::NONE };
+            std::atomic<double> keyFilterBitsPerKey{ 10.0 };
+            std::atomic<SnapshotFsync> snapshotFsyncPolicy{ SnapshotFsync::FILE };
+
+            // JSON is handed to the file writer (which batches disk writes) in chunks of this size
+            constexpr size_t SNAPSHOT_WRITE_BUFFER = 64 << 10;
+
+            void fsyncPath(const std::string& path, bool directory) {
+#ifdef _WIN32
+                // Windows cannot open directories for syncing; the rename is journaled by NTFS
+                if(directory) return;
+                int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+                bool ok = fd >= 0 && _commit(fd) == 0;
+                if(fd >= 0) _close(fd);
+#else
+                int fd = ::open(path.c_str(), (directory ? O_DIRECTORY : 0) | O_RDONLY | O_CLOEXEC);
+                bool ok = fd >= 0 && ::fsync(fd) == 0;
+                if(fd >= 0) ::close(fd);
+#endif
+                if(!ok) throw exceptions::PersistenceException("Cannot fsync " + path + ": " + std::strerror(errno));
+            }
+
+            constexpr char KEY_FILTER_MAGIC[8] = { 'K', 'V', 'S', 'P', 'B', 'L', 'O', 'M' };
+            constexpr uint32_t KEY_FILTER_VERSION = 1;
+
+            // Identifies the snapshot contents a key filter was built for
+            struct SnapshotStamp {
+                uint64_t size;
+                uint64_t mtime;
+            };
+
+            std::optional<SnapshotStamp> stampOf(const std::string& path) {
+                std::error_code ec;
+                uint64_t size = std::filesystem::file_size(path, ec);
+                if(ec) return std::nullopt;
+                auto mtime = std::filesystem::last_write_time(path, ec);
+                if(ec) return std::nullopt;
+                return SnapshotStamp{ size, static_cast<uint64_t>(mtime.time_since_epoch().count()) };
+            }
+        }
+
         PersistenceManager::PersistenceManager(const std::string& filePath)
             : filePath_(filePath) {
         }
@@ -18,33 +80,51 @@ namespace kvspp {
             std::lock_guard<std::mutex> lock(mtx_);
 
             try {
-                std::ostringstream json;
-                json << "{\n";
-                json << "  \"store\": {\n";
-
-                auto keys = store.keys();
-                for(size_t i = 0; i < keys.size(); ++i) {
-                    const auto& key = keys[i];
-                    const auto* valueObj = store.get(key);
-
-                    if(valueObj) {
-                        json << "    \"" << escapeJsonString(key) << "\": "
-                            << valueObjectToJson(*valueObj);
-                        json << ",\n";
+                // The key filter covers the key list the snapshot is written from
+                std::vector<std::string> keys;
+                auto onKeys = [&keys](const std::vector<std::string>& written) {
+                    if(keyFilterBits() > 0) keys = written;
+                };
+                // Written beside the old snapshot and renamed over it, so a crash
+                // never leaves a torn file in its place
+                const std::string temporary = filePath_ + ".tmp";
+                try {
+                    if(formatForPath(filePath_) == SnapshotFormat::BINARY) {
+                        utils::Codec codec = compression();
+                        BinarySnapshot::save(store, temporary, codec, codec == utils::Codec::NONE ? nullptr : sharedLoadPool(), onKeys);
+                    }
+                    else {
+                        writeFile(temporary, [&store, &onKeys](JsonWriter& writer) {
+                            writer.store(store, JsonWriter::Style::PRETTY, onKeys);
+                        });
                     }
+                    commitFile(temporary, filePath_);
+                }
+                catch(...) {
+                    std::error_code ec;
+                    std::filesystem::remove(temporary, ec);
+                    throw;
                 }
-                // Write autosave field (assume store.hasAutosave() and store.getAutosave())
-                json << "    \"autosave\": " << (store.hasAutosave() ? (store.getAutosave() ? "true" : "false") : "false") << "\n";
-                json << "  }\n";
-                json << "}";
 
-                writeFile(filePath_, json.str());
+                // A missing filter only costs lookups; a stale one would hide keys
+                std::error_code ec;
+                std::filesystem::remove(keyFilterPathFor(filePath_), ec);
+                if(keyFilterBits() > 0) {
+                    try {
+                        writeKeyFilter(keys, filePath_);
+                    }
+                    catch(const std::exception&) {
+                        std::filesystem::remove(keyFilterPathFor(filePath_), ec);
+                    }
+                }
 
             }
             catch(const std::exception& e) {
                 throw exceptions::KVStoreException("Failed to save store: " + std::string(e.what()));
             }
-        }        void PersistenceManager::load(core::KeyValueStore& store) {
+        }
+
+        void PersistenceManager::load(core::KeyValueStore& store) {
             std::lock_guard<std::mutex> lock(mtx_);
 
             if(!fileExists()) {
@@ -52,23 +132,15 @@ namespace kvspp {
             }
 
             try {
-                std::string content = readFile(filePath_);
-
-                // Clear existing store
-                auto keys = store.keys();
-                for(const auto& key : keys) {
-                    store.deleteKey(key);
-                }
-
-                // Parse JSON and load data
-                std::string storeSection = findJsonValue(content, "store");
-                if(storeSection.empty()) {
-                    return; // Empty or invalid JSON
+                if(BinarySnapshot::isBinarySnapshot(filePath_)) {
+                    BinarySnapshot::load(store, filePath_, sharedLoadPool());
+                    return;
                 }
 
-                // Parse the store section which contains key-value pairs
-                parseStoreSection(storeSection, store);
-
+                utils::MappedFile file(filePath_);
+                file.adviseSequential();
+                JsonReader::verifyChecksum(file.data(), file.size());
+                JsonReader::loadStore(store, file.data(), file.size(), sharedLoadPool());
             }
             catch(const std::exception& e) {
                 throw exceptions::KVStoreException("Failed to load store: " + std::string(e.what()));
@@ -88,338 +160,135 @@ namespace kvspp {
             filePath_ = newFilePath;
         }
 
-        // JSON serialization helpers
-        std::string PersistenceManager::valueObjectToJson(const core::ValueObject& obj) const {
-            std::ostringstream json;
-            json << "{\n";
-
-            const auto& attributes = obj.getAttributes();
-            size_t count = 0;
-
-            for(const auto& [key, value] : attributes) {
-                json << "      \"" << escapeJsonString(key) << "\": "
-                    << attributeValueToJson(value);
-
-                if(++count < attributes.size()) {
-                    json << ",";
-                }
-                json << "\n";
-            }
-
-            json << "    }";
-            return json.str();
+        SnapshotFormat PersistenceManager::formatForPath(const std::string& path) {
+            return std::filesystem::path(path).extension() == extensionFor(SnapshotFormat::BINARY)
+                ? SnapshotFormat::BINARY : SnapshotFormat::JSON;
         }
 
-        std::string PersistenceManager::attributeValueToJson(const core::AttributeValue& value) const {
-            if(std::holds_alternative<std::string>(value)) {
-                return "\"" + escapeJsonString(std::get<std::string>(value)) + "\"";
-            }
-            else if(std::holds_alternative<int>(value)) {
-                return std::to_string(std::get<int>(value));
-            }
-            else if(std::holds_alternative<double>(value)) {
-                return std::to_string(std::get<double>(value));
-            }
-            else if(std::holds_alternative<bool>(value)) {
-                return std::get<bool>(value) ? "true" : "false";
-            }
-            return "null";
+        const char* PersistenceManager::extensionFor(SnapshotFormat format) {
+            return format == SnapshotFormat::BINARY ? ".kvs" : ".json";
         }
 
-        std::string PersistenceManager::escapeJsonString(const std::string& str) const {
-            std::string result;
-            for(char c : str) {
-                switch(c) {
-                case '"': result += "\\\""; break;
-                case '\\': result += "\\\\"; break;
-                case '\b': result += "\\b"; break;
-                case '\f': result += "\\f"; break;
-                case '\n': result += "\\n"; break;
-                case '\r': result += "\\r"; break;
-                case '\t': result += "\\t"; break;
-                default: result += c; break;
-                }
-            }
-            return result;
+        void PersistenceManager::setLoadThreads(size_t threads) {
+            std::lock_guard<std::mutex> lock(loadPoolMutex);
+            if(threads == loadThreads && loadPool) return;
+            loadThreads = threads;
+            loadPool.reset();
         }
 
-        // JSON deserialization helpers
-        core::ValueObject PersistenceManager::jsonToValueObject(const std::string& jsonStr, core::TypeRegistry& typeRegistry) const {
-            core::ValueObject obj(typeRegistry);
-
-            std::string content = jsonStr;
-            // Remove outer braces
-            if(content.front() == '{') content.erase(0, 1);
-            if(content.back() == '}') content.pop_back();
-
-            std::istringstream iss(content);
-            std::string line;
-
-            while(std::getline(iss, line)) {
-                // Skip empty lines and whitespace
-                line.erase(0, line.find_first_not_of(" \t\n\r"));
-                line.erase(line.find_last_not_of(" \t\n\r") + 1);
-
-                if(line.empty()) continue;
-
-                // Find the key and value
-                size_t colonPos = line.find(':');
-                if(colonPos == std::string::npos) continue;
-
-                std::string keyPart = line.substr(0, colonPos);
-                std::string valuePart = line.substr(colonPos + 1);
+        void PersistenceManager::setCompression(utils::Codec codec) {
+            snapshotCompression = utils::Compression::resolve(codec);
+        }
 
-                // Remove quotes and whitespace from key
-                keyPart.erase(0, keyPart.find_first_not_of(" \t\""));
-                keyPart.erase(keyPart.find_last_not_of(" \t\"") + 1);
+        utils::Codec PersistenceManager::compression() {
+            return snapshotCompression;
+        }
 
-                // Remove whitespace from value part
-                valuePart.erase(0, valuePart.find_first_not_of(" \t"));
-                if(valuePart.back() == ',') valuePart.pop_back();
-                valuePart.erase(valuePart.find_last_not_of(" \t") + 1);
+        void PersistenceManager::setSnapshotFsync(SnapshotFsync policy) {
+            snapshotFsyncPolicy = policy;
+        }
 
-                if(!keyPart.empty() && !valuePart.empty()) {
-                    core::AttributeValue value = parseJsonValue(valuePart);
+        SnapshotFsync PersistenceManager::snapshotFsync() {
+            return snapshotFsyncPolicy;
+        }
 
-                    // Use the appropriate setAttribute method based on type
-                    if(std::holds_alternative<std::string>(value)) {
-                        obj.setAttribute(unescapeJsonString(keyPart), std::get<std::string>(value));
-                    }
-                    else if(std::holds_alternative<int>(value)) {
-                        obj.setAttribute(unescapeJsonString(keyPart), std::get<int>(value));
-                    }
-                    else if(std::holds_alternative<double>(value)) {
-                        obj.setAttribute(unescapeJsonString(keyPart), std::get<double>(value));
-                    }
-                    else if(std::holds_alternative<bool>(value)) {
-                        obj.setAttribute(unescapeJsonString(keyPart), std::get<bool>(value));
-                    }
-                }
+        void PersistenceManager::commitFile(const std::string& temporary, const std::string& path) {
+            const SnapshotFsync policy = snapshotFsync();
+            if(policy != SnapshotFsync::NONE) fsyncPath(temporary, false);
+            std::error_code ec;
+            std::filesystem::rename(temporary, path, ec);
+            if(ec) throw exceptions::PersistenceException("Cannot rename " + temporary + " to " + path + ": " + ec.message());
+            if(policy == SnapshotFsync::DIRECTORY) {
+                std::filesystem::path directory = std::filesystem::path(path).parent_path();
+                fsyncPath(directory.empty() ? "." : directory.string(), true);
             }
+        }
+
+        void PersistenceManager::setKeyFilterBits(double bitsPerKey) {
+            keyFilterBitsPerKey = std::max(bitsPerKey, 0.0);
+        }
 
-            return obj;
+        double PersistenceManager::keyFilterBits() {
+            return keyFilterBitsPerKey;
         }
 
-        core::AttributeValue PersistenceManager::parseJsonValue(const std::string& jsonValue) const {
-            std::string value = jsonValue;
+        std::string PersistenceManager::keyFilterPathFor(const std::string& snapshotPath) {
+            return snapshotPath + ".bloom";
+        }
 
-            // Remove whitespace
-            value.erase(0, value.find_first_not_of(" \t"));
-            value.erase(value.find_last_not_of(" \t") + 1);
+        void PersistenceManager::writeKeyFilter(const std::vector<std::string>& keys, const std::string& snapshotPath) {
+            auto stamp = stampOf(snapshotPath);
+            if(!stamp) throw exceptions::PersistenceException("Cannot stat snapshot " + snapshotPath);
+
+            utils::BloomFilter filter(keys.size(), std::max(keyFilterBits(), 1.0));
+            for(const auto& key : keys) filter.add(key);
+
+            // magic, u32 version, u64 snapshot size, u64 snapshot mtime, filter, u32 crc32
+            std::string out(KEY_FILTER_MAGIC, sizeof(KEY_FILTER_MAGIC));
+            BinaryWriter::putU32(out, KEY_FILTER_VERSION);
+            BinaryWriter::putU64(out, stamp->size);
+            BinaryWriter::putU64(out, stamp->mtime);
+            filter.serialize(out);
+            BinaryWriter::putU32(out, utils::Checksum::crc32(out.data(), out.size()));
+
+            const std::string path = keyFilterPathFor(snapshotPath);
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(out.data(), static_cast<std::streamsize>(out.size()));
+            file.flush();
+            if(!file) throw exceptions::PersistenceException("Failed writing key filter: " + path);
+        }
 
-            // Check for boolean values
-            if(value == "true") return true;
-            if(value == "false") return false;
+        std::unique_ptr<utils::BloomFilter> PersistenceManager::loadKeyFilter(const std::string& snapshotPath) {
+            auto stamp = stampOf(snapshotPath);
+            const std::string path = keyFilterPathFor(snapshotPath);
+            std::ifstream file(path, std::ios::binary);
+            if(!stamp || !file) return nullptr;
+            std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 
-            // Check for quoted string
-            if(value.front() == '"' && value.back() == '"') {
-                std::string str = value.substr(1, value.length() - 2);
-                return unescapeJsonString(str);
+            constexpr size_t HEADER_SIZE = sizeof(KEY_FILTER_MAGIC) + 4 + 8 + 8;
+            if(data.size() < HEADER_SIZE + 4 || data.compare(0, sizeof(KEY_FILTER_MAGIC), KEY_FILTER_MAGIC, sizeof(KEY_FILTER_MAGIC)) != 0) {
+                return nullptr;
             }
-
-            // Try to parse as number
             try {
-                if(value.find('.') != std::string::npos) {
-                    return std::stod(value);
-                }
-                else {
-                    return std::stoi(value);
+                BinaryReader reader(data.data() + sizeof(KEY_FILTER_MAGIC), HEADER_SIZE - sizeof(KEY_FILTER_MAGIC));
+                BinaryReader trailer(data.data() + data.size() - 4, 4);
+                if(reader.u32() != KEY_FILTER_VERSION || reader.u64() != stamp->size || reader.u64() != stamp->mtime ||
+                    trailer.u32() != utils::Checksum::crc32(data.data(), data.size() - 4)) {
+                    return nullptr;
                 }
+                return std::make_unique<utils::BloomFilter>(
+                    utils::BloomFilter::deserialize(data.data() + HEADER_SIZE, data.size() - HEADER_SIZE - 4));
             }
             catch(const std::exception&) {
-             // If parsing fails, treat as string
-                return value;
+                return nullptr;
             }
         }
 
-        std::string PersistenceManager::unescapeJsonString(const std::string& str) const {
-            std::string result;
-            for(size_t i = 0; i < str.length(); ++i) {
-                if(str[i] == '\\' && i + 1 < str.length()) {
-                    switch(str[i + 1]) {
-                    case '"': result += '"'; ++i; break;
-                    case '\\': result += '\\'; ++i; break;
-                    case 'b': result += '\b'; ++i; break;
-                    case 'f': result += '\f'; ++i; break;
-                    case 'n': result += '\n'; ++i; break;
-                    case 'r': result += '\r'; ++i; break;
-                    case 't': result += '\t'; ++i; break;
-                    default: result += str[i]; break;
-                    }
-                }
-                else {
-                    result += str[i];
-                }
+        utils::ThreadPool* PersistenceManager::sharedLoadPool() {
+            std::lock_guard<std::mutex> lock(loadPoolMutex);
+            if(loadThreads == 1 || (loadThreads == 0 && utils::ThreadPool::defaultThreadCount() == 1)) {
+                return nullptr;
             }
-            return result;
+            if(!loadPool) loadPool = std::make_unique<utils::ThreadPool>(loadThreads);
+            return loadPool.get();
         }
 
         // File I/O helpers
-        std::string PersistenceManager::readFile(const std::string& path) const {
-            std::ifstream file(path);
-            if(!file) {
-                throw std::runtime_error("Cannot open file for reading: " + path);
-            }
-
-            std::ostringstream content;
-            content << file.rdbuf();
-            return content.str();
-        }
-
-        void PersistenceManager::writeFile(const std::string& path, const std::string& content) const {
+        void PersistenceManager::writeFile(const std::string& path, const std::function<void(JsonWriter&)>& serialize) const {
             // Ensure directory exists
             std::filesystem::path filePath(path);
             if(filePath.has_parent_path()) {
                 std::filesystem::create_directories(filePath.parent_path());
             }
 
-            std::ofstream file(path);
-            if(!file) {
-                throw std::runtime_error("Cannot open file for writing: " + path);
-            }
-
-            file << content;
-        }
-
-        // JSON parsing utilities
-        std::string PersistenceManager::findJsonValue(const std::string& json, const std::string& key) const {
-            std::string searchKey = "\"" + key + "\"";
-            size_t keyPos = json.find(searchKey);
-            if(keyPos == std::string::npos) return "";
-
-            size_t colonPos = json.find(':', keyPos);
-            if(colonPos == std::string::npos) return "";
-
-            // Find the start of the value
-            size_t valueStart = colonPos + 1;
-            while(valueStart < json.length() && std::isspace(json[valueStart])) {
-                ++valueStart;
-            }
-
-            if(valueStart >= json.length()) return "";
-
-            // Find the end of the value (handle nested objects)
-            size_t valueEnd = valueStart;
-            int braceCount = 0;
-            bool inString = false;
-            bool escaped = false;
-
-            while(valueEnd < json.length()) {
-                char c = json[valueEnd];
-
-                if(escaped) {
-                    escaped = false;
-                }
-                else if(c == '\\') {
-                    escaped = true;
-                }
-                else if(c == '"') {
-                    inString = !inString;
-                }
-                else if(!inString) {
-                    if(c == '{') {
-                        ++braceCount;
-                    }
-                    else if(c == '}') {
-                        if(braceCount == 0) break;
-                        --braceCount;
-                    }
-                    else if(c == ',' && braceCount == 0) {
-                        break;
-                    }
-                }
-                ++valueEnd;
-            }
-            return json.substr(valueStart, valueEnd - valueStart);
-        }
-
-        void PersistenceManager::parseStoreSection(const std::string& storeJson, core::KeyValueStore& store) const {
-            std::string content = storeJson;
-
-            // Remove outer braces
-            if(content.front() == '{') content.erase(0, 1);
-            if(content.back() == '}') content.pop_back();
-
-            // Parse each key-value pair and autosave field
-            size_t pos = 0;
-            while(pos < content.length()) {
-                // Find the start of a key
-                size_t keyStart = content.find('"', pos);
-                if(keyStart == std::string::npos) break;
-
-                // Find the end of the key
-                size_t keyEnd = content.find('"', keyStart + 1);
-                if(keyEnd == std::string::npos) break;
-
-                std::string key = content.substr(keyStart + 1, keyEnd - keyStart - 1);
-
-                // Find the colon after the key
-                size_t colonPos = content.find(':', keyEnd);
-                if(colonPos == std::string::npos) break;
-
-                // Check for autosave field
-                if(key == "autosave") {
-                    // Find value (true/false)
-                    size_t valStart = content.find_first_not_of(" ", colonPos + 1);
-                    if(valStart != std::string::npos) {
-                        bool autosave = false;
-                        if(content.compare(valStart, 4, "true") == 0) autosave = true;
-                        else if(content.compare(valStart, 5, "false") == 0) autosave = false;
-                        store.setAutosave(autosave);
-                    }
-                    // Move to next field
-                    pos = content.find(',', colonPos);
-                    if(pos == std::string::npos) break;
-                    ++pos;
-                    continue;
-                }
-
-                // Find the start of the value (should be an object starting with '{')
-                size_t valueStart = content.find('{', colonPos);
-                if(valueStart == std::string::npos) break;
-
-                // Find the matching closing brace for this object
-                size_t valueEnd = valueStart + 1;
-                int braceCount = 1;
-                bool inString = false;
-                bool escaped = false;
-
-                while(valueEnd < content.length() && braceCount > 0) {
-                    char c = content[valueEnd];
-
-                    if(escaped) {
-                        escaped = false;
-                    }
-                    else if(c == '\\') {
-                        escaped = true;
-                    }
-                    else if(c == '"') {
-                        inString = !inString;
-                    }
-                    else if(!inString) {
-                        if(c == '{') {
-                            ++braceCount;
-                        }
-                        else if(c == '}') {
-                            --braceCount;
-                        }
-                    }
-                    ++valueEnd;
-                }
-
-                if(braceCount == 0) {
-                    // Extract the complete object JSON
-                    std::string objectJson = content.substr(valueStart, valueEnd - valueStart);
-
-                    // Parse the object and add to store
-                    core::ValueObject obj = jsonToValueObject(objectJson, store.getTypeRegistry());
-                    store.put(unescapeJsonString(key), obj);
-                }
-
-                // Move to next key-value pair
-                pos = valueEnd;
-            }
+            utils::FileWriter file(path);
+            JsonWriter writer([&file](const char* data, size_t length) {
+                file.write(data, length);
+            }, SNAPSHOT_WRITE_BUFFER);
+            serialize(writer);
+            writer.flush();
+            file.close();
         }
 
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,100 @@
+#include "kvstore/persistence/ReplicationBacklog.hpp"
+#include "kvstore/persistence/BinaryCodec.hpp"
+#include "kvstore/persistence/WriteAheadLog.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace kvspp {
+    namespace persistence {
+
+        namespace {
+            // Random 40 hex digit id of one replication history
+            std::string randomId() {
+                static const char HEX[] = "0123456789abcdef";
+                std::random_device device;
+                std::mt19937_64 generator((static_cast<uint64_t>(device()) << 32) ^ device() ^
+                    static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+                std::string id(40, '0');
+                for(char& c : id) c = HEX[generator() & 15];
+                return id;
+            }
+        }
+
+        ReplicationBacklog::ReplicationBacklog(size_t capacity)
+            : id_(randomId()), ring_(std::max<size_t>(capacity, 1)) {
+        }
+
+        void ReplicationBacklog::appendFrame(std::string& out, const std::string& payload) {
+            BinaryWriter::putU32(out, static_cast<uint32_t>(payload.size()));
+            BinaryWriter::putU32(out, utils::Checksum::crc32(payload.data(), payload.size()));
+            out += payload;
+        }
+
+        std::string ReplicationBacklog::recordPayload(const std::string& token, const core::Mutation& mutation) {
+            std::string payload;
+            BinaryWriter::putU8(payload, FRAME_RECORD);
+            BinaryWriter::putString(payload, token);
+            WriteAheadLog::encodeRecord(mutation, payload);
+            return payload;
+        }
+
+        void ReplicationBacklog::append(const std::string& token, const core::Mutation& mutation) {
+            // Encoded before taking the lock; readers copy out under it
+            std::string frame;
+            appendFrame(frame, recordPayload(token, mutation));
+
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                const size_t capacity = ring_.size();
+                // Only the tail of a frame larger than the whole ring can survive
+                size_t skip = frame.size() > capacity ? frame.size() - capacity : 0;
+                uint64_t position = end_ + skip;
+                while(skip < frame.size()) {
+                    size_t at = static_cast<size_t>(position % capacity);
+                    size_t chunk = std::min(frame.size() - skip, capacity - at);
+                    std::memcpy(ring_.data() + at, frame.data() + skip, chunk);
+                    skip += chunk;
+                    position += chunk;
+                }
+                end_ += frame.size();
+            }
+            cv_.notify_all();
+        }
+
+        bool ReplicationBacklog::read(uint64_t offset, std::string& out, size_t maxBytes,
+            std::chrono::milliseconds timeout) const {
+            out.clear();
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait_for(lock, timeout, [this, offset]() { return end_ != offset; });
+
+            const size_t capacity = ring_.size();
+            const uint64_t start = end_ > capacity ? end_ - capacity : 0;
+            if(offset < start || offset > end_) return false;
+
+            size_t length = static_cast<size_t>(std::min<uint64_t>(end_ - offset, maxBytes));
+            out.resize(length);
+            size_t copied = 0;
+            while(copied < length) {
+                size_t at = static_cast<size_t>((offset + copied) % capacity);
+                size_t chunk = std::min(length - copied, capacity - at);
+                std::memcpy(out.data() + copied, ring_.data() + at, chunk);
+                copied += chunk;
+            }
+            return true;
+        }
+
+        bool ReplicationBacklog::contains(uint64_t offset) const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            const uint64_t start = end_ > ring_.size() ? end_ - ring_.size() : 0;
+            return offset >= start && offset <= end_;
+        }
+
+        uint64_t ReplicationBacklog::endOffset() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return end_;
+        }
+
+    }
+}
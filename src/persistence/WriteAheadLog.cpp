@@ -0,0 +1,371 @@
+#include "kvstore/persistence/WriteAheadLog.hpp"
+#include "kvstore/persistence/BinaryCodec.hpp"
+#include "kvstore/persistence/PersistenceManager.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace kvspp {
+    namespace persistence {
+
+        namespace {
+            constexpr size_t RECORD_HEADER_SIZE = 8;
+            constexpr size_t REPLAY_CHUNK_SIZE = 1 << 20;
+
+            std::string errnoMessage(const std::string& what, const std::string& path) {
+                return what + " '" + path + "': " + std::strerror(errno);
+            }
+
+            void closeDescriptor(int fd) {
+#ifdef _WIN32
+                _close(fd);
+#else
+                ::close(fd);
+#endif
+            }
+        }
+
+        WriteAheadLog::WriteAheadLog(const std::string& filePath, FsyncPolicy policy)
+            : filePath_(filePath), policy_(policy) {
+            std::filesystem::path path(filePath_);
+            if(path.has_parent_path()) {
+                std::filesystem::create_directories(path.parent_path());
+            }
+            openFile();
+            writtenBytes_ = std::filesystem::file_size(filePath_);
+        }
+
+        WriteAheadLog::~WriteAheadLog() {
+            try {
+                commit();
+                if(policy_ != FsyncPolicy::NO) syncFile(fd_);
+            }
+            catch(const std::exception& e) {
+                std::cerr << "Failed to flush write-ahead log " << filePath_ << ": " << e.what() << "\n";
+            }
+            closeFile();
+        }
+
+        void WriteAheadLog::openFile() {
+#ifdef _WIN32
+            fd_ = _open(filePath_.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+            fd_ = ::open(filePath_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+            if(fd_ < 0) {
+                throw exceptions::PersistenceException(errnoMessage("Cannot open write-ahead log", filePath_));
+            }
+        }
+
+        void WriteAheadLog::closeFile() {
+            if(fd_ < 0) return;
+            closeDescriptor(fd_);
+            fd_ = -1;
+        }
+
+        void WriteAheadLog::writeAll(const std::string& data) {
+            const char* p = data.data();
+            size_t left = data.size();
+            while(left > 0) {
+#ifdef _WIN32
+                int written = _write(fd_, p, static_cast<unsigned int>(left));
+#else
+                ssize_t written = ::write(fd_, p, left);
+#endif
+                if(written < 0) {
+                    if(errno == EINTR) continue;
+                    throw exceptions::PersistenceException(errnoMessage("Cannot write write-ahead log", filePath_));
+                }
+                p += written;
+                left -= static_cast<size_t>(written);
+            }
+        }
+
+        void WriteAheadLog::syncFile(int fd) {
+#ifdef _WIN32
+            int rc = _commit(fd);
+#elif defined(__linux__)
+            int rc = ::fdatasync(fd);
+#else
+            int rc = ::fsync(fd);
+#endif
+            if(rc != 0) {
+                throw exceptions::PersistenceException(errnoMessage("Cannot fsync write-ahead log", filePath_));
+            }
+        }
+
+        void WriteAheadLog::waitForLeader(std::unique_lock<std::mutex>& lock) {
+            cv_.wait(lock, [this] { return !flushing_; });
+        }
+
+        void WriteAheadLog::encodeRecord(const core::Mutation& mutation, std::string& out) {
+            switch(mutation.type) {
+            case core::Mutation::Type::PUT:
+                BinaryWriter::putU8(out, static_cast<uint8_t>(RecordType::PUT));
+                BinaryWriter::putString(out, *mutation.key);
+                BinaryWriter::putValueObject(out, *mutation.value);
+                break;
+            case core::Mutation::Type::REMOVE:
+                BinaryWriter::putU8(out, static_cast<uint8_t>(RecordType::REMOVE));
+                BinaryWriter::putString(out, *mutation.key);
+                break;
+            case core::Mutation::Type::CLEAR:
+                BinaryWriter::putU8(out, static_cast<uint8_t>(RecordType::CLEAR));
+                break;
+            case core::Mutation::Type::AUTOSAVE:
+                BinaryWriter::putU8(out, static_cast<uint8_t>(RecordType::AUTOSAVE));
+                BinaryWriter::putU8(out, mutation.autosave ? 1 : 0);
+                break;
+            }
+        }
+
+        void WriteAheadLog::applyRecord(const char* payload, size_t length, core::KeyValueStore& store) {
+            BinaryReader reader(payload, length);
+            switch(static_cast<RecordType>(reader.u8())) {
+            case RecordType::PUT: {
+                std::string key = reader.string();
+                // put() checks the types against the store's registry under its lock
+                core::TypeRegistry types;
+                core::ValueObject obj(types);
+                reader.valueObject(obj);
+                store.put(key, obj);
+                break;
+            }
+            case RecordType::REMOVE:
+                store.deleteKey(reader.string());
+                break;
+            case RecordType::CLEAR:
+                store.clear();
+                break;
+            case RecordType::AUTOSAVE:
+                store.setAutosave(reader.u8() != 0);
+                break;
+            default:
+                throw exceptions::PersistenceException("Unknown mutation record type");
+            }
+        }
+
+        uint64_t WriteAheadLog::append(const core::Mutation& mutation) {
+            std::string payload;
+            encodeRecord(mutation, payload);
+
+            std::string header;
+            BinaryWriter::putU32(header, static_cast<uint32_t>(payload.size()));
+            BinaryWriter::putU32(header, utils::Checksum::crc32(payload.data(), payload.size()));
+
+            std::lock_guard<std::mutex> lock(mtx_);
+            pending_ += header;
+            pending_ += payload;
+            return ++appendedSeq_;
+        }
+
+        void WriteAheadLog::commit() {
+            std::unique_lock<std::mutex> lock(mtx_);
+            const uint64_t target = appendedSeq_;
+
+            while(writtenSeq_ < target) {
+                if(flushing_) {
+                    // Another writer is leading a batch; it may well include our record
+                    cv_.wait(lock);
+                    continue;
+                }
+
+                // Become the leader for everything buffered so far
+                flushing_ = true;
+                std::string batch;
+                batch.swap(pending_);
+                const uint64_t batchSeq = appendedSeq_;
+                lock.unlock();
+
+                try {
+                    writeAll(batch);
+                    if(policy_ == FsyncPolicy::ALWAYS) syncFile(fd_);
+                }
+                catch(...) {
+                    lock.lock();
+                    flushing_ = false;
+                    cv_.notify_all();
+                    throw;
+                }
+
+                lock.lock();
+                writtenBytes_ += batch.size();
+                writtenSeq_ = batchSeq;
+                unsynced_ = unsynced_ || policy_ != FsyncPolicy::ALWAYS;
+                flushing_ = false;
+                cv_.notify_all();
+            }
+        }
+
+        void WriteAheadLog::fsyncIfNeeded() {
+            int fd;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if(!unsynced_ || fd_ < 0) return;
+                // rotate() and reset() may close fd_ meanwhile: sync a duplicate, without holding up appends
+#ifdef _WIN32
+                fd = _dup(fd_);
+#else
+                fd = ::fcntl(fd_, F_DUPFD_CLOEXEC, 0);
+#endif
+                if(fd < 0) throw exceptions::PersistenceException(errnoMessage("Cannot fsync write-ahead log", filePath_));
+                unsynced_ = false;
+            }
+            try {
+                syncFile(fd);
+            }
+            catch(...) {
+                closeDescriptor(fd);
+                throw;
+            }
+            closeDescriptor(fd);
+        }
+
+        void WriteAheadLog::reset() {
+            std::unique_lock<std::mutex> lock(mtx_);
+            waitForLeader(lock);
+            pending_.clear();
+            writtenSeq_ = appendedSeq_;
+            writtenBytes_ = 0;
+            unsynced_ = false;
+            closeFile();
+            std::filesystem::resize_file(filePath_, 0);
+            openFile();
+        }
+
+        std::string WriteAheadLog::rotate() {
+            std::unique_lock<std::mutex> lock(mtx_);
+            waitForLeader(lock);
+
+            writeAll(pending_);
+            pending_.clear();
+            writtenSeq_ = appendedSeq_;
+            if(policy_ != FsyncPolicy::NO) syncFile(fd_);
+            unsynced_ = false;
+            closeFile();
+
+            const std::string oldPath = rotatedPath(filePath_);
+            if(std::filesystem::exists(oldPath)) {
+                // A previous rewrite never finished: keep its records in front of ours.
+                // Merged off to the side, so a crash never leaves a torn rotated log
+                const std::string merged = oldPath + ".tmp";
+                {
+                    std::ofstream out(merged, std::ios::binary | std::ios::trunc);
+                    for(const std::string& part : { oldPath, filePath_ }) {
+                        std::ifstream in(part, std::ios::binary);
+                        // Inserting an empty stream buffer would fail the output stream
+                        if(in.peek() != std::ifstream::traits_type::eof()) out << in.rdbuf();
+                    }
+                    out.close();
+                    if(!out) throw exceptions::PersistenceException(errnoMessage("Cannot write", merged));
+                }
+                PersistenceManager::commitFile(merged, oldPath);
+                std::filesystem::remove(filePath_);
+            }
+            else {
+                std::filesystem::rename(filePath_, oldPath);
+            }
+
+            writtenBytes_ = 0;
+            openFile();
+            return oldPath;
+        }
+
+        uint64_t WriteAheadLog::size() const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return writtenBytes_ + pending_.size();
+        }
+
+        std::string WriteAheadLog::rotatedPath(const std::string& filePath) {
+            return filePath + ".old";
+        }
+
+        size_t WriteAheadLog::replay(const std::string& filePath, core::KeyValueStore& store, bool newest) {
+            if(!std::filesystem::exists(filePath)) return 0;
+
+            std::ifstream file(filePath, std::ios::binary);
+            if(!file) {
+                throw exceptions::PersistenceException("Cannot open write-ahead log for replay: " + filePath);
+            }
+            const uint64_t fileSize = std::filesystem::file_size(filePath);
+
+            // The file is read a chunk at a time; buffer holds it from file offset
+            // `offset` - begin on, and only grows for a record bigger than a chunk
+            std::string buffer;
+            size_t begin = 0;
+            uint64_t offset = 0;
+            // Make `need` bytes from begin on available; false if the file ends first
+            auto fill = [&](size_t need) {
+                if(buffer.size() - begin >= need) return true;
+                buffer.erase(0, begin);
+                begin = 0;
+                while(buffer.size() < need) {
+                    const size_t filled = buffer.size();
+                    buffer.resize(filled + std::max(need - filled, REPLAY_CHUNK_SIZE));
+                    file.read(buffer.data() + filled, static_cast<std::streamsize>(buffer.size() - filled));
+                    buffer.resize(filled + static_cast<size_t>(file.gcount()));
+                    if(buffer.size() == filled) return false;
+                }
+                return true;
+            };
+
+            size_t applied = 0;
+            const char* problem = "incomplete record";
+            bool lastRecord = true;
+            while(fill(RECORD_HEADER_SIZE)) {
+                BinaryReader header(buffer.data() + begin, RECORD_HEADER_SIZE);
+                const uint32_t length = header.u32();
+                const uint32_t crc = header.u32();
+                // Checked against the file size before a corrupt length can size the buffer
+                if(offset + RECORD_HEADER_SIZE + length > fileSize || !fill(RECORD_HEADER_SIZE + length)) break;
+
+                const char* payload = buffer.data() + begin + RECORD_HEADER_SIZE;
+                if(utils::Checksum::crc32(payload, length) != crc) {
+                    problem = "checksum mismatch";
+                    lastRecord = offset + RECORD_HEADER_SIZE + length == fileSize;
+                    break;
+                }
+
+                try {
+                    applyRecord(payload, length, store);
+                }
+                catch(const exceptions::PersistenceException&) {
+                    throw exceptions::PersistenceException("Malformed record in write-ahead log: " + filePath);
+                }
+
+                begin += RECORD_HEADER_SIZE + length;
+                offset += RECORD_HEADER_SIZE + length;
+                ++applied;
+            }
+            file.close();
+
+            if(offset < fileSize) {
+                // Only the last record of the file being appended to can be torn by a
+                // crash mid-append; anything else would drop records without a word
+                if(!newest || !lastRecord) {
+                    throw exceptions::PersistenceException("Corrupt write-ahead log " + filePath + " at offset " +
+                        std::to_string(offset) + ": " + problem);
+                }
+                // Drop the torn tail so new records are not appended after garbage
+                std::cerr << "Truncating write-ahead log " << filePath << " at offset " << offset
+                    << " (" << (fileSize - offset) << " trailing bytes discarded)\n";
+                std::filesystem::resize_file(filePath, offset);
+            }
+            return applied;
+        }
+
+    }
+}
@@ -1,23 +1,259 @@
 #include <iostream>
+#include <algorithm>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 #include "kvstore/core/KeyValueStore.hpp"
+#include "kvstore/core/StoreManager.hpp"
 #include "kvstore/net/TCPServer.hpp"
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 /**
  * TCP server main entry point
  * Runs the key-value store as a persistent TCP server
  */
 int main(int argc, char* argv[]) {
+#ifdef __GLIBC__
+    // A pipelined batch's replies are freed together once sent. With its default
+    // sliding thresholds glibc hands that memory back to the kernel after each
+    // batch and page-faults it in again for the next one.
+    mallopt(M_MMAP_THRESHOLD, 4 << 20);
+    mallopt(M_TRIM_THRESHOLD, 64 << 20);
+#endif
     int port = 5555;
-    if(argc > 1) {
-        port = std::stoi(argv[1]);
+    kvstore::StoreManager::PersistenceOptions options;
+    bool customSaveRules = false;
+    bool preload = false;
+    size_t preloadThreads = 0;
+    std::string replicaHost;
+    int replicaPort = 0;
+    int tcpBacklog = 511;
+    size_t commandThreads = 0;
+    size_t reactors = 1;
+    std::vector<int> reactorCpus;
+
+    try {
+        for(int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto requireValue = [&](const std::string& option) -> std::string {
+                if(i + 1 >= argc) throw std::invalid_argument(option + " requires a value");
+                return argv[++i];
+            };
+
+            if(arg == "--appendfsync") {
+                std::string policy = requireValue(arg);
+                if(policy == "always") options.fsyncPolicy = kvspp::persistence::FsyncPolicy::ALWAYS;
+                else if(policy == "everysec") options.fsyncPolicy = kvspp::persistence::FsyncPolicy::EVERYSEC;
+                else if(policy == "no") options.fsyncPolicy = kvspp::persistence::FsyncPolicy::NO;
+                else throw std::invalid_argument("--appendfsync must be always, everysec or no");
+            }
+            else if(arg == "--fsync-interval-ms") {
+                options.fsyncInterval = std::chrono::milliseconds(std::stol(requireValue(arg)));
+            }
+            else if(arg == "--wal-rewrite-ratio") {
+                options.rewriteRatio = std::stod(requireValue(arg));
+            }
+            else if(arg == "--wal-rewrite-min-size") {
+                options.rewriteMinSize = std::stoull(requireValue(arg));
+            }
+            else if(arg == "--snapshot-format") {
+                std::string format = requireValue(arg);
+                if(format == "json") options.snapshotFormat = kvspp::persistence::SnapshotFormat::JSON;
+                else if(format == "binary") options.snapshotFormat = kvspp::persistence::SnapshotFormat::BINARY;
+                else throw std::invalid_argument("--snapshot-format must be json or binary");
+            }
+            else if(arg == "--snapshot-compression") {
+                auto codec = kvspp::utils::Compression::parse(requireValue(arg));
+                if(!codec) throw std::invalid_argument("--snapshot-compression must be none, fast, lz4 or zstd");
+                if(!kvspp::utils::Compression::available(*codec)) {
+                    std::cerr << "Warning: " << kvspp::utils::Compression::name(*codec)
+                              << " support is not built in, using fast" << std::endl;
+                }
+                options.snapshotCompression = kvspp::utils::Compression::resolve(*codec);
+            }
+            else if(arg == "--snapshot-fsync") {
+                std::string policy = requireValue(arg);
+                if(policy == "none") options.snapshotFsync = kvspp::persistence::SnapshotFsync::NONE;
+                else if(policy == "file") options.snapshotFsync = kvspp::persistence::SnapshotFsync::FILE;
+                else if(policy == "dir") options.snapshotFsync = kvspp::persistence::SnapshotFsync::DIRECTORY;
+                else throw std::invalid_argument("--snapshot-fsync must be none, file or dir");
+            }
+            else if(arg == "--storage-engine") {
+                std::string engine = requireValue(arg);
+                if(engine == "memory") options.storageEngine = kvstore::StoreManager::StorageEngine::MEMORY;
+                else if(engine == "log") options.storageEngine = kvstore::StoreManager::StorageEngine::LOG;
+                else throw std::invalid_argument("--storage-engine must be memory or log");
+            }
+            else if(arg == "--log-file-size") {
+                options.logStorage.maxFileSize = std::stoull(requireValue(arg));
+            }
+            else if(arg == "--log-merge-ratio") {
+                options.logStorage.mergeRatio = std::stod(requireValue(arg));
+            }
+            else if(arg == "--log-merge-min-size") {
+                options.logStorage.mergeMinBytes = std::stoull(requireValue(arg));
+            }
+            else if(arg == "--cold-after") {
+                options.coldAfterSeconds = static_cast<uint32_t>(std::stoul(requireValue(arg)));
+            }
+            else if(arg == "--key-filter-bits") {
+                options.keyFilterBitsPerKey = std::stod(requireValue(arg));
+            }
+            else if(arg == "--replicaof") {
+                std::string leader = requireValue(arg);
+                size_t colon = leader.rfind(':');
+                if(colon == std::string::npos || colon == 0) throw std::invalid_argument("--replicaof must be HOST:PORT");
+                replicaHost = leader.substr(0, colon);
+                replicaPort = std::stoi(leader.substr(colon + 1));
+            }
+            else if(arg == "--repl-backlog-size") {
+                kvspp::net::ReplicationLeader::setBacklogSize(std::stoull(requireValue(arg)));
+            }
+            else if(arg == "--tcp-backlog") {
+                tcpBacklog = std::stoi(requireValue(arg));
+                if(tcpBacklog <= 0) throw std::invalid_argument("--tcp-backlog must be positive");
+            }
+            else if(arg == "--command-threads") {
+                commandThreads = std::stoul(requireValue(arg));
+            }
+            else if(arg == "--reactors") {
+                reactors = std::stoul(requireValue(arg));
+                if(reactors == 0) reactors = std::max(1u, std::thread::hardware_concurrency());
+            }
+            else if(arg == "--reactor-cpus") {
+                // Comma-separated CPUs or ranges, e.g. "0-3,8"
+                std::stringstream list(requireValue(arg));
+                std::string item;
+                while(std::getline(list, item, ',')) {
+                    size_t dash = item.find('-');
+                    int first = std::stoi(item.substr(0, dash));
+                    int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+                    if(first < 0 || last < first) throw std::invalid_argument("--reactor-cpus expects CPUs like 0-3,8");
+                    for(int cpu = first; cpu <= last; ++cpu) reactorCpus.push_back(cpu);
+                }
+                if(reactorCpus.empty()) throw std::invalid_argument("--reactor-cpus expects CPUs like 0-3,8");
+            }
+            else if(arg == "--io-uring") {
+                std::string value = requireValue(arg);
+                if(value != "yes" && value != "no") throw std::invalid_argument("--io-uring must be yes or no");
+                options.ioUring = value == "yes";
+            }
+            else if(arg == "--preload") {
+                preload = true;
+            }
+            else if(arg == "--preload-threads") {
+                preloadThreads = std::stoul(requireValue(arg));
+            }
+            else if(arg == "--loading-policy") {
+                std::string policy = requireValue(arg);
+                if(policy == "block") options.loadingPolicy = kvstore::StoreManager::LoadingPolicy::BLOCK;
+                else if(policy == "reject") options.loadingPolicy = kvstore::StoreManager::LoadingPolicy::REJECT;
+                else throw std::invalid_argument("--loading-policy must be block or reject");
+            }
+            else if(arg == "--load-threads") {
+                options.loadThreads = std::stoul(requireValue(arg));
+            }
+            else if(arg == "--delta-snapshots") {
+                std::string value = requireValue(arg);
+                if(value != "yes" && value != "no") throw std::invalid_argument("--delta-snapshots must be yes or no");
+                options.deltaSnapshots = value == "yes";
+            }
+            else if(arg == "--delta-merge-ratio") {
+                options.deltaMergeRatio = std::stod(requireValue(arg));
+            }
+            else if(arg == "--max-deltas") {
+                options.maxDeltas = std::stoul(requireValue(arg));
+            }
+            else if(arg == "--appendonly") {
+                std::string value = requireValue(arg);
+                if(value != "yes" && value != "no") throw std::invalid_argument("--appendonly must be yes or no");
+                options.appendOnly = value == "yes";
+            }
+            else if(arg == "--save") {
+                // --save "<seconds> <changes>", may be repeated; --save "" disables rule-based saves
+                std::string rule = requireValue(arg);
+                if(!customSaveRules) options.saveRules.clear();
+                customSaveRules = true;
+                if(!rule.empty()) {
+                    size_t space = rule.find(' ');
+                    if(space == std::string::npos) throw std::invalid_argument("--save expects \"<seconds> <changes>\"");
+                    options.saveRules.push_back({ std::chrono::seconds(std::stol(rule.substr(0, space))),
+                        std::stoull(rule.substr(space + 1)) });
+                }
+            }
+            else if(arg == "--help" || arg == "-h") {
+                std::cout << "Usage: " << argv[0] << " [port] [OPTIONS]" << std::endl;
+                std::cout << std::endl;
+                std::cout << "Options:" << std::endl;
+                std::cout << "  --snapshot-format json|binary      Format of store snapshots (default: json)" << std::endl;
+                std::cout << "  --snapshot-compression none|fast|lz4|zstd  Block codec of binary snapshots (default: none)" << std::endl;
+                std::cout << "  --snapshot-fsync none|file|dir     fsync snapshots before renaming them into place, and their directory after (default: file)" << std::endl;
+                std::cout << "  --storage-engine memory|log        Keep store values in memory or in log-structured data files (default: memory)" << std::endl;
+                std::cout << "  --log-file-size BYTES              Seal log-structured data files at this size (default: 67108864)" << std::endl;
+                std::cout << "  --log-merge-ratio R                Merge once R of the sealed data is stale (default: 0.5)" << std::endl;
+                std::cout << "  --log-merge-min-size BYTES         Never merge less stale data than this (default: 16777216)" << std::endl;
+                std::cout << "  --cold-after SECONDS               Move values idle this long to a memory-mapped cold file (default: 0 = off)" << std::endl;
+                std::cout << "  --key-filter-bits N                Bits per key of the Bloom filter saved beside snapshots (default: 10, 0 = none)" << std::endl;
+                std::cout << "  --replicaof HOST:PORT              Run as a read-only follower replicating the leader at HOST:PORT" << std::endl;
+                std::cout << "  --repl-backlog-size BYTES          Writes kept for followers to resume from after a disconnect (default: 16777216)" << std::endl;
+                std::cout << "  --tcp-backlog N                    Connections queued for accept (default: 511, capped by net.core.somaxconn)" << std::endl;
+                std::cout << "  --command-threads N                Threads running client commands (default: 0 = on the event loops)" << std::endl;
+                std::cout << "  --reactors N                       Event loop threads serving connections (default: 1, 0 = one per core)" << std::endl;
+                std::cout << "  --reactor-cpus LIST                Pin reactor i to the i-th CPU of LIST, e.g. 0-3,8 (default: not pinned)" << std::endl;
+                std::cout << "  --io-uring yes|no                  Serve connections and write snapshots through io_uring, falling back" << std::endl;
+                std::cout << "                                     to epoll and write() where the kernel lacks it (default: no)" << std::endl;
+                std::cout << "  --preload                          Load every snapshot in store/ at startup, largest first" << std::endl;
+                std::cout << "  --preload-threads N                Stores loaded concurrently by --preload (default: 0 = one per core)" << std::endl;
+                std::cout << "  --loading-policy block|reject      Requests to a store still loading wait or fail (default: block)" << std::endl;
+                std::cout << "  --load-threads N                   Threads used to parse large snapshots (default: 0 = one per core)" << std::endl;
+                std::cout << "  --delta-snapshots yes|no           Snapshot only changed keys as delta segments (default: no)" << std::endl;
+                std::cout << "  --delta-merge-ratio R              Merge deltas into the base past R x base size (default: 0.5)" << std::endl;
+                std::cout << "  --max-deltas N                     Merge deltas into the base after N segments (default: 16)" << std::endl;
+                std::cout << "  --appendonly yes|no                Log autosave writes to a write-ahead log (default: yes)" << std::endl;
+                std::cout << "  --appendfsync always|everysec|no   Write-ahead log fsync policy (default: everysec)" << std::endl;
+                std::cout << "  --fsync-interval-ms N              Background fsync interval for everysec (default: 1000)" << std::endl;
+                std::cout << "  --wal-rewrite-ratio R              Rewrite the log once it exceeds R x snapshot size (default: 2)" << std::endl;
+                std::cout << "  --wal-rewrite-min-size BYTES       Never rewrite logs smaller than this (default: 1048576)" << std::endl;
+                std::cout << "  --save \"SECONDS CHANGES\"           Snapshot after SECONDS if at least CHANGES writes (repeatable," << std::endl;
+                std::cout << "                                     default: 3600 1, 300 100, 60 10000)" << std::endl;
+                return 0;
+            }
+            else {
+                port = std::stoi(arg);
+            }
+        }
+    }
+    catch(const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        std::cerr << "Use --help for usage information" << std::endl;
+        return 1;
+    }
+
+    kvstore::StoreManager::instance().setPersistenceOptions(options);
+    if(preload) {
+        // Stores are marked as loading before the first connection is accepted
+        size_t scheduled = kvstore::StoreManager::instance().preloadStores(preloadThreads);
+        std::cout << "Preloading " << scheduled << " store(s) from store/" << std::endl;
     }
     kvspp::net::TCPServer server(port);
+    server.setListenBacklog(tcpBacklog);
+    server.setCommandThreads(commandThreads);
+    server.setReactors(reactors);
+    server.setReactorCpus(reactorCpus);
+    server.setIoUring(options.ioUring);
+    if(!replicaHost.empty()) {
+        server.replicateFrom(replicaHost, replicaPort);
+        std::cout << "Replicating " << replicaHost << ":" << replicaPort << " (read-only)" << std::endl;
+    }
     std::cout << "KVS++ TCP server listening on port " << port << std::endl;
     server.start();
     // Wait for user to terminate
     std::cout << "Press Enter to stop the server..." << std::endl;
     std::cin.get();
     server.stop();
+    kvstore::StoreManager::instance().flushPendingSaves();
     return 0;
 }
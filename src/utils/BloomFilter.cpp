@@ -0,0 +1,86 @@
+#include "kvstore/utils/BloomFilter.hpp"
+#include "kvstore/utils/Checksum.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace kvspp {
+    namespace utils {
+
+        namespace {
+            constexpr uint64_t WORDS_PER_BLOCK = 8;   // 512 bits, one cache line
+            // Bit positions within a block are 9-bit slices of one 64-bit hash
+            constexpr uint32_t MAX_HASHES = 7;
+            constexpr size_t SERIALIZED_HEADER = 12;
+
+            uint64_t loadU64(const char* p) {
+                uint64_t value = 0;
+                for(int i = 0; i < 8; ++i) {
+                    value |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+                }
+                return value;
+            }
+
+            void appendU64(std::string& out, uint64_t value) {
+                for(int i = 0; i < 8; ++i) {
+                    out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+                }
+            }
+        }
+
+        BloomFilter::BloomFilter(size_t expectedKeys, double bitsPerKey) {
+            bitsPerKey = std::max(bitsPerKey, 1.0);
+            const double bits = std::max(1.0, static_cast<double>(expectedKeys) * bitsPerKey);
+            blocks_ = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(bits / (WORDS_PER_BLOCK * 64))));
+            hashes_ = std::clamp<uint32_t>(static_cast<uint32_t>(std::lround(bitsPerKey * 0.69)), 1, MAX_HASHES);
+            words_.assign(blocks_ * WORDS_PER_BLOCK, 0);
+        }
+
+        void BloomFilter::add(std::string_view key) {
+            const uint64_t hash = Checksum::hash64(key);
+            uint64_t* block = words_.data() + (((hash >> 32) * blocks_) >> 32) * WORDS_PER_BLOCK;
+            uint64_t bits = Checksum::mix64(hash);
+            for(uint32_t i = 0; i < hashes_; ++i, bits >>= 9) {
+                block[(bits >> 6) & 7] |= uint64_t(1) << (bits & 63);
+            }
+        }
+
+        bool BloomFilter::mayContain(std::string_view key) const {
+            const uint64_t hash = Checksum::hash64(key);
+            const uint64_t* block = words_.data() + (((hash >> 32) * blocks_) >> 32) * WORDS_PER_BLOCK;
+            uint64_t bits = Checksum::mix64(hash);
+            for(uint32_t i = 0; i < hashes_; ++i, bits >>= 9) {
+                if(!(block[(bits >> 6) & 7] & (uint64_t(1) << (bits & 63)))) return false;
+            }
+            return true;
+        }
+
+        void BloomFilter::serialize(std::string& out) const {
+            out.reserve(out.size() + SERIALIZED_HEADER + words_.size() * 8);
+            for(int i = 0; i < 4; ++i) {
+                out.push_back(static_cast<char>((hashes_ >> (8 * i)) & 0xFF));
+            }
+            appendU64(out, blocks_);
+            for(uint64_t word : words_) appendU64(out, word);
+        }
+
+        BloomFilter BloomFilter::deserialize(const char* data, size_t length) {
+            if(length < SERIALIZED_HEADER) throw std::runtime_error("Truncated Bloom filter");
+            BloomFilter filter;
+            for(int i = 0; i < 4; ++i) {
+                filter.hashes_ |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+            }
+            filter.blocks_ = loadU64(data + 4);
+            if(filter.hashes_ < 1 || filter.hashes_ > MAX_HASHES || filter.blocks_ == 0 ||
+                filter.blocks_ > UINT32_MAX || length != SERIALIZED_HEADER + filter.blocks_ * WORDS_PER_BLOCK * 8) {
+                throw std::runtime_error("Malformed Bloom filter");
+            }
+            filter.words_.resize(filter.blocks_ * WORDS_PER_BLOCK);
+            for(size_t i = 0; i < filter.words_.size(); ++i) {
+                filter.words_[i] = loadU64(data + SERIALIZED_HEADER + i * 8);
+            }
+            return filter;
+        }
+
+    }
+}
@@ -0,0 +1,78 @@
+#include "kvstore/utils/Checksum.hpp"
+#include <array>
+
+namespace kvspp {
+    namespace utils {
+
+        namespace {
+            // Slice-by-4 tables for the reflected IEEE polynomial
+            std::array<std::array<uint32_t, 256>, 4> buildTables() {
+                std::array<std::array<uint32_t, 256>, 4> tables{};
+                for(uint32_t i = 0; i < 256; ++i) {
+                    uint32_t c = i;
+                    for(int k = 0; k < 8; ++k) {
+                        c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                    }
+                    tables[0][i] = c;
+                }
+                for(uint32_t i = 0; i < 256; ++i) {
+                    for(size_t t = 1; t < 4; ++t) {
+                        uint32_t prev = tables[t - 1][i];
+                        tables[t][i] = (prev >> 8) ^ tables[0][prev & 0xFF];
+                    }
+                }
+                return tables;
+            }
+
+            const std::array<std::array<uint32_t, 256>, 4>& tables() {
+                static const auto instance = buildTables();
+                return instance;
+            }
+        }
+
+        uint32_t Checksum::crc32(const void* data, size_t length, uint32_t crc) {
+            const auto& t = tables();
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            crc = ~crc;
+
+            while(length >= 4) {
+                crc ^= static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                    (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+                crc = t[3][crc & 0xFF] ^ t[2][(crc >> 8) & 0xFF] ^
+                    t[1][(crc >> 16) & 0xFF] ^ t[0][crc >> 24];
+                p += 4;
+                length -= 4;
+            }
+            while(length--) {
+                crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        uint64_t Checksum::mix64(uint64_t x) {
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ull;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebull;
+            x ^= x >> 31;
+            return x;
+        }
+
+        uint64_t Checksum::hash64(std::string_view data, uint64_t seed) {
+            auto load = [](const char* p, size_t length) {
+                uint64_t value = 0;
+                for(size_t i = 0; i < length; ++i) {
+                    value |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+                }
+                return value;
+            };
+            uint64_t h = seed ^ (data.size() * 0x9e3779b97f4a7c15ull);
+            size_t i = 0;
+            for(; i + 8 <= data.size(); i += 8) {
+                h = mix64(h ^ load(data.data() + i, 8));
+            }
+            return mix64(h ^ load(data.data() + i, data.size() - i) ^ 0xff51afd7ed558ccdull);
+        }
+
+    }
+}
@@ -0,0 +1,248 @@
+#include "kvstore/utils/Compression.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#ifdef KVSPP_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef KVSPP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace kvspp {
+    namespace utils {
+
+        namespace {
+            // Built-in codec: LZ77 with a single-probe hash table, in the spirit of LZ4.
+            // A block is a series of sequences: a token (high nibble literal length,
+            // low nibble match length - MIN_MATCH, 15 = continued in 255-run bytes),
+            // the literals, then a u16 little-endian match offset. The last sequence
+            // has literals only and ends the block.
+            constexpr size_t MIN_MATCH = 4;
+            constexpr size_t MAX_OFFSET = 65535;
+            constexpr int HASH_BITS = 14;
+            constexpr int ZSTD_LEVEL = 1;
+
+            uint32_t read32(const char* p) {
+                uint32_t value;
+                std::memcpy(&value, p, sizeof(value));
+                return value;
+            }
+
+            uint32_t hash(uint32_t sequence) {
+                return (sequence * 2654435761u) >> (32 - HASH_BITS);
+            }
+
+            void putLength(std::string& out, size_t length) {
+                while(length >= 255) {
+                    out.push_back(static_cast<char>(255));
+                    length -= 255;
+                }
+                out.push_back(static_cast<char>(length));
+            }
+
+            void putSequence(std::string& out, const char* literals, size_t literalLength, size_t offset, size_t matchLength) {
+                const size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+                const uint8_t token = static_cast<uint8_t>((std::min<size_t>(literalLength, 15) << 4) |
+                    std::min<size_t>(matchCode, 15));
+                out.push_back(static_cast<char>(token));
+                if(literalLength >= 15) putLength(out, literalLength - 15);
+                out.append(literals, literalLength);
+                if(matchLength == 0) return;
+                out.push_back(static_cast<char>(offset & 0xFF));
+                out.push_back(static_cast<char>(offset >> 8));
+                if(matchCode >= 15) putLength(out, matchCode - 15);
+            }
+
+            void compressFast(const char* data, size_t length, std::string& out) {
+                out.clear();
+                out.reserve(length + length / 255 + 16);
+                std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+
+                size_t anchor = 0;
+                size_t pos = 0;
+                while(length >= MIN_MATCH && pos + MIN_MATCH <= length) {
+                    const uint32_t sequence = read32(data + pos);
+                    uint32_t& slot = table[hash(sequence)];
+                    const size_t candidate = slot;
+                    slot = static_cast<uint32_t>(pos);
+
+                    if(candidate < pos && pos - candidate <= MAX_OFFSET && read32(data + candidate) == sequence) {
+                        size_t matchLength = MIN_MATCH;
+                        while(pos + matchLength < length && data[candidate + matchLength] == data[pos + matchLength]) {
+                            ++matchLength;
+                        }
+                        putSequence(out, data + anchor, pos - anchor, pos - candidate, matchLength);
+                        pos += matchLength;
+                        anchor = pos;
+                        if(pos >= 2 && pos + MIN_MATCH <= length) {
+                            table[hash(read32(data + pos - 2))] = static_cast<uint32_t>(pos - 2);
+                        }
+                    }
+                    else {
+                        // Skip faster through data that does not compress
+                        pos += 1 + ((pos - anchor) >> 6);
+                    }
+                }
+                putSequence(out, data + anchor, length - anchor, 0, 0);
+            }
+
+            [[noreturn]] void corrupt() {
+                throw exceptions::PersistenceException("Corrupt compressed block");
+            }
+
+            size_t getLength(const uint8_t*& in, const uint8_t* end, size_t length) {
+                uint8_t byte;
+                do {
+                    if(in >= end) corrupt();
+                    byte = *in++;
+                    length += byte;
+                } while(byte == 255);
+                return length;
+            }
+
+            void decompressFast(const char* data, size_t length, char* out, size_t rawLength) {
+                const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+                const uint8_t* inEnd = in + length;
+                size_t written = 0;
+
+                while(true) {
+                    if(in >= inEnd) corrupt();
+                    const uint8_t token = *in++;
+
+                    size_t literalLength = token >> 4;
+                    if(literalLength == 15) literalLength = getLength(in, inEnd, literalLength);
+                    if(literalLength > static_cast<size_t>(inEnd - in) || literalLength > rawLength - written) corrupt();
+                    std::memcpy(out + written, in, literalLength);
+                    in += literalLength;
+                    written += literalLength;
+                    if(in == inEnd) break;
+
+                    if(inEnd - in < 2) corrupt();
+                    const size_t offset = in[0] | (size_t(in[1]) << 8);
+                    in += 2;
+                    size_t matchLength = token & 0x0F;
+                    if(matchLength == 15) matchLength = getLength(in, inEnd, matchLength);
+                    matchLength += MIN_MATCH;
+                    if(offset == 0 || offset > written || matchLength > rawLength - written) corrupt();
+
+                    char* dst = out + written;
+                    const char* src = dst - offset;
+                    if(offset >= matchLength) {
+                        std::memcpy(dst, src, matchLength);
+                    }
+                    else {
+                        // Overlapping copy repeats the last `offset` bytes
+                        for(size_t i = 0; i < matchLength; ++i) dst[i] = src[i];
+                    }
+                    written += matchLength;
+                }
+                if(written != rawLength) corrupt();
+            }
+        }
+
+        bool Compression::available(Codec codec) {
+            switch(codec) {
+                case Codec::NONE:
+                case Codec::FAST:
+                    return true;
+                case Codec::LZ4:
+#ifdef KVSPP_HAVE_LZ4
+                    return true;
+#else
+                    return false;
+#endif
+                case Codec::ZSTD:
+#ifdef KVSPP_HAVE_ZSTD
+                    return true;
+#else
+                    return false;
+#endif
+            }
+            return false;
+        }
+
+        Codec Compression::resolve(Codec codec) {
+            return available(codec) ? codec : Codec::FAST;
+        }
+
+        const char* Compression::name(Codec codec) {
+            switch(codec) {
+                case Codec::NONE: return "none";
+                case Codec::FAST: return "fast";
+                case Codec::LZ4: return "lz4";
+                case Codec::ZSTD: return "zstd";
+            }
+            return "unknown";
+        }
+
+        std::optional<Codec> Compression::parse(const std::string& name) {
+            for(Codec codec : { Codec::NONE, Codec::FAST, Codec::LZ4, Codec::ZSTD }) {
+                if(name == Compression::name(codec)) return codec;
+            }
+            return std::nullopt;
+        }
+
+        bool Compression::compress(Codec codec, const char* data, size_t length, std::string& out) {
+            switch(codec) {
+                case Codec::NONE:
+                    return false;
+                case Codec::FAST:
+                    compressFast(data, length, out);
+                    break;
+#ifdef KVSPP_HAVE_LZ4
+                case Codec::LZ4: {
+                    out.resize(static_cast<size_t>(LZ4_compressBound(static_cast<int>(length))));
+                    int size = LZ4_compress_default(data, out.data(), static_cast<int>(length), static_cast<int>(out.size()));
+                    if(size <= 0) return false;
+                    out.resize(static_cast<size_t>(size));
+                    break;
+                }
+#endif
+#ifdef KVSPP_HAVE_ZSTD
+                case Codec::ZSTD: {
+                    out.resize(ZSTD_compressBound(length));
+                    size_t size = ZSTD_compress(out.data(), out.size(), data, length, ZSTD_LEVEL);
+                    if(ZSTD_isError(size)) return false;
+                    out.resize(size);
+                    break;
+                }
+#endif
+                default:
+                    throw exceptions::PersistenceException(std::string("Compression codec not available: ") + name(codec));
+            }
+            return out.size() < length;
+        }
+
+        void Compression::decompress(Codec codec, const char* data, size_t length, char* out, size_t rawLength) {
+            switch(codec) {
+                case Codec::NONE:
+                    if(length != rawLength) corrupt();
+                    std::memcpy(out, data, length);
+                    return;
+                case Codec::FAST:
+                    decompressFast(data, length, out, rawLength);
+                    return;
+#ifdef KVSPP_HAVE_LZ4
+                case Codec::LZ4: {
+                    int size = LZ4_decompress_safe(data, out, static_cast<int>(length), static_cast<int>(rawLength));
+                    if(size < 0 || static_cast<size_t>(size) != rawLength) corrupt();
+                    return;
+                }
+#endif
+#ifdef KVSPP_HAVE_ZSTD
+                case Codec::ZSTD: {
+                    size_t size = ZSTD_decompress(out, rawLength, data, length);
+                    if(ZSTD_isError(size) || size != rawLength) corrupt();
+                    return;
+                }
+#endif
+                default:
+                    throw exceptions::PersistenceException(std::string("Snapshot uses the ") + name(codec) +
+                        " codec, which this build does not support");
+            }
+        }
+
+    }
+}
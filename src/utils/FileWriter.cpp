@@ -0,0 +1,190 @@
+#include "kvstore/utils/FileWriter.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <system_error>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace kvspp {
+    namespace utils {
+
+        namespace {
+            constexpr size_t BUFFER_SIZE = 1 << 20;
+            constexpr size_t RING_BUFFERS = 4;
+
+            std::atomic<bool> useIoUring{ false };
+        }
+
+        FileWriter::FileWriter(const std::string& path) : path_(path) {
+#ifdef _WIN32
+            fd_ = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+            fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+            if(fd_ < 0) {
+                throw exceptions::PersistenceException("Cannot open file for writing: " + path + ": " + std::strerror(errno));
+            }
+#ifdef KVSPP_HAVE_IO_URING
+            if(useIoUring) {
+                try {
+                    ring_ = std::make_unique<IoUring>(RING_BUFFERS * 2);
+                }
+                catch(const std::system_error& e) {
+                    if(useIoUring.exchange(false)) {
+                        std::cerr << "io_uring unavailable for file writes (" << e.what() << "), using write()" << std::endl;
+                    }
+                }
+            }
+            slots_.resize(ring_ ? RING_BUFFERS : 1);
+#else
+            slots_.resize(1);
+#endif
+            slots_[0].data.reserve(BUFFER_SIZE);
+        }
+
+        FileWriter::~FileWriter() {
+#ifdef KVSPP_HAVE_IO_URING
+            // The kernel may still be reading the buffers
+            while(inFlight_ > 0) reap(true);
+#endif
+            closeFile();
+        }
+
+        void FileWriter::setIoUring(bool enabled) {
+            useIoUring = enabled;
+        }
+
+        bool FileWriter::ioUring() {
+            return useIoUring;
+        }
+
+        void FileWriter::write(const char* data, size_t length) {
+            if(error_) fail(error_);
+            while(length > 0) {
+                std::string& buffer = slots_[current_].data;
+                const size_t take = std::min(length, BUFFER_SIZE - buffer.size());
+                buffer.append(data, take);
+                data += take;
+                length -= take;
+                if(buffer.size() == BUFFER_SIZE) flushBuffer();
+            }
+        }
+
+        void FileWriter::close() {
+            flushBuffer();
+#ifdef KVSPP_HAVE_IO_URING
+            while(inFlight_ > 0) reap(true);
+#endif
+            if(error_) fail(error_);
+#ifdef _WIN32
+            const int result = _close(fd_);
+#else
+            const int result = ::close(fd_);
+#endif
+            fd_ = -1;
+            if(result != 0) fail(errno);
+        }
+
+        void FileWriter::flushBuffer() {
+            Slot& slot = slots_[current_];
+            if(slot.data.empty()) return;
+            slot.offset = offset_;
+            slot.done = 0;
+            offset_ += slot.data.size();
+#ifdef KVSPP_HAVE_IO_URING
+            if(ring_) {
+                queue(current_);
+                current_ = (current_ + 1) % slots_.size();
+                while(slots_[current_].inFlight) reap(true);
+                if(error_) fail(error_);
+                slots_[current_].data.reserve(BUFFER_SIZE);
+                return;
+            }
+#endif
+            const char* data = slot.data.data();
+            size_t length = slot.data.size();
+            while(length > 0) {
+#ifdef _WIN32
+                int written = _write(fd_, data, static_cast<unsigned int>(std::min<size_t>(length, 1u << 30)));
+#else
+                ssize_t written = ::write(fd_, data, length);
+#endif
+                if(written < 0) {
+                    if(errno == EINTR) continue;
+                    fail(errno);
+                }
+                data += written;
+                length -= static_cast<size_t>(written);
+            }
+            slot.data.clear();
+        }
+
+#ifdef KVSPP_HAVE_IO_URING
+        void FileWriter::queue(size_t index) {
+            Slot& slot = slots_[index];
+            io_uring_sqe* sqe = ring_->sqe();
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = fd_;
+            sqe->addr = reinterpret_cast<uint64_t>(slot.data.data() + slot.done);
+            sqe->len = static_cast<uint32_t>(slot.data.size() - slot.done);
+            sqe->off = slot.offset + slot.done;
+            sqe->user_data = index;
+            slot.inFlight = true;
+            ++inFlight_;
+            ring_->submit(0);
+        }
+
+        void FileWriter::reap(bool wait) {
+            if(wait) {
+                const int result = ring_->submit(1);
+                if(result < 0 && result != -EINTR) {
+                    // The ring cannot be waited on: stop waiting for the writes
+                    if(!error_) error_ = -result;
+                    for(Slot& slot : slots_) slot.inFlight = false;
+                    inFlight_ = 0;
+                    return;
+                }
+            }
+            ring_->drain([this](const io_uring_cqe& cqe) {
+                Slot& slot = slots_[cqe.user_data];
+                slot.inFlight = false;
+                --inFlight_;
+                if(cqe.res <= 0 && !error_) error_ = cqe.res < 0 ? -cqe.res : EIO;
+                if(cqe.res > 0) slot.done += static_cast<size_t>(cqe.res);
+                // A short write continues where it stopped
+                if(!error_ && slot.done < slot.data.size()) queue(cqe.user_data);
+                else slot.data.clear();
+            });
+        }
+#endif
+
+        void FileWriter::fail(int error) {
+#ifdef KVSPP_HAVE_IO_URING
+            while(inFlight_ > 0) reap(true);
+#endif
+            closeFile();
+            throw exceptions::PersistenceException("Cannot write file " + path_ + ": " + std::strerror(error));
+        }
+
+        void FileWriter::closeFile() {
+            if(fd_ < 0) return;
+#ifdef _WIN32
+            _close(fd_);
+#else
+            ::close(fd_);
+#endif
+            fd_ = -1;
+        }
+
+    }
+}
@@ -0,0 +1,148 @@
+#include "kvstore/utils/IoUring.hpp"
+
+#ifdef KVSPP_HAVE_IO_URING
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace kvspp {
+    namespace utils {
+
+        namespace {
+            int ringSetup(unsigned entries, io_uring_params* params) {
+                return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+            }
+
+            int ringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+                return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+            }
+
+            int ringRegister(int fd, unsigned opcode, void* arg, unsigned count) {
+                return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+            }
+
+            template<typename T>
+            T* at(void* base, uint32_t offset) {
+                return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+            }
+        }
+
+        IoUring::IoUring(unsigned entries) {
+            io_uring_params params{};
+            // The owning thread reaps completions when it enters the kernel anyway, so
+            // they need not interrupt it (5.19; older kernels are asked again without)
+            params.flags = IORING_SETUP_COOP_TASKRUN;
+            fd_ = ringSetup(entries, &params);
+            if(fd_ < 0 && errno == EINVAL) {
+                params = io_uring_params{};
+                fd_ = ringSetup(entries, &params);
+            }
+            if(fd_ < 0) throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+            if(!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+                ::close(fd_);
+                throw std::system_error(ENOSYS, std::generic_category(), "io_uring without single mmap");
+            }
+
+            ringSize_ = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+            ring_ = ::mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+            sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqes = ring_ == MAP_FAILED ? MAP_FAILED
+                : ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+            if(ring_ == MAP_FAILED || sqes == MAP_FAILED) {
+                const int error = errno;
+                if(ring_ != MAP_FAILED) ::munmap(ring_, ringSize_);
+                ::close(fd_);
+                throw std::system_error(error, std::generic_category(), "io_uring mmap");
+            }
+            sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+            sqHead_ = at<unsigned>(ring_, params.sq_off.head);
+            sqTail_ = at<unsigned>(ring_, params.sq_off.tail);
+            sqMask_ = *at<unsigned>(ring_, params.sq_off.ring_mask);
+            sqEntries_ = params.sq_entries;
+            sqeTail_ = *sqTail_;
+            // Entries are used in ring order, so the index array maps each slot to itself
+            unsigned* array = at<unsigned>(ring_, params.sq_off.array);
+            for(unsigned i = 0; i < sqEntries_; ++i) array[i] = i;
+
+            cqHead_ = at<unsigned>(ring_, params.cq_off.head);
+            cqTail_ = at<unsigned>(ring_, params.cq_off.tail);
+            cqMask_ = *at<unsigned>(ring_, params.cq_off.ring_mask);
+            cqes_ = at<io_uring_cqe>(ring_, params.cq_off.cqes);
+
+            // Opcodes the kernel knows (IORING_REGISTER_PROBE exists since 5.6)
+            supported_.assign(256, false);
+            std::vector<char> probeSpace(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+            auto* probe = reinterpret_cast<io_uring_probe*>(probeSpace.data());
+            if(ringRegister(fd_, IORING_REGISTER_PROBE, probe, 256) == 0) {
+                for(unsigned i = 0; i < probe->ops_len; ++i) {
+                    if(probe->ops[i].flags & IO_URING_OP_SUPPORTED) supported_[probe->ops[i].op] = true;
+                }
+            }
+        }
+
+        IoUring::~IoUring() {
+            ::munmap(sqes_, sqesSize_);
+            ::munmap(ring_, ringSize_);
+            ::close(fd_);
+        }
+
+        io_uring_sqe* IoUring::sqe() {
+            if(sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) submit(0);
+            io_uring_sqe* entry = &sqes_[sqeTail_ & sqMask_];
+            ++sqeTail_;
+            std::memset(entry, 0, sizeof(*entry));
+            return entry;
+        }
+
+        int IoUring::submit(unsigned waitFor) {
+            __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+            const unsigned pending = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+            if(pending == 0 && waitFor == 0) return 0;
+            int result = ringEnter(fd_, pending, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0);
+            return result < 0 ? -errno : result;
+        }
+
+        bool IoUring::supports(uint8_t opcode) const {
+            return supported_[opcode];
+        }
+
+        void IoUring::setupBuffers(uint16_t count, uint32_t size) {
+            bufferSize_ = size;
+            bufferData_.resize(static_cast<size_t>(count) * size);
+            io_uring_sqe* entry = sqe();
+            entry->opcode = IORING_OP_PROVIDE_BUFFERS;
+            entry->fd = count;
+            entry->addr = reinterpret_cast<uint64_t>(bufferData_.data());
+            entry->len = size;
+            entry->buf_group = BUFFER_GROUP;
+            entry->user_data = BUFFER_TAG;
+            int result = submit(1);
+            if(result >= 0) {
+                // Only this completion can be ready, nothing else was submitted yet
+                result = cqes_[*cqHead_ & cqMask_].res;
+                __atomic_store_n(cqHead_, *cqHead_ + 1, __ATOMIC_RELEASE);
+            }
+            if(result < 0) throw std::system_error(-result, std::generic_category(), "IORING_OP_PROVIDE_BUFFERS");
+        }
+
+        void IoUring::recycleBuffer(uint16_t id) {
+            io_uring_sqe* entry = sqe();
+            entry->opcode = IORING_OP_PROVIDE_BUFFERS;
+            entry->fd = 1;
+            entry->addr = reinterpret_cast<uint64_t>(buffer(id));
+            entry->len = bufferSize_;
+            entry->off = id;
+            entry->buf_group = BUFFER_GROUP;
+            entry->flags = IOSQE_CQE_SKIP_SUCCESS;
+            entry->user_data = BUFFER_TAG;
+        }
+
+    }
+}
+#endif
@@ -0,0 +1,58 @@
+#include "kvstore/utils/LazyFree.hpp"
+
+namespace kvspp {
+    namespace utils {
+
+        LazyFree& LazyFree::instance() {
+            // Never destroyed: stores released during static destruction must still find it
+            static LazyFree* instance = new LazyFree();
+            return *instance;
+        }
+
+        LazyFree::LazyFree() {
+            thread_ = std::thread(&LazyFree::run, this);
+            thread_.detach();
+        }
+
+        void LazyFree::enqueue(std::shared_ptr<void> object, size_t bytes) {
+            pendingBytes_ += bytes;
+            ++pendingObjects_;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                jobs_.push_back({ std::move(object), bytes });
+            }
+            cv_.notify_one();
+        }
+
+        LazyFree::Stats LazyFree::stats() const {
+            return { pendingBytes_.load(), pendingObjects_.load(), freedBytes_.load(), freedObjects_.load() };
+        }
+
+        void LazyFree::drain() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            drained_.wait(lock, [this]() { return jobs_.empty() && !busy_; });
+        }
+
+        void LazyFree::run() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while(true) {
+                cv_.wait(lock, [this]() { return !jobs_.empty(); });
+                Job job = std::move(jobs_.front());
+                jobs_.pop_front();
+                busy_ = true;
+                lock.unlock();
+
+                job.object.reset();
+                pendingBytes_ -= job.bytes;
+                --pendingObjects_;
+                freedBytes_ += job.bytes;
+                ++freedObjects_;
+
+                lock.lock();
+                busy_ = false;
+                if(jobs_.empty()) drained_.notify_all();
+            }
+        }
+
+    }
+}
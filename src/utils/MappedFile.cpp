@@ -0,0 +1,93 @@
+#include "kvstore/utils/MappedFile.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include <cerrno>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kvspp {
+    namespace utils {
+
+#ifdef _WIN32
+        MappedFile::MappedFile(const std::string& path) {
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if(file == INVALID_HANDLE_VALUE) {
+                throw exceptions::PersistenceException("Cannot open file for mapping: " + path);
+            }
+            fileHandle_ = file;
+
+            LARGE_INTEGER fileSize;
+            if(!GetFileSizeEx(file, &fileSize)) {
+                CloseHandle(file);
+                throw exceptions::PersistenceException("Cannot stat file for mapping: " + path);
+            }
+            size_ = static_cast<size_t>(fileSize.QuadPart);
+            if(size_ == 0) return;
+
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if(!mapping) {
+                CloseHandle(file);
+                throw exceptions::PersistenceException("Cannot map file: " + path);
+            }
+            mappingHandle_ = mapping;
+            data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            if(!data_) {
+                CloseHandle(mapping);
+                CloseHandle(file);
+                throw exceptions::PersistenceException("Cannot map file: " + path);
+            }
+        }
+
+        MappedFile::~MappedFile() {
+            if(data_) UnmapViewOfFile(data_);
+            if(mappingHandle_) CloseHandle(mappingHandle_);
+            if(fileHandle_) CloseHandle(fileHandle_);
+        }
+
+        void MappedFile::adviseSequential() const {
+        }
+#else
+        MappedFile::MappedFile(const std::string& path) {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0) {
+                throw exceptions::PersistenceException("Cannot open file for mapping '" + path + "': " + std::strerror(errno));
+            }
+
+            struct stat st;
+            if(::fstat(fd, &st) != 0) {
+                ::close(fd);
+                throw exceptions::PersistenceException("Cannot stat file for mapping '" + path + "': " + std::strerror(errno));
+            }
+            size_ = static_cast<size_t>(st.st_size);
+            if(size_ > 0) {
+                void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(addr == MAP_FAILED) {
+                    ::close(fd);
+                    throw exceptions::PersistenceException("Cannot map file '" + path + "': " + std::strerror(errno));
+                }
+                data_ = static_cast<const char*>(addr);
+            }
+            // The mapping stays valid after the descriptor is closed
+            ::close(fd);
+        }
+
+        MappedFile::~MappedFile() {
+            if(data_) ::munmap(const_cast<char*>(data_), size_);
+        }
+
+        void MappedFile::adviseSequential() const {
+            if(!data_) return;
+            ::madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+            ::madvise(const_cast<char*>(data_), size_, MADV_WILLNEED);
+        }
+#endif
+
+    }
+}
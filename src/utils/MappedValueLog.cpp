@@ -0,0 +1,103 @@
+#include "kvstore/utils/MappedValueLog.hpp"
+#include "kvstore/exceptions/Exceptions.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace kvspp {
+    namespace utils {
+
+        namespace {
+            constexpr uint64_t MIN_CAPACITY = 1 << 20;
+        }
+
+#ifdef _WIN32
+        MappedValueLog::MappedValueLog(const std::string& path) : path_(path) {
+            std::filesystem::path filePath(path);
+            if(filePath.has_parent_path()) std::filesystem::create_directories(filePath.parent_path());
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+            if(file == INVALID_HANDLE_VALUE) {
+                throw exceptions::PersistenceException("Cannot create value log: " + path);
+            }
+            fileHandle_ = file;
+        }
+
+        MappedValueLog::~MappedValueLog() {
+            if(map_) UnmapViewOfFile(map_);
+            if(mappingHandle_) CloseHandle(mappingHandle_);
+            if(fileHandle_) CloseHandle(fileHandle_);   // FILE_FLAG_DELETE_ON_CLOSE removes it
+        }
+
+        void MappedValueLog::remap(uint64_t capacity) {
+            if(map_) UnmapViewOfFile(map_);
+            if(mappingHandle_) CloseHandle(mappingHandle_);
+            map_ = nullptr;
+            mappingHandle_ = nullptr;
+
+            // Mapping a section larger than the file extends it
+            HANDLE mapping = CreateFileMappingA(fileHandle_, nullptr, PAGE_READWRITE,
+                static_cast<DWORD>(capacity >> 32), static_cast<DWORD>(capacity & 0xFFFFFFFF), nullptr);
+            if(!mapping) throw exceptions::PersistenceException("Cannot map value log: " + path_);
+            mappingHandle_ = mapping;
+            map_ = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+            if(!map_) throw exceptions::PersistenceException("Cannot map value log: " + path_);
+            capacity_ = capacity;
+        }
+#else
+        MappedValueLog::MappedValueLog(const std::string& path) : path_(path) {
+            std::filesystem::path filePath(path);
+            if(filePath.has_parent_path()) std::filesystem::create_directories(filePath.parent_path());
+            fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+            if(fd_ < 0) {
+                throw exceptions::PersistenceException("Cannot create value log '" + path + "': " + std::strerror(errno));
+            }
+        }
+
+        MappedValueLog::~MappedValueLog() {
+            if(map_) ::munmap(map_, capacity_);
+            if(fd_ >= 0) ::close(fd_);
+            ::unlink(path_.c_str());
+        }
+
+        void MappedValueLog::remap(uint64_t capacity) {
+            if(::ftruncate(fd_, static_cast<off_t>(capacity)) != 0) {
+                throw exceptions::PersistenceException("Cannot grow value log '" + path_ + "': " + std::strerror(errno));
+            }
+            if(map_) ::munmap(map_, capacity_);
+            map_ = nullptr;
+            void* map = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            if(map == MAP_FAILED) {
+                throw exceptions::PersistenceException("Cannot map value log '" + path_ + "': " + std::strerror(errno));
+            }
+            map_ = static_cast<char*>(map);
+            capacity_ = capacity;
+        }
+#endif
+
+        uint64_t MappedValueLog::append(const char* bytes, size_t length) {
+            if(size_ + length > capacity_) {
+                remap(std::max<uint64_t>({ capacity_ * 2, size_ + length, MIN_CAPACITY }));
+            }
+            const uint64_t offset = size_;
+            std::memcpy(map_ + offset, bytes, length);
+            size_ += length;
+            liveBytes_ += length;
+            return offset;
+        }
+
+        void MappedValueLog::reset() {
+            size_ = 0;
+            liveBytes_ = 0;
+        }
+
+    }
+}
@@ -0,0 +1,45 @@
+#include "kvstore/utils/ThreadPool.hpp"
+
+namespace kvspp {
+    namespace utils {
+
+        ThreadPool::ThreadPool(size_t threads) {
+            if(threads == 0) threads = defaultThreadCount();
+            workers_.reserve(threads);
+            for(size_t i = 0; i < threads; ++i) {
+                workers_.emplace_back(&ThreadPool::workerLoop, this);
+            }
+        }
+
+        ThreadPool::~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            cv_.notify_all();
+            for(auto& worker : workers_) {
+                worker.join();
+            }
+        }
+
+        size_t ThreadPool::defaultThreadCount() {
+            unsigned int cores = std::thread::hardware_concurrency();
+            return cores == 0 ? 1 : cores;
+        }
+
+        void ThreadPool::workerLoop() {
+            while(true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+                    if(tasks_.empty()) return;
+                    task = std::move(tasks_.front());
+                    tasks_.pop();
+                }
+                task();
+            }
+        }
+
+    }
+}